@@ -0,0 +1,266 @@
+/** @file bench.cc
+ * @brief A harness for micro-benchmarks.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "bench.h"
+#include "shadow.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+using namespace std;
+
+/// Default number of timed repetitions.
+static const unsigned DEFAULT_REPS = 7;
+
+/// Default warm-up time in seconds.
+static const double DEFAULT_WARMUP = 0.1;
+
+/// Append a string to JSON output as a quoted string.
+static void
+append_json_string(string & out, const string & value)
+{
+    out += '"';
+    for (size_t i = 0; i != value.size(); ++i) {
+	unsigned char ch = value[i];
+	if (ch == '"' || ch == '\\') {
+	    out += '\\';
+	    out += ch;
+	} else if (ch < 0x20) {
+	    char buf[8];
+	    snprintf(buf, sizeof(buf), "\\u%04x", ch);
+	    out += buf;
+	} else {
+	    out += ch;
+	}
+    }
+    out += '"';
+}
+
+/// Append a number to JSON output.
+static void
+append_json_number(string & out, double value)
+{
+    char buf[32];
+    if (fabs(value) < 1e15 && value == floor(value)) {
+	snprintf(buf, sizeof(buf), "%.0f", value);
+    } else {
+	snprintf(buf, sizeof(buf), "%.6g", value);
+    }
+    out += buf;
+}
+
+GeoEncode::BenchRunner::BenchRunner()
+    : reps(DEFAULT_REPS), warmup(DEFAULT_WARMUP), sink(0), points(0)
+{
+}
+
+/// Print a usage message for a benchmark program.
+static void
+usage(const char * program)
+{
+    fprintf(stderr, "usage: %s [--reps N] [--warmup SECONDS] [--points N] "
+	    "[--json FILE] [--counters] [--shadow FRACTION] [FILTER]\n",
+	    program);
+}
+
+bool
+GeoEncode::BenchRunner::parse_args(int argc, char ** argv)
+{
+    for (int i = 1; i < argc; ++i) {
+	const char * arg = argv[i];
+	if (arg[0] != '-') {
+	    filter = arg;
+	    continue;
+	}
+	if (strcmp(arg, "--counters") == 0) {
+	    if (!counters.open()) {
+		fprintf(stderr, "%s: counters unavailable, reporting times "
+			"only: %s\n", argv[0], counters.get_error().c_str());
+	    }
+	    continue;
+	}
+	if (i + 1 == argc) {
+	    usage(argv[0]);
+	    return false;
+	}
+	const char * value = argv[++i];
+	char * end = NULL;
+	bool valid;
+	if (strcmp(arg, "--reps") == 0) {
+	    reps = unsigned(strtoul(value, &end, 10));
+	    valid = (reps != 0);
+	} else if (strcmp(arg, "--warmup") == 0) {
+	    warmup = strtod(value, &end);
+	    valid = (warmup >= 0);
+	} else if (strcmp(arg, "--points") == 0) {
+	    points = strtoul(value, &end, 10);
+	    valid = (points != 0);
+	} else if (strcmp(arg, "--json") == 0) {
+	    json_path = value;
+	    valid = true;
+	} else if (strcmp(arg, "--shadow") == 0) {
+	    double fraction = strtod(value, &end);
+	    valid = (fraction >= 0 && fraction <= 1);
+	    set_shadow_fraction(fraction);
+	} else {
+	    valid = false;
+	}
+	if (!valid || (end && (*end || end == value))) {
+	    usage(argv[0]);
+	    return false;
+	}
+    }
+    return true;
+}
+
+GeoEncode::BenchResult &
+GeoEncode::BenchRunner::record(const string & name, size_t ops,
+			       vector<double> & times)
+{
+    sort(times.begin(), times.end());
+    size_t mid = times.size() / 2;
+    double median = times.size() % 2 ? times[mid] :
+	    (times[mid - 1] + times[mid]) * 0.5;
+    double scale = ops ? 1e9 / ops : 0;
+
+    BenchResult result;
+    result.name = name;
+    result.points = ops;
+    result.reps = unsigned(times.size());
+    result.ns_per_op = median * scale;
+    result.min_ns_per_op = times.front() * scale;
+    result.max_ns_per_op = times.back() * scale;
+    result.points_per_sec = median > 0 ? ops / median : 0;
+    printf("%-44s %9.2f ns/op %13.0f points/s  (min %.2f, max %.2f)\n",
+	   name.c_str(), result.ns_per_op, result.points_per_sec,
+	   result.min_ns_per_op, result.max_ns_per_op);
+
+    if (counters.any_available()) {
+	// Counts per operation, over all the timed repetitions.
+	double per_op = ops ? 1.0 / (double(ops) * times.size()) : 0;
+	string line = "   ";
+	double cycles, instructions;
+	if (counters.get(PerfCounters::CYCLES, cycles) &&
+	    counters.get(PerfCounters::INSTRUCTIONS, instructions) &&
+	    cycles > 0) {
+	    result.extra.push_back(make_pair("ipc", instructions / cycles));
+	    char buf[32];
+	    snprintf(buf, sizeof(buf), " ipc %.2f;", instructions / cycles);
+	    line += buf;
+	}
+	line += " per op:";
+	for (unsigned i = 0; i != PerfCounters::COUNTER_COUNT; ++i) {
+	    PerfCounters::Counter counter = PerfCounters::Counter(i);
+	    double value;
+	    if (!counters.get(counter, value)) continue;
+	    string key = PerfCounters::name(counter);
+	    result.extra.push_back(make_pair(key + "_per_op", value * per_op));
+	    char buf[64];
+	    snprintf(buf, sizeof(buf), " %s %.3f", key.c_str(),
+		     value * per_op);
+	    line += buf;
+	}
+	printf("%s\n", line.c_str());
+    }
+    fflush(stdout);
+
+    results.push_back(result);
+    return results.back();
+}
+
+bool
+GeoEncode::BenchRunner::finish()
+{
+    if (get_shadow_fraction() > 0) {
+	printf("\n%s", shadow_report().c_str());
+    }
+    if (json_path.empty()) {
+	return true;
+    }
+
+    string out = "{\n  \"context\": {\n    \"date\": ";
+    char date[32];
+    time_t t = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&t));
+    append_json_string(out, date);
+    out += ",\n    \"compiler\": ";
+#ifdef __VERSION__
+    append_json_string(out, __VERSION__);
+#else
+    append_json_string(out, "unknown");
+#endif
+    static const char * const simd_names[] = { "none", "avx2", "avx512" };
+    out += ",\n    \"simd\": ";
+    append_json_string(out, simd_names[simd_level()]);
+    out += ",\n    \"reps\": ";
+    append_json_number(out, reps);
+    out += ",\n    \"warmup\": ";
+    append_json_number(out, warmup);
+    out += "\n  },\n  \"benchmarks\": [";
+
+    for (size_t i = 0; i != results.size(); ++i) {
+	const BenchResult & r = results[i];
+	out += i ? ",\n    {" : "\n    {";
+	out += "\"name\": ";
+	append_json_string(out, r.name);
+	out += ", \"points\": ";
+	append_json_number(out, double(r.points));
+	out += ", \"reps\": ";
+	append_json_number(out, r.reps);
+	out += ", \"ns_per_op\": ";
+	append_json_number(out, r.ns_per_op);
+	out += ", \"min_ns_per_op\": ";
+	append_json_number(out, r.min_ns_per_op);
+	out += ", \"max_ns_per_op\": ";
+	append_json_number(out, r.max_ns_per_op);
+	out += ", \"points_per_sec\": ";
+	append_json_number(out, r.points_per_sec);
+	for (size_t j = 0; j != r.extra.size(); ++j) {
+	    out += ", ";
+	    append_json_string(out, r.extra[j].first);
+	    out += ": ";
+	    append_json_number(out, r.extra[j].second);
+	}
+	out += "}";
+    }
+    out += "\n  ]\n}\n";
+
+    FILE * f = fopen(json_path.c_str(), "w");
+    if (!f) {
+	perror(json_path.c_str());
+	return false;
+    }
+    bool ok = fwrite(out.data(), 1, out.size(), f) == out.size();
+    ok &= (fclose(f) == 0);
+    if (!ok) {
+	fprintf(stderr, "%s: write failed\n", json_path.c_str());
+    }
+    return ok;
+}
@@ -0,0 +1,202 @@
+/** @file bench.h
+ * @brief A harness for micro-benchmarks.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GEOENCODE_INCLUDED_BENCH_H
+#define GEOENCODE_INCLUDED_BENCH_H
+
+#include "perfcounters.h"
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+namespace GeoEncode {
+
+/** The result of one benchmark.
+ */
+struct BenchResult {
+    /** The name of the benchmark.
+     */
+    std::string name;
+
+    /** The number of operations (usually one per point) in each repetition.
+     */
+    size_t points;
+
+    /** The number of timed repetitions.
+     */
+    unsigned reps;
+
+    /** The median time per operation, in nanoseconds.
+     */
+    double ns_per_op;
+
+    /** The fastest repetition's time per operation, in nanoseconds.
+     */
+    double min_ns_per_op;
+
+    /** The slowest repetition's time per operation, in nanoseconds.
+     */
+    double max_ns_per_op;
+
+    /** The number of operations per second at the median time.
+     */
+    double points_per_sec;
+
+    /** Other values describing the benchmark, such as the proportion of
+     *  points a query matched, reported alongside the timings.
+     */
+    std::vector<std::pair<std::string, double> > extra;
+};
+
+/** Run micro-benchmarks and collect their results.
+ *
+ *  Each benchmark is a function which performs a fixed number of operations
+ *  and returns a checksum of their results, which is accumulated so that the
+ *  compiler can't discard the work.  The function is run repeatedly for a
+ *  warm-up period, to fill caches and let the processor's clock settle, and
+ *  then timed over a number of repetitions.  The median time is reported,
+ *  since it is less disturbed by other activity on the machine than the
+ *  mean.
+ *
+ *  Results are printed as they are measured, and can be written to a JSON
+ *  file to compare between releases.
+ */
+class BenchRunner {
+    /** The number of timed repetitions of each benchmark.
+     */
+    unsigned reps;
+
+    /** The minimum time to run each benchmark before timing it, in
+     *  seconds.
+     */
+    double warmup;
+
+    /** Only benchmarks whose names contain this are run.
+     */
+    std::string filter;
+
+    /** The file to write results to, or empty for none.
+     */
+    std::string json_path;
+
+    /** Hardware performance counters, if they were requested and are
+     *  available.
+     */
+    PerfCounters counters;
+
+    /** The results so far.
+     */
+    std::vector<BenchResult> results;
+
+    /** The accumulated checksums of the benchmarks.
+     */
+    uint64_t sink;
+
+    /** Get the current time in seconds.
+     */
+    static double now() {
+	return std::chrono::duration<double>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /** Summarise and print the times of a benchmark, and store the result.
+     */
+    BenchResult & record(const std::string & name, size_t points,
+			 std::vector<double> & times);
+
+  public:
+    /** The number of points given with --points, or 0 if the program
+     *  should use its default.
+     */
+    size_t points;
+
+    BenchRunner();
+
+    /** Parse command line arguments.
+     *
+     *  The options understood are "--reps N", "--warmup SECONDS",
+     *  "--points N", "--json FILE", "--counters", which reads hardware
+     *  performance counters around the timed repetitions (if the system
+     *  allows it; otherwise a warning is printed and only times are
+     *  reported), and "--shadow FRACTION", which checks that fraction of
+     *  the kernel calls against their references (see shadow.h) and
+     *  reports the checks at the end.  Any other argument is a filter on
+     *  the names of the benchmarks to run.
+     *
+     *  @returns false if the arguments were invalid, after printing a
+     *           message to stderr.
+     */
+    bool parse_args(int argc, char ** argv);
+
+    /** Check whether a benchmark is selected by the filter.
+     */
+    bool wanted(const std::string & name) const {
+	return filter.empty() || name.find(filter) != std::string::npos;
+    }
+
+    /** Run a benchmark.
+     *
+     *  @param name The name of the benchmark.
+     *  @param ops The number of operations performed by each call to
+     *             @a body.
+     *  @param body A function taking no arguments, which performs the
+     *              operations and returns a checksum.
+     *
+     *  @returns The result, to which extra values can be added until the
+     *           next benchmark is run, or NULL if the benchmark wasn't
+     *           selected by the filter.
+     */
+    template<typename F>
+    BenchResult * run(const std::string & name, size_t ops, F body) {
+	if (!wanted(name)) return NULL;
+	double start = now();
+	do {
+	    sink += body();
+	} while (now() - start < warmup);
+	std::vector<double> times;
+	counters.reset();
+	for (unsigned i = 0; i != reps; ++i) {
+	    counters.start();
+	    double t = now();
+	    sink += body();
+	    times.push_back(now() - t);
+	    counters.stop();
+	}
+	return &record(name, ops, times);
+    }
+
+    /** Write the results to the JSON file, if one was given, after
+     *  printing the report of any kernel checks.
+     *
+     *  @returns false if the file couldn't be written.
+     */
+    bool finish();
+};
+
+}
+
+#endif /* GEOENCODE_INCLUDED_BENCH_H */
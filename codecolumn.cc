@@ -0,0 +1,422 @@
+/** @file codecolumn.cc
+ * @brief Compressed storage for sorted columns of encoded coordinates.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "codecolumn.h"
+
+#include "metrics.h"
+#include "serialise.h"
+#include "shadow.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#if GEOENCODE_X86_SIMD
+# include <immintrin.h>
+#endif
+
+using namespace std;
+using GeoEncode::PackedCode;
+
+/// One more than the highest valid packed code.
+static const PackedCode CODE_LIMIT = PackedCode(1) << 48;
+
+/// Number of bytes in the serialised header of each block.
+static const size_t BLOCK_HEADER_BYTES = 6 + 6 + 6 + 1;
+
+/// Number of bytes needed for @a n values of @a width bits.
+static size_t
+packed_bytes(size_t n, unsigned width)
+{
+    return (n * width + 7) / 8;
+}
+
+/** Unpack and sum differences, starting at a given bit offset.
+ *
+ *  @param ptr The start of the packed differences.
+ *  @param bit The bit offset of the first difference to unpack.
+ *  @param width The number of bits in each difference.
+ *  @param min_delta The value to add to each difference.
+ *  @param prev The code preceding the first one to produce.
+ *  @param n The number of codes to produce.
+ *  @param result The array to write the codes to.
+ */
+static void
+unpack_scalar(const char * ptr, size_t bit, unsigned width,
+	      PackedCode min_delta, PackedCode prev, size_t n,
+	      PackedCode * result)
+{
+    const uint64_t mask = (uint64_t(1) << width) - 1;
+    for (size_t i = 0; i != n; ++i) {
+	uint64_t v = GeoEncode::load_le64(ptr + (bit >> 3)) >> (bit & 7);
+	prev += (v & mask) + min_delta;
+	result[i] = prev;
+	bit += width;
+    }
+}
+
+#if GEOENCODE_X86_SIMD
+/** AVX2 version of unpack_scalar(), starting at bit offset 0.
+ *
+ *  Four differences are gathered at a time (a difference of at most 48 bits
+ *  starting anywhere in a byte always fits in an unaligned 64 bit load),
+ *  shifted into place, and summed with a prefix sum across the lanes.
+ */
+__attribute__((target("avx2")))
+static void
+unpack_avx2(const char * ptr, unsigned width,
+	    PackedCode min_delta, PackedCode prev, size_t n,
+	    PackedCode * result)
+{
+    const __m256i mask = _mm256_set1_epi64x((int64_t(1) << width) - 1);
+    const __m256i add = _mm256_set1_epi64x(min_delta);
+    const __m256i seven = _mm256_set1_epi64x(7);
+    const __m256i step = _mm256_set1_epi64x(4 * width);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i bits = _mm256_set_epi64x(3 * width, 2 * width, width, 0);
+    __m256i running = _mm256_set1_epi64x(prev);
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+	__m256i offsets = _mm256_srli_epi64(bits, 3);
+	__m256i shifts = _mm256_and_si256(bits, seven);
+	__m256i v = _mm256_i64gather_epi64(
+		reinterpret_cast<const long long *>(ptr), offsets, 1);
+	v = _mm256_and_si256(_mm256_srlv_epi64(v, shifts), mask);
+	v = _mm256_add_epi64(v, add);
+
+	// Inclusive prefix sum over the four lanes.
+	v = _mm256_add_epi64(v, _mm256_blend_epi32(
+		_mm256_permute4x64_epi64(v, _MM_SHUFFLE(2, 1, 0, 0)),
+		zero, 0x03));
+	v = _mm256_add_epi64(v, _mm256_blend_epi32(
+		_mm256_permute4x64_epi64(v, _MM_SHUFFLE(1, 0, 0, 0)),
+		zero, 0x0f));
+	v = _mm256_add_epi64(v, running);
+
+	_mm256_storeu_si256(reinterpret_cast<__m256i *>(result + i), v);
+	running = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 3, 3, 3));
+	bits = _mm256_add_epi64(bits, step);
+    }
+    if (i != n) {
+	prev = _mm256_extract_epi64(running, 0);
+	unpack_scalar(ptr, i * width, width, min_delta, prev, n - i,
+		      result + i);
+    }
+}
+#endif
+
+bool
+GeoEncode::CodeColumn::finish_blocks(size_t data_len)
+{
+    size_t offset = 0;
+    for (size_t b = 0; b != blocks.size(); ++b) {
+	blocks[b].offset = offset;
+	offset += packed_bytes(block_size(b) - 1, blocks[b].width);
+    }
+    if (offset != data_len) {
+	return false;
+    }
+    data.append(8, '\0');
+    return true;
+}
+
+bool
+GeoEncode::CodeColumn::build(const PackedCode * codes, size_t n)
+{
+    MetricScope metric(METRIC_COLUMN_BUILD, n, n * sizeof(PackedCode));
+    blocks.clear();
+    data.clear();
+    count = 0;
+
+    for (size_t i = 0; i != n; ++i) {
+	if (rare(codes[i] >= CODE_LIMIT || (i && codes[i] < codes[i - 1]))) {
+	    return false;
+	}
+    }
+
+    count = n;
+    blocks.reserve((n + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    for (size_t start = 0; start < n; start += BLOCK_SIZE) {
+	size_t end = min(n, start + BLOCK_SIZE);
+	Block block;
+	block.first = codes[start];
+	block.last = codes[end - 1];
+
+	PackedCode min_delta = CODE_LIMIT, max_delta = 0;
+	for (size_t i = start + 1; i != end; ++i) {
+	    PackedCode delta = codes[i] - codes[i - 1];
+	    min_delta = min(min_delta, delta);
+	    max_delta = max(max_delta, delta);
+	}
+	if (end - start == 1) {
+	    min_delta = max_delta = 0;
+	}
+	block.min_delta = min_delta;
+	block.width = 0;
+	while ((max_delta - min_delta) >> block.width) {
+	    ++block.width;
+	}
+
+	// Pack the differences, least significant bit first.
+	uint64_t acc = 0;
+	unsigned acc_bits = 0;
+	for (size_t i = start + 1; i != end; ++i) {
+	    acc |= (codes[i] - codes[i - 1] - min_delta) << acc_bits;
+	    acc_bits += block.width;
+	    while (acc_bits >= 8) {
+		data += char(acc & 0xff);
+		acc >>= 8;
+		acc_bits -= 8;
+	    }
+	}
+	if (acc_bits) {
+	    data += char(acc & 0xff);
+	}
+	blocks.push_back(block);
+    }
+    finish_blocks(data.size());
+    return true;
+}
+
+size_t
+GeoEncode::CodeColumn::decode_block(size_t block, PackedCode * result,
+				    bool scalar) const
+{
+    const Block & b = blocks[block];
+    size_t n = block_size(block);
+    result[0] = b.first;
+    const char * ptr = data.data() + b.offset;
+#if GEOENCODE_X86_SIMD
+    if (!scalar && simd_level() >= SIMD_AVX2) {
+	unpack_avx2(ptr, b.width, b.min_delta, b.first, n - 1, result + 1);
+	return n;
+    }
+#else
+    (void)scalar;
+#endif
+    unpack_scalar(ptr, 0, b.width, b.min_delta, b.first, n - 1, result + 1);
+    return n;
+}
+
+void
+GeoEncode::CodeColumn::decode_all(vector<PackedCode> & result) const
+{
+    MetricScope metric(METRIC_COLUMN_DECODE, count, compressed_size());
+    size_t old_size = result.size();
+    result.resize(old_size + count);
+    ShadowCheck shadow(SHADOW_COLUMN_DECODE);
+    PackedCode buf[BLOCK_SIZE];
+    for (size_t b = 0; b != blocks.size(); ++b) {
+	size_t n = decode_block(b, buf);
+	copy(buf, buf + n, result.begin() + old_size + b * BLOCK_SIZE);
+    }
+
+    if (shadow.active()) {
+	shadow.fast_done();
+	for (size_t b = 0; b != blocks.size(); ++b) {
+	    size_t n = decode_block(b, buf, true);
+	    size_t pos = old_size + b * BLOCK_SIZE;
+	    size_t i = 0;
+	    while (i != n && buf[i] == result[pos + i]) {
+		++i;
+	    }
+	    if (i != n) {
+		char desc[160];
+		snprintf(desc, sizeof(desc),
+			 "code %zu of %zu (block width %u) decoded as "
+			 "%012llx, reference %012llx", b * BLOCK_SIZE + i,
+			 count, blocks[b].width,
+			 (unsigned long long)result[pos + i],
+			 (unsigned long long)buf[i]);
+		shadow.mismatch(desc);
+		break;
+	    }
+	}
+    }
+}
+
+size_t
+GeoEncode::CodeColumn::lower_bound(PackedCode code) const
+{
+    // Find the first block whose last code isn't less than code.
+    size_t lo = 0, hi = blocks.size();
+    while (lo < hi) {
+	size_t mid = lo + (hi - lo) / 2;
+	if (blocks[mid].last < code) {
+	    lo = mid + 1;
+	} else {
+	    hi = mid;
+	}
+    }
+    if (lo == blocks.size()) {
+	return count;
+    }
+    if (blocks[lo].first >= code) {
+	return lo * BLOCK_SIZE;
+    }
+    PackedCode buf[BLOCK_SIZE];
+    size_t n = decode_block(lo, buf);
+    return lo * BLOCK_SIZE + (std::lower_bound(buf, buf + n, code) - buf);
+}
+
+size_t
+GeoEncode::CodeColumn::filter(const DecoderWithBoundingBox & bbox,
+			      vector<size_t> & positions,
+			      vector<PackedCode> * codes) const
+{
+    MetricScope metric(METRIC_COLUMN_FILTER, count,
+		       blocks.size() * sizeof(Block));
+    ShadowCheck shadow(SHADOW_COLUMN_FILTER);
+    size_t old_size = positions.size();
+    size_t matches = 0;
+    PackedCode buf[BLOCK_SIZE];
+    for (size_t b = 0; b != blocks.size(); ++b) {
+	if (!bbox.might_contain_range(blocks[b].first, blocks[b].last)) {
+	    continue;
+	}
+	size_t n = decode_block(b, buf);
+	metric.add_bytes(((n - 1) * blocks[b].width + 7) / 8);
+	for (size_t i = 0; i != n; ++i) {
+	    char encoded[6];
+	    unpack(buf[i], encoded);
+	    double lat, lon;
+	    if (bbox.decode(encoded, 6, lat, lon)) {
+		positions.push_back(b * BLOCK_SIZE + i);
+		if (codes) codes->push_back(buf[i]);
+		++matches;
+	    }
+	}
+    }
+
+    if (shadow.active()) {
+	shadow.fast_done();
+	check_filter(bbox, positions, old_size, shadow);
+    }
+    return matches;
+}
+
+void
+GeoEncode::CodeColumn::check_filter(const DecoderWithBoundingBox & bbox,
+				    const vector<size_t> & positions,
+				    size_t old_size,
+				    ShadowCheck & shadow) const
+{
+    // Decode every code in full, and compare the positions accepted.
+    size_t next = old_size;
+    PackedCode buf[BLOCK_SIZE];
+    for (size_t b = 0; b != blocks.size(); ++b) {
+	size_t n = decode_block(b, buf, true);
+	for (size_t i = 0; i != n; ++i) {
+	    size_t pos = b * BLOCK_SIZE + i;
+	    char encoded[6];
+	    unpack(buf[i], encoded);
+	    double lat, lon;
+	    GeoEncode::decode(encoded, 6, lat, lon);
+	    bool expected = bbox.contains(lat, lon);
+	    bool got = (next != positions.size() && positions[next] == pos);
+	    if (got) {
+		++next;
+	    }
+	    if (got != expected) {
+		double lat1, lon1, lat2, lon2;
+		bbox.get_box(lat1, lon1, lat2, lon2);
+		char desc[200];
+		snprintf(desc, sizeof(desc),
+			 "box (%.9f, %.9f, %.9f, %.9f): code %012llx "
+			 "(%.9f, %.9f) at %zu %s, reference %s",
+			 lat1, lon1, lat2, lon2, (unsigned long long)buf[i],
+			 lat, lon, pos, got ? "accepted" : "rejected",
+			 expected ? "accepts" : "rejects");
+		shadow.mismatch(desc);
+		return;
+	    }
+	}
+    }
+    if (next != positions.size()) {
+	shadow.mismatch("positions accepted out of order");
+    }
+}
+
+void
+GeoEncode::CodeColumn::serialise(string & result) const
+{
+    append_uint(result, count, 8);
+    for (size_t b = 0; b != blocks.size(); ++b) {
+	append_uint(result, blocks[b].first, 6);
+	append_uint(result, blocks[b].last, 6);
+	append_uint(result, blocks[b].min_delta, 6);
+	append_uint(result, blocks[b].width, 1);
+    }
+    size_t data_len = data.size() - 8;
+    append_uint(result, data_len, 8);
+    result.append(data, 0, data_len);
+}
+
+bool
+GeoEncode::CodeColumn::unserialise(const char * ptr, size_t len)
+{
+    blocks.clear();
+    data.clear();
+    count = 0;
+
+    const char * end = ptr + len;
+    uint64_t n;
+    if (!read_uint(ptr, end, n, 8)) {
+	return false;
+    }
+    uint64_t nblocks = (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    if (nblocks > uint64_t(end - ptr) / BLOCK_HEADER_BYTES) {
+	return false;
+    }
+    blocks.resize(nblocks);
+    for (size_t b = 0; b != nblocks; ++b) {
+	uint64_t width;
+	if (!read_uint(ptr, end, blocks[b].first, 6) ||
+	    !read_uint(ptr, end, blocks[b].last, 6) ||
+	    !read_uint(ptr, end, blocks[b].min_delta, 6) ||
+	    !read_uint(ptr, end, width, 1) ||
+	    width > 48) {
+	    blocks.clear();
+	    return false;
+	}
+	blocks[b].width = width;
+    }
+    uint64_t data_len;
+    if (!read_uint(ptr, end, data_len, 8) ||
+	data_len != uint64_t(end - ptr)) {
+	blocks.clear();
+	return false;
+    }
+    count = n;
+    data.assign(ptr, data_len);
+    if (!finish_blocks(data_len)) {
+	blocks.clear();
+	data.clear();
+	count = 0;
+	return false;
+    }
+    return true;
+}
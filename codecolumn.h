@@ -0,0 +1,231 @@
+/** @file codecolumn.h
+ * @brief Compressed storage for sorted columns of encoded coordinates.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GEOENCODE_INCLUDED_CODECOLUMN_H
+#define GEOENCODE_INCLUDED_CODECOLUMN_H
+
+#include "geoencode.h"
+
+#include <string>
+#include <vector>
+
+namespace GeoEncode {
+
+class ShadowCheck;
+
+/** A sorted column of packed codes, stored in compressed blocks.
+ *
+ *  Codes are split into blocks of BLOCK_SIZE.  Each block stores its first
+ *  code in full (the frame of reference), and the differences between
+ *  consecutive codes, less the smallest such difference in the block, are
+ *  bit-packed using as many bits as the largest of them needs.  Sorted codes
+ *  for densely clustered points differ by far less than the full 48 bits, so
+ *  this typically takes a small fraction of the 6 bytes per code of the
+ *  uncompressed form.
+ *
+ *  Each block also records its first and last code, which allows binary
+ *  search over the blocks, and lets blocks which can't contain any matches
+ *  for a bounding box be skipped without being unpacked.
+ *
+ *  Blocks are unpacked with AVX2 where the processor supports it.
+ */
+class CodeColumn {
+  public:
+    /** Number of codes in each block (the final block may hold fewer).
+     */
+    static const size_t BLOCK_SIZE = 128;
+
+  private:
+    /** Header information for a block.
+     */
+    struct Block {
+	/** First code in the block.
+	 */
+	PackedCode first;
+
+	/** Last code in the block.
+	 */
+	PackedCode last;
+
+	/** Smallest difference between consecutive codes in the block.
+	 */
+	PackedCode min_delta;
+
+	/** Offset of the packed differences in data.
+	 */
+	size_t offset;
+
+	/** Number of bits used for each packed difference (0 to 48).
+	 */
+	unsigned width;
+    };
+
+    /** Headers for the blocks, in order.
+     */
+    std::vector<Block> blocks;
+
+    /** The packed differences for all blocks.
+     *
+     *  This is followed by 8 bytes of padding, so that unpacking can always
+     *  load a whole 64 bit word.
+     */
+    std::string data;
+
+    /** Number of codes in the column.
+     */
+    size_t count;
+
+    /** Fill in offsets and padding after the block widths are known.
+     *
+     *  @returns false if data is the wrong size for the blocks.
+     */
+    bool finish_blocks(size_t data_len);
+
+    /** Check the positions found by filter() against decoding every code
+     *  with the scalar unpacker and decode().
+     */
+    void check_filter(const DecoderWithBoundingBox & bbox,
+		      const std::vector<size_t> & positions, size_t old_size,
+		      ShadowCheck & shadow) const;
+
+  public:
+    /** Create an empty column.
+     */
+    CodeColumn() : count(0) {}
+
+    /** Build the column from an array of packed codes.
+     *
+     *  @param codes The codes, which must be in ascending order (duplicates
+     *               are allowed).
+     *  @param n The number of codes.
+     *
+     *  @returns true if the column was built, or false if the codes weren't
+     *           sorted or weren't valid packed codes, in which case the
+     *           column is left empty.
+     */
+    bool build(const PackedCode * codes, size_t n);
+
+    /** Build the column from a vector of packed codes.
+     */
+    bool build(const std::vector<PackedCode> & codes) {
+	return build(codes.empty() ? NULL : &codes[0], codes.size());
+    }
+
+    /** Get the number of codes in the column.
+     */
+    size_t size() const { return count; }
+
+    /** Get the number of blocks in the column.
+     */
+    size_t block_count() const { return blocks.size(); }
+
+    /** Get the first code in a block.
+     */
+    PackedCode block_first(size_t block) const {
+	return blocks[block].first;
+    }
+
+    /** Get the last code in a block.
+     */
+    PackedCode block_last(size_t block) const {
+	return blocks[block].last;
+    }
+
+    /** Get the number of codes in a block.
+     */
+    size_t block_size(size_t block) const {
+	return (block + 1 == blocks.size()) ?
+		count - block * BLOCK_SIZE : BLOCK_SIZE;
+    }
+
+    /** Unpack the codes in a block.
+     *
+     *  @param block The block to unpack.
+     *  @param result An array of at least BLOCK_SIZE codes to write to.
+     *  @param scalar If true, use the scalar unpacker whatever the SIMD
+     *                level, as a reference to check the SIMD one against.
+     *
+     *  @returns The number of codes written.
+     */
+    size_t decode_block(size_t block, PackedCode * result,
+			bool scalar = false) const;
+
+    /** Unpack every code in the column, appending them to a vector.
+     */
+    void decode_all(std::vector<PackedCode> & result) const;
+
+    /** Find the position of the first code which isn't less than a code.
+     *
+     *  @returns The position, or size() if all codes are less than @a code.
+     */
+    size_t lower_bound(PackedCode code) const;
+
+    /** Find the codes which lie inside a bounding box.
+     *
+     *  Blocks for which DecoderWithBoundingBox::might_contain_range() returns
+     *  false are skipped without being unpacked; the others are unpacked and
+     *  filtered one code at a time.
+     *
+     *  @param bbox The bounding box decoder.
+     *  @param positions A vector to append the positions of matching codes
+     *                   to.
+     *  @param codes If non-NULL, a vector to append the matching codes to.
+     *
+     *  @returns The number of matching codes.
+     */
+    size_t filter(const DecoderWithBoundingBox & bbox,
+		  std::vector<size_t> & positions,
+		  std::vector<PackedCode> * codes = NULL) const;
+
+    /** Get the number of bytes of memory used to hold the compressed codes.
+     */
+    size_t compressed_size() const {
+	return blocks.size() * sizeof(Block) + data.size();
+    }
+
+    /** Get the number of bytes of memory used by the column.
+     *
+     *  Unlike compressed_size(), this includes the column object, unused
+     *  capacity and the padding after the data.
+     */
+    size_t memory_used() const {
+	return sizeof(*this) + blocks.capacity() * sizeof(Block) +
+		data.capacity();
+    }
+
+    /** Serialise the column, appending it to a string.
+     */
+    void serialise(std::string & result) const;
+
+    /** Replace the contents of the column with a serialised column.
+     *
+     *  @returns false if the serialised form is invalid, in which case the
+     *           column is left empty.
+     */
+    bool unserialise(const char * ptr, size_t len);
+};
+
+}
+
+#endif /* GEOENCODE_INCLUDED_CODECOLUMN_H */
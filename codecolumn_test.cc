@@ -0,0 +1,230 @@
+/** @file codecolumn_test.cc
+ * @brief Tests for compressed columns of encoded coordinates.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "codecolumn.h"
+#include "simd.h"
+#include "testutils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+using GeoEncode::PackedCode;
+
+/** Check that a column built from some codes returns them again.
+ */
+static bool
+check_roundtrip(const vector<PackedCode> & codes)
+{
+    GeoEncode::CodeColumn column;
+    if (!column.build(codes)) {
+	fprintf(stderr, "build failed for %zu codes\n", codes.size());
+	return false;
+    }
+    vector<PackedCode> decoded;
+    column.decode_all(decoded);
+    if (decoded != codes) {
+	fprintf(stderr, "decoded codes differ for %zu codes\n", codes.size());
+	return false;
+    }
+
+    string serialised;
+    column.serialise(serialised);
+    GeoEncode::CodeColumn column2;
+    if (!column2.unserialise(serialised.data(), serialised.size())) {
+	fprintf(stderr, "unserialise failed for %zu codes\n", codes.size());
+	return false;
+    }
+    decoded.clear();
+    column2.decode_all(decoded);
+    if (decoded != codes) {
+	fprintf(stderr, "unserialised codes differ for %zu codes\n",
+		codes.size());
+	return false;
+    }
+    // Every truncation is rejected, leaving the column empty.
+    size_t min_len = serialised.size() < 2000 ? 0 : serialised.size() - 1;
+    for (size_t len = min_len; len < serialised.size(); ++len) {
+	if (column2.unserialise(serialised.data(), len) ||
+	    column2.size() != 0) {
+	    fprintf(stderr, "unserialise of %zu of %zu bytes succeeded\n",
+		    len, serialised.size());
+	    return false;
+	}
+    }
+    return true;
+}
+
+/** Check lower_bound() against std::lower_bound() for random probes.
+ */
+static bool
+check_lower_bound(const vector<PackedCode> & codes)
+{
+    GeoEncode::CodeColumn column;
+    column.build(codes);
+    for (int i = 0; i != 1000; ++i) {
+	PackedCode probe;
+	if (i % 2 && !codes.empty()) {
+	    probe = codes[random() % codes.size()];
+	} else {
+	    probe = ((PackedCode(random()) << 24) ^ random()) &
+		    ((PackedCode(1) << 48) - 1);
+	}
+	size_t expected = lower_bound(codes.begin(), codes.end(), probe) -
+		codes.begin();
+	size_t got = column.lower_bound(probe);
+	if (got != expected) {
+	    fprintf(stderr, "lower_bound(%llx) = %zu, expected %zu\n",
+		    (unsigned long long)probe, got, expected);
+	    return false;
+	}
+    }
+    return true;
+}
+
+/** Check that filtering a column gives the same results as decoding each
+ *  code with the bounding box decoder.
+ */
+static bool
+check_filter(const vector<PackedCode> & codes,
+	     double lat1, double lon1, double lat2, double lon2)
+{
+    GeoEncode::CodeColumn column;
+    column.build(codes);
+    GeoEncode::DecoderWithBoundingBox bb(lat1, lon1, lat2, lon2);
+
+    vector<size_t> expected;
+    for (size_t i = 0; i != codes.size(); ++i) {
+	string encoded;
+	GeoEncode::unpack(codes[i], encoded);
+	double lat, lon;
+	if (bb.decode(encoded, lat, lon)) {
+	    expected.push_back(i);
+	}
+    }
+
+    vector<size_t> positions;
+    vector<PackedCode> matched;
+    size_t n = column.filter(bb, positions, &matched);
+    if (n != expected.size() || positions != expected) {
+	fprintf(stderr, "filter(%g,%g,%g,%g) found %zu codes, expected %zu\n",
+		lat1, lon1, lat2, lon2, n, expected.size());
+	return false;
+    }
+    for (size_t i = 0; i != positions.size(); ++i) {
+	if (matched[i] != codes[positions[i]]) {
+	    fprintf(stderr, "filter returned wrong code at %zu\n",
+		    positions[i]);
+	    return false;
+	}
+    }
+    return true;
+}
+
+int main() {
+    bool ok = true;
+
+    GeoEncode::SimdLevel levels[] = {
+	GeoEncode::SIMD_NONE, GeoEncode::SIMD_AVX512
+    };
+    for (int l = 0; l != 2; ++l) {
+	GeoEncode::set_simd_limit(levels[l]);
+
+	// Sizes around the block size.
+	size_t sizes[] = { 0, 1, 2, 5, 127, 128, 129, 256, 1000, 100000 };
+	for (size_t i = 0; i != sizeof(sizes) / sizeof(sizes[0]); ++i) {
+	    vector<PackedCode> codes;
+	    make_codes(sizes[i], 0, 0, 180, codes);
+	    ok &= check_roundtrip(codes);
+	    ok &= check_lower_bound(codes);
+	    make_codes(sizes[i], 51.5, -0.1, 0.05, codes);
+	    ok &= check_roundtrip(codes);
+	    ok &= check_lower_bound(codes);
+	}
+
+	// Duplicates, and extreme differences.
+	vector<PackedCode> codes;
+	codes.push_back(0);
+	codes.push_back(0);
+	codes.push_back(0);
+	codes.push_back((PackedCode(1) << 48) - 1);
+	codes.push_back((PackedCode(1) << 48) - 1);
+	ok &= check_roundtrip(codes);
+	codes.assign(300, 12345);
+	ok &= check_roundtrip(codes);
+
+	// Filtering, including boxes over the poles and the 0/360 boundary.
+	make_codes(50000, 0, 0, 180, codes);
+	ok &= check_filter(codes, -90, -60, 10, 50);
+	ok &= check_filter(codes, -10, 0, 10, 50);
+	ok &= check_filter(codes, 20, 100, 90, 120);
+	ok &= check_filter(codes, -30, 350, 30, 10);
+	make_codes(50000, 51.5, -0.1, 1, codes);
+	ok &= check_filter(codes, 51.4, -0.5, 51.6, 0.2);
+	ok &= check_filter(codes, -10, 10, 10, 20);
+    }
+    GeoEncode::set_simd_limit(GeoEncode::SIMD_AVX512);
+
+    // Unsorted or out of range input is rejected.
+    {
+	vector<PackedCode> codes;
+	codes.push_back(2);
+	codes.push_back(1);
+	GeoEncode::CodeColumn column;
+	if (column.build(codes) || column.size() != 0) {
+	    fprintf(stderr, "unsorted codes were accepted\n");
+	    ok = false;
+	}
+	codes.assign(1, PackedCode(1) << 48);
+	if (column.build(codes)) {
+	    fprintf(stderr, "out of range code was accepted\n");
+	    ok = false;
+	}
+    }
+
+    // Dense clustered data should compress well.
+    {
+	vector<PackedCode> codes;
+	make_codes(1000000, 51.5, -0.1, 0.1, codes);
+	GeoEncode::CodeColumn column;
+	column.build(codes);
+	double ratio = double(codes.size() * 6) / column.compressed_size();
+	if (ratio < 3) {
+	    fprintf(stderr, "compression ratio %g for clustered codes\n",
+		    ratio);
+	    ok = false;
+	}
+	if (column.memory_used() < column.compressed_size() ||
+	    column.memory_used() > column.compressed_size() * 2) {
+	    fprintf(stderr, "column of %zu bytes uses %zu bytes of memory\n",
+		    column.compressed_size(), column.memory_used());
+	    ok = false;
+	}
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,521 @@
+/** @file corridor.cc
+ * @brief Queries for points within a distance of a route.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "corridor.h"
+
+#include "distance.h"
+#include "metrics.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using GeoEncode::CodeRange;
+using GeoEncode::PackedCode;
+
+/// Radians per degree.
+static const double RADIANS = M_PI / 180.0;
+
+/// Length of the longest prefix cells are refined to (15 second cells).
+static const unsigned MAX_PREFIX = 4;
+
+/// Classifications of cells.
+enum { CELL_OUTSIDE, CELL_PARTIAL, CELL_INSIDE };
+
+/// Calculate the dot product of two vectors.
+static inline double
+dot(const double * u, const double * v)
+{
+    return u[0] * v[0] + u[1] * v[1] + u[2] * v[2];
+}
+
+/// Calculate the cross product of two vectors.
+static inline void
+cross(const double * u, const double * v, double * result)
+{
+    result[0] = u[1] * v[2] - u[2] * v[1];
+    result[1] = u[2] * v[0] - u[0] * v[2];
+    result[2] = u[0] * v[1] - u[1] * v[0];
+}
+
+/// Calculate the squared distance between two points.
+static inline double
+distance_squared(const double * u, const double * v)
+{
+    double dx = u[0] - v[0];
+    double dy = u[1] - v[1];
+    double dz = u[2] - v[2];
+    return dx * dx + dy * dy + dz * dz;
+}
+
+/// Convert a squared chord length on a unit sphere to an angle.
+static inline double
+chord_angle(double chord2)
+{
+    return 2 * asin(min(1.0, sqrt(chord2) * 0.5));
+}
+
+/// Wrap a longitude to the range [0,360).
+static double
+wrap_longitude(double lon)
+{
+    lon = fmod(lon, 360.0);
+    if (lon < 0) {
+	lon += 360;
+    }
+    return lon;
+}
+
+GeoEncode::Corridor::Corridor(const vector<pair<double, double> > & points,
+			      double distance, size_t max_cells)
+{
+    angle = min(distance / EARTH_RADIUS, M_PI_2);
+    sin_angle = sin(angle);
+    double s = sin(angle * 0.5);
+    chord_squared = 4 * s * s;
+
+    for (size_t i = 0; i < points.size(); ++i) {
+	// A single point is a segment with both ends the same.
+	size_t j = (i + 1 < points.size()) ? i + 1 : i;
+	if (j == i && i != 0) {
+	    break;
+	}
+	Segment segment;
+	segment.lat1 = points[i].first;
+	segment.lon1 = points[i].second;
+	segment.lat2 = points[j].first;
+	segment.lon2 = points[j].second;
+	unit_vector(segment.lat1, segment.lon1, segment.a);
+	unit_vector(segment.lat2, segment.lon2, segment.b);
+	cross(segment.a, segment.b, segment.normal);
+	double len = sqrt(dot(segment.normal, segment.normal));
+	segment.has_arc = (len > 1e-12);
+	if (segment.has_arc) {
+	    for (int k = 0; k != 3; ++k) segment.normal[k] /= len;
+	    cross(segment.normal, segment.a, segment.to_b);
+	    cross(segment.b, segment.normal, segment.to_a);
+	}
+	segments.push_back(segment);
+    }
+    build_cover(max_cells);
+}
+
+double
+GeoEncode::Corridor::segment_angle(const Segment & segment,
+				   const double * p) const
+{
+    if (segment.has_arc &&
+	dot(p, segment.to_b) >= 0 && dot(p, segment.to_a) >= 0) {
+	return asin(min(1.0, fabs(dot(p, segment.normal))));
+    }
+    return chord_angle(min(distance_squared(p, segment.a),
+			   distance_squared(p, segment.b)));
+}
+
+bool
+GeoEncode::Corridor::near_segment(const Segment & segment,
+				  const double * p) const
+{
+    if (segment.has_arc &&
+	dot(p, segment.to_b) >= 0 && dot(p, segment.to_a) >= 0) {
+	// The nearest point on the great circle is in the segment, and the
+	// sine of the distance to it is the component along the normal.
+	return fabs(dot(p, segment.normal)) <= sin_angle;
+    }
+    return distance_squared(p, segment.a) <= chord_squared ||
+	    distance_squared(p, segment.b) <= chord_squared;
+}
+
+bool
+GeoEncode::Corridor::near_any(PackedCode code,
+			      const unsigned * list, size_t n) const
+{
+    double p[3];
+    code_unit_vector(code, p);
+    for (size_t i = 0; i != n; ++i) {
+	if (near_segment(segments[list[i]], p)) {
+	    return true;
+	}
+    }
+    return false;
+}
+
+/** Find the degree cells within a bounding box of a segment.
+ *
+ *  The box covers the latitudes of the ends, and of the point of the great
+ *  circle nearest a pole if that is in the segment, and the longitudes
+ *  between the ends, widened by the distance.
+ */
+void
+GeoEncode::Corridor::segment_degree_cells(unsigned index,
+					  vector<pair<unsigned, unsigned> > &
+					      result) const
+{
+    const Segment & segment = segments[index];
+    double min_lat = min(segment.lat1, segment.lat2);
+    double max_lat = max(segment.lat1, segment.lat2);
+    if (segment.has_arc) {
+	// The northernmost point of the great circle is the north pole
+	// projected onto its plane.
+	double v[3] = {
+	    -segment.normal[2] * segment.normal[0],
+	    -segment.normal[2] * segment.normal[1],
+	    1 - segment.normal[2] * segment.normal[2]
+	};
+	double len = sqrt(dot(v, v));
+	if (len > 1e-12) {
+	    for (int k = 0; k != 3; ++k) v[k] /= len;
+	    double lat = asin(min(1.0, v[2])) / RADIANS;
+	    if (dot(v, segment.to_b) >= 0 && dot(v, segment.to_a) >= 0) {
+		max_lat = max(max_lat, lat);
+	    }
+	    for (int k = 0; k != 3; ++k) v[k] = -v[k];
+	    if (dot(v, segment.to_b) >= 0 && dot(v, segment.to_a) >= 0) {
+		min_lat = min(min_lat, -lat);
+	    }
+	}
+    }
+    double margin = angle / RADIANS;
+    min_lat -= margin;
+    max_lat += margin;
+
+    double west = 0, width = 360;
+    if (min_lat > -90 && max_lat < 90) {
+	double lon1 = wrap_longitude(segment.lon1);
+	double lon2 = wrap_longitude(segment.lon2);
+	double d = lon2 - lon1;
+	if (d > 180) d -= 360;
+	if (d < -180) d += 360;
+	west = (d >= 0) ? lon1 : lon2;
+	width = fabs(d);
+	double cos_max = cos(max(-min_lat, max_lat) * RADIANS);
+	if (sin_angle < cos_max) {
+	    double lon_margin = asin(sin_angle / cos_max) / RADIANS;
+	    west = wrap_longitude(west - lon_margin);
+	    width += 2 * lon_margin;
+	} else {
+	    width = 360;
+	}
+	if (width >= 360) {
+	    west = 0;
+	    width = 360;
+	}
+    }
+
+    unsigned row_first = unsigned(max(0.0, floor(min_lat + 90)));
+    unsigned row_last = unsigned(min(180.0, floor(max_lat + 90)));
+    unsigned col_first = unsigned(floor(west));
+    unsigned cols = min(360u, unsigned(floor(west + width)) - col_first + 1);
+    for (unsigned row = row_first; row <= row_last; ++row) {
+	if (row == 180) {
+	    // The north pole has a cell of its own.
+	    result.push_back(make_pair(180u, index));
+	    continue;
+	}
+	for (unsigned i = 0; i != cols; ++i) {
+	    unsigned col = (col_first + i) % 360;
+	    result.push_back(make_pair(row + col * 181, index));
+	}
+    }
+}
+
+/** Classify a cell against a list of segments.
+ *
+ *  The cell is bounded by a circle around its centre, through its furthest
+ *  corner, and compared with the distance from the centre to each segment.
+ *
+ *  @returns CELL_INSIDE if the cell is wholly within the distance of one of
+ *           the segments, CELL_OUTSIDE if it is wholly beyond the distance
+ *           of all of them, or CELL_PARTIAL otherwise, in which case the
+ *           segments which may come within the distance of it are appended
+ *           to @a near.
+ */
+int
+GeoEncode::Corridor::classify(PackedCode prefix, unsigned len,
+			      const unsigned * list, size_t n,
+			      vector<unsigned> & near) const
+{
+    CellBounds cell;
+    if (!cell_bounds(prefix, len, cell)) {
+	return CELL_OUTSIDE;
+    }
+    double centre[3];
+    unit_vector((cell.min_lat + cell.max_lat) * 0.5,
+		(cell.min_lon + cell.max_lon) * 0.5, centre);
+    double radius = 0;
+    for (int i = 0; i != 4; ++i) {
+	double corner[3];
+	unit_vector((i & 1) ? cell.max_lat : cell.min_lat,
+		    (i & 2) ? cell.max_lon : cell.min_lon, corner);
+	radius = max(radius, distance_squared(centre, corner));
+    }
+    // Allow for rounding in the calculation of the angles.
+    radius = chord_angle(radius) + 1e-12;
+
+    size_t start = near.size();
+    for (size_t i = 0; i != n; ++i) {
+	double a = segment_angle(segments[list[i]], centre);
+	if (a + radius <= angle) {
+	    near.resize(start);
+	    return CELL_INSIDE;
+	}
+	if (a - radius <= angle) {
+	    near.push_back(list[i]);
+	}
+    }
+    return near.size() == start ? CELL_OUTSIDE : CELL_PARTIAL;
+}
+
+namespace {
+
+/** A cell being classified while building the cover.
+ *
+ *  Neighbouring cells which are inside the corridor are merged as they are
+ *  found, since they won't be refined further.
+ */
+struct WorkCell {
+    /// The first code in the cell.
+    PackedCode prefix;
+
+    /// The last code in the cell, or in the run of cells merged with it.
+    PackedCode last;
+
+    /// The length of the prefix denoting the cell.
+    unsigned len;
+
+    /// The classification of the cell.
+    int type;
+
+    /// Start of the segments which come near the cell.
+    size_t begin;
+
+    /// End of the segments which come near the cell.
+    size_t end;
+};
+
+/** Append a cell to a list of cells, merging it with the last if both are
+ *  inside the corridor and they are adjacent.
+ */
+static void
+add_cell(vector<WorkCell> & cells, const WorkCell & cell)
+{
+    if (cell.type == CELL_INSIDE && !cells.empty() &&
+	cells.back().type == CELL_INSIDE &&
+	cells.back().last + 1 == cell.prefix) {
+	cells.back().last = cell.last;
+	return;
+    }
+    cells.push_back(cell);
+}
+
+}
+
+/// Get the last code in the cell denoted by a prefix.
+static inline PackedCode
+prefix_last(PackedCode prefix, unsigned len)
+{
+    return prefix | ((PackedCode(1) << ((6 - len) * 8)) - 1);
+}
+
+void
+GeoEncode::Corridor::build_cover(size_t max_cells)
+{
+    vector<pair<unsigned, unsigned> > near;
+    for (unsigned i = 0; i != segments.size(); ++i) {
+	segment_degree_cells(i, near);
+    }
+    sort(near.begin(), near.end());
+    near.erase(unique(near.begin(), near.end()), near.end());
+
+    vector<WorkCell> work;
+    vector<unsigned> work_candidates;
+    vector<unsigned> list;
+    for (size_t i = 0; i != near.size(); ) {
+	unsigned dd = near[i].first;
+	list.clear();
+	while (i != near.size() && near[i].first == dd) {
+	    list.push_back(near[i++].second);
+	}
+	WorkCell cell;
+	cell.prefix = PackedCode(dd) << 32;
+	cell.len = 2;
+	cell.last = prefix_last(cell.prefix, cell.len);
+	cell.begin = work_candidates.size();
+	cell.type = classify(cell.prefix, cell.len, &list[0], list.size(),
+			     work_candidates);
+	cell.end = work_candidates.size();
+	if (cell.type != CELL_OUTSIDE) {
+	    add_cell(work, cell);
+	}
+    }
+
+    // Refine the cells which are partly inside, a level at a time, while
+    // the number of cells stays within the limit.
+    for (unsigned len = 2; len < MAX_PREFIX; ++len) {
+	size_t partial = 0;
+	for (size_t i = 0; i != work.size(); ++i) {
+	    partial += (work[i].type == CELL_PARTIAL);
+	}
+	// A segment crossing a cell passes through at least 15 of its
+	// children, so don't bother if that would exceed the limit.
+	if (partial == 0 || work.size() + partial * 15 > max_cells) {
+	    break;
+	}
+	vector<WorkCell> next;
+	vector<unsigned> next_candidates;
+	unsigned shift = (5 - len) * 8;
+	for (size_t i = 0; i != work.size(); ++i) {
+	    const WorkCell & cell = work[i];
+	    const unsigned * cell_list = work_candidates.empty() ? NULL :
+		    &work_candidates[0] + cell.begin;
+	    if (cell.type == CELL_INSIDE) {
+		WorkCell copy = cell;
+		copy.begin = copy.end = next_candidates.size();
+		add_cell(next, copy);
+		continue;
+	    }
+	    for (unsigned byte = 0; byte != 256; ++byte) {
+		WorkCell child;
+		child.prefix = cell.prefix | (PackedCode(byte) << shift);
+		child.len = len + 1;
+		child.last = prefix_last(child.prefix, child.len);
+		child.begin = next_candidates.size();
+		child.type = classify(child.prefix, child.len, cell_list,
+				      cell.end - cell.begin, next_candidates);
+		child.end = next_candidates.size();
+		if (child.type != CELL_OUTSIDE) {
+		    add_cell(next, child);
+		}
+	    }
+	}
+	if (next.size() > max_cells) {
+	    break;
+	}
+	swap(work, next);
+	swap(work_candidates, next_candidates);
+    }
+
+    candidates.swap(work_candidates);
+    for (size_t i = 0; i != work.size(); ++i) {
+	const WorkCell & w = work[i];
+	Cell cell;
+	cell.range.first = w.prefix;
+	cell.range.last = w.last;
+	cell.inside = (w.type == CELL_INSIDE);
+	cell.candidates_begin = w.begin;
+	cell.candidates_end = w.end;
+	cells.push_back(cell);
+    }
+}
+
+bool
+GeoEncode::Corridor::contains(PackedCode code) const
+{
+    // Find the last cell starting at or before the code.
+    size_t lo = 0, hi = cells.size();
+    while (lo != hi) {
+	size_t mid = (lo + hi) / 2;
+	if (cells[mid].range.first <= code) {
+	    lo = mid + 1;
+	} else {
+	    hi = mid;
+	}
+    }
+    if (lo == 0) {
+	return false;
+    }
+    const Cell & cell = cells[lo - 1];
+    if (code > cell.range.last) {
+	return false;
+    }
+    if (cell.inside) {
+	return true;
+    }
+    return near_any(code, &candidates[0] + cell.candidates_begin,
+		    cell.candidates_end - cell.candidates_begin);
+}
+
+size_t
+GeoEncode::Corridor::filter(const PackedCode * codes, size_t n,
+			    vector<size_t> & positions) const
+{
+    MetricScope metric(METRIC_CORRIDOR_FILTER, n);
+    size_t count = 0;
+    size_t pos = 0;
+    for (size_t i = 0; i != cells.size() && pos != n; ++i) {
+	const Cell & cell = cells[i];
+	pos = lower_bound(codes + pos, codes + n, cell.range.first) - codes;
+	if (cell.inside) {
+	    size_t end = upper_bound(codes + pos, codes + n,
+				     cell.range.last) - codes;
+	    count += end - pos;
+	    for ( ; pos != end; ++pos) {
+		positions.push_back(pos);
+	    }
+	    continue;
+	}
+	const unsigned * list = &candidates[0] + cell.candidates_begin;
+	size_t list_len = cell.candidates_end - cell.candidates_begin;
+	for ( ; pos != n && codes[pos] <= cell.range.last; ++pos) {
+	    if (near_any(codes[pos], list, list_len)) {
+		positions.push_back(pos);
+		++count;
+	    }
+	}
+    }
+    return count;
+}
+
+void
+GeoEncode::Corridor::cover(vector<CodeRange> & ranges) const
+{
+    size_t start = ranges.size();
+    for (size_t i = 0; i != cells.size(); ++i) {
+	if (ranges.size() != start &&
+	    ranges.back().last + 1 == cells[i].range.first) {
+	    ranges.back().last = cells[i].range.last;
+	} else {
+	    ranges.push_back(cells[i].range);
+	}
+    }
+}
+
+size_t
+GeoEncode::Corridor::inside_cell_count() const
+{
+    size_t count = 0;
+    for (size_t i = 0; i != cells.size(); ++i) {
+	count += cells[i].inside;
+    }
+    return count;
+}
+
+size_t
+GeoEncode::Corridor::memory_used() const
+{
+    return sizeof(*this) + segments.capacity() * sizeof(Segment) +
+	    cells.capacity() * sizeof(Cell) +
+	    candidates.capacity() * sizeof(unsigned);
+}
@@ -0,0 +1,230 @@
+/** @file corridor.h
+ * @brief Queries for points within a distance of a route.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GEOENCODE_INCLUDED_CORRIDOR_H
+#define GEOENCODE_INCLUDED_CORRIDOR_H
+
+#include "cover.h"
+#include "geoencode.h"
+
+#include <utility>
+#include <vector>
+
+namespace GeoEncode {
+
+/** The region within a distance of a polyline.
+ *
+ *  The polyline is a sequence of points joined by great-circle segments.
+ *  When the corridor is created, the cells of the encoding near it are
+ *  classified: cells which lie wholly within the distance of a single
+ *  segment are inside the corridor, cells which lie wholly beyond the
+ *  distance of every segment are dropped, and the rest are refined into
+ *  smaller cells, down to 15 second cells, as far as the limit on the number
+ *  of cells allows.  This gives a cover of the corridor by ranges of codes.
+ *
+ *  Filtering a sorted array of codes then accepts every code in a cell
+ *  which is inside the corridor without any geometry, and tests the codes in
+ *  the other cells against only the segments which come near that cell.
+ *  The tests work on unit vectors (see code_unit_vector()), so they need no
+ *  trigonometry: one dot product against each segment's great circle, or a
+ *  squared distance to its ends.
+ *
+ *  A code is in the corridor if its decoded coordinate is within the
+ *  distance of the polyline, as measured on a sphere of radius EARTH_RADIUS.
+ */
+class Corridor {
+    /** A segment of the polyline.
+     */
+    struct Segment {
+	/** Unit vectors for the ends of the segment.
+	 */
+	double a[3], b[3];
+
+	/** Unit normal to the plane of the segment's great circle.
+	 */
+	double normal[3];
+
+	/** Tangent to the great circle at @a a, pointing towards @a b.
+	 *
+	 *  Points whose dot product with this and with to_a are both
+	 *  non-negative are nearest to a point inside the segment.
+	 */
+	double to_b[3];
+
+	/** Tangent to the great circle at @a b, pointing towards @a a.
+	 */
+	double to_a[3];
+
+	/** False if the ends coincide (or are opposite), in which case only
+	 *  the distances to the ends are considered.
+	 */
+	bool has_arc;
+
+	/** The ends of the segment in degrees.
+	 */
+	double lat1, lon1, lat2, lon2;
+    };
+
+    /** A cell in the cover of the corridor.
+     */
+    struct Cell {
+	/** The range of codes in the cell.
+	 */
+	CodeRange range;
+
+	/** True if the whole cell is inside the corridor.
+	 */
+	bool inside;
+
+	/** Start of the segments which come near the cell, in candidates.
+	 */
+	size_t candidates_begin;
+
+	/** End of the segments which come near the cell, in candidates.
+	 */
+	size_t candidates_end;
+    };
+
+    /** The segments of the polyline.
+     */
+    std::vector<Segment> segments;
+
+    /** The distance, as an angle in radians.
+     */
+    double angle;
+
+    /** The sine of the angle.
+     */
+    double sin_angle;
+
+    /** The squared length of the chord of the angle on a unit sphere.
+     */
+    double chord_squared;
+
+    /** The cells covering the corridor, in ascending order of code.
+     */
+    std::vector<Cell> cells;
+
+    /** Indices of the segments which come near each cell which isn't wholly
+     *  inside the corridor.
+     */
+    std::vector<unsigned> candidates;
+
+    /** Calculate the angle from a point to a segment.
+     */
+    double segment_angle(const Segment & segment, const double * p) const;
+
+    /** Test whether a point is within the distance of a segment.
+     */
+    bool near_segment(const Segment & segment, const double * p) const;
+
+    /** Test whether a code is within the distance of any of a list of
+     *  segments.
+     */
+    bool near_any(PackedCode code, const unsigned * list, size_t n) const;
+
+    /** Find the degree cells which may come near a segment.
+     */
+    void segment_degree_cells(unsigned index,
+			      std::vector<std::pair<unsigned, unsigned> > &
+				  result) const;
+
+    /** Classify a cell against a list of segments.
+     */
+    int classify(PackedCode prefix, unsigned len,
+		 const unsigned * list, size_t n,
+		 std::vector<unsigned> & near) const;
+
+    /** Build the cover of the corridor.
+     */
+    void build_cover(size_t max_cells);
+
+  public:
+    /** Create a corridor.
+     *
+     *  @param points The points of the polyline, as (latitude, longitude)
+     *                pairs in degrees.  A single point gives a circle.
+     *                Consecutive points must not be opposite each other.
+     *  @param distance The distance from the polyline in metres, up to a
+     *                  quarter of the circumference of the earth.
+     *  @param max_cells The number of cells in the cover above which cells
+     *                   aren't refined further.  Corridors spanning many
+     *                   degrees may still have more cells than this.
+     */
+    Corridor(const std::vector<std::pair<double, double> > & points,
+	     double distance, size_t max_cells = 4096);
+
+    /** Test whether a code is within the corridor.
+     */
+    bool contains(PackedCode code) const;
+
+    /** Find the codes in a sorted array which are within the corridor.
+     *
+     *  @param codes The codes, in ascending order (duplicates are allowed).
+     *  @param n The number of codes.
+     *  @param positions A vector to append the positions of the matching
+     *                   codes to, in ascending order.
+     *
+     *  @returns The number of matching codes.
+     */
+    size_t filter(const PackedCode * codes, size_t n,
+		  std::vector<size_t> & positions) const;
+
+    /** Find the codes in a sorted vector which are within the corridor.
+     */
+    size_t filter(const std::vector<PackedCode> & codes,
+		  std::vector<size_t> & positions) const {
+	return filter(codes.empty() ? NULL : &codes[0], codes.size(),
+		      positions);
+    }
+
+    /** Get ranges of codes which cover the corridor.
+     *
+     *  Every code in the corridor lies in one of the ranges, so a sorted
+     *  index of codes can be searched by looking up each range and
+     *  filtering the codes found with contains().
+     *
+     *  @param ranges A vector to append the ranges to, in ascending order.
+     *                Adjacent ranges are merged.
+     */
+    void cover(std::vector<CodeRange> & ranges) const;
+
+    /** Get the number of cells in the cover.
+     */
+    size_t cell_count() const { return cells.size(); }
+
+    /** Get the number of cells in the cover which are wholly inside the
+     *  corridor.
+     */
+    size_t inside_cell_count() const;
+
+    /** Get the number of bytes of memory used by the corridor and its
+     *  cover.
+     */
+    size_t memory_used() const;
+};
+
+}
+
+#endif /* GEOENCODE_INCLUDED_CORRIDOR_H */
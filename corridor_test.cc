@@ -0,0 +1,220 @@
+/** @file corridor_test.cc
+ * @brief Tests for queries for points within a distance of a route.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "corridor.h"
+#include "distance.h"
+#include "testutils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+using GeoEncode::PackedCode;
+
+/// Radians per degree.
+static const double RADIANS = M_PI / 180.0;
+
+/** Calculate the initial bearing from one coordinate to another, in
+ *  radians.
+ */
+static double
+bearing(double lat1, double lon1, double lat2, double lon2)
+{
+    double phi1 = lat1 * RADIANS;
+    double phi2 = lat2 * RADIANS;
+    double dlon = (lon2 - lon1) * RADIANS;
+    return atan2(sin(dlon) * cos(phi2),
+		 cos(phi1) * sin(phi2) - sin(phi1) * cos(phi2) * cos(dlon));
+}
+
+/** Calculate the distance from a coordinate to a great-circle segment.
+ *
+ *  This uses the cross-track and along-track distances, which is a
+ *  different method from the one used by Corridor.
+ */
+static double
+segment_distance(double lat, double lon,
+		 double lat1, double lon1, double lat2, double lon2)
+{
+    double R = GeoEncode::EARTH_RADIUS;
+    double end = min(GeoEncode::haversine_distance(lat1, lon1, lat, lon),
+		     GeoEncode::haversine_distance(lat2, lon2, lat, lon));
+    double d12 = GeoEncode::haversine_distance(lat1, lon1, lat2, lon2) / R;
+    if (d12 == 0) {
+	return end;
+    }
+    double d13 = GeoEncode::haversine_distance(lat1, lon1, lat, lon) / R;
+    double t = bearing(lat1, lon1, lat, lon) - bearing(lat1, lon1, lat2, lon2);
+    double xt = asin(sin(d13) * sin(t));
+    double at = acos(max(-1.0, min(1.0, cos(d13) / cos(xt))));
+    if (cos(t) > 0 && at <= d12) {
+	return min(end, fabs(xt) * R);
+    }
+    return end;
+}
+
+/** Calculate the distance from a coordinate to a polyline.
+ */
+static double
+polyline_distance(double lat, double lon,
+		  const vector<pair<double, double> > & points)
+{
+    if (points.size() == 1) {
+	return GeoEncode::haversine_distance(lat, lon, points[0].first,
+					     points[0].second);
+    }
+    double best = HUGE_VAL;
+    for (size_t i = 0; i + 1 < points.size(); ++i) {
+	best = min(best, segment_distance(lat, lon,
+					  points[i].first, points[i].second,
+					  points[i + 1].first,
+					  points[i + 1].second));
+    }
+    return best;
+}
+
+/** Make a sorted set of codes for random points near a polyline.
+ */
+static void
+make_codes(const vector<pair<double, double> > & points, double spread,
+	   size_t n, vector<PackedCode> & codes)
+{
+    codes.clear();
+    for (size_t i = 0; i != n; ++i) {
+	size_t j = random() % points.size();
+	size_t k = (j + 1 < points.size()) ? j + 1 : j;
+	double t = double(random()) / RAND_MAX;
+	double lat = points[j].first + t * (points[k].first - points[j].first);
+	double lon = points[j].second + t * (points[k].second - points[j].second);
+	lat = max(-90.0, min(90.0, lat + random_offset(spread)));
+	codes.push_back(pack_coord(lat, fmod(lon + random_offset(spread) + 720,
+					     360)));
+    }
+    sort(codes.begin(), codes.end());
+}
+
+/** Check a corridor against the distance from each code to the polyline.
+ */
+static bool
+check_corridor(const vector<pair<double, double> > & points, double distance,
+	       double spread, size_t max_cells = 4096)
+{
+    vector<PackedCode> codes;
+    make_codes(points, spread, 20000, codes);
+    GeoEncode::Corridor corridor(points, distance, max_cells);
+
+    vector<GeoEncode::CodeRange> ranges;
+    corridor.cover(ranges);
+    vector<size_t> expected;
+    size_t r = 0;
+    for (size_t i = 0; i != codes.size(); ++i) {
+	bool in = corridor.contains(codes[i]);
+	if (in) {
+	    expected.push_back(i);
+	    while (r != ranges.size() && ranges[r].last < codes[i]) ++r;
+	    if (r == ranges.size() || ranges[r].first > codes[i]) {
+		fprintf(stderr, "code %zu in corridor isn't in the cover\n", i);
+		return false;
+	    }
+	}
+
+	string encoded;
+	GeoEncode::unpack(codes[i], encoded);
+	double lat, lon;
+	GeoEncode::decode(encoded, lat, lon);
+	double d = polyline_distance(lat, lon, points);
+	if (fabs(d - distance) > 0.01 && in != (d < distance)) {
+	    fprintf(stderr, "corridor of %g m: (%.9g,%.9g) at %.9g m %s\n",
+		    distance, lat, lon, d,
+		    in ? "was accepted" : "was rejected");
+	    return false;
+	}
+    }
+
+    vector<size_t> positions;
+    size_t n = corridor.filter(codes, positions);
+    if (n != expected.size() || positions != expected) {
+	fprintf(stderr, "filter found %zu codes, expected %zu\n", n,
+		expected.size());
+	return false;
+    }
+    return true;
+}
+
+int main() {
+    bool ok = true;
+
+    // A route across London, at several distances.
+    vector<pair<double, double> > points;
+    points.push_back(make_pair(51.45, -0.35));
+    points.push_back(make_pair(51.52, -0.12));
+    points.push_back(make_pair(51.50, 0.05));
+    points.push_back(make_pair(51.60, 0.10));
+    ok &= check_corridor(points, 500, 0.02);
+    ok &= check_corridor(points, 5000, 0.1);
+    ok &= check_corridor(points, 5000, 0.1, 10);
+    {
+	// A wide corridor has cells wholly inside it.
+	GeoEncode::Corridor corridor(points, 5000);
+	if (corridor.inside_cell_count() == 0) {
+	    fprintf(stderr, "no cells inside a 5 km corridor\n");
+	    ok = false;
+	}
+    }
+
+    // A single point.
+    points.assign(1, make_pair(-33.9, 151.2));
+    ok &= check_corridor(points, 2000, 0.05);
+
+    // Across the antimeridian, and the 0/360 boundary.
+    points.clear();
+    points.push_back(make_pair(-17.5, 177.5));
+    points.push_back(make_pair(-16.9, 179.9));
+    points.push_back(make_pair(-16.5, 181.5));
+    ok &= check_corridor(points, 3000, 0.1);
+    points.clear();
+    points.push_back(make_pair(5.0, -0.5));
+    points.push_back(make_pair(5.3, 0.5));
+    ok &= check_corridor(points, 3000, 0.1);
+
+    // Long segments, whose great circles bend towards the pole, and a
+    // segment over the pole.
+    points.clear();
+    points.push_back(make_pair(50.0, -120.0));
+    points.push_back(make_pair(50.0, 0.0));
+    ok &= check_corridor(points, 100000, 5);
+    points.clear();
+    points.push_back(make_pair(85.0, 30.0));
+    points.push_back(make_pair(85.0, 210.0));
+    ok &= check_corridor(points, 20000, 1);
+    points.clear();
+    points.push_back(make_pair(-89.5, 0.0));
+    points.push_back(make_pair(-89.0, 90.0));
+    ok &= check_corridor(points, 10000, 1);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,219 @@
+/** @file cover.cc
+ * @brief Ranges of packed codes covering a bounding box.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "cover.h"
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using GeoEncode::CodeRange;
+using GeoEncode::PackedCode;
+
+/// Number of 16ths of a second in a degree.
+static const int DEGREE = 3600 * 16;
+
+/// Number of 16ths of a second in a 4 minute group.
+static const int GROUP = 4 * 60 * 16;
+
+/// Index of the last 4 minute group in a degree.
+static const int LAST_GROUP = 14;
+
+/// Amount to widen the box by, in 16ths of a second, to allow for rounding.
+static const double SLACK = 0.001;
+
+/** Calculate the first code with a given prefix.
+ *
+ *  @param dd The first two bytes, combining the degrees.
+ *  @param a The group of 4 minutes of latitude.
+ *  @param b The group of 4 minutes of longitude.
+ */
+static PackedCode
+group_start(unsigned dd, int a, int b)
+{
+    return (PackedCode(dd) << 32) | (PackedCode(a) << 28) |
+	    (PackedCode(b) << 24);
+}
+
+/** Calculate the last code with a given prefix.
+ *
+ *  Group 15 isn't used, so the range is extended over it when @a b (and
+ *  also @a a) is the last group, so that ranges for neighbouring cells
+ *  can be merged.
+ */
+static PackedCode
+group_end(unsigned dd, int a, int b)
+{
+    PackedCode end = group_start(dd, a, b) | 0xffffff;
+    if (b == LAST_GROUP) {
+	end |= 0x0fffffff;
+	if (a == LAST_GROUP) {
+	    end |= 0xffffffff;
+	}
+    }
+    return end;
+}
+
+/** A range of longitudes, in 16ths of a second.
+ */
+struct LonInterval {
+    int first, last;
+};
+
+/** Add ranges covering part of the box.
+ *
+ *  @param lat_first The first latitude, in 16ths of a second north of the
+ *                   south pole.
+ *  @param lat_last The last latitude.
+ *  @param lons The longitude intervals of the box.
+ *  @param refine Whether to refine to 4 minute groups.
+ */
+static void
+add_ranges(int lat_first, int lat_last, const vector<LonInterval> & lons,
+	   bool refine, vector<CodeRange> & ranges)
+{
+    int row_first = lat_first / DEGREE;
+    int row_last = lat_last / DEGREE;
+    for (size_t i = 0; i != lons.size(); ++i) {
+	int col_first = lons[i].first / DEGREE;
+	int col_last = lons[i].last / DEGREE;
+	for (int col = col_first; col <= col_last; ++col) {
+	    int b_first = 0, b_last = LAST_GROUP;
+	    if (refine && col == col_first) {
+		b_first = (lons[i].first % DEGREE) / GROUP;
+	    }
+	    if (refine && col == col_last) {
+		b_last = (lons[i].last % DEGREE) / GROUP;
+	    }
+	    if (b_first == 0 && b_last == LAST_GROUP) {
+		// A whole column of the degree cells can be one range.
+		int a_first = refine ? (lat_first % DEGREE) / GROUP : 0;
+		int a_last = refine ? (lat_last % DEGREE) / GROUP : LAST_GROUP;
+		CodeRange range;
+		range.first = group_start(row_first + col * 181, a_first, 0);
+		range.last = group_end(row_last + col * 181, a_last,
+				       LAST_GROUP);
+		ranges.push_back(range);
+		continue;
+	    }
+	    for (int row = row_first; row <= row_last; ++row) {
+		unsigned dd = row + col * 181;
+		int a_first = 0, a_last = LAST_GROUP;
+		if (row == row_first) {
+		    a_first = (lat_first % DEGREE) / GROUP;
+		}
+		if (row == row_last) {
+		    a_last = (lat_last % DEGREE) / GROUP;
+		}
+		for (int a = a_first; a <= a_last; ++a) {
+		    CodeRange range;
+		    range.first = group_start(dd, a, b_first);
+		    range.last = group_end(dd, a, b_last);
+		    ranges.push_back(range);
+		}
+	    }
+	}
+    }
+}
+
+/// Order ranges by their first code.
+static bool
+range_less(const CodeRange & a, const CodeRange & b)
+{
+    return a.first < b.first;
+}
+
+/// Sort ranges, and merge any which overlap or are adjacent.
+static void
+merge_ranges(vector<CodeRange> & ranges, size_t start)
+{
+    sort(ranges.begin() + start, ranges.end(), range_less);
+    size_t out = start;
+    for (size_t i = start; i != ranges.size(); ++i) {
+	if (out != start && ranges[i].first <= ranges[out - 1].last + 1) {
+	    ranges[out - 1].last = max(ranges[out - 1].last, ranges[i].last);
+	} else {
+	    ranges[out++] = ranges[i];
+	}
+    }
+    ranges.resize(out);
+}
+
+void
+GeoEncode::bounding_box_cover(double lat1, double lon1,
+			      double lat2, double lon2,
+			      vector<CodeRange> & ranges, size_t max_ranges)
+{
+    MetricScope metric(METRIC_BOX_COVER);
+    size_t start = ranges.size();
+
+    // Coordinates at the poles are accepted whatever their longitude, and
+    // are always encoded with longitude 0.
+    if (lat1 <= -90) {
+	CodeRange range = { 0, 0 };
+	ranges.push_back(range);
+    }
+    if (lat2 >= 90) {
+	CodeRange range = { PackedCode(180) << 32, PackedCode(180) << 32 };
+	ranges.push_back(range);
+    }
+
+    // Latitude range in 16ths of a second, excluding the north pole.
+    double lat_lo = max(0.0, floor((lat1 + 90.0) * DEGREE - SLACK));
+    double lat_hi = min(180.0 * DEGREE - 1,
+			ceil((lat2 + 90.0) * DEGREE + SLACK));
+    if (lat_lo <= lat_hi) {
+	// Longitude intervals, wrapped in the same way as the decoder.
+	lon1 = fmod(lon1, 360.0);
+	if (lon1 < 0) lon1 += 360;
+	lon2 = fmod(lon2, 360.0);
+	if (lon2 < 0) lon2 += 360;
+	int lon_lo = int(max(0.0, floor(lon1 * DEGREE - SLACK)));
+	int lon_hi = int(min(360.0 * DEGREE - 1, ceil(lon2 * DEGREE + SLACK)));
+	vector<LonInterval> lons;
+	if (lon1 <= lon2) {
+	    LonInterval interval = { lon_lo, lon_hi };
+	    lons.push_back(interval);
+	} else {
+	    LonInterval east = { 0, lon_hi };
+	    LonInterval west = { lon_lo, 360 * DEGREE - 1 };
+	    lons.push_back(east);
+	    lons.push_back(west);
+	}
+
+	vector<CodeRange> cells;
+	add_ranges(int(lat_lo), int(lat_hi), lons, true, cells);
+	merge_ranges(cells, 0);
+	if (cells.size() > max_ranges) {
+	    cells.clear();
+	    add_ranges(int(lat_lo), int(lat_hi), lons, false, cells);
+	}
+	ranges.insert(ranges.end(), cells.begin(), cells.end());
+    }
+    merge_ranges(ranges, start);
+    metric.add_points(ranges.size() - start);
+}
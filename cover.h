@@ -0,0 +1,72 @@
+/** @file cover.h
+ * @brief Ranges of packed codes covering a bounding box.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GEOENCODE_INCLUDED_COVER_H
+#define GEOENCODE_INCLUDED_COVER_H
+
+#include "geoencode.h"
+
+#include <vector>
+
+namespace GeoEncode {
+
+/** A range of packed codes.
+ */
+struct CodeRange {
+    /** The first code in the range.
+     */
+    PackedCode first;
+
+    /** The last code in the range (inclusive).
+     */
+    PackedCode last;
+};
+
+/** Calculate ranges of packed codes which cover a bounding box.
+ *
+ *  Every code which DecoderWithBoundingBox would accept for the box lies in
+ *  one of the ranges, so a sorted index of codes can be searched by looking
+ *  up each range and filtering the codes found with the decoder.
+ *
+ *  The box is covered by the 1 degree cells denoted by 2 byte prefixes, and
+ *  where the number of ranges allows, the cells at the edges of the box are
+ *  refined to the 4 minute cells denoted by 3 byte prefixes.  Ranges which
+ *  are adjacent in code order are merged.
+ *
+ *  @param lat1 The latitude of the southern edge of the bounding box.
+ *  @param lon1 The longitude of the western edge of the bounding box.
+ *  @param lat2 The latitude of the northern edge of the bounding box.
+ *  @param lon2 The longitude of the eastern edge of the bounding box.
+ *  @param ranges A vector to append the ranges to, in ascending order.
+ *  @param max_ranges The number of ranges above which the edges aren't
+ *                    refined.  Boxes spanning many degrees of longitude may
+ *                    still produce more ranges than this.
+ */
+extern void
+bounding_box_cover(double lat1, double lon1, double lat2, double lon2,
+		   std::vector<CodeRange> & ranges, size_t max_ranges = 256);
+
+}
+
+#endif /* GEOENCODE_INCLUDED_COVER_H */
@@ -0,0 +1,131 @@
+/** @file cover_test.cc
+ * @brief Tests for covering bounding boxes with ranges of codes.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "cover.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+using GeoEncode::CodeRange;
+using GeoEncode::PackedCode;
+
+/** Check that the cover of a box contains every code the decoder accepts.
+ *
+ *  @returns the number of ranges, or 0 on failure.
+ */
+static size_t
+check_cover(double lat1, double lon1, double lat2, double lon2,
+	    size_t max_ranges = 256)
+{
+    vector<CodeRange> ranges;
+    GeoEncode::bounding_box_cover(lat1, lon1, lat2, lon2, ranges,
+				  max_ranges);
+    for (size_t i = 0; i != ranges.size(); ++i) {
+	if (ranges[i].first > ranges[i].last ||
+	    (i && ranges[i].first <= ranges[i - 1].last + 1)) {
+	    fprintf(stderr, "cover(%g,%g,%g,%g): ranges not sorted and "
+		    "disjoint\n", lat1, lon1, lat2, lon2);
+	    return 0;
+	}
+    }
+
+    GeoEncode::DecoderWithBoundingBox bb(lat1, lon1, lat2, lon2);
+    double width = fmod(lon2 - lon1 + 720.0, 360.0);
+    for (int i = 0; i != 5000; ++i) {
+	// Pick points in and around the box, and on its edges.
+	double lat = lat1 - 0.1 + ((random() * (lat2 - lat1 + 0.2)) / RAND_MAX);
+	double lon = lon1 - 0.1 + ((random() * (width + 0.2)) / RAND_MAX);
+	switch (random() % 8) {
+	    case 0: lat = lat1; break;
+	    case 1: lat = lat2; break;
+	    case 2: lon = lon1; break;
+	    case 3: lon = lon2; break;
+	}
+	if (lat < -90) lat = -90;
+	if (lat > 90) lat = 90;
+	string encoded;
+	GeoEncode::encode(lat, lon, encoded);
+	double d_lat, d_lon;
+	if (!bb.decode(encoded, d_lat, d_lon)) {
+	    continue;
+	}
+	PackedCode code = GeoEncode::pack(encoded.data());
+	bool found = false;
+	for (size_t j = 0; j != ranges.size(); ++j) {
+	    if (ranges[j].first <= code && code <= ranges[j].last) {
+		found = true;
+		break;
+	    }
+	}
+	if (!found) {
+	    fprintf(stderr, "cover(%g,%g,%g,%g) misses %.15g,%.15g\n",
+		    lat1, lon1, lat2, lon2, lat, lon);
+	    return 0;
+	}
+    }
+    return ranges.size() ? ranges.size() : 1;
+}
+
+int main() {
+    bool ok = true;
+
+    ok &= check_cover(51.4, -0.3, 51.6, 0.1) != 0;
+    ok &= check_cover(-90, -60, 10, 50) != 0;
+    ok &= check_cover(80, 100, 90, 120) != 0;
+    ok &= check_cover(-10, 350, 10, 5) != 0;
+    ok &= check_cover(-10, 0, 10, 360) != 0;
+    ok &= check_cover(10, 20, 10, 20) != 0;
+    ok &= check_cover(-1, 179, 1, -179) != 0;
+    for (int i = 0; i != 300; ++i) {
+	double lat1 = ((random() * 180.0) / RAND_MAX) - 90.0;
+	double lat2 = lat1 + ((random() * 10.0) / RAND_MAX);
+	if (lat2 > 90 || random() % 10 == 0) lat2 = 90;
+	if (random() % 10 == 0) lat1 = -90;
+	double lon1 = ((random() * 720.0) / RAND_MAX) - 360.0;
+	double lon2 = lon1 + ((random() * 10.0) / RAND_MAX);
+	ok &= check_cover(lat1, lon1, lat2, lon2, 1 + random() % 300) != 0;
+    }
+
+    // A small box within one degree cell is refined to a few ranges.
+    {
+	vector<CodeRange> ranges;
+	GeoEncode::bounding_box_cover(51.45, 0.01, 51.55, 0.1, ranges);
+	// Three rows of 4 minute groups, each covering two groups.
+	if (ranges.size() != 3) {
+	    fprintf(stderr, "small box gave %zu ranges\n", ranges.size());
+	    ok = false;
+	}
+	PackedCode cell_size = PackedCode(1) << 32;
+	if (ranges.size() && ranges[0].last - ranges[0].first >= cell_size) {
+	    fprintf(stderr, "small box wasn't refined\n");
+	    ok = false;
+	}
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,631 @@
+/** @file dbscan.cc
+ * @brief Density-based clustering of encoded coordinates.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "dbscan.h"
+
+#include "distance.h"
+#include "metrics.h"
+#include "neighbours.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <utility>
+
+using namespace std;
+using GeoEncode::PackedCode;
+
+/// The most cells to look for neighbours in before using larger cells.
+static const size_t MAX_NEIGHBOURS = 1024;
+
+/// Number of cells in each unit of work handed to a thread.
+static const size_t CHUNK_CELLS = 256;
+
+/// Allowance for rounding in deciding whether cells are within eps across.
+static const double CELL_MARGIN = 1.001;
+
+namespace {
+
+/// A cell holding at least one code.
+struct Cell {
+    /// The first code in the cell.
+    PackedCode prefix;
+
+    /// The position of the first code in the cell.
+    size_t begin;
+
+    /// The position after the last code in the cell.
+    size_t end;
+
+    /// The position of the first core point in the cell, or end if none.
+    size_t first_core;
+
+    /// Whether the core points in the cell are all in the same set.
+    bool joined;
+};
+
+/// Order cells by prefix.
+inline bool
+operator<(const Cell & cell, PackedCode prefix)
+{
+    return cell.prefix < prefix;
+}
+
+/// The neighbouring cells of a run of cells.
+struct Chunk {
+    /// The neighbours of the i-th cell are offsets[i] to offsets[i + 1].
+    vector<size_t> offsets;
+
+    /// The indices of the neighbouring cells, ascending for each cell.
+    vector<size_t> neighbours;
+
+    /// Whether each neighbouring cell lies wholly within eps of the cell.
+    vector<char> near;
+};
+
+/// Buffers for a thread, reused between chunks.
+struct Workspace {
+    vector<PackedCode> prefixes;
+    vector<pair<size_t, size_t> > runs;
+};
+
+/// The state of a clustering.
+class Dbscan {
+    /// The codes being clustered.
+    const PackedCode * codes;
+
+    /// The number of codes.
+    size_t n;
+
+    /// The neighbourhood radius in metres.
+    double eps;
+
+    /// The number of codes within eps which makes a core point.
+    size_t min_points;
+
+    /// The squared chord length for eps on a unit sphere.
+    double max_chord_squared;
+
+    /// The length of the prefixes used to bucket codes.
+    unsigned len;
+
+    /// Whether all the codes in a cell are within eps of each other.
+    bool small_cells;
+
+    /// The cells holding codes, in ascending order.
+    vector<Cell> cells;
+
+    /// The neighbours of the cells, CHUNK_CELLS cells at a time.
+    vector<Chunk> chunks;
+
+    /// The unit vector for each code, from code_unit_vector_batch().
+    vector<double> xyz;
+
+    /// Whether each code is a core point.
+    vector<char> core;
+
+    /// The union-find forest over the core points.
+    vector<atomic<size_t> > parent;
+
+    /// The index of the next chunk to work on.
+    atomic<size_t> next_chunk;
+
+    typedef void (Dbscan::*Stage)(size_t, Workspace &);
+
+    void find_neighbours(size_t cell, Workspace & ws, Chunk & out);
+
+    /// Check whether two codes are within eps of each other.
+    bool within(size_t a, size_t b) const {
+	const double * u = &xyz[a * 3];
+	const double * v = &xyz[b * 3];
+	double dx = u[0] - v[0], dy = u[1] - v[1], dz = u[2] - v[2];
+	return dx * dx + dy * dy + dz * dz <= max_chord_squared;
+    }
+
+    void decode(size_t chunk, Workspace & ws);
+
+    size_t find(size_t x);
+
+    void unite(size_t a, size_t b);
+
+    void find_cores(size_t chunk, Workspace & ws);
+
+    void link_within(size_t chunk, Workspace & ws);
+
+    void link_between(size_t chunk, Workspace & ws);
+
+    void label_borders(size_t chunk, Workspace & ws);
+
+    void worker(Stage stage);
+
+    void run(Stage stage, unsigned threads);
+
+    /// The label of each code.
+    vector<long> & labels;
+
+  public:
+    Dbscan(const PackedCode * codes_, size_t n_, double eps_,
+	   size_t min_points_, vector<long> & labels_);
+
+    size_t label_cores();
+
+    void decode_stage(unsigned threads) {
+	run(&Dbscan::decode, threads);
+    }
+
+    void find_cores_stage(unsigned threads) {
+	run(&Dbscan::find_cores, threads);
+    }
+
+    void link_cores_stage(unsigned threads) {
+	run(&Dbscan::link_within, threads);
+	run(&Dbscan::link_between, threads);
+    }
+
+    void label_borders_stage(unsigned threads) {
+	run(&Dbscan::label_borders, threads);
+    }
+
+    size_t chunk_count() const { return chunks.size(); }
+};
+
+}
+
+Dbscan::Dbscan(const PackedCode * codes_, size_t n_, double eps_,
+	       size_t min_points_, vector<long> & labels_)
+    : codes(codes_), n(n_), eps(eps_), min_points(min_points_),
+      xyz(n_ * 3), core(n_), parent(n_), next_chunk(0), labels(labels_)
+{
+    double radians = min(eps / GeoEncode::EARTH_RADIUS, M_PI);
+    double s = sin(radians * 0.5);
+    max_chord_squared = 4 * s * s;
+
+    // Use the largest cells which are no more than eps across, so a cell
+    // holding enough codes is all core points.  If those are much smaller
+    // than eps, so that each would have a great many neighbours, use the
+    // next size up instead, and compare the codes in each cell.
+    len = 6;
+    small_cells = false;
+    for (unsigned l = 2; l <= 6; ++l) {
+	if (GeoEncode::cell_height(l) * M_SQRT2 * CELL_MARGIN <= eps) {
+	    len = l;
+	    small_cells = true;
+	    if (l > 2 && GeoEncode::cell_height(l) * 4 < eps) {
+		len = l - 1;
+		small_cells = false;
+	    }
+	    break;
+	}
+    }
+
+    unsigned shift = (6 - len) * 8;
+    size_t pos = 0;
+    while (pos != n) {
+	Cell cell;
+	cell.prefix = (codes[pos] >> shift) << shift;
+	cell.begin = pos;
+	PackedCode next = cell.prefix + (PackedCode(1) << shift);
+	pos = lower_bound(codes + pos, codes + n, next) - codes;
+	cell.end = cell.first_core = pos;
+	cell.joined = false;
+	cells.push_back(cell);
+    }
+    chunks.resize((cells.size() + CHUNK_CELLS - 1) / CHUNK_CELLS);
+}
+
+/** Find the cells which might hold codes within eps of a cell.
+ *
+ *  The block of cells around the cell is found with cells_within_distance(),
+ *  which may use larger cells, in which case the cells holding codes within
+ *  each are found.  Cells which are certainly further away than eps are left
+ *  out, and those certainly within eps of all of the cell are marked as
+ *  near.
+ *
+ *  @param cell The index of the cell.
+ *  @param ws The thread's buffers.
+ *  @param out The chunk to append the indices of the cells to, in ascending
+ *             order, not including the cell itself.
+ */
+void
+Dbscan::find_neighbours(size_t cell, Workspace & ws, Chunk & out)
+{
+    const PackedCode prefix = cells[cell].prefix;
+    GeoEncode::CellBounds bounds;
+    GeoEncode::cell_bounds(prefix, len, bounds);
+    ws.prefixes.clear();
+    unsigned l = GeoEncode::cells_within_distance(prefix, len, eps,
+						  MAX_NEIGHBOURS, ws.prefixes);
+    unsigned shift = (6 - l) * 8;
+
+    // Bound the distance to other cells from the centre of this one.
+    double lat = (bounds.min_lat + bounds.max_lat) / 2;
+    double lon = (bounds.min_lon + bounds.max_lon) / 2;
+    double radius = max(
+	GeoEncode::haversine_distance(lat, lon, bounds.min_lat, bounds.min_lon),
+	GeoEncode::haversine_distance(lat, lon, bounds.max_lat, bounds.min_lon));
+    GeoEncode::CellDistanceBounds distances(lat, lon);
+    double reach = min((eps + radius) / GeoEncode::EARTH_RADIUS, M_PI);
+    double max_rank = sin(reach * 0.5);
+    max_rank *= max_rank;
+    double near_rank = -1;
+    if (eps > radius) {
+	near_rank = sin((eps - radius) / GeoEncode::EARTH_RADIUS * 0.5);
+	near_rank *= near_rank;
+    }
+
+    PackedCode span = PackedCode(1) << shift;
+    vector<Cell>::iterator c = cells.begin();
+    for (size_t i = 0; i != ws.prefixes.size(); ++i) {
+	PackedCode first = ws.prefixes[i];
+	c = lower_bound(c, cells.end(), first);
+	for ( ; c != cells.end() && c->prefix < first + span; ++c) {
+	    size_t index = c - cells.begin();
+	    if (index == cell) continue;
+	    GeoEncode::CellBounds other;
+	    GeoEncode::cell_bounds(c->prefix, len, other);
+	    if (distances.min_rank(other) > max_rank) continue;
+	    out.neighbours.push_back(index);
+	    out.near.push_back(distances.max_rank(other) <= near_rank);
+	}
+    }
+}
+
+/// Calculate the unit vectors for the codes in the cells of a chunk.
+void
+Dbscan::decode(size_t chunk, Workspace &)
+{
+    size_t first = chunk * CHUNK_CELLS;
+    size_t last = min(first + CHUNK_CELLS, cells.size());
+    size_t begin = cells[first].begin;
+    GeoEncode::code_unit_vector_batch(codes + begin,
+				      cells[last - 1].end - begin,
+				      &xyz[begin * 3]);
+}
+
+/** Find the root of the set holding a core point.
+ *
+ *  Each set is linked under its lowest position, so the root is the first
+ *  core point in the cluster.  Paths are halved as they are followed.
+ */
+size_t
+Dbscan::find(size_t x)
+{
+    while (true) {
+	size_t p = parent[x];
+	if (p == x) {
+	    return x;
+	}
+	size_t g = parent[p];
+	if (g != p) {
+	    parent[x].compare_exchange_weak(p, g);
+	}
+	x = g;
+    }
+}
+
+/// Merge the sets holding two core points.
+void
+Dbscan::unite(size_t a, size_t b)
+{
+    while (true) {
+	a = find(a);
+	b = find(b);
+	if (a == b) {
+	    return;
+	}
+	if (a < b) {
+	    swap(a, b);
+	}
+	size_t expected = a;
+	if (parent[a].compare_exchange_strong(expected, b)) {
+	    return;
+	}
+    }
+}
+
+/** Find the neighbours of the cells in a chunk and their core points.
+ */
+void
+Dbscan::find_cores(size_t chunk, Workspace & ws)
+{
+    Chunk & info = chunks[chunk];
+    size_t first = chunk * CHUNK_CELLS;
+    size_t last = min(first + CHUNK_CELLS, cells.size());
+    info.offsets.push_back(0);
+    for (size_t c = first; c != last; ++c) {
+	find_neighbours(c, ws, info);
+	info.offsets.push_back(info.neighbours.size());
+
+	Cell & cell = cells[c];
+	size_t nb = info.offsets[c - first];
+	size_t nb_end = info.offsets[c - first + 1];
+	// All the codes in near cells are within eps of every code in this
+	// one, and so are those in this one if it's small.
+	size_t near_count = small_cells ? cell.end - cell.begin : 0;
+	for (size_t j = nb; j != nb_end; ++j) {
+	    if (info.near[j]) {
+		const Cell & other = cells[info.neighbours[j]];
+		near_count += other.end - other.begin;
+	    }
+	}
+	bool all_core = near_count >= min_points;
+
+	// The codes in the other cells, as runs of contiguous positions.
+	ws.runs.clear();
+	size_t total = near_count;
+	if (!small_cells) {
+	    total += cell.end - cell.begin;
+	    ws.runs.push_back(make_pair(cell.begin, cell.end));
+	}
+	for (size_t j = nb; j != nb_end && !all_core; ++j) {
+	    if (info.near[j]) continue;
+	    const Cell & other = cells[info.neighbours[j]];
+	    total += other.end - other.begin;
+	    if (!ws.runs.empty() && ws.runs.back().second == other.begin) {
+		ws.runs.back().second = other.end;
+	    } else {
+		ws.runs.push_back(make_pair(other.begin, other.end));
+	    }
+	}
+	if (total < min_points) {
+	    // There aren't enough codes around for any to be core points.
+	    continue;
+	}
+
+	for (size_t pos = cell.begin; pos != cell.end; ++pos) {
+	    size_t count = near_count;
+	    for (size_t r = 0; r != ws.runs.size() && count < min_points; ++r) {
+		for (size_t q = ws.runs[r].first; q != ws.runs[r].second; ++q) {
+		    count += within(pos, q);
+		}
+	    }
+	    if (count >= min_points) {
+		core[pos] = true;
+		parent[pos] = pos;
+		if (cell.first_core == cell.end) {
+		    cell.first_core = pos;
+		}
+	    }
+	}
+    }
+}
+
+/** Merge the sets of core points within eps of each other in each cell of
+ *  a chunk.
+ */
+void
+Dbscan::link_within(size_t chunk, Workspace &)
+{
+    size_t first = chunk * CHUNK_CELLS;
+    size_t last = min(first + CHUNK_CELLS, cells.size());
+    for (size_t c = first; c != last; ++c) {
+	Cell & cell = cells[c];
+	if (cell.first_core == cell.end) continue;
+	for (size_t pos = cell.first_core; pos != cell.end; ++pos) {
+	    if (!core[pos]) continue;
+	    if (small_cells) {
+		unite(cell.first_core, pos);
+		continue;
+	    }
+	    for (size_t q = pos + 1; q != cell.end; ++q) {
+		if (core[q] && within(pos, q)) {
+		    unite(pos, q);
+		}
+	    }
+	}
+	cell.joined = true;
+	if (!small_cells) {
+	    size_t root = find(cell.first_core);
+	    for (size_t pos = cell.first_core + 1; pos != cell.end; ++pos) {
+		if (core[pos] && find(pos) != root) {
+		    cell.joined = false;
+		    break;
+		}
+	    }
+	}
+    }
+}
+
+/** Merge the sets of core points within eps of each other, for the core
+ *  points in the cells of a chunk and those in later cells.
+ *
+ *  Once the core points in a cell are all in one set (as they always are in
+ *  small cells), one link to a core point in it is enough, and a pair of
+ *  such cells already in the same set needs no more work.
+ */
+void
+Dbscan::link_between(size_t chunk, Workspace &)
+{
+    const Chunk & info = chunks[chunk];
+    size_t first = chunk * CHUNK_CELLS;
+    size_t last = min(first + CHUNK_CELLS, cells.size());
+    for (size_t c = first; c != last; ++c) {
+	const Cell & cell = cells[c];
+	if (cell.first_core == cell.end) continue;
+	for (size_t i = info.offsets[c - first];
+	     i != info.offsets[c - first + 1]; ++i) {
+	    size_t j = info.neighbours[i];
+	    const Cell & other = cells[j];
+	    if (j < c || other.first_core == other.end) continue;
+	    if (info.near[i]) {
+		// Every core point in each cell is within eps of every one in
+		// the other.
+		unite(cell.first_core, other.first_core);
+		if (!cell.joined) {
+		    for (size_t pos = cell.first_core; pos != cell.end; ++pos) {
+			if (core[pos]) unite(pos, other.first_core);
+		    }
+		}
+		if (!other.joined) {
+		    for (size_t q = other.first_core; q != other.end; ++q) {
+			if (core[q]) unite(cell.first_core, q);
+		    }
+		}
+		continue;
+	    }
+	    bool both_joined = cell.joined && other.joined;
+	    if (both_joined && find(cell.first_core) == find(other.first_core)) {
+		continue;
+	    }
+	    bool linked = false;
+	    for (size_t pos = cell.first_core; pos != cell.end && !linked;
+		 ++pos) {
+		if (!core[pos]) continue;
+		if (other.joined && find(pos) == find(other.first_core)) {
+		    continue;
+		}
+		for (size_t q = other.first_core; q != other.end; ++q) {
+		    if (core[q] && within(pos, q)) {
+			unite(pos, q);
+			linked = both_joined;
+			if (other.joined) break;
+		    }
+		}
+	    }
+	}
+    }
+}
+
+/** Number the clusters, and label the core points.
+ *
+ *  @returns The number of clusters.
+ */
+size_t
+Dbscan::label_cores()
+{
+    labels.assign(n, GeoEncode::DBSCAN_NOISE);
+    size_t clusters = 0;
+    for (size_t pos = 0; pos != n; ++pos) {
+	if (!core[pos]) continue;
+	size_t root = find(pos);
+	labels[pos] = (root == pos) ? long(clusters++) : labels[root];
+    }
+    return clusters;
+}
+
+/** Label the border points in the cells of a chunk with the cluster of the
+ *  first core point within eps of them.
+ */
+void
+Dbscan::label_borders(size_t chunk, Workspace &)
+{
+    const Chunk & info = chunks[chunk];
+    size_t first = chunk * CHUNK_CELLS;
+    size_t last = min(first + CHUNK_CELLS, cells.size());
+    for (size_t c = first; c != last; ++c) {
+	const Cell & cell = cells[c];
+	if (small_cells && cell.end - cell.begin >= min_points) continue;
+	size_t nb = info.offsets[c - first];
+	size_t nb_end = info.offsets[c - first + 1];
+	for (size_t pos = cell.begin; pos != cell.end; ++pos) {
+	    if (core[pos]) continue;
+	    // Look through the cells in order, including this one, so the
+	    // first core point in the array within eps is found.
+	    size_t j = nb;
+	    bool done_self = false;
+	    while (labels[pos] == GeoEncode::DBSCAN_NOISE) {
+		size_t index;
+		bool near = false;
+		if (!done_self && (j == nb_end || info.neighbours[j] > c)) {
+		    index = c;
+		    near = small_cells;
+		    done_self = true;
+		} else if (j != nb_end) {
+		    index = info.neighbours[j];
+		    near = info.near[j++];
+		} else {
+		    break;
+		}
+		const Cell & other = cells[index];
+		if (other.first_core == other.end) continue;
+		if (near) {
+		    labels[pos] = labels[other.first_core];
+		    break;
+		}
+		for (size_t q = other.first_core; q != other.end; ++q) {
+		    if (core[q] && within(pos, q)) {
+			labels[pos] = labels[q];
+			break;
+		    }
+		}
+	    }
+	}
+    }
+}
+
+/// Run a stage on chunks until there are none left.
+void
+Dbscan::worker(Stage stage)
+{
+    Workspace ws;
+    while (true) {
+	size_t chunk = next_chunk++;
+	if (chunk >= chunks.size()) {
+	    break;
+	}
+	(this->*stage)(chunk, ws);
+    }
+}
+
+/// Run a stage on all the chunks, with a number of threads.
+void
+Dbscan::run(Stage stage, unsigned threads)
+{
+    next_chunk = 0;
+    vector<thread> workers;
+    for (unsigned i = 1; i < threads; ++i) {
+	workers.push_back(thread(&Dbscan::worker, this, stage));
+    }
+    worker(stage);
+    for (size_t i = 0; i != workers.size(); ++i) {
+	workers[i].join();
+    }
+}
+
+size_t
+GeoEncode::dbscan(const PackedCode * codes, size_t n, double eps,
+		  size_t min_points, vector<long> & labels, unsigned threads)
+{
+    MetricScope metric(METRIC_DBSCAN, n);
+    labels.assign(n, DBSCAN_NOISE);
+    if (n == 0 || eps < 0) {
+	return 0;
+    }
+    Dbscan clustering(codes, n, eps, min_points, labels);
+    if (threads == 0) {
+	threads = max(1u, thread::hardware_concurrency());
+    }
+    threads = unsigned(min(size_t(threads), clustering.chunk_count()));
+    // The codes are only read here, to find their unit vectors; the other
+    // stages work on those.
+    clustering.decode_stage(threads);
+    metric.add_bytes(n * sizeof(PackedCode));
+    clustering.find_cores_stage(threads);
+    clustering.link_cores_stage(threads);
+    size_t clusters = clustering.label_cores();
+    clustering.label_borders_stage(threads);
+    return clusters;
+}
@@ -0,0 +1,90 @@
+/** @file dbscan.h
+ * @brief Density-based clustering of encoded coordinates.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GEOENCODE_INCLUDED_DBSCAN_H
+#define GEOENCODE_INCLUDED_DBSCAN_H
+
+#include "geoencode.h"
+
+#include <vector>
+
+namespace GeoEncode {
+
+/** The label given to codes which aren't in any cluster.
+ */
+const long DBSCAN_NOISE = -1;
+
+/** Cluster the codes in a sorted array with DBSCAN.
+ *
+ * A code is a core point if at least @a min_points codes (counting itself)
+ * lie within @a eps of it.  Core points within @a eps of each other are in
+ * the same cluster.  Other codes within @a eps of a core point are border
+ * points, and join the cluster of the first such core point in the array;
+ * the rest are noise.  Clusters are numbered from 0 in the order of their
+ * first core point in the array, so the labels don't depend on the number
+ * of threads.
+ *
+ * Codes are bucketed by the cells of the longest prefix whose cells are no
+ * more than @a eps across, so that all the codes in a cell are within
+ * @a eps of each other: a cell holding @a min_points codes holds only core
+ * points, all in one cluster, without any distances being calculated.  The
+ * codes in other cells are compared with chord_squared_batch() against the
+ * codes in the cells around them, less those cells which can be shown to be
+ * too far away.  The cells around a cell are found with
+ * cells_within_distance(), which covers the area within @a eps with larger
+ * cells when that takes fewer of them, and then the bucket cells holding
+ * codes inside each of those.  Clusters are formed with a concurrent
+ * union-find structure.
+ *
+ * The cells are shared between threads in each stage of the algorithm.
+ *
+ * @param codes The codes, in ascending order (duplicates are allowed).
+ * @param n The number of codes.
+ * @param eps The neighbourhood radius in metres.
+ * @param min_points The number of codes within @a eps which makes a code a
+ *                   core point.
+ * @param labels A vector to return the cluster number of each code in, or
+ *               DBSCAN_NOISE; it is resized to @a n.
+ * @param threads The number of threads to use, or 0 to use one for each
+ *                processor.
+ *
+ * @returns The number of clusters.
+ */
+extern size_t
+dbscan(const PackedCode * codes, size_t n, double eps, size_t min_points,
+       std::vector<long> & labels, unsigned threads = 0);
+
+/** Cluster the codes in a sorted vector with DBSCAN.
+ */
+inline size_t
+dbscan(const std::vector<PackedCode> & codes, double eps, size_t min_points,
+       std::vector<long> & labels, unsigned threads = 0)
+{
+    return dbscan(codes.empty() ? NULL : &codes[0], codes.size(), eps,
+		  min_points, labels, threads);
+}
+
+}
+
+#endif /* GEOENCODE_INCLUDED_DBSCAN_H */
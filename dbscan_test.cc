@@ -0,0 +1,199 @@
+/** @file dbscan_test.cc
+ * @brief Tests for density-based clustering of encoded coordinates.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "dbscan.h"
+#include "distance.h"
+#include "testutils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+using GeoEncode::PackedCode;
+
+/** Make a sorted set of codes in clusters of random sizes around random
+ *  centres within @a spread degrees of a coordinate, with some noise.
+ *
+ *  @param size The rough radius of each cluster in degrees.
+ */
+static void
+make_clusters(size_t n, double lat, double lon, double spread, double size,
+	      vector<PackedCode> & codes)
+{
+    codes.clear();
+    while (codes.size() < n) {
+	double c_lat = lat + random_offset(spread);
+	double c_lon = lon + random_offset(spread);
+	size_t count = 1 + random() % 50;
+	for (size_t i = 0; i != count && codes.size() < n; ++i) {
+	    codes.push_back(random_code_near(c_lat, c_lon, size));
+	}
+    }
+    sort(codes.begin(), codes.end());
+}
+
+/** Cluster codes by comparing every pair of them.
+ */
+static size_t
+brute_force(const vector<PackedCode> & codes, double eps, size_t min_points,
+	    vector<long> & labels)
+{
+    size_t n = codes.size();
+    double s = sin(min(eps / GeoEncode::EARTH_RADIUS, M_PI) * 0.5);
+    double max_chord_squared = 4 * s * s;
+    vector<vector<size_t> > within(n);
+    vector<double> chords(n);
+    vector<bool> core(n);
+    for (size_t i = 0; i != n; ++i) {
+	int lat_16ths, lon_16ths;
+	GeoEncode::decode_16ths(codes[i], lat_16ths, lon_16ths);
+	double lat = double(lat_16ths) / 57600 - 90;
+	double lon = double(lon_16ths) / 57600;
+	GeoEncode::chord_squared_batch(lat, lon, &codes[0], n, &chords[0]);
+	for (size_t j = 0; j != n; ++j) {
+	    if (chords[j] <= max_chord_squared) {
+		within[i].push_back(j);
+	    }
+	}
+	core[i] = within[i].size() >= min_points;
+    }
+
+    // Label each cluster, found by a search from its first core point.
+    labels.assign(n, GeoEncode::DBSCAN_NOISE);
+    size_t clusters = 0;
+    for (size_t i = 0; i != n; ++i) {
+	if (!core[i] || labels[i] != GeoEncode::DBSCAN_NOISE) continue;
+	vector<size_t> stack(1, i);
+	labels[i] = long(clusters);
+	while (!stack.empty()) {
+	    size_t p = stack.back();
+	    stack.pop_back();
+	    for (size_t k = 0; k != within[p].size(); ++k) {
+		size_t q = within[p][k];
+		if (core[q] && labels[q] == GeoEncode::DBSCAN_NOISE) {
+		    labels[q] = long(clusters);
+		    stack.push_back(q);
+		}
+	    }
+	}
+	++clusters;
+    }
+    for (size_t i = 0; i != n; ++i) {
+	if (core[i]) continue;
+	for (size_t k = 0; k != within[i].size(); ++k) {
+	    if (core[within[i][k]]) {
+		labels[i] = labels[within[i][k]];
+		break;
+	    }
+	}
+    }
+    return clusters;
+}
+
+/** Check that clustering gives the same labels as comparing every pair.
+ */
+static bool
+check_dbscan(const vector<PackedCode> & codes, double eps, size_t min_points,
+	     unsigned threads)
+{
+    vector<long> expected;
+    size_t expected_clusters = brute_force(codes, eps, min_points, expected);
+    vector<long> labels;
+    size_t clusters = GeoEncode::dbscan(codes, eps, min_points, labels,
+					threads);
+    if (clusters != expected_clusters || labels != expected) {
+	size_t wrong = 0;
+	for (size_t i = 0; i != labels.size() && i != expected.size(); ++i) {
+	    wrong += (labels[i] != expected[i]);
+	}
+	fprintf(stderr, "dbscan(%zu codes, %g, %zu) found %zu clusters, "
+		"expected %zu, with %zu labels wrong\n", codes.size(), eps,
+		min_points, clusters, expected_clusters, wrong);
+	return false;
+    }
+    return true;
+}
+
+int main() {
+    bool ok = true;
+
+    // A range of radii, so that the cells used are small enough for every
+    // code in them to be within eps of each other, or not.
+    static const double radii[] = { 1, 5, 20, 50, 300, 2000, 20000 };
+    for (size_t r = 0; r != sizeof(radii) / sizeof(radii[0]); ++r) {
+	double eps = radii[r];
+	vector<PackedCode> codes;
+	double size = eps / 111000 * 2;
+	make_clusters(2000, 51.5, -0.1, size * 20, size, codes);
+	ok &= check_dbscan(codes, eps, 5, 1);
+	ok &= check_dbscan(codes, eps, 5, 4);
+	ok &= check_dbscan(codes, eps, 1, 2);
+	ok &= check_dbscan(codes, eps, 30, 3);
+    }
+
+    // Across the antimeridian, and near and at both poles.
+    {
+	vector<PackedCode> codes;
+	make_clusters(2000, 0, 0, 0.05, 0.001, codes);
+	ok &= check_dbscan(codes, 100, 4, 2);
+	make_clusters(2000, 89.99, 0, 0.02, 0.001, codes);
+	codes.push_back(pack_coord(90, 0));
+	codes.push_back(pack_coord(90, 0));
+	sort(codes.begin(), codes.end());
+	ok &= check_dbscan(codes, 200, 4, 2);
+	make_clusters(2000, -89.99, 100, 0.02, 0.001, codes);
+	ok &= check_dbscan(codes, 200, 4, 2);
+	make_clusters(2000, -89.9, 0, 0.2, 0.01, codes);
+	ok &= check_dbscan(codes, 3000, 4, 2);
+	// Scattered over the polar caps, at all longitudes.
+	for (int pole = -1; pole <= 1; pole += 2) {
+	    codes.clear();
+	    for (int i = 0; i != 2000; ++i) {
+		double lat = pole * (90 - (random() * 0.02) / RAND_MAX);
+		double lon = (random() * 360.0) / RAND_MAX;
+		codes.push_back(pack_coord(lat, lon));
+	    }
+	    sort(codes.begin(), codes.end());
+	    ok &= check_dbscan(codes, 50, 4, 2);
+	    ok &= check_dbscan(codes, 10, 2, 2);
+	}
+    }
+
+    // Duplicates, empty input and a single code.
+    {
+	vector<PackedCode> codes(100, pack_coord(10, 10));
+	ok &= check_dbscan(codes, 0, 100, 2);
+	ok &= check_dbscan(codes, 0, 101, 2);
+	codes.clear();
+	ok &= check_dbscan(codes, 10, 2, 2);
+	codes.push_back(pack_coord(10, 10));
+	ok &= check_dbscan(codes, 10, 2, 2);
+	ok &= check_dbscan(codes, 10, 1, 2);
+    }
+
+    return ok ? 0 : 1;
+}
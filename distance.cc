@@ -0,0 +1,1330 @@
+/** @file distance.cc
+ * @brief Distance calculations between coordinates.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "distance.h"
+
+#include "metrics.h"
+#include "shadow.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#if GEOENCODE_X86_SIMD
+# include <immintrin.h>
+#endif
+
+using namespace std;
+using GeoEncode::PackedCode;
+
+/// Radians per degree.
+static const double RADIANS = M_PI / 180.0;
+
+/// Wrap a longitude to the range [0,360).
+static double
+wrap_longitude(double lon)
+{
+    lon = fmod(lon, 360.0);
+    if (lon < 0) {
+	lon += 360;
+    }
+    return lon;
+}
+
+double
+GeoEncode::haversine_distance(double lat1, double lon1,
+			      double lat2, double lon2)
+{
+    double phi1 = lat1 * RADIANS;
+    double phi2 = lat2 * RADIANS;
+    double s_lat = sin((phi2 - phi1) * 0.5);
+    double s_lon = sin((lon2 - lon1) * RADIANS * 0.5);
+    double a = s_lat * s_lat + cos(phi1) * cos(phi2) * s_lon * s_lon;
+    return 2 * EARTH_RADIUS * asin(min(1.0, sqrt(a)));
+}
+
+/// Number of 16ths of a second in a degree.
+static const int DEGREE_16THS = 57600;
+
+namespace {
+
+/// Sines and cosines of half of each whole degree from -90 to 360.
+struct HalfAngleTable {
+    /// sin(d / 2) for degree d, at index d + 90.
+    double sines[451];
+
+    /// cos(d / 2) for degree d, at index d + 90.
+    double cosines[451];
+
+    HalfAngleTable() {
+	for (int i = 0; i != 451; ++i) {
+	    sines[i] = sin((i - 90) * RADIANS * 0.5);
+	    cosines[i] = cos((i - 90) * RADIANS * 0.5);
+	}
+    }
+};
+
+}
+
+/// Get the table of half-angle sines and cosines.
+static const HalfAngleTable &
+half_angles()
+{
+    static const HalfAngleTable table;
+    return table;
+}
+
+/** Calculate the sine and cosine of half an angle.
+ *
+ *  @param table The table of half-angle sines and cosines.
+ *  @param index The index in the table of the whole degrees of the angle.
+ *  @param rest The rest of the angle, in 16ths of a second (less than a
+ *              degree).
+ *  @param sine A reference to return the sine in.
+ *  @param cosine A reference to return the cosine in.
+ */
+static inline void
+half_angle_sincos(const HalfAngleTable & table, int index, int rest,
+		  double & sine, double & cosine)
+{
+    // Invalid codes can give longitudes of up to 363 degrees; clamp them
+    // rather than read past the table.
+    index = min(index, 450);
+    // The half-offset is under 0.0088 radians, so the next terms of these
+    // series are below 1e-18.
+    double x = rest * (RADIANS * 0.5 / DEGREE_16THS);
+    double x2 = x * x;
+    double sin_x = x * (1 - x2 * (1.0 / 6) * (1 - x2 * (1.0 / 20)));
+    double cos_x = 1 - x2 * 0.5 * (1 - x2 * (1.0 / 12));
+    sine = table.sines[index] * cos_x + table.cosines[index] * sin_x;
+    cosine = table.cosines[index] * cos_x - table.sines[index] * sin_x;
+}
+
+/** Calculate the sine of half an angle.
+ *
+ *  @param table The table of half-angle sines and cosines.
+ *  @param angle The angle, in 16ths of a second (0 up to 360 degrees).
+ *  @param offset The index in the table of the degree which @a angle is
+ *                measured from: 90 for an angle from 0, or 0 for a latitude
+ *                measured north of the south pole.
+ */
+static inline double
+half_angle_sine(const HalfAngleTable & table, int angle, int offset)
+{
+    int deg = angle / DEGREE_16THS;
+    double sine, cosine;
+    half_angle_sincos(table, deg + offset, angle - deg * DEGREE_16THS,
+		      sine, cosine);
+    return sine;
+}
+
+/** Calculate asin(x) for x in [0, 0.5].
+ *
+ *  This uses the rational approximation from fdlibm, which is accurate to
+ *  about an ulp over this range.
+ */
+static inline double
+asin_small(double x)
+{
+    // The polynomials are evaluated in Estrin's form, which has a shorter
+    // dependency chain than Horner's.
+    double t = x * x;
+    double t2 = t * t;
+    double t4 = t2 * t2;
+    double p = t * ((1.66666666666666657415e-01 +
+		     t * -3.25565818622400915405e-01) +
+		    t2 * (2.01212532134862925881e-01 +
+			  t * -4.00555345006794114027e-02) +
+		    t4 * (7.91534994289814532176e-04 +
+			  t * 3.47933107596021167570e-05));
+    double q = (1 + t * -2.40339491173441421878e+00) +
+	       t2 * (2.02094576023350569471e+00 +
+		     t * -6.88283971605453293030e-01) +
+	       t4 * 7.70381505559019352791e-02;
+    return x + x * (p / q);
+}
+
+/** Calculate asin(x) for x in [0, 1], without calling libm.
+ *
+ *  Above 0.5 this uses asin(x) = pi/2 - 2 asin(sqrt((1 - x) / 2)), where
+ *  1 - x is exact.  Both are computed and the right one selected
+ *  arithmetically, since a mispredicted branch here costs more than the
+ *  extra square root.
+ */
+static inline double
+fast_asin(double x)
+{
+    double big = (x > 0.5);
+    double y = sqrt((1 - min(x, 1.0)) * 0.5);
+    double r = asin_small(x + big * (y - x));
+    return r + big * (M_PI_2 - 3 * r);
+}
+
+double
+GeoEncode::code_distance_rank(PackedCode code1, PackedCode code2)
+{
+    const HalfAngleTable & table = half_angles();
+    int lat1, lon1, lat2, lon2;
+    decode_16ths(code1, lat1, lon1);
+    decode_16ths(code2, lat2, lon2);
+
+    // The differences are exact, so the sines of their halves are found
+    // directly, and only their squares are needed.
+    double s_dlat = half_angle_sine(table, abs(lat2 - lat1), 90);
+    double s_dlon = half_angle_sine(table, abs(lon2 - lon1), 90);
+    double s_lat1 = half_angle_sine(table, lat1, 0);
+    double s_lat2 = half_angle_sine(table, lat2, 0);
+    double cos_lat1 = 1 - 2 * s_lat1 * s_lat1;
+    double cos_lat2 = 1 - 2 * s_lat2 * s_lat2;
+    return s_dlat * s_dlat + cos_lat1 * cos_lat2 * s_dlon * s_dlon;
+}
+
+double
+GeoEncode::rank_to_distance(double rank)
+{
+    return 2 * EARTH_RADIUS * fast_asin(sqrt(max(0.0, rank)));
+}
+
+double
+GeoEncode::code_distance_fast(PackedCode code1, PackedCode code2)
+{
+    const HalfAngleTable & table = half_angles();
+    int lat1, lon1, lat2, lon2;
+    decode_16ths(code1, lat1, lon1);
+    decode_16ths(code2, lat2, lon2);
+
+    int dlon = lon2 - lon1;
+    if (dlon > 180 * DEGREE_16THS) {
+	dlon -= 360 * DEGREE_16THS;
+    } else if (dlon < -180 * DEGREE_16THS) {
+	dlon += 360 * DEGREE_16THS;
+    }
+
+    // The cosine of the mean latitude, from the sine of half of it.
+    double s = half_angle_sine(table, (lat1 + lat2) >> 1, 0);
+    double cos_lat = 1 - 2 * s * s;
+
+    double x = dlon * cos_lat;
+    double y = lat2 - lat1;
+    return sqrt(x * x + y * y) * (RADIANS / DEGREE_16THS * EARTH_RADIUS);
+}
+
+/** Calculate the unit vector for an encoded coordinate.
+ *
+ *  The sines and cosines of the latitude and longitude are found from those
+ *  of their halves, which need the shortest correction series.
+ */
+template<typename T>
+static inline void
+unit_vector_from_table(const HalfAngleTable & table, PackedCode code, T * xyz)
+{
+    int lat_deg, lat_rest, lon_deg, lon_rest;
+    GeoEncode::decode_degrees(code, lat_deg, lat_rest, lon_deg, lon_rest);
+    double s_lat, c_lat, s_lon, c_lon;
+    half_angle_sincos(table, lat_deg, lat_rest, s_lat, c_lat);
+    half_angle_sincos(table, lon_deg + 90, lon_rest, s_lon, c_lon);
+    // These forms of the double angle formulae avoid cancellation.
+    double cos_lat = (c_lat - s_lat) * (c_lat + s_lat);
+    xyz[0] = T(cos_lat * ((c_lon - s_lon) * (c_lon + s_lon)));
+    xyz[1] = T(cos_lat * (2 * s_lon * c_lon));
+    xyz[2] = T(2 * s_lat * c_lat);
+}
+
+void
+GeoEncode::unit_vector(double lat, double lon, double * xyz)
+{
+    double phi = lat * RADIANS;
+    double lambda = lon * RADIANS;
+    xyz[0] = cos(phi) * cos(lambda);
+    xyz[1] = cos(phi) * sin(lambda);
+    xyz[2] = sin(phi);
+}
+
+void
+GeoEncode::code_unit_vector(PackedCode code, double * xyz)
+{
+    unit_vector_from_table(half_angles(), code, xyz);
+}
+
+void
+GeoEncode::code_unit_vector(PackedCode code, float * xyz)
+{
+    unit_vector_from_table(half_angles(), code, xyz);
+}
+
+size_t
+GeoEncode::distance_tables_memory_used()
+{
+    return sizeof(HalfAngleTable);
+}
+
+/// The documented accuracy of the components of code_unit_vector().
+static inline double
+unit_vector_tolerance(const double *)
+{
+    return 4e-15;
+}
+
+/// The accuracy of the components of code_unit_vector() in single precision.
+static inline double
+unit_vector_tolerance(const float *)
+{
+    return 4e-15 + 6e-8;
+}
+
+/** Check unit vectors from the tables against unit_vector() of the decoded
+ *  coordinates.
+ */
+template<typename T>
+static void
+check_unit_vectors(const PackedCode * codes, size_t n, const T * xyz,
+		   GeoEncode::ShadowCheck & shadow)
+{
+    double tolerance = unit_vector_tolerance(xyz);
+    for (size_t i = 0; i != n; ++i) {
+	char encoded[6];
+	GeoEncode::unpack(codes[i], encoded);
+	double lat, lon, expected[3];
+	GeoEncode::decode(encoded, 6, lat, lon);
+	GeoEncode::unit_vector(lat, lon, expected);
+	for (int c = 0; c != 3; ++c) {
+	    if (!(fabs(xyz[i * 3 + c] - expected[c]) <= tolerance)) {
+		char desc[200];
+		snprintf(desc, sizeof(desc),
+			 "code %012llx (%.9f, %.9f): component %d is %.17g, "
+			 "reference %.17g", (unsigned long long)codes[i],
+			 lat, lon, c, double(xyz[i * 3 + c]), expected[c]);
+		shadow.mismatch(desc);
+		return;
+	    }
+	}
+    }
+}
+
+void
+GeoEncode::code_unit_vector_batch(const PackedCode * codes, size_t n,
+				  double * xyz)
+{
+    MetricScope metric(METRIC_UNIT_VECTORS, n, n * sizeof(PackedCode));
+    ShadowCheck shadow(SHADOW_UNIT_VECTORS);
+    const HalfAngleTable & table = half_angles();
+    for (size_t i = 0; i != n; ++i) {
+	unit_vector_from_table(table, codes[i], xyz + i * 3);
+    }
+    if (shadow.active()) {
+	shadow.fast_done();
+	check_unit_vectors(codes, n, xyz, shadow);
+    }
+}
+
+void
+GeoEncode::code_unit_vector_batch(const PackedCode * codes, size_t n,
+				  float * xyz)
+{
+    MetricScope metric(METRIC_UNIT_VECTORS, n, n * sizeof(PackedCode));
+    ShadowCheck shadow(SHADOW_UNIT_VECTORS);
+    const HalfAngleTable & table = half_angles();
+    for (size_t i = 0; i != n; ++i) {
+	unit_vector_from_table(table, codes[i], xyz + i * 3);
+    }
+    if (shadow.active()) {
+	shadow.fast_done();
+	check_unit_vectors(codes, n, xyz, shadow);
+    }
+}
+
+/** Distance from a coordinate to the nearest point on a meridian segment.
+ *
+ *  @param lat The latitude of the coordinate.
+ *  @param lon The longitude of the coordinate.
+ *  @param meridian The longitude of the meridian.
+ *  @param min_lat The southern end of the segment.
+ *  @param max_lat The northern end of the segment.
+ */
+static double
+meridian_min_distance(double lat, double lon, double meridian,
+		      double min_lat, double max_lat)
+{
+    double dlon = fabs(lon - meridian);
+    if (dlon > 180) {
+	dlon = 360 - dlon;
+    }
+    if (dlon >= 90) {
+	// The distance increases monotonically from one end of the segment
+	// towards the point opposite the coordinate, so the nearest point is
+	// an end.
+	return min(GeoEncode::haversine_distance(lat, lon, min_lat, meridian),
+		   GeoEncode::haversine_distance(lat, lon, max_lat, meridian));
+    }
+    // Project the coordinate onto the plane of the meridian to find the
+    // nearest point on its great circle, and clamp to the segment.
+    double phi = lat * RADIANS;
+    double nearest = atan2(sin(phi), cos(phi) * cos(dlon * RADIANS));
+    nearest /= RADIANS;
+    nearest = max(min_lat, min(max_lat, nearest));
+    return GeoEncode::haversine_distance(lat, lon, nearest, meridian);
+}
+
+double
+GeoEncode::box_min_distance(double lat, double lon,
+			    double min_lat, double lon1,
+			    double max_lat, double lon2)
+{
+    lon = wrap_longitude(lon);
+    lon1 = wrap_longitude(lon1);
+    lon2 = wrap_longitude(lon2);
+
+    bool in_range;
+    if (lon1 <= lon2) {
+	in_range = (lon1 <= lon && lon <= lon2);
+    } else {
+	in_range = (lon1 <= lon || lon <= lon2);
+    }
+    if (in_range || lat == 90 || lat == -90) {
+	// The nearest point is on the coordinate's own meridian (which is
+	// any meridian, at a pole).
+	if (lat < min_lat) {
+	    return (min_lat - lat) * RADIANS * EARTH_RADIUS;
+	}
+	if (lat > max_lat) {
+	    return (lat - max_lat) * RADIANS * EARTH_RADIUS;
+	}
+	return 0;
+    }
+    return min(meridian_min_distance(lat, lon, lon1, min_lat, max_lat),
+	       meridian_min_distance(lat, lon, lon2, min_lat, max_lat));
+}
+
+/// Number of codes decoded at a time by the batch functions.
+static const size_t BATCH_BLOCK = 256;
+
+/** The error allowed in squared chords from chord_squared_batch(), when
+ *  checking it against the unit vectors of the decoded coordinates.
+ *
+ *  The kernels are within about 4e-15 in double precision and 1.5e-6 in
+ *  single precision.
+ */
+static const double CHORD_TOLERANCE = 1e-14;
+
+/// The error allowed in squared chords in single precision.
+static const double FLOAT_CHORD_TOLERANCE = 4e-6;
+
+/// Radians in half of a 16th of a second.
+static const double HALF_16TH = RADIANS * 0.5 / DEGREE_16THS;
+
+namespace {
+
+/// A query point for the batch functions.
+struct BatchQuery {
+    /// Latitude north of the south pole, in whole 16ths of a second.
+    int lat_16ths;
+
+    /// Longitude east of the meridian, in whole 16ths of a second.
+    int lon_16ths;
+
+    /// Fractions of a 16th of a second to add to lat_16ths and lon_16ths.
+    double lat_frac, lon_frac;
+
+    /// Cosine of the latitude.
+    double cos_lat;
+
+    BatchQuery(double lat, double lon) {
+	double lat_16ths_d = (lat + 90) * DEGREE_16THS;
+	double lon_16ths_d = wrap_longitude(lon) * DEGREE_16THS;
+	lat_16ths = int(floor(lat_16ths_d));
+	lon_16ths = int(floor(lon_16ths_d));
+	lat_frac = lat_16ths_d - lat_16ths;
+	lon_frac = lon_16ths_d - lon_16ths;
+	cos_lat = cos(lat * RADIANS);
+    }
+};
+
+/** Codes decoded relative to a query point, in 16ths of a second.
+ *
+ *  Keeping these as integers makes them exact, and small enough to convert
+ *  to float exactly.
+ */
+struct BatchBlock {
+    /// Latitude less the query's whole latitude.
+    int dlat[BATCH_BLOCK];
+
+    /// Longitude less the query's, wrapped to +/-180 degrees.
+    int dlon[BATCH_BLOCK];
+
+    /// Latitude (north of the equator).
+    int lat[BATCH_BLOCK];
+};
+
+}
+
+/** Calculate sin(x) for |x| <= pi/2.
+ *
+ *  This is the Taylor series to x^19, whose error is below 3e-16 over this
+ *  range.
+ */
+static inline double
+poly_sin(double x)
+{
+    double x2 = x * x;
+    double p = -1.0 / 121645100408832000.0;
+    p = p * x2 + 1.0 / 355687428096000.0;
+    p = p * x2 - 1.0 / 1307674368000.0;
+    p = p * x2 + 1.0 / 6227020800.0;
+    p = p * x2 - 1.0 / 39916800.0;
+    p = p * x2 + 1.0 / 362880.0;
+    p = p * x2 - 1.0 / 5040.0;
+    p = p * x2 + 1.0 / 120.0;
+    p = p * x2 - 1.0 / 6.0;
+    return x + x * x2 * p;
+}
+
+/// Decode codes relative to a query point, one at a time.
+static void
+decode_batch_scalar(const BatchQuery & q, const PackedCode * codes, size_t n,
+		    BatchBlock & block)
+{
+    for (size_t i = 0; i != n; ++i) {
+	int lat, lon;
+	GeoEncode::decode_16ths(codes[i], lat, lon);
+	int dlon = lon - q.lon_16ths;
+	if (dlon > 180 * DEGREE_16THS) {
+	    dlon -= 360 * DEGREE_16THS;
+	} else if (dlon < -180 * DEGREE_16THS) {
+	    dlon += 360 * DEGREE_16THS;
+	}
+	block.dlat[i] = lat - q.lat_16ths;
+	block.dlon[i] = dlon;
+	block.lat[i] = lat - 90 * DEGREE_16THS;
+    }
+}
+
+/** Calculate the haversine of the angle from the query to a decoded code.
+ *
+ *  This is a quarter of the squared chord length on a unit sphere.
+ */
+static inline double
+batch_haversine(const BatchQuery & q, const BatchBlock & block, size_t i)
+{
+    double s_lat = poly_sin((block.dlat[i] - q.lat_frac) * HALF_16TH);
+    double s_lon = poly_sin((block.dlon[i] - q.lon_frac) * HALF_16TH);
+    double s_half = poly_sin(block.lat[i] * HALF_16TH);
+    double cos_lat = 1 - 2 * s_half * s_half;
+    return s_lat * s_lat + cos_lat * q.cos_lat * s_lon * s_lon;
+}
+
+/// Convert a haversine to a distance in metres.
+static inline double
+haversine_to_metres(double a)
+{
+    return 2 * GeoEncode::EARTH_RADIUS * fast_asin(min(1.0, sqrt(a)));
+}
+
+/// Calculate results from decoded codes, one at a time.
+template<typename T>
+static void
+haversine_batch_scalar(const BatchQuery & q, const BatchBlock & block,
+		       size_t start, size_t n, bool metres, T * result)
+{
+    for (size_t i = start; i != n; ++i) {
+	double a = batch_haversine(q, block, i);
+	result[i] = T(metres ? haversine_to_metres(a) : 4 * a);
+    }
+}
+
+#if GEOENCODE_X86_SIMD
+/** Decode four codes relative to a query point.
+ *
+ *  The fields are extracted in 64 bit lanes.  Division by 181 is done by
+ *  multiplying by 23173 and shifting right by 22, which is exact for all
+ *  16 bit values.
+ */
+__attribute__((target("avx2")))
+static void
+decode_batch_avx2(const BatchQuery & q, const PackedCode * codes, size_t n,
+		  BatchBlock & block)
+{
+    const __m256i ff = _mm256_set1_epi64x(0xff);
+    const __m256i fifteen = _mm256_set1_epi64x(15);
+    const __m256i three = _mm256_set1_epi64x(3);
+    const __m256i half_turn = _mm256_set1_epi64x(180 * DEGREE_16THS);
+    const __m256i minus_half_turn = _mm256_set1_epi64x(-180 * DEGREE_16THS);
+    const __m256i turn = _mm256_set1_epi64x(360 * DEGREE_16THS);
+    const __m256i degree = _mm256_set1_epi64x(DEGREE_16THS);
+    const __m256i q_lat = _mm256_set1_epi64x(q.lat_16ths);
+    const __m256i q_lon = _mm256_set1_epi64x(q.lon_16ths);
+    const __m256i equator = _mm256_set1_epi64x(90 * DEGREE_16THS);
+    const __m256i pack = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+	__m256i c = _mm256_loadu_si256(
+		reinterpret_cast<const __m256i *>(codes + i));
+	__m256i dd = _mm256_and_si256(_mm256_srli_epi64(c, 32),
+				      _mm256_set1_epi64x(0xffff));
+	__m256i lon_deg = _mm256_srli_epi64(
+		_mm256_mul_epu32(dd, _mm256_set1_epi64x(23173)), 22);
+	__m256i lat_deg = _mm256_sub_epi64(
+		dd, _mm256_mul_epu32(lon_deg, _mm256_set1_epi64x(181)));
+	__m256i minutes = _mm256_and_si256(_mm256_srli_epi64(c, 24), ff);
+	__m256i mixed = _mm256_and_si256(_mm256_srli_epi64(c, 16), ff);
+	__m256i seconds = _mm256_and_si256(_mm256_srli_epi64(c, 8), ff);
+	__m256i sixteenths = _mm256_and_si256(c, ff);
+
+	__m256i lat_m = _mm256_add_epi64(
+		_mm256_slli_epi64(_mm256_srli_epi64(minutes, 4), 2),
+		_mm256_and_si256(_mm256_srli_epi64(mixed, 6), three));
+	__m256i lon_m = _mm256_add_epi64(
+		_mm256_slli_epi64(_mm256_and_si256(minutes, fifteen), 2),
+		_mm256_and_si256(_mm256_srli_epi64(mixed, 4), three));
+	__m256i lat_s = _mm256_add_epi64(
+		_mm256_mul_epu32(_mm256_and_si256(_mm256_srli_epi64(mixed, 2),
+						  three), fifteen),
+		_mm256_srli_epi64(seconds, 4));
+	__m256i lon_s = _mm256_add_epi64(
+		_mm256_mul_epu32(_mm256_and_si256(mixed, three), fifteen),
+		_mm256_and_si256(seconds, fifteen));
+	__m256i sixty = _mm256_set1_epi64x(60);
+	__m256i lat = _mm256_add_epi64(
+		_mm256_slli_epi64(_mm256_add_epi64(
+			_mm256_mul_epu32(lat_m, sixty), lat_s), 4),
+		_mm256_srli_epi64(sixteenths, 4));
+	__m256i lon = _mm256_add_epi64(
+		_mm256_slli_epi64(_mm256_add_epi64(
+			_mm256_mul_epu32(lon_m, sixty), lon_s), 4),
+		_mm256_and_si256(sixteenths, fifteen));
+	lat = _mm256_add_epi64(lat, _mm256_mul_epu32(lat_deg, degree));
+	lon = _mm256_add_epi64(lon, _mm256_mul_epu32(lon_deg, degree));
+
+	__m256i dlon = _mm256_sub_epi64(lon, q_lon);
+	dlon = _mm256_sub_epi64(dlon, _mm256_and_si256(
+		_mm256_cmpgt_epi64(dlon, half_turn), turn));
+	dlon = _mm256_add_epi64(dlon, _mm256_and_si256(
+		_mm256_cmpgt_epi64(minus_half_turn, dlon), turn));
+
+	// Take the low 32 bits of each lane.
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(block.dlat + i),
+		_mm256_castsi256_si128(_mm256_permutevar8x32_epi32(
+			_mm256_sub_epi64(lat, q_lat), pack)));
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(block.dlon + i),
+		_mm256_castsi256_si128(_mm256_permutevar8x32_epi32(
+			dlon, pack)));
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(block.lat + i),
+		_mm256_castsi256_si128(_mm256_permutevar8x32_epi32(
+			_mm256_sub_epi64(lat, equator), pack)));
+    }
+    if (i != n) {
+	BatchBlock tail;
+	decode_batch_scalar(q, codes + i, n - i, tail);
+	copy(tail.dlat, tail.dlat + (n - i), block.dlat + i);
+	copy(tail.dlon, tail.dlon + (n - i), block.dlon + i);
+	copy(tail.lat, tail.lat + (n - i), block.lat + i);
+    }
+}
+
+/// AVX-512 version of decode_batch_avx2(), eight codes at a time.
+__attribute__((target("avx512f,avx512dq")))
+static void
+decode_batch_avx512(const BatchQuery & q, const PackedCode * codes, size_t n,
+		    BatchBlock & block)
+{
+    const __m512i ff = _mm512_set1_epi64(0xff);
+    const __m512i fifteen = _mm512_set1_epi64(15);
+    const __m512i three = _mm512_set1_epi64(3);
+    const __m512i sixty = _mm512_set1_epi64(60);
+    const __m512i half_turn = _mm512_set1_epi64(180 * DEGREE_16THS);
+    const __m512i minus_half_turn = _mm512_set1_epi64(-180 * DEGREE_16THS);
+    const __m512i turn = _mm512_set1_epi64(360 * DEGREE_16THS);
+    const __m512i degree = _mm512_set1_epi64(DEGREE_16THS);
+    const __m512i q_lat = _mm512_set1_epi64(q.lat_16ths);
+    const __m512i q_lon = _mm512_set1_epi64(q.lon_16ths);
+    const __m512i equator = _mm512_set1_epi64(90 * DEGREE_16THS);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+	__m512i c = _mm512_loadu_si512(codes + i);
+	__m512i dd = _mm512_and_si512(_mm512_srli_epi64(c, 32),
+				      _mm512_set1_epi64(0xffff));
+	__m512i lon_deg = _mm512_srli_epi64(
+		_mm512_mul_epu32(dd, _mm512_set1_epi64(23173)), 22);
+	__m512i lat_deg = _mm512_sub_epi64(
+		dd, _mm512_mul_epu32(lon_deg, _mm512_set1_epi64(181)));
+	__m512i minutes = _mm512_and_si512(_mm512_srli_epi64(c, 24), ff);
+	__m512i mixed = _mm512_and_si512(_mm512_srli_epi64(c, 16), ff);
+	__m512i seconds = _mm512_and_si512(_mm512_srli_epi64(c, 8), ff);
+	__m512i sixteenths = _mm512_and_si512(c, ff);
+
+	__m512i lat_m = _mm512_add_epi64(
+		_mm512_slli_epi64(_mm512_srli_epi64(minutes, 4), 2),
+		_mm512_and_si512(_mm512_srli_epi64(mixed, 6), three));
+	__m512i lon_m = _mm512_add_epi64(
+		_mm512_slli_epi64(_mm512_and_si512(minutes, fifteen), 2),
+		_mm512_and_si512(_mm512_srli_epi64(mixed, 4), three));
+	__m512i lat_s = _mm512_add_epi64(
+		_mm512_mul_epu32(_mm512_and_si512(_mm512_srli_epi64(mixed, 2),
+						  three), fifteen),
+		_mm512_srli_epi64(seconds, 4));
+	__m512i lon_s = _mm512_add_epi64(
+		_mm512_mul_epu32(_mm512_and_si512(mixed, three), fifteen),
+		_mm512_and_si512(seconds, fifteen));
+	__m512i lat = _mm512_add_epi64(
+		_mm512_slli_epi64(_mm512_add_epi64(
+			_mm512_mul_epu32(lat_m, sixty), lat_s), 4),
+		_mm512_srli_epi64(sixteenths, 4));
+	__m512i lon = _mm512_add_epi64(
+		_mm512_slli_epi64(_mm512_add_epi64(
+			_mm512_mul_epu32(lon_m, sixty), lon_s), 4),
+		_mm512_and_si512(sixteenths, fifteen));
+	lat = _mm512_add_epi64(lat, _mm512_mul_epu32(lat_deg, degree));
+	lon = _mm512_add_epi64(lon, _mm512_mul_epu32(lon_deg, degree));
+
+	__m512i dlon = _mm512_sub_epi64(lon, q_lon);
+	dlon = _mm512_mask_sub_epi64(
+		dlon, _mm512_cmpgt_epi64_mask(dlon, half_turn), dlon, turn);
+	dlon = _mm512_mask_add_epi64(
+		dlon, _mm512_cmplt_epi64_mask(dlon, minus_half_turn), dlon,
+		turn);
+
+	_mm256_storeu_si256(reinterpret_cast<__m256i *>(block.dlat + i),
+			    _mm512_cvtepi64_epi32(_mm512_sub_epi64(lat, q_lat)));
+	_mm256_storeu_si256(reinterpret_cast<__m256i *>(block.dlon + i),
+			    _mm512_cvtepi64_epi32(dlon));
+	_mm256_storeu_si256(reinterpret_cast<__m256i *>(block.lat + i),
+			    _mm512_cvtepi64_epi32(
+				_mm512_sub_epi64(lat, equator)));
+    }
+    if (i != n) {
+	BatchBlock tail;
+	decode_batch_scalar(q, codes + i, n - i, tail);
+	copy(tail.dlat, tail.dlat + (n - i), block.dlat + i);
+	copy(tail.dlon, tail.dlon + (n - i), block.dlon + i);
+	copy(tail.lat, tail.lat + (n - i), block.lat + i);
+    }
+}
+
+/// Four lane version of poly_sin().
+__attribute__((target("avx2")))
+static inline __m256d
+poly_sin_avx2(__m256d x)
+{
+    __m256d x2 = _mm256_mul_pd(x, x);
+    __m256d p = _mm256_set1_pd(-1.0 / 121645100408832000.0);
+    p = _mm256_add_pd(_mm256_mul_pd(p, x2),
+		      _mm256_set1_pd(1.0 / 355687428096000.0));
+    p = _mm256_add_pd(_mm256_mul_pd(p, x2),
+		      _mm256_set1_pd(-1.0 / 1307674368000.0));
+    p = _mm256_add_pd(_mm256_mul_pd(p, x2),
+		      _mm256_set1_pd(1.0 / 6227020800.0));
+    p = _mm256_add_pd(_mm256_mul_pd(p, x2),
+		      _mm256_set1_pd(-1.0 / 39916800.0));
+    p = _mm256_add_pd(_mm256_mul_pd(p, x2), _mm256_set1_pd(1.0 / 362880.0));
+    p = _mm256_add_pd(_mm256_mul_pd(p, x2), _mm256_set1_pd(-1.0 / 5040.0));
+    p = _mm256_add_pd(_mm256_mul_pd(p, x2), _mm256_set1_pd(1.0 / 120.0));
+    p = _mm256_add_pd(_mm256_mul_pd(p, x2), _mm256_set1_pd(-1.0 / 6.0));
+    return _mm256_add_pd(x, _mm256_mul_pd(_mm256_mul_pd(x, x2), p));
+}
+
+/// Four lane version of haversine_to_metres().
+__attribute__((target("avx2")))
+static inline __m256d
+haversine_to_metres_avx2(__m256d a)
+{
+    const __m256d one = _mm256_set1_pd(1.0);
+    __m256d x = _mm256_min_pd(_mm256_sqrt_pd(a), one);
+    __m256d big = _mm256_cmp_pd(x, _mm256_set1_pd(0.5), _CMP_GT_OQ);
+    __m256d y = _mm256_sqrt_pd(_mm256_mul_pd(_mm256_sub_pd(one, x),
+					     _mm256_set1_pd(0.5)));
+    x = _mm256_blendv_pd(x, y, big);
+
+    __m256d t = _mm256_mul_pd(x, x);
+    __m256d p = _mm256_set1_pd(3.47933107596021167570e-05);
+    p = _mm256_add_pd(_mm256_mul_pd(p, t),
+		      _mm256_set1_pd(7.91534994289814532176e-04));
+    p = _mm256_add_pd(_mm256_mul_pd(p, t),
+		      _mm256_set1_pd(-4.00555345006794114027e-02));
+    p = _mm256_add_pd(_mm256_mul_pd(p, t),
+		      _mm256_set1_pd(2.01212532134862925881e-01));
+    p = _mm256_add_pd(_mm256_mul_pd(p, t),
+		      _mm256_set1_pd(-3.25565818622400915405e-01));
+    p = _mm256_add_pd(_mm256_mul_pd(p, t),
+		      _mm256_set1_pd(1.66666666666666657415e-01));
+    p = _mm256_mul_pd(p, t);
+    __m256d qq = _mm256_set1_pd(7.70381505559019352791e-02);
+    qq = _mm256_add_pd(_mm256_mul_pd(qq, t),
+		       _mm256_set1_pd(-6.88283971605453293030e-01));
+    qq = _mm256_add_pd(_mm256_mul_pd(qq, t),
+		       _mm256_set1_pd(2.02094576023350569471e+00));
+    qq = _mm256_add_pd(_mm256_mul_pd(qq, t),
+		       _mm256_set1_pd(-2.40339491173441421878e+00));
+    qq = _mm256_add_pd(_mm256_mul_pd(qq, t), one);
+    __m256d r = _mm256_add_pd(x, _mm256_mul_pd(x, _mm256_div_pd(p, qq)));
+
+    __m256d r_big = _mm256_sub_pd(_mm256_set1_pd(M_PI_2),
+				  _mm256_add_pd(r, r));
+    r = _mm256_blendv_pd(r, r_big, big);
+    return _mm256_mul_pd(r, _mm256_set1_pd(2 * GeoEncode::EARTH_RADIUS));
+}
+
+/// Calculate results from decoded codes, four at a time.
+__attribute__((target("avx2")))
+static void
+haversine_batch_avx2(const BatchQuery & q, const BatchBlock & block,
+		     size_t n, bool metres, double * result)
+{
+    const __m256d half_16th = _mm256_set1_pd(HALF_16TH);
+    const __m256d lat_frac = _mm256_set1_pd(q.lat_frac);
+    const __m256d lon_frac = _mm256_set1_pd(q.lon_frac);
+    const __m256d cos_q = _mm256_set1_pd(q.cos_lat);
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d two = _mm256_set1_pd(2.0);
+    const __m256d four = _mm256_set1_pd(4.0);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+	__m256d dlat = _mm256_cvtepi32_pd(_mm_loadu_si128(
+		reinterpret_cast<const __m128i *>(block.dlat + i)));
+	__m256d dlon = _mm256_cvtepi32_pd(_mm_loadu_si128(
+		reinterpret_cast<const __m128i *>(block.dlon + i)));
+	__m256d lat = _mm256_cvtepi32_pd(_mm_loadu_si128(
+		reinterpret_cast<const __m128i *>(block.lat + i)));
+	__m256d s_lat = poly_sin_avx2(
+		_mm256_mul_pd(_mm256_sub_pd(dlat, lat_frac), half_16th));
+	__m256d s_lon = poly_sin_avx2(
+		_mm256_mul_pd(_mm256_sub_pd(dlon, lon_frac), half_16th));
+	__m256d s_half = poly_sin_avx2(_mm256_mul_pd(lat, half_16th));
+	__m256d cos_lat = _mm256_sub_pd(
+		one, _mm256_mul_pd(two, _mm256_mul_pd(s_half, s_half)));
+	__m256d a = _mm256_add_pd(
+		_mm256_mul_pd(s_lat, s_lat),
+		_mm256_mul_pd(_mm256_mul_pd(cos_lat, cos_q),
+			      _mm256_mul_pd(s_lon, s_lon)));
+	a = metres ? haversine_to_metres_avx2(a) : _mm256_mul_pd(a, four);
+	_mm256_storeu_pd(result + i, a);
+    }
+    haversine_batch_scalar(q, block, i, n, metres, result);
+}
+
+/// Float version of poly_sin_avx2(), to x^11, eight lanes.
+__attribute__((target("avx2")))
+static inline __m256
+poly_sin_avx2(__m256 x)
+{
+    __m256 x2 = _mm256_mul_ps(x, x);
+    __m256 p = _mm256_set1_ps(-1.0f / 39916800.0f);
+    p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(1.0f / 362880.0f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(-1.0f / 5040.0f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(1.0f / 120.0f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(-1.0f / 6.0f));
+    return _mm256_add_ps(x, _mm256_mul_ps(_mm256_mul_ps(x, x2), p));
+}
+
+/** Float version of haversine_to_metres_avx2(), eight lanes.
+ *
+ *  This uses the shorter rational approximation from fdlibm's asinf().
+ */
+__attribute__((target("avx2")))
+static inline __m256
+haversine_to_metres_avx2(__m256 a)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    __m256 x = _mm256_min_ps(_mm256_sqrt_ps(a), one);
+    __m256 big = _mm256_cmp_ps(x, _mm256_set1_ps(0.5f), _CMP_GT_OQ);
+    __m256 y = _mm256_sqrt_ps(_mm256_mul_ps(_mm256_sub_ps(one, x),
+					    _mm256_set1_ps(0.5f)));
+    x = _mm256_blendv_ps(x, y, big);
+
+    __m256 t = _mm256_mul_ps(x, x);
+    __m256 p = _mm256_set1_ps(-8.6563630030e-03f);
+    p = _mm256_add_ps(_mm256_mul_ps(p, t), _mm256_set1_ps(-4.2743422091e-02f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, t), _mm256_set1_ps(1.6666586697e-01f));
+    p = _mm256_mul_ps(p, t);
+    __m256 qq = _mm256_add_ps(
+	    _mm256_mul_ps(_mm256_set1_ps(-7.0662963390e-01f), t), one);
+    __m256 r = _mm256_add_ps(x, _mm256_mul_ps(x, _mm256_div_ps(p, qq)));
+
+    __m256 r_big = _mm256_sub_ps(_mm256_set1_ps(float(M_PI_2)),
+				 _mm256_add_ps(r, r));
+    r = _mm256_blendv_ps(r, r_big, big);
+    return _mm256_mul_ps(r, _mm256_set1_ps(float(2 * GeoEncode::EARTH_RADIUS)));
+}
+
+/// Calculate float results from decoded codes, eight at a time.
+__attribute__((target("avx2")))
+static void
+haversine_batch_avx2(const BatchQuery & q, const BatchBlock & block,
+		     size_t n, bool metres, float * result)
+{
+    const __m256 half_16th = _mm256_set1_ps(float(HALF_16TH));
+    const __m256 lat_frac = _mm256_set1_ps(float(q.lat_frac));
+    const __m256 lon_frac = _mm256_set1_ps(float(q.lon_frac));
+    const __m256 cos_q = _mm256_set1_ps(float(q.cos_lat));
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 four = _mm256_set1_ps(4.0f);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+	__m256 dlat = _mm256_cvtepi32_ps(_mm256_loadu_si256(
+		reinterpret_cast<const __m256i *>(block.dlat + i)));
+	__m256 dlon = _mm256_cvtepi32_ps(_mm256_loadu_si256(
+		reinterpret_cast<const __m256i *>(block.dlon + i)));
+	__m256 lat = _mm256_cvtepi32_ps(_mm256_loadu_si256(
+		reinterpret_cast<const __m256i *>(block.lat + i)));
+	__m256 s_lat = poly_sin_avx2(
+		_mm256_mul_ps(_mm256_sub_ps(dlat, lat_frac), half_16th));
+	__m256 s_lon = poly_sin_avx2(
+		_mm256_mul_ps(_mm256_sub_ps(dlon, lon_frac), half_16th));
+	__m256 s_half = poly_sin_avx2(_mm256_mul_ps(lat, half_16th));
+	__m256 cos_lat = _mm256_sub_ps(
+		one, _mm256_mul_ps(two, _mm256_mul_ps(s_half, s_half)));
+	__m256 a = _mm256_add_ps(
+		_mm256_mul_ps(s_lat, s_lat),
+		_mm256_mul_ps(_mm256_mul_ps(cos_lat, cos_q),
+			      _mm256_mul_ps(s_lon, s_lon)));
+	a = metres ? haversine_to_metres_avx2(a) : _mm256_mul_ps(a, four);
+	_mm256_storeu_ps(result + i, a);
+    }
+    haversine_batch_scalar(q, block, i, n, metres, result);
+}
+
+/// Eight lane version of poly_sin().
+__attribute__((target("avx512f,avx512dq")))
+static inline __m512d
+poly_sin_avx512(__m512d x)
+{
+    __m512d x2 = _mm512_mul_pd(x, x);
+    __m512d p = _mm512_set1_pd(-1.0 / 121645100408832000.0);
+    p = _mm512_add_pd(_mm512_mul_pd(p, x2),
+		      _mm512_set1_pd(1.0 / 355687428096000.0));
+    p = _mm512_add_pd(_mm512_mul_pd(p, x2),
+		      _mm512_set1_pd(-1.0 / 1307674368000.0));
+    p = _mm512_add_pd(_mm512_mul_pd(p, x2),
+		      _mm512_set1_pd(1.0 / 6227020800.0));
+    p = _mm512_add_pd(_mm512_mul_pd(p, x2),
+		      _mm512_set1_pd(-1.0 / 39916800.0));
+    p = _mm512_add_pd(_mm512_mul_pd(p, x2), _mm512_set1_pd(1.0 / 362880.0));
+    p = _mm512_add_pd(_mm512_mul_pd(p, x2), _mm512_set1_pd(-1.0 / 5040.0));
+    p = _mm512_add_pd(_mm512_mul_pd(p, x2), _mm512_set1_pd(1.0 / 120.0));
+    p = _mm512_add_pd(_mm512_mul_pd(p, x2), _mm512_set1_pd(-1.0 / 6.0));
+    return _mm512_add_pd(x, _mm512_mul_pd(_mm512_mul_pd(x, x2), p));
+}
+
+/// Eight lane version of haversine_to_metres().
+__attribute__((target("avx512f,avx512dq")))
+static inline __m512d
+haversine_to_metres_avx512(__m512d a)
+{
+    const __m512d one = _mm512_set1_pd(1.0);
+    __m512d x = _mm512_min_pd(_mm512_sqrt_pd(a), one);
+    __mmask8 big = _mm512_cmp_pd_mask(x, _mm512_set1_pd(0.5), _CMP_GT_OQ);
+    x = _mm512_mask_sqrt_pd(x, big, _mm512_mul_pd(_mm512_sub_pd(one, x),
+						  _mm512_set1_pd(0.5)));
+
+    __m512d t = _mm512_mul_pd(x, x);
+    __m512d p = _mm512_set1_pd(3.47933107596021167570e-05);
+    p = _mm512_add_pd(_mm512_mul_pd(p, t),
+		      _mm512_set1_pd(7.91534994289814532176e-04));
+    p = _mm512_add_pd(_mm512_mul_pd(p, t),
+		      _mm512_set1_pd(-4.00555345006794114027e-02));
+    p = _mm512_add_pd(_mm512_mul_pd(p, t),
+		      _mm512_set1_pd(2.01212532134862925881e-01));
+    p = _mm512_add_pd(_mm512_mul_pd(p, t),
+		      _mm512_set1_pd(-3.25565818622400915405e-01));
+    p = _mm512_add_pd(_mm512_mul_pd(p, t),
+		      _mm512_set1_pd(1.66666666666666657415e-01));
+    p = _mm512_mul_pd(p, t);
+    __m512d qq = _mm512_set1_pd(7.70381505559019352791e-02);
+    qq = _mm512_add_pd(_mm512_mul_pd(qq, t),
+		       _mm512_set1_pd(-6.88283971605453293030e-01));
+    qq = _mm512_add_pd(_mm512_mul_pd(qq, t),
+		       _mm512_set1_pd(2.02094576023350569471e+00));
+    qq = _mm512_add_pd(_mm512_mul_pd(qq, t),
+		       _mm512_set1_pd(-2.40339491173441421878e+00));
+    qq = _mm512_add_pd(_mm512_mul_pd(qq, t), one);
+    __m512d r = _mm512_add_pd(x, _mm512_mul_pd(x, _mm512_div_pd(p, qq)));
+
+    r = _mm512_mask_sub_pd(r, big, _mm512_set1_pd(M_PI_2),
+			   _mm512_add_pd(r, r));
+    return _mm512_mul_pd(r, _mm512_set1_pd(2 * GeoEncode::EARTH_RADIUS));
+}
+
+/// Calculate results from decoded codes, eight at a time.
+__attribute__((target("avx512f,avx512dq")))
+static void
+haversine_batch_avx512(const BatchQuery & q, const BatchBlock & block,
+		       size_t n, bool metres, double * result)
+{
+    const __m512d half_16th = _mm512_set1_pd(HALF_16TH);
+    const __m512d lat_frac = _mm512_set1_pd(q.lat_frac);
+    const __m512d lon_frac = _mm512_set1_pd(q.lon_frac);
+    const __m512d cos_q = _mm512_set1_pd(q.cos_lat);
+    const __m512d one = _mm512_set1_pd(1.0);
+    const __m512d two = _mm512_set1_pd(2.0);
+    const __m512d four = _mm512_set1_pd(4.0);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+	__m512d dlat = _mm512_cvtepi32_pd(_mm256_loadu_si256(
+		reinterpret_cast<const __m256i *>(block.dlat + i)));
+	__m512d dlon = _mm512_cvtepi32_pd(_mm256_loadu_si256(
+		reinterpret_cast<const __m256i *>(block.dlon + i)));
+	__m512d lat = _mm512_cvtepi32_pd(_mm256_loadu_si256(
+		reinterpret_cast<const __m256i *>(block.lat + i)));
+	__m512d s_lat = poly_sin_avx512(
+		_mm512_mul_pd(_mm512_sub_pd(dlat, lat_frac), half_16th));
+	__m512d s_lon = poly_sin_avx512(
+		_mm512_mul_pd(_mm512_sub_pd(dlon, lon_frac), half_16th));
+	__m512d s_half = poly_sin_avx512(_mm512_mul_pd(lat, half_16th));
+	__m512d cos_lat = _mm512_sub_pd(
+		one, _mm512_mul_pd(two, _mm512_mul_pd(s_half, s_half)));
+	__m512d a = _mm512_add_pd(
+		_mm512_mul_pd(s_lat, s_lat),
+		_mm512_mul_pd(_mm512_mul_pd(cos_lat, cos_q),
+			      _mm512_mul_pd(s_lon, s_lon)));
+	a = metres ? haversine_to_metres_avx512(a) : _mm512_mul_pd(a, four);
+	_mm512_storeu_pd(result + i, a);
+    }
+    haversine_batch_scalar(q, block, i, n, metres, result);
+}
+
+/// Float version of poly_sin_avx512(), to x^11, sixteen lanes.
+__attribute__((target("avx512f,avx512dq")))
+static inline __m512
+poly_sin_avx512(__m512 x)
+{
+    __m512 x2 = _mm512_mul_ps(x, x);
+    __m512 p = _mm512_set1_ps(-1.0f / 39916800.0f);
+    p = _mm512_add_ps(_mm512_mul_ps(p, x2), _mm512_set1_ps(1.0f / 362880.0f));
+    p = _mm512_add_ps(_mm512_mul_ps(p, x2), _mm512_set1_ps(-1.0f / 5040.0f));
+    p = _mm512_add_ps(_mm512_mul_ps(p, x2), _mm512_set1_ps(1.0f / 120.0f));
+    p = _mm512_add_ps(_mm512_mul_ps(p, x2), _mm512_set1_ps(-1.0f / 6.0f));
+    return _mm512_add_ps(x, _mm512_mul_ps(_mm512_mul_ps(x, x2), p));
+}
+
+/// Float version of haversine_to_metres_avx512(), sixteen lanes.
+__attribute__((target("avx512f,avx512dq")))
+static inline __m512
+haversine_to_metres_avx512(__m512 a)
+{
+    const __m512 one = _mm512_set1_ps(1.0f);
+    __m512 x = _mm512_min_ps(_mm512_sqrt_ps(a), one);
+    __mmask16 big = _mm512_cmp_ps_mask(x, _mm512_set1_ps(0.5f), _CMP_GT_OQ);
+    x = _mm512_mask_sqrt_ps(x, big, _mm512_mul_ps(_mm512_sub_ps(one, x),
+						  _mm512_set1_ps(0.5f)));
+
+    __m512 t = _mm512_mul_ps(x, x);
+    __m512 p = _mm512_set1_ps(-8.6563630030e-03f);
+    p = _mm512_add_ps(_mm512_mul_ps(p, t), _mm512_set1_ps(-4.2743422091e-02f));
+    p = _mm512_add_ps(_mm512_mul_ps(p, t), _mm512_set1_ps(1.6666586697e-01f));
+    p = _mm512_mul_ps(p, t);
+    __m512 qq = _mm512_add_ps(
+	    _mm512_mul_ps(_mm512_set1_ps(-7.0662963390e-01f), t), one);
+    __m512 r = _mm512_add_ps(x, _mm512_mul_ps(x, _mm512_div_ps(p, qq)));
+
+    r = _mm512_mask_sub_ps(r, big, _mm512_set1_ps(float(M_PI_2)),
+			   _mm512_add_ps(r, r));
+    return _mm512_mul_ps(r, _mm512_set1_ps(float(2 * GeoEncode::EARTH_RADIUS)));
+}
+
+/// Calculate float results from decoded codes, sixteen at a time.
+__attribute__((target("avx512f,avx512dq")))
+static void
+haversine_batch_avx512(const BatchQuery & q, const BatchBlock & block,
+		       size_t n, bool metres, float * result)
+{
+    const __m512 half_16th = _mm512_set1_ps(float(HALF_16TH));
+    const __m512 lat_frac = _mm512_set1_ps(float(q.lat_frac));
+    const __m512 lon_frac = _mm512_set1_ps(float(q.lon_frac));
+    const __m512 cos_q = _mm512_set1_ps(float(q.cos_lat));
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 two = _mm512_set1_ps(2.0f);
+    const __m512 four = _mm512_set1_ps(4.0f);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+	__m512 dlat = _mm512_cvtepi32_ps(_mm512_loadu_si512(block.dlat + i));
+	__m512 dlon = _mm512_cvtepi32_ps(_mm512_loadu_si512(block.dlon + i));
+	__m512 lat = _mm512_cvtepi32_ps(_mm512_loadu_si512(block.lat + i));
+	__m512 s_lat = poly_sin_avx512(
+		_mm512_mul_ps(_mm512_sub_ps(dlat, lat_frac), half_16th));
+	__m512 s_lon = poly_sin_avx512(
+		_mm512_mul_ps(_mm512_sub_ps(dlon, lon_frac), half_16th));
+	__m512 s_half = poly_sin_avx512(_mm512_mul_ps(lat, half_16th));
+	__m512 cos_lat = _mm512_sub_ps(
+		one, _mm512_mul_ps(two, _mm512_mul_ps(s_half, s_half)));
+	__m512 a = _mm512_add_ps(
+		_mm512_mul_ps(s_lat, s_lat),
+		_mm512_mul_ps(_mm512_mul_ps(cos_lat, cos_q),
+			      _mm512_mul_ps(s_lon, s_lon)));
+	a = metres ? haversine_to_metres_avx512(a) : _mm512_mul_ps(a, four);
+	_mm512_storeu_ps(result + i, a);
+    }
+    haversine_batch_scalar(q, block, i, n, metres, result);
+}
+#endif
+
+/** Get the error allowed in a distance from code_distance_batch(), given
+ *  the distance from haversine_distance().
+ *
+ *  These are the accuracies the functions document.
+ */
+static inline double
+distance_tolerance(double expected, const double *)
+{
+    if (expected > M_PI * GeoEncode::EARTH_RADIUS - 100e3) {
+	return 1;
+    }
+    return 1e-6;
+}
+
+static inline double
+distance_tolerance(double expected, const float *)
+{
+    if (expected > 10000e3) {
+	return 10e3;
+    }
+    return expected * 1e-5 + 1;
+}
+
+/// Get the error allowed in a squared chord from chord_squared_batch().
+static inline double
+chord_tolerance(const double *)
+{
+    return CHORD_TOLERANCE;
+}
+
+static inline double
+chord_tolerance(const float *)
+{
+    return FLOAT_CHORD_TOLERANCE;
+}
+
+/** Check distances or squared chords against the decoded coordinates.
+ */
+template<typename T>
+static void
+check_distance_batch(double lat, double lon, const PackedCode * codes,
+		     size_t n, bool metres, const T * result,
+		     GeoEncode::ShadowCheck & shadow)
+{
+    double q[3];
+    GeoEncode::unit_vector(lat, lon, q);
+    for (size_t i = 0; i != n; ++i) {
+	char encoded[6];
+	GeoEncode::unpack(codes[i], encoded);
+	double code_lat, code_lon;
+	GeoEncode::decode(encoded, 6, code_lat, code_lon);
+	double expected, tolerance;
+	if (metres) {
+	    expected = GeoEncode::haversine_distance(lat, lon,
+						     code_lat, code_lon);
+	    tolerance = distance_tolerance(expected, result);
+	} else {
+	    double p[3];
+	    GeoEncode::unit_vector(code_lat, code_lon, p);
+	    expected = 0;
+	    for (int c = 0; c != 3; ++c) {
+		expected += (p[c] - q[c]) * (p[c] - q[c]);
+	    }
+	    tolerance = chord_tolerance(result);
+	}
+	if (!(fabs(result[i] - expected) <= tolerance)) {
+	    char desc[200];
+	    snprintf(desc, sizeof(desc),
+		     "%s from (%.9f, %.9f) to code %012llx (%.9f, %.9f) is "
+		     "%.17g, reference %.17g", metres ? "distance" : "chord",
+		     lat, lon, (unsigned long long)codes[i], code_lat,
+		     code_lon, double(result[i]), expected);
+	    shadow.mismatch(desc);
+	    return;
+	}
+    }
+}
+
+/** Run the batch kernels for the SIMD level in use.
+ *
+ *  Codes are decoded BATCH_BLOCK at a time to exact integer offsets from the
+ *  query, and the distances then calculated from those.
+ */
+template<typename T>
+static void
+distance_batch(double lat, double lon, const PackedCode * codes, size_t n,
+	       bool metres, T * result)
+{
+    GeoEncode::MetricScope metric(GeoEncode::METRIC_DISTANCE_BATCH, n,
+				  n * sizeof(PackedCode));
+    GeoEncode::ShadowCheck shadow(GeoEncode::SHADOW_DISTANCE_BATCH);
+    BatchQuery q(lat, lon);
+    BatchBlock block;
+    GeoEncode::SimdLevel level = GeoEncode::simd_level();
+    for (size_t start = 0; start < n; start += BATCH_BLOCK) {
+	size_t m = min(BATCH_BLOCK, n - start);
+#if GEOENCODE_X86_SIMD
+	if (level == GeoEncode::SIMD_AVX512) {
+	    decode_batch_avx512(q, codes + start, m, block);
+	    haversine_batch_avx512(q, block, m, metres, result + start);
+	    continue;
+	}
+	if (level == GeoEncode::SIMD_AVX2) {
+	    decode_batch_avx2(q, codes + start, m, block);
+	    haversine_batch_avx2(q, block, m, metres, result + start);
+	    continue;
+	}
+#endif
+	decode_batch_scalar(q, codes + start, m, block);
+	haversine_batch_scalar(q, block, 0, m, metres, result + start);
+    }
+    (void)level;
+
+    if (shadow.active()) {
+	shadow.fast_done();
+	check_distance_batch(lat, lon, codes, n, metres, result, shadow);
+    }
+}
+
+void
+GeoEncode::code_distance_batch(double lat, double lon,
+			       const PackedCode * codes, size_t n,
+			       double * result)
+{
+    distance_batch(lat, lon, codes, n, true, result);
+}
+
+void
+GeoEncode::code_distance_batch(double lat, double lon,
+			       const PackedCode * codes, size_t n,
+			       float * result)
+{
+    distance_batch(lat, lon, codes, n, true, result);
+}
+
+void
+GeoEncode::chord_squared_batch(double lat, double lon,
+			       const PackedCode * codes, size_t n,
+			       double * result)
+{
+    distance_batch(lat, lon, codes, n, false, result);
+}
+
+void
+GeoEncode::chord_squared_batch(double lat, double lon,
+			       const PackedCode * codes, size_t n,
+			       float * result)
+{
+    distance_batch(lat, lon, codes, n, false, result);
+}
+
+/// Calculate the haversine of an angle in degrees, between 0 and 180.
+static inline double
+haversine_degrees(double angle)
+{
+    double s = poly_sin(angle * (RADIANS * 0.5));
+    return s * s;
+}
+
+/// Calculate the cosine of a latitude in degrees.
+static inline double
+cos_latitude(double lat)
+{
+    double s = poly_sin(lat * (RADIANS * 0.5));
+    return max(0.0, 1 - 2 * s * s);
+}
+
+/** Find the smallest rank of the distance from a coordinate to a cell which
+ *  reaches a pole.
+ *
+ *  The cosine of the latitude vanishes at the pole, so bounding with the
+ *  smallest cosine in the cell would ignore the longitude, and make every
+ *  cell around the pole look as near as the nearest.  Instead, the haversine
+ *  formula at the nearest longitude is minimised over the latitudes in the
+ *  cell exactly: it is 1/2 - (a sin(phi) + b cos(phi)), for a and b which
+ *  don't depend on phi, and this is smallest either at an edge of the cell
+ *  or where phi = atan2(a, b).
+ *
+ *  @param lat The latitude of the coordinate in degrees.
+ *  @param cos_lat The cosine of the latitude.
+ *  @param cell The cell.
+ *  @param dlon The difference in longitude to the nearest edge of the cell,
+ *              in degrees, between 0 and 180.
+ */
+static double
+polar_min_rank(double lat, double cos_lat, const GeoEncode::CellBounds & cell,
+	       double dlon)
+{
+    double a = 0.5 * sin(lat * RADIANS);
+    double b = cos_lat * (0.5 - haversine_degrees(dlon));
+    double lo = cell.min_lat * RADIANS;
+    double hi = cell.max_lat * RADIANS;
+    double g = max(a * sin(lo) + b * cos(lo), a * sin(hi) + b * cos(hi));
+    double theta = atan2(a, b);
+    if (theta > lo && theta < hi) {
+	g = hypot(a, b);
+    }
+    return max(0.0, 0.5 - g);
+}
+
+GeoEncode::CellDistanceBounds::CellDistanceBounds(double lat_, double lon_)
+	: lat(lat_), lon(wrap_longitude(lon_)), cos_lat(cos(lat_ * RADIANS))
+{
+}
+
+double
+GeoEncode::CellDistanceBounds::min_rank(const CellBounds & cell) const
+{
+    double dlat = max(0.0, max(cell.min_lat - lat, lat - cell.max_lat));
+
+    // Distance east from the coordinate to the cell, and west from it.
+    double east = cell.min_lon - lon;
+    if (east < 0) east += 360;
+    double west = lon - cell.max_lon;
+    if (west < 0) west += 360;
+    double dlon = (lon >= cell.min_lon && lon <= cell.max_lon) ?
+	    0 : min(east, west);
+    if (dlon > 0 && (cell.min_lat <= -90 || cell.max_lat >= 90)) {
+	return polar_min_rank(lat, cos_lat, cell, min(dlon, 180.0));
+    }
+
+    double cos_min = min(cos_latitude(cell.min_lat),
+			 cos_latitude(cell.max_lat));
+    return haversine_degrees(dlat) +
+	    cos_lat * cos_min * haversine_degrees(min(dlon, 180.0));
+}
+
+double
+GeoEncode::CellDistanceBounds::max_rank(const CellBounds & cell) const
+{
+    double dlat = max(fabs(cell.min_lat - lat), fabs(cell.max_lat - lat));
+
+    // The furthest longitude is either edge, unless the point opposite the
+    // coordinate is in the cell.
+    double dlon1 = fabs(cell.min_lon - lon);
+    if (dlon1 > 180) dlon1 = 360 - dlon1;
+    double dlon2 = fabs(cell.max_lon - lon);
+    if (dlon2 > 180) dlon2 = 360 - dlon2;
+    double dlon = max(dlon1, dlon2);
+    double opposite = lon < 180 ? lon + 180 : lon - 180;
+    if (opposite >= cell.min_lon && opposite <= cell.max_lon) {
+	dlon = 180;
+    }
+
+    double cos_max = (cell.min_lat <= 0 && cell.max_lat >= 0) ? 1.0 :
+	    max(cos_latitude(cell.min_lat), cos_latitude(cell.max_lat));
+    return min(1.0, haversine_degrees(dlat) +
+		    cos_lat * cos_max * haversine_degrees(dlon));
+}
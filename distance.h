@@ -0,0 +1,335 @@
+/** @file distance.h
+ * @brief Distance calculations between coordinates.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GEOENCODE_INCLUDED_DISTANCE_H
+#define GEOENCODE_INCLUDED_DISTANCE_H
+
+#include "geoencode.h"
+
+namespace GeoEncode {
+
+/** Mean radius of the earth, in metres.
+ *
+ *  All distances are calculated on a sphere of this radius.
+ */
+const double EARTH_RADIUS = 6371008.8;
+
+/** Calculate the great-circle distance between two coordinates.
+ *
+ * @param lat1 The latitude of the first coordinate in degrees.
+ * @param lon1 The longitude of the first coordinate in degrees.
+ * @param lat2 The latitude of the second coordinate in degrees.
+ * @param lon2 The longitude of the second coordinate in degrees.
+ *
+ * @returns The distance in metres, calculated with the haversine formula.
+ */
+extern double
+haversine_distance(double lat1, double lon1, double lat2, double lon2);
+
+/** Calculate the distance from a coordinate to the nearest point in a box.
+ *
+ * @param lat The latitude of the coordinate in degrees.
+ * @param lon The longitude of the coordinate in degrees.
+ * @param min_lat The latitude of the southern edge of the box.
+ * @param lon1 The longitude of the western edge of the box.
+ * @param max_lat The latitude of the northern edge of the box.
+ * @param lon2 The longitude of the eastern edge of the box.  If this is
+ *             less than @a lon1 (after wrapping both to the range [0,360)),
+ *             the box crosses the boundary at which longitudes wrap.
+ *
+ * @returns The distance in metres, which is zero if the coordinate is in
+ *          the box.
+ */
+extern double
+box_min_distance(double lat, double lon,
+		 double min_lat, double lon1, double max_lat, double lon2);
+
+/** Calculate a value which ranks the distance between encoded coordinates.
+ *
+ * This is the haversine of the angle between the coordinates, which
+ * increases with the distance, so it can be used to sort points by distance
+ * without the arcsine needed for the distance itself.  Use
+ * rank_to_distance() to convert it to metres.
+ *
+ * This works on the packed codes directly, without decoding them to degrees
+ * or calling libm trigonometric functions.  Sines and cosines of each whole
+ * degree are looked up in a table, and corrected for the minutes and seconds
+ * with short Taylor series, which are exact to double precision for offsets
+ * of less than a degree.
+ *
+ * The codes must be valid, with their first two bytes less than 181 * 360,
+ * as they are from encode(); for other codes, the result is meaningless.
+ *
+ * @param code1 The first coordinate.
+ * @param code2 The second coordinate.
+ *
+ * @returns The rank, between 0 and 1.
+ */
+extern double
+code_distance_rank(PackedCode code1, PackedCode code2);
+
+/** Convert a value from code_distance_rank() to a distance.
+ *
+ * @param rank The value to convert.
+ *
+ * @returns The distance in metres.
+ */
+extern double
+rank_to_distance(double rank);
+
+/** Calculate the great-circle distance between two encoded coordinates.
+ *
+ * This is rank_to_distance(code_distance_rank(code1, code2)), and it agrees
+ * with haversine_distance() of the decoded coordinates to within 1e-6
+ * metres, except within about 100 km of the antipode, where the haversine
+ * formula loses precision and they agree to within a metre.
+ *
+ * @param code1 The first coordinate.
+ * @param code2 The second coordinate.
+ *
+ * @returns The distance in metres, calculated with the haversine formula.
+ */
+inline double
+code_distance(PackedCode code1, PackedCode code2)
+{
+    return rank_to_distance(code_distance_rank(code1, code2));
+}
+
+/** Approximate the distance between two encoded coordinates.
+ *
+ * This uses an equirectangular projection centred on the mean latitude of
+ * the coordinates, which needs one table lookup and a square root.  It is
+ * intended for ranking nearby points.
+ *
+ * For coordinates less than 100 km apart and below 80 degrees latitude, the
+ * relative error is below 0.1%.  The error grows with the distance and
+ * towards the poles, and the approximation is poor beyond a few hundred
+ * kilometres.
+ *
+ * @param code1 The first coordinate.
+ * @param code2 The second coordinate.
+ *
+ * @returns The approximate distance in metres.
+ */
+extern double
+code_distance_fast(PackedCode code1, PackedCode code2);
+
+/** Calculate the unit vector for a coordinate.
+ *
+ * The vector is in the earth-centred, earth-fixed frame: x towards latitude
+ * and longitude 0, y towards longitude 90 on the equator, and z towards the
+ * north pole.  The dot product of two unit vectors is the cosine of the
+ * angle between them, so it orders points by distance with no trigonometry
+ * per pair; see dot_to_rank().
+ *
+ * @param lat The latitude of the coordinate in degrees.
+ * @param lon The longitude of the coordinate in degrees.
+ * @param xyz An array of 3 values to write the vector to.
+ */
+extern void
+unit_vector(double lat, double lon, double * xyz);
+
+/** Calculate the unit vector for an encoded coordinate.
+ *
+ * Like code_distance_rank(), this works on the packed code directly, using
+ * the table of sines and cosines of whole degrees rather than libm.  The
+ * components are within 4e-15 of those from unit_vector() of the decoded
+ * coordinate.  As for code_distance_rank(), the code must be valid.
+ *
+ * @param code The coordinate.
+ * @param xyz An array of 3 values to write the vector to.
+ */
+extern void
+code_unit_vector(PackedCode code, double * xyz);
+
+/** Calculate the unit vector for an encoded coordinate, in single
+ *  precision.
+ *
+ * Single precision vectors resolve angles of about 3e-4 radians (2 km)
+ * from their dot products, but about 1e-7 radians (1 m) from the squared
+ * lengths of their differences.
+ */
+extern void
+code_unit_vector(PackedCode code, float * xyz);
+
+/** Calculate the unit vectors for an array of codes.
+ *
+ * @param codes The codes.
+ * @param n The number of codes.
+ * @param xyz An array of 3 * @a n values to write the vectors to, with the
+ *            x, y and z components of each vector together.
+ */
+extern void
+code_unit_vector_batch(const PackedCode * codes, size_t n, double * xyz);
+
+/** Calculate the unit vectors for an array of codes, in single precision.
+ */
+extern void
+code_unit_vector_batch(const PackedCode * codes, size_t n, float * xyz);
+
+/** Get the number of bytes of memory used by the table of sines and cosines
+ *  of whole degrees, which code_unit_vector(), code_distance() and the
+ *  functions built on them share.
+ */
+extern size_t
+distance_tables_memory_used();
+
+/** Convert the dot product of two unit vectors to a rank.
+ *
+ * The result is on the same scale as code_distance_rank(), so
+ * rank_to_distance() converts it to metres.  The dot product is close to 1
+ * for nearby points, so distances from it are only accurate to about 0.1 m
+ * in double precision; a quarter of the squared length of the difference of
+ * the vectors gives the same rank without this loss.
+ */
+inline double
+dot_to_rank(double dot)
+{
+    return dot >= 1 ? 0 : dot <= -1 ? 1 : (1 - dot) * 0.5;
+}
+
+/** Calculate the distances from a coordinate to an array of codes.
+ *
+ * This decodes the codes and evaluates the haversine formula with AVX2 or
+ * AVX-512 where the processor supports them, using polynomial approximations
+ * rather than libm.  The results agree with haversine_distance() of the
+ * decoded coordinates as closely as code_distance() does.
+ *
+ * @param lat The latitude of the coordinate in degrees.
+ * @param lon The longitude of the coordinate in degrees.
+ * @param codes The codes.
+ * @param n The number of codes.
+ * @param result An array of @a n values to write the distances in metres
+ *               to.
+ */
+extern void
+code_distance_batch(double lat, double lon, const PackedCode * codes,
+		    size_t n, double * result);
+
+/** Calculate the distances from a coordinate to an array of codes, in single
+ *  precision.
+ *
+ * This works in single precision throughout, which doubles the number of
+ * codes handled by each SIMD instruction.  For distances up to 10000 km the
+ * error is below 1e-5 of the distance plus a metre, but precision is lost
+ * towards the antipode of the coordinate, where it may be several km.
+ */
+extern void
+code_distance_batch(double lat, double lon, const PackedCode * codes,
+		    size_t n, float * result);
+
+/** Calculate the squared chord lengths from a coordinate to an array of
+ *  codes.
+ *
+ * The chord is the straight line between the points through a sphere of
+ * radius 1, and its squared length increases with the distance, so it can be
+ * used to rank points by distance.  It is cheaper to calculate than the
+ * distance, since it needs no square root or arcsine.
+ *
+ * @param lat The latitude of the coordinate in degrees.
+ * @param lon The longitude of the coordinate in degrees.
+ * @param codes The codes.
+ * @param n The number of codes.
+ * @param result An array of @a n values to write the squared chord lengths
+ *               (between 0 and 4) to.
+ */
+extern void
+chord_squared_batch(double lat, double lon, const PackedCode * codes,
+		    size_t n, double * result);
+
+/** Calculate the squared chord lengths from a coordinate to an array of
+ *  codes, in single precision.
+ *
+ * This is intended for ranking, where exact distances aren't needed.
+ */
+extern void
+chord_squared_batch(double lat, double lon, const PackedCode * codes,
+		    size_t n, float * result);
+
+/** Bounds on the distances from a coordinate to the points in cells.
+ *
+ * This is intended for pruning cells during searches without decoding the
+ * codes in them.  The bounds are conservative: the distance from the
+ * coordinate to any point in a cell lies between the minimum and maximum.
+ *
+ * Each bound is found from the haversine formula, using the nearest (or
+ * furthest) latitude and longitude in the cell to the coordinate, and the
+ * cosine of the latitude in the cell furthest from (or nearest to) the
+ * equator.  The minimum is zero for a cell holding the coordinate, and can
+ * be noticeably below the true minimum for cells wider than a few degrees.
+ * For cells reaching a pole, where the cosine vanishes, the minimum is
+ * found exactly instead.
+ *
+ * Bounds are available as ranks (see code_distance_rank()), which avoid the
+ * arcsine, or in metres.
+ */
+class CellDistanceBounds {
+    /** The latitude of the coordinate in degrees.
+     */
+    double lat;
+
+    /** The longitude of the coordinate in degrees, in [0,360).
+     */
+    double lon;
+
+    /** The cosine of the latitude.
+     */
+    double cos_lat;
+
+  public:
+    /** Prepare to bound distances from a coordinate.
+     *
+     * @param lat The latitude of the coordinate in degrees.
+     * @param lon The longitude of the coordinate in degrees.
+     */
+    CellDistanceBounds(double lat, double lon);
+
+    /** Get a lower bound on the rank of the distance to a point in a cell.
+     */
+    double min_rank(const CellBounds & cell) const;
+
+    /** Get an upper bound on the rank of the distance to a point in a cell.
+     */
+    double max_rank(const CellBounds & cell) const;
+
+    /** Get a lower bound on the distance to a point in a cell, in metres.
+     */
+    double min_distance(const CellBounds & cell) const {
+	return rank_to_distance(min_rank(cell));
+    }
+
+    /** Get an upper bound on the distance to a point in a cell, in metres.
+     */
+    double max_distance(const CellBounds & cell) const {
+	return rank_to_distance(max_rank(cell));
+    }
+
+    /** Get the number of bytes of memory used by the bounds.
+     */
+    size_t memory_used() const { return sizeof(*this); }
+};
+
+}
+
+#endif /* GEOENCODE_INCLUDED_DISTANCE_H */
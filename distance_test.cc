@@ -0,0 +1,381 @@
+/** @file distance_test.cc
+ * @brief Tests for distance calculations.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "distance.h"
+#include "simd.h"
+#include "testutils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+/** Check that a distance is close to an expected value.
+ */
+static bool
+check_close(const char * what, double got, double expected,
+	    double tolerance)
+{
+    if (fabs(got - expected) > tolerance) {
+	fprintf(stderr, "%s: got %.10g, expected %.10g\n", what, got,
+		expected);
+	return false;
+    }
+    return true;
+}
+
+/** Get the tolerance for comparing a distance with haversine_distance().
+ *
+ *  Within about 100 km of the antipode, the haversine formula loses
+ *  precision, so only agreement to a metre is expected there.
+ */
+static double
+tolerance(double expected)
+{
+    return (expected < GeoEncode::EARTH_RADIUS * M_PI - 100000) ? 1e-6 : 1.0;
+}
+
+/** Check box_min_distance() against the minimum over a fine grid of points
+ *  in the box.
+ */
+static bool
+check_box(double lat, double lon,
+	  double min_lat, double lon1, double max_lat, double lon2)
+{
+    double got = GeoEncode::box_min_distance(lat, lon, min_lat, lon1,
+					     max_lat, lon2);
+    double width = lon2 - lon1;
+    if (width < 0) width += 360;
+    double best = HUGE_VAL;
+    const int steps = 400;
+    for (int i = 0; i <= steps; ++i) {
+	double p_lat = min_lat + (max_lat - min_lat) * i / steps;
+	for (int j = 0; j <= steps; ++j) {
+	    double p_lon = lon1 + width * j / steps;
+	    double d = GeoEncode::haversine_distance(lat, lon, p_lat, p_lon);
+	    if (d < best) best = d;
+	}
+    }
+    // The grid minimum can only be larger than the true minimum.
+    double slack = (max_lat - min_lat + width) / steps *
+	    GeoEncode::EARTH_RADIUS * M_PI / 180.0;
+    if (got > best + 1e-6 || got < best - slack) {
+	fprintf(stderr, "box_min_distance(%g,%g, %g,%g,%g,%g) = %.10g, "
+		"grid minimum %.10g\n", lat, lon, min_lat, lon1, max_lat,
+		lon2, got, best);
+	return false;
+    }
+    return true;
+}
+
+/// Encode a coordinate as a packed code.
+/** Check the unit vectors for two coordinates against unit_vector() of the
+ *  decoded coordinates, and the rank from their dot product.
+ */
+static bool
+check_unit_vectors(double lat1, double lon1, double lat2, double lon2)
+{
+    GeoEncode::PackedCode codes[2] = {
+	pack_coord(lat1, lon1), pack_coord(lat2, lon2)
+    };
+    double got[6], expected[6];
+    float got_float[6];
+    GeoEncode::code_unit_vector_batch(codes, 2, got);
+    GeoEncode::code_unit_vector_batch(codes, 2, got_float);
+    for (int i = 0; i != 2; ++i) {
+	string encoded;
+	GeoEncode::unpack(codes[i], encoded);
+	double lat, lon;
+	GeoEncode::decode(encoded, lat, lon);
+	GeoEncode::unit_vector(lat, lon, expected + i * 3);
+	double single[3];
+	GeoEncode::code_unit_vector(codes[i], single);
+	for (int j = 0; j != 3; ++j) {
+	    if (fabs(got[i * 3 + j] - expected[i * 3 + j]) > 4e-15 ||
+		single[j] != got[i * 3 + j] ||
+		fabs(got_float[i * 3 + j] - expected[i * 3 + j]) > 1e-7) {
+		fprintf(stderr, "unit vector for (%g,%g) component %d: got "
+			"%.17g (%.9g), expected %.17g\n", lat, lon, j,
+			got[i * 3 + j], got_float[i * 3 + j],
+			expected[i * 3 + j]);
+		return false;
+	    }
+	}
+    }
+
+    double dot = got[0] * got[3] + got[1] * got[4] + got[2] * got[5];
+    double rank = GeoEncode::code_distance_rank(codes[0], codes[1]);
+    return check_close("dot_to_rank", GeoEncode::dot_to_rank(dot), rank,
+		       4e-15);
+}
+
+/** Check code_distance() against haversine_distance() of the decoded
+ *  coordinates, and code_distance_fast() against it for nearby points.
+ */
+static bool
+check_codes(double lat1, double lon1, double lat2, double lon2)
+{
+    GeoEncode::PackedCode code1 = pack_coord(lat1, lon1);
+    GeoEncode::PackedCode code2 = pack_coord(lat2, lon2);
+    string encoded1, encoded2;
+    GeoEncode::unpack(code1, encoded1);
+    GeoEncode::decode(encoded1, lat1, lon1);
+    GeoEncode::unpack(code2, encoded2);
+    GeoEncode::decode(encoded2, lat2, lon2);
+    double expected = GeoEncode::haversine_distance(lat1, lon1, lat2, lon2);
+
+    double got = GeoEncode::code_distance(code1, code2);
+    if (fabs(got - expected) > tolerance(expected)) {
+	fprintf(stderr, "code_distance(%g,%g, %g,%g) = %.10g, expected "
+		"%.10g\n", lat1, lon1, lat2, lon2, got, expected);
+	return false;
+    }
+
+    if (expected < 100000 && fabs(lat1) < 80 && fabs(lat2) < 80) {
+	got = GeoEncode::code_distance_fast(code1, code2);
+	if (fabs(got - expected) > expected * 0.001) {
+	    fprintf(stderr, "code_distance_fast(%g,%g, %g,%g) = %.10g, "
+		    "expected %.10g\n", lat1, lon1, lat2, lon2, got, expected);
+	    return false;
+	}
+    }
+    return true;
+}
+
+/** Check the batch functions against haversine_distance() of the decoded
+ *  coordinates.
+ */
+static bool
+check_batch(double lat, double lon, const vector<GeoEncode::PackedCode> & codes)
+{
+    size_t n = codes.size();
+    vector<double> metres(n), chords(n);
+    vector<float> metres_f(n), chords_f(n);
+    const GeoEncode::PackedCode * p = n ? &codes[0] : NULL;
+    GeoEncode::code_distance_batch(lat, lon, p, n, n ? &metres[0] : NULL);
+    GeoEncode::code_distance_batch(lat, lon, p, n, n ? &metres_f[0] : NULL);
+    GeoEncode::chord_squared_batch(lat, lon, p, n, n ? &chords[0] : NULL);
+    GeoEncode::chord_squared_batch(lat, lon, p, n, n ? &chords_f[0] : NULL);
+    for (size_t i = 0; i != n; ++i) {
+	string encoded;
+	GeoEncode::unpack(codes[i], encoded);
+	double lat2, lon2;
+	GeoEncode::decode(encoded, lat2, lon2);
+	double expected = GeoEncode::haversine_distance(lat, lon, lat2, lon2);
+	double s = sin(expected / (2 * GeoEncode::EARTH_RADIUS));
+	double chord = 4 * s * s;
+	if (fabs(metres[i] - expected) > tolerance(expected) ||
+	    (expected < 1e7 &&
+	     fabs(metres_f[i] - expected) > expected * 1e-5 + 1) ||
+	    fabs(chords[i] - chord) > chord * 1e-9 + 1e-15 ||
+	    fabs(chords_f[i] - chord) > chord * 1e-5 + 1e-12) {
+	    fprintf(stderr, "batch from (%g,%g) to (%g,%g): got %.10g %.10g "
+		    "%.10g %.10g, expected %.10g %.10g\n", lat, lon, lat2, lon2,
+		    metres[i], metres_f[i], chords[i], chords_f[i], expected,
+		    chord);
+	    return false;
+	}
+    }
+    return true;
+}
+
+/** Check that the bounds on distances from a coordinate to a cell hold for
+ *  random points in the cell and its corners.
+ */
+static bool
+check_cell_bounds(double lat, double lon, GeoEncode::PackedCode code,
+		  size_t len)
+{
+    GeoEncode::CellBounds cell;
+    if (!GeoEncode::cell_bounds(code, len, cell)) {
+	fprintf(stderr, "cell_bounds failed\n");
+	return false;
+    }
+    GeoEncode::CellDistanceBounds bounds(lat, lon);
+    double lo = bounds.min_distance(cell);
+    double hi = bounds.max_distance(cell);
+    for (int i = 0; i != 20; ++i) {
+	double p_lat = (i & 1) ? cell.max_lat : cell.min_lat;
+	double p_lon = (i & 2) ? cell.max_lon : cell.min_lon;
+	if (i >= 4) {
+	    p_lat = cell.min_lat +
+		    (cell.max_lat - cell.min_lat) * random() / RAND_MAX;
+	    p_lon = cell.min_lon +
+		    (cell.max_lon - cell.min_lon) * random() / RAND_MAX;
+	}
+	double d = GeoEncode::haversine_distance(lat, lon, p_lat, p_lon);
+	if (d < lo - tolerance(d) || d > hi + tolerance(d)) {
+	    fprintf(stderr, "distance from (%g,%g) to (%g,%g) is %.10g, "
+		    "outside bounds %.10g to %.10g for cell "
+		    "(%g,%g)-(%g,%g)\n", lat, lon, p_lat, p_lon, d, lo, hi,
+		    cell.min_lat, cell.min_lon, cell.max_lat, cell.max_lon);
+	    return false;
+	}
+    }
+    return true;
+}
+
+int main() {
+    bool ok = true;
+    const double degree = GeoEncode::EARTH_RADIUS * M_PI / 180.0;
+
+    ok &= check_close("zero", GeoEncode::haversine_distance(10, 20, 10, 20),
+		      0, 1e-9);
+    ok &= check_close("meridian",
+		      GeoEncode::haversine_distance(0, 0, 1, 0), degree, 1e-6);
+    ok &= check_close("equator",
+		      GeoEncode::haversine_distance(0, 359.5, 0, 0.5),
+		      degree, 1e-6);
+    ok &= check_close("poles",
+		      GeoEncode::haversine_distance(-90, 0, 90, 123),
+		      180 * degree, 1e-6);
+    ok &= check_close("antipodes",
+		      GeoEncode::haversine_distance(30, 40, -30, 220),
+		      180 * degree, 1e-6);
+
+    ok &= check_close("inside",
+		      GeoEncode::box_min_distance(5, 5, 0, 0, 10, 10), 0, 0);
+    ok &= check_close("inside wrapped",
+		      GeoEncode::box_min_distance(5, 1, 0, 350, 10, 10), 0, 0);
+    ok &= check_close("south of box",
+		      GeoEncode::box_min_distance(-2, 5, 0, 0, 10, 10),
+		      2 * degree, 1e-6);
+    ok &= check_close("pole",
+		      GeoEncode::box_min_distance(90, 0, 0, 100, 80, 110),
+		      10 * degree, 1e-6);
+
+    for (int i = 0; i != 200; ++i) {
+	double lat = ((random() * 180.0) / RAND_MAX) - 90.0;
+	double lon = ((random() * 360.0) / RAND_MAX);
+	double lat1 = ((random() * 180.0) / RAND_MAX) - 90.0;
+	double lat2 = ((random() * 180.0) / RAND_MAX) - 90.0;
+	if (lat1 > lat2) {
+	    double tmp = lat1;
+	    lat1 = lat2;
+	    lat2 = tmp;
+	}
+	double lon1 = ((random() * 360.0) / RAND_MAX);
+	double lon2 = lon1 + ((random() * 40.0) / RAND_MAX);
+	if (lon2 >= 360) lon2 -= 360;
+	ok &= check_box(lat, lon, lat1, lon1, lat2, lon2);
+    }
+
+    // Distances between codes: random pairs, nearby pairs, and pairs near
+    // the poles, the 0/360 boundary and the antipodes.
+    ok &= check_codes(-90, 0, 90, 0);
+    ok &= check_codes(0, 0, 0, 180);
+    ok &= check_codes(30, 40, -30, 220);
+    ok &= check_codes(51.5, 359.9999, 51.5, 0.0001);
+    ok &= check_codes(89.99, 10, 89.99, 190);
+    for (int i = 0; i != 100000; ++i) {
+	double lat1 = ((random() * 180.0) / RAND_MAX) - 90.0;
+	double lon1 = ((random() * 360.0) / RAND_MAX);
+	double lat2 = ((random() * 180.0) / RAND_MAX) - 90.0;
+	double lon2 = ((random() * 360.0) / RAND_MAX);
+	ok &= check_codes(lat1, lon1, lat2, lon2);
+	double spread = (i % 3 == 0) ? 0.01 : (i % 3 == 1) ? 1.0 : 10.0;
+	lat2 = lat1 + ((random() * spread) / RAND_MAX) - spread / 2;
+	lon2 = lon1 + ((random() * spread) / RAND_MAX) - spread / 2;
+	if (lat2 > 90) lat2 = 90;
+	if (lat2 < -90) lat2 = -90;
+	ok &= check_codes(lat1, lon1, lat2, fmod(lon2 + 360, 360));
+	ok &= check_unit_vectors(lat1, lon1, lat2, fmod(lon2 + 360, 360));
+    }
+    ok &= check_unit_vectors(-90, 0, 90, 0);
+    ok &= check_unit_vectors(0, 359.9999, 0.0001, 180);
+    ok &= check_unit_vectors(30, 90, -30, 270);
+
+    // Invalid codes give meaningless results, but mustn't read past the
+    // tables.
+    {
+	GeoEncode::PackedCode bad = (GeoEncode::PackedCode(1) << 48) - 1;
+	double xyz[3];
+	GeoEncode::code_unit_vector(bad, xyz);
+	double rank = GeoEncode::code_distance_rank(bad, 0);
+	if (!isfinite(xyz[0] + xyz[1] + xyz[2]) || !isfinite(rank)) {
+	    fprintf(stderr, "invalid code gave a non-finite result\n");
+	    ok = false;
+	}
+    }
+
+    // Distance bounds for cells of each size, near and far from the
+    // coordinate, and at the poles.
+    for (int i = 0; i != 20000; ++i) {
+	double lat = ((random() * 180.0) / RAND_MAX) - 90.0;
+	double lon = ((random() * 360.0) / RAND_MAX);
+	double lat2, lon2;
+	if (i % 2) {
+	    lat2 = ((random() * 180.0) / RAND_MAX) - 90.0;
+	    lon2 = ((random() * 360.0) / RAND_MAX);
+	} else {
+	    lat2 = max(-90.0, min(90.0, lat + ((random() * 2.0) / RAND_MAX) - 1));
+	    lon2 = fmod(lon + ((random() * 2.0) / RAND_MAX) + 359, 360);
+	}
+	if (i % 100 == 0) lat2 = 90;
+	if (i % 100 == 1) lat2 = -90;
+	ok &= check_cell_bounds(lat, lon, pack_coord(lat2, lon2), 2 + i % 5);
+    }
+    {
+	GeoEncode::CellBounds cell;
+	GeoEncode::cell_bounds(pack_coord(51.5, 359.5), 2, cell);
+	GeoEncode::CellDistanceBounds bounds(51.2, -0.7);
+	ok &= check_close("inside cell", bounds.min_distance(cell), 0, 0);
+    }
+
+    // Batch distances with each SIMD level, for sizes which leave tails.
+    GeoEncode::SimdLevel levels[] = {
+	GeoEncode::SIMD_NONE, GeoEncode::SIMD_AVX2, GeoEncode::SIMD_AVX512
+    };
+    for (int l = 0; l != 3; ++l) {
+	GeoEncode::set_simd_limit(levels[l]);
+	for (int i = 0; i != 100; ++i) {
+	    double lat = ((random() * 180.0) / RAND_MAX) - 90.0;
+	    double lon = ((random() * 360.0) / RAND_MAX) - 180.0;
+	    if (i == 0) lat = 90;
+	    if (i == 1) lat = -90;
+	    vector<GeoEncode::PackedCode> codes(random() % 600);
+	    for (size_t j = 0; j != codes.size(); ++j) {
+		double lat2, lon2;
+		if (j % 2) {
+		    lat2 = ((random() * 180.0) / RAND_MAX) - 90.0;
+		    lon2 = ((random() * 360.0) / RAND_MAX);
+		} else {
+		    lat2 = lat + ((random() * 0.1) / RAND_MAX) - 0.05;
+		    lon2 = lon + ((random() * 0.1) / RAND_MAX) - 0.05;
+		    lat2 = max(-90.0, min(90.0, lat2));
+		    lon2 = fmod(lon2 + 360, 360);
+		}
+		codes[j] = pack_coord(lat2, lon2);
+	    }
+	    ok &= check_batch(lat, lon, codes);
+	}
+    }
+    GeoEncode::set_simd_limit(GeoEncode::SIMD_AVX512);
+
+    return ok ? 0 : 1;
+}
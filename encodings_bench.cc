@@ -0,0 +1,641 @@
+/** @file encodings_bench.cc
+ * @brief Benchmark comparing the encoding with other point encodings.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "bench.h"
+#include "cover.h"
+#include "distance.h"
+#include "geoencode.h"
+#include "workload.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+using GeoEncode::QueryBox;
+
+/// Default number of points in each benchmark.
+static const size_t DEFAULT_POINTS = 1000000;
+
+/// Seed for generating the points, so runs are comparable.
+static const uint64_t POINTS_SEED = 42;
+
+/// Seed for generating the query boxes.
+static const uint64_t BOXES_SEED = 4242;
+
+/// Number of boxes of each selectivity to cover.
+static const size_t BOXES = 16;
+
+/// Proportions of the points which the bounding boxes should contain.
+static const double SELECTIVITIES[] = {
+    0.0001, 0.01, 0.1
+};
+
+/// Numbers of ranges which covers may use before they stop refining.
+static const size_t BUDGETS[] = {
+    16, 256
+};
+
+/** A range of sort keys, inclusive.
+ */
+struct KeyRange {
+    uint64_t first, last;
+};
+
+/// Order ranges by their first key.
+static bool
+range_less(const KeyRange & a, const KeyRange & b)
+{
+    return a.first < b.first;
+}
+
+/// Sort ranges, and merge any which overlap or are adjacent.
+static void
+merge_ranges(vector<KeyRange> & ranges)
+{
+    sort(ranges.begin(), ranges.end(), range_less);
+    size_t out = 0;
+    for (size_t i = 0; i != ranges.size(); ++i) {
+	if (out && ranges[i].first <= ranges[out - 1].last + 1 &&
+	    ranges[out - 1].last != ~uint64_t(0)) {
+	    ranges[out - 1].last = max(ranges[out - 1].last, ranges[i].last);
+	} else {
+	    ranges[out++] = ranges[i];
+	}
+    }
+    ranges.resize(out);
+}
+
+/** Convert a longitude from the range 0 to 360 used by the workloads to
+ *  the range -180 to 180 used by the other encodings.
+ */
+static inline double
+signed_lon(double lon)
+{
+    return lon >= 180 ? lon - 360 : lon;
+}
+
+/** Find the longitude intervals of a box in the range -180 to 180.
+ *
+ *  The workload boxes wrap at 0/360, and the other encodings at 180, so a
+ *  box may need splitting in two.
+ */
+static void
+signed_lon_intervals(const QueryBox & box,
+		     vector<pair<double, double> > & lons)
+{
+    lons.clear();
+    double lon1 = signed_lon(box.lon1), lon2 = signed_lon(box.lon2);
+    if (lon1 <= lon2) {
+	lons.push_back(make_pair(lon1, lon2));
+    } else {
+	lons.push_back(make_pair(lon1, 180.0));
+	lons.push_back(make_pair(-180.0, lon2));
+    }
+}
+
+/** Quantise a coordinate to one of 2^@a bits steps over its range.
+ */
+static inline uint64_t
+quantise(double value, double lo, double span, unsigned bits)
+{
+    double steps = ldexp(1.0, bits);
+    double q = floor((value - lo) / span * steps);
+    if (q < 0) return 0;
+    return q >= steps ? uint64_t(steps) - 1 : uint64_t(q);
+}
+
+/// Spread the low 32 bits of a value to the even bits.
+static inline uint64_t
+spread_bits(uint64_t x)
+{
+    x &= 0xffffffff;
+    x = (x | (x << 16)) & 0x0000ffff0000ffffULL;
+    x = (x | (x << 8)) & 0x00ff00ff00ff00ffULL;
+    x = (x | (x << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    x = (x | (x << 2)) & 0x3333333333333333ULL;
+    x = (x | (x << 1)) & 0x5555555555555555ULL;
+    return x;
+}
+
+/// Gather the even bits of a value into the low 32 bits.
+static inline uint64_t
+compact_bits(uint64_t x)
+{
+    x &= 0x5555555555555555ULL;
+    x = (x | (x >> 1)) & 0x3333333333333333ULL;
+    x = (x | (x >> 2)) & 0x0f0f0f0f0f0f0f0fULL;
+    x = (x | (x >> 4)) & 0x00ff00ff00ff00ffULL;
+    x = (x | (x >> 8)) & 0x0000ffff0000ffffULL;
+    x = (x | (x >> 16)) & 0x00000000ffffffffULL;
+    return x;
+}
+
+/** A rectangle of cells in a 2^bits by 2^bits grid, inclusive.
+ */
+struct GridRect {
+    uint64_t x1, x2, y1, y2;
+};
+
+/** Find the grid rectangles of a box for a Z-order encoding.
+ */
+static void
+grid_rects(const QueryBox & box, unsigned bits, vector<GridRect> & rects)
+{
+    rects.clear();
+    vector<pair<double, double> > lons;
+    signed_lon_intervals(box, lons);
+    for (size_t i = 0; i != lons.size(); ++i) {
+	GridRect r;
+	r.x1 = quantise(lons[i].first, -180, 360, bits);
+	r.x2 = quantise(lons[i].second, -180, 360, bits);
+	r.y1 = quantise(box.lat1, -90, 180, bits);
+	r.y2 = quantise(box.lat2, -90, 180, bits);
+	rects.push_back(r);
+    }
+}
+
+/** Cover grid rectangles with cells of a Z-order curve.
+ *
+ *  Starting from the whole grid, cells which partly overlap the rectangles
+ *  are split into their four quadrants, level by level, until refining
+ *  another level would take more than @a budget cells; cells entirely
+ *  inside a rectangle are kept as they are.  This is the usual prefix cover
+ *  for geohash and Morton codes, and the ranges are the cells' key ranges
+ *  merged where adjacent.
+ *
+ *  The keys have the longitude bit above the latitude bit at each level,
+ *  as geohash does.
+ */
+static void
+zorder_cover(const vector<GridRect> & rects, unsigned bits, size_t budget,
+	     vector<KeyRange> & ranges)
+{
+    struct Cell {
+	unsigned level;
+	uint64_t x, y;
+    };
+    vector<Cell> whole, partial, next;
+    Cell root = { 0, 0, 0 };
+    partial.push_back(root);
+    for (unsigned level = 0; level != bits && !partial.empty(); ++level) {
+	if (whole.size() + partial.size() * 4 > budget) {
+	    break;
+	}
+	next.clear();
+	unsigned shift = bits - level - 1;
+	for (size_t i = 0; i != partial.size(); ++i) {
+	    for (unsigned q = 0; q != 4; ++q) {
+		Cell child = {
+		    level + 1, partial[i].x * 2 + (q >> 1),
+		    partial[i].y * 2 + (q & 1)
+		};
+		uint64_t x1 = child.x << shift;
+		uint64_t x2 = ((child.x + 1) << shift) - 1;
+		uint64_t y1 = child.y << shift;
+		uint64_t y2 = ((child.y + 1) << shift) - 1;
+		bool overlaps = false, inside = false;
+		for (size_t r = 0; r != rects.size(); ++r) {
+		    const GridRect & rect = rects[r];
+		    if (x2 < rect.x1 || x1 > rect.x2 ||
+			y2 < rect.y1 || y1 > rect.y2) {
+			continue;
+		    }
+		    overlaps = true;
+		    if (x1 >= rect.x1 && x2 <= rect.x2 &&
+			y1 >= rect.y1 && y2 <= rect.y2) {
+			inside = true;
+		    }
+		}
+		if (inside) {
+		    whole.push_back(child);
+		} else if (overlaps) {
+		    next.push_back(child);
+		}
+	    }
+	}
+	partial.swap(next);
+    }
+    whole.insert(whole.end(), partial.begin(), partial.end());
+
+    ranges.clear();
+    for (size_t i = 0; i != whole.size(); ++i) {
+	const Cell & cell = whole[i];
+	unsigned shift = 2 * (bits - cell.level);
+	KeyRange range;
+	if (shift >= 64) {
+	    range.first = 0;
+	    range.last = ~uint64_t(0) >> (64 - 2 * bits);
+	} else {
+	    uint64_t prefix = (spread_bits(cell.x) << 1) |
+		    spread_bits(cell.y);
+	    range.first = prefix << shift;
+	    range.last = range.first + ((uint64_t(1) << shift) - 1);
+	}
+	ranges.push_back(range);
+    }
+    merge_ranges(ranges);
+}
+
+/** This library's encoding, with its truncated-prefix cover.
+ */
+struct GeoEncodeFormat {
+    static const size_t BYTES = 6;
+
+    static const char * name() { return "geoencode"; }
+
+    static void encode(double lat, double lon, string & result) {
+	GeoEncode::encode(lat, lon, result);
+    }
+
+    static void decode(const char * ptr, double & lat, double & lon) {
+	GeoEncode::decode(ptr, 6, lat, lon);
+    }
+
+    static uint64_t key(const char * ptr) {
+	return GeoEncode::pack(ptr);
+    }
+
+    static void cover(const QueryBox & box, size_t budget,
+		      vector<KeyRange> & ranges) {
+	vector<GeoEncode::CodeRange> codes;
+	GeoEncode::bounding_box_cover(box.lat1, box.lon1, box.lat2, box.lon2,
+				      codes, budget);
+	ranges.clear();
+	for (size_t i = 0; i != codes.size(); ++i) {
+	    KeyRange range = { codes[i].first, codes[i].last };
+	    ranges.push_back(range);
+	}
+    }
+};
+
+/// The characters of geohashes, in order of their values.
+static const char GEOHASH_ALPHABET[] = "0123456789bcdefghjkmnpqrstuvwxyz";
+
+/** The values of geohash characters, with invalid characters treated as 0.
+ */
+static struct GeohashValues {
+    unsigned char values[256];
+
+    GeohashValues() {
+	memset(values, 0, sizeof(values));
+	for (unsigned i = 0; i != 32; ++i) {
+	    values[(unsigned char)GEOHASH_ALPHABET[i]] = i;
+	}
+    }
+} geohash_values;
+
+/** Geohash with 12 characters: 30 bits each of longitude and latitude,
+ *  interleaved and written 5 bits to a character in base 32.
+ */
+struct GeohashFormat {
+    static const size_t BYTES = 12;
+
+    static const unsigned BITS = 30;
+
+    static const char * name() { return "geohash"; }
+
+    static void encode(double lat, double lon, string & result) {
+	uint64_t x = quantise(signed_lon(lon), -180, 360, BITS);
+	uint64_t y = quantise(lat, -90, 180, BITS);
+	uint64_t bits = (spread_bits(x) << 1) | spread_bits(y);
+	char buf[BYTES];
+	for (size_t i = 0; i != BYTES; ++i) {
+	    buf[i] = GEOHASH_ALPHABET[(bits >> (55 - 5 * i)) & 31];
+	}
+	result.append(buf, BYTES);
+    }
+
+    static uint64_t key(const char * ptr) {
+	uint64_t bits = 0;
+	for (size_t i = 0; i != BYTES; ++i) {
+	    bits = (bits << 5) | geohash_values.values[(unsigned char)ptr[i]];
+	}
+	return bits;
+    }
+
+    static void decode(const char * ptr, double & lat, double & lon) {
+	uint64_t bits = key(ptr);
+	double scale = ldexp(1.0, -int(BITS));
+	lon = -180 + (compact_bits(bits >> 1) + 0.5) * 360 * scale;
+	lat = -90 + (compact_bits(bits) + 0.5) * 180 * scale;
+    }
+
+    static void cover(const QueryBox & box, size_t budget,
+		      vector<KeyRange> & ranges) {
+	vector<GridRect> rects;
+	grid_rects(box, BITS, rects);
+	zorder_cover(rects, BITS, budget, ranges);
+    }
+};
+
+/** A 64 bit Morton (Z-order) code: 32 bits each of longitude and latitude,
+ *  interleaved and stored big-endian.
+ */
+struct MortonFormat {
+    static const size_t BYTES = 8;
+
+    static const unsigned BITS = 32;
+
+    static const char * name() { return "morton64"; }
+
+    static void encode(double lat, double lon, string & result) {
+	uint64_t x = quantise(signed_lon(lon), -180, 360, BITS);
+	uint64_t y = quantise(lat, -90, 180, BITS);
+	uint64_t bits = (spread_bits(x) << 1) | spread_bits(y);
+	char buf[BYTES];
+	for (int i = BYTES - 1; i >= 0; --i) {
+	    buf[i] = char(bits & 0xff);
+	    bits >>= 8;
+	}
+	result.append(buf, BYTES);
+    }
+
+    static uint64_t key(const char * ptr) {
+	const unsigned char * p = reinterpret_cast<const unsigned char *>(ptr);
+	uint64_t bits = 0;
+	for (size_t i = 0; i != BYTES; ++i) {
+	    bits = (bits << 8) | p[i];
+	}
+	return bits;
+    }
+
+    static void decode(const char * ptr, double & lat, double & lon) {
+	uint64_t bits = key(ptr);
+	double scale = ldexp(1.0, -int(BITS));
+	lon = -180 + (compact_bits(bits >> 1) + 0.5) * 360 * scale;
+	lat = -90 + (compact_bits(bits) + 0.5) * 180 * scale;
+    }
+
+    static void cover(const QueryBox & box, size_t budget,
+		      vector<KeyRange> & ranges) {
+	vector<GridRect> rects;
+	grid_rects(box, BITS, rects);
+	zorder_cover(rects, BITS, budget, ranges);
+    }
+};
+
+/** A pair of 32 bit integers holding the latitude and longitude in units
+ *  of 10^-7 degrees, sorted by latitude and then longitude.
+ */
+struct Int32PairFormat {
+    static const size_t BYTES = 8;
+
+    static const char * name() { return "int32_pair"; }
+
+    static int32_t to_e7(double degrees) {
+	return int32_t(lround(degrees * 1e7));
+    }
+
+    static void encode(double lat, double lon, string & result) {
+	int32_t values[2] = { to_e7(lat), to_e7(signed_lon(lon)) };
+	result.append(reinterpret_cast<const char *>(values), BYTES);
+    }
+
+    static void decode(const char * ptr, double & lat, double & lon) {
+	int32_t values[2];
+	memcpy(values, ptr, BYTES);
+	lat = values[0] * 1e-7;
+	lon = values[1] * 1e-7;
+    }
+
+    /// Make a key from the fields, offset to be unsigned.
+    static uint64_t make_key(int32_t lat_e7, int32_t lon_e7) {
+	return (uint64_t(uint32_t(lat_e7) ^ 0x80000000u) << 32) |
+		(uint32_t(lon_e7) ^ 0x80000000u);
+    }
+
+    static uint64_t key(const char * ptr) {
+	int32_t values[2];
+	memcpy(values, ptr, BYTES);
+	return make_key(values[0], values[1]);
+    }
+
+    /** Ranges are exact for each row of latitude while there are few
+     *  enough rows; otherwise the whole band of latitude is one range.
+     */
+    static void cover(const QueryBox & box, size_t budget,
+		      vector<KeyRange> & ranges) {
+	vector<pair<double, double> > lons;
+	signed_lon_intervals(box, lons);
+	int32_t lat1 = to_e7(box.lat1), lat2 = to_e7(box.lat2);
+	ranges.clear();
+	if (uint64_t(lat2 - lat1 + 1) * lons.size() > budget) {
+	    KeyRange range = {
+		make_key(lat1, INT32_MIN), make_key(lat2, INT32_MAX)
+	    };
+	    ranges.push_back(range);
+	    return;
+	}
+	for (int32_t lat = lat1; lat <= lat2; ++lat) {
+	    for (size_t i = 0; i != lons.size(); ++i) {
+		KeyRange range = {
+		    make_key(lat, to_e7(lons[i].first)),
+		    make_key(lat, to_e7(lons[i].second))
+		};
+		ranges.push_back(range);
+	    }
+	}
+	merge_ranges(ranges);
+    }
+};
+
+/** Check whether a workload point is in a box.
+ */
+static bool
+in_box(const QueryBox & box, double lat, double lon)
+{
+    if (lat < box.lat1 || lat > box.lat2) return false;
+    if (box.lon1 <= box.lon2) return lon >= box.lon1 && lon <= box.lon2;
+    return lon >= box.lon1 || lon <= box.lon2;
+}
+
+/** Count the sorted keys in a set of ranges.
+ */
+static size_t
+count_in_ranges(const vector<uint64_t> & keys,
+		const vector<KeyRange> & ranges)
+{
+    size_t count = 0;
+    for (size_t i = 0; i != ranges.size(); ++i) {
+	count += upper_bound(keys.begin(), keys.end(), ranges[i].last) -
+		lower_bound(keys.begin(), keys.end(), ranges[i].first);
+    }
+    return count;
+}
+
+/** The query boxes for a workload, with the number of points each holds.
+ */
+struct BoxSet {
+    double selectivity;
+
+    vector<QueryBox> boxes;
+
+    vector<size_t> matches;
+};
+
+/** Benchmark one encoding on a workload.
+ *
+ *  Encoding and decoding are timed per point, and the size and precision
+ *  of the encoding reported.  The covers of each set of boxes are timed,
+ *  and reported with the mean number of key ranges in a cover, and the
+ *  number of points a scan of those ranges reads for each point in the
+ *  boxes.
+ */
+template<typename Format>
+static void
+bench_format(GeoEncode::BenchRunner & runner, const char * workload,
+	     const vector<pair<double, double> > & points,
+	     const vector<BoxSet> & box_sets)
+{
+    size_t n = points.size();
+    string encoded;
+    encoded.reserve(n * Format::BYTES);
+    for (size_t i = 0; i != n; ++i) {
+	Format::encode(points[i].first, points[i].second, encoded);
+    }
+
+    string prefix = string(Format::name()) + "/" + workload;
+    GeoEncode::BenchResult * result =
+	    runner.run("encode/" + prefix, n, [&]() {
+	string out;
+	out.reserve(n * Format::BYTES);
+	for (size_t i = 0; i != n; ++i) {
+	    Format::encode(points[i].first, points[i].second, out);
+	}
+	return size_t(out[n / 2 * Format::BYTES]);
+    });
+    if (result) {
+	double max_error = 0;
+	for (size_t i = 0; i != n; ++i) {
+	    double lat, lon;
+	    Format::decode(encoded.data() + i * Format::BYTES, lat, lon);
+	    double error = GeoEncode::haversine_distance(
+		    points[i].first, points[i].second, lat, lon);
+	    max_error = max(max_error, error);
+	}
+	result->extra.push_back(make_pair("bytes_per_point",
+					  double(Format::BYTES)));
+	result->extra.push_back(make_pair("max_error_m", max_error));
+	printf("    %zu bytes per point, max error %.3f m\n", Format::BYTES,
+	       max_error);
+    }
+
+    runner.run("decode/" + prefix, n, [&]() {
+	const char * ptr = encoded.data();
+	double sum = 0;
+	for (size_t i = 0; i != n; ++i) {
+	    double lat, lon;
+	    Format::decode(ptr + i * Format::BYTES, lat, lon);
+	    sum += lat + lon;
+	}
+	return size_t(sum);
+    });
+
+    vector<uint64_t> keys;
+    for (size_t b = 0; b != box_sets.size(); ++b) {
+	const BoxSet & set = box_sets[b];
+	for (size_t k = 0; k != sizeof(BUDGETS) / sizeof(BUDGETS[0]); ++k) {
+	    char name[120];
+	    snprintf(name, sizeof(name), "cover/%s/sel=%g/max=%zu",
+		     prefix.c_str(), set.selectivity, BUDGETS[k]);
+	    vector<KeyRange> ranges;
+	    result = runner.run(name, set.boxes.size(), [&]() {
+		size_t total = 0;
+		for (size_t i = 0; i != set.boxes.size(); ++i) {
+		    Format::cover(set.boxes[i], BUDGETS[k], ranges);
+		    total += ranges.size();
+		}
+		return total;
+	    });
+	    if (!result) continue;
+
+	    if (keys.empty()) {
+		keys.resize(n);
+		for (size_t i = 0; i != n; ++i) {
+		    keys[i] = Format::key(encoded.data() + i * Format::BYTES);
+		}
+		sort(keys.begin(), keys.end());
+	    }
+	    size_t total_ranges = 0, scanned = 0, matches = 0;
+	    for (size_t i = 0; i != set.boxes.size(); ++i) {
+		Format::cover(set.boxes[i], BUDGETS[k], ranges);
+		total_ranges += ranges.size();
+		scanned += count_in_ranges(keys, ranges);
+		matches += set.matches[i];
+	    }
+	    double mean_ranges = double(total_ranges) / set.boxes.size();
+	    double scan_ratio = double(scanned) / max(matches, size_t(1));
+	    result->extra.push_back(make_pair("ranges", mean_ranges));
+	    result->extra.push_back(make_pair("scan_ratio", scan_ratio));
+	    printf("    %.1f ranges, %.2f points scanned per match\n",
+		   mean_ranges, scan_ratio);
+	}
+    }
+}
+
+int main(int argc, char ** argv) {
+    GeoEncode::BenchRunner runner;
+    if (!runner.parse_args(argc, argv)) {
+	return 1;
+    }
+    size_t n = runner.points ? runner.points : DEFAULT_POINTS;
+
+    vector<pair<double, double> > points;
+    for (unsigned k = 0; k != GeoEncode::WORKLOAD_KINDS; ++k) {
+	GeoEncode::WorkloadKind kind = GeoEncode::WorkloadKind(k);
+	const char * workload = GeoEncode::workload_name(kind);
+	GeoEncode::make_workload(kind, n, POINTS_SEED, points);
+
+	// Every encoding covers the same boxes.
+	vector<BoxSet> box_sets;
+	const size_t nsel = sizeof(SELECTIVITIES) / sizeof(SELECTIVITIES[0]);
+	for (size_t s = 0; s != nsel; ++s) {
+	    BoxSet set;
+	    set.selectivity = SELECTIVITIES[s];
+	    GeoEncode::make_query_boxes(points, set.selectivity, BOXES,
+					BOXES_SEED, set.boxes);
+	    for (size_t b = 0; b != set.boxes.size(); ++b) {
+		size_t matches = 0;
+		for (size_t i = 0; i != n; ++i) {
+		    matches += in_box(set.boxes[b], points[i].first,
+				      points[i].second);
+		}
+		set.matches.push_back(matches);
+	    }
+	    box_sets.push_back(set);
+	}
+
+	bench_format<GeoEncodeFormat>(runner, workload, points, box_sets);
+	bench_format<GeohashFormat>(runner, workload, points, box_sets);
+	bench_format<MortonFormat>(runner, workload, points, box_sets);
+	bench_format<Int32PairFormat>(runner, workload, points, box_sets);
+    }
+
+    return runner.finish() ? 0 : 1;
+}
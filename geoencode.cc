@@ -26,155 +26,52 @@
 #include <config.h>
 #include "geoencode.h"
 
-#include <cmath>
-
-using namespace std;
-
-/** Angles, split into degrees, minutes and seconds.
- *
- *  Only designed to work with positive angles.
- */
-struct DegreesMinutesSeconds {
-    /** Number of degrees.
-     *
-     *  Range 0 <= degrees <= 180 for latitude, 0 <= degrees < 360 for
-     *  longitude.
-     */
-    int degrees;
+#include "geoencode_inline.h"
 
-    /** Number of minutes: 0 to 59 */
-    int minutes;
-
-    /** Number of seconds: 0 to 59 */
-    int seconds;
+#include <algorithm>
+#include <cmath>
 
-    /** Number of 16ths of a second: 0 to 15 */
-    int sec16ths;
+#ifdef GEOENCODE_DECODER_STATS
+# include "shards.h"
+#endif
 
-    /** Initialise with a (positive) angle, as an integer representing the
-     *  number of 16ths of a second, rounding to nearest.
-     *
-     *  The range of valid angles is assumed to be 0 <= angle in degrees < 360,
-     *  so range of angle_16th_secs is 0..20735999, which fits easily into a 32
-     *  bit int.  (Latitudes are represented in the range 0 <= angle <= 180,
-     *  where 0 is the south pole.)
-     */
-    DegreesMinutesSeconds(int angle_16th_secs) {
-	degrees = angle_16th_secs / (3600 * 16);
-	angle_16th_secs = angle_16th_secs % (3600 * 16);
-	minutes = angle_16th_secs / (60 * 16);
-	angle_16th_secs = angle_16th_secs % (60 * 16);
-	seconds = angle_16th_secs / 16;
-	sec16ths = angle_16th_secs % 16;
-    }
-};
+using namespace std;
 
 bool
-GeoEncode::encode(double lat, double lon, string & result)
+GeoEncode::cell_bounds(const char * value, size_t len, CellBounds & bounds)
 {
-    // Check range of latitude.
-    if (rare(lat < -90.0 || lat > 90.0)) {
+    // Size of the cell for each prefix length, in 16ths of a second.
+    static const int cell_16ths[7] = { 0, 0, 3600 * 16, 240 * 16, 15 * 16,
+				       16, 1 };
+    if (rare(len < 2 || len > 6)) {
 	return false;
     }
-
-    // Wrap longitude to range [0,360).
-    lon = fmod(lon, 360.0);
-    if (lon < 0) {
-	lon += 360;
+    const unsigned char * ptr
+	    = reinterpret_cast<const unsigned char *>(value);
+    if (rare((ptr[0] << 8 | ptr[1]) >= 181 * 360)) {
+	return false;
+    }
+    // Nibbles holding groups of 4 minutes or whole seconds only go up to 14.
+    if (len > 2 && rare(((ptr[2] >> 4) == 15 || (ptr[2] & 15) == 15))) {
+	return false;
+    }
+    if (len > 4 && rare(((ptr[4] >> 4) == 15 || (ptr[4] & 15) == 15))) {
+	return false;
     }
 
     int lat_16ths, lon_16ths;
-    lat_16ths = round((lat + 90.0) * 57600.0);
-    if (lat_16ths == 0 || lat_16ths == 57600 * 180) {
-	lon_16ths = 0;
-    } else {
-	lon_16ths = round(lon * 57600.0);
-	if (lon_16ths == 57600 * 360) {
-	    lon_16ths = 0;
-	}
+    decode_16ths(pack(value, len), lat_16ths, lon_16ths);
+    if (rare(lat_16ths > 180 * 57600)) {
+	return false;
     }
-
-    DegreesMinutesSeconds lat_dms(lat_16ths);
-    DegreesMinutesSeconds lon_dms(lon_16ths);
-
-    size_t old_len = result.size();
-    result.resize(old_len + 6);
-
-    // Add degrees parts as first two bytes.
-    unsigned dd = lat_dms.degrees + lon_dms.degrees * 181;
-    // dd is in range 0..180*360+359 = 0..65159
-    result[old_len] = char(dd >> 8);
-    result[old_len + 1] = char(dd & 0xff);
-
-    // Add minutes next; 4 bits from each in the first byte.
-    result[old_len + 2] = char(((lat_dms.minutes / 4) << 4) |
-			       (lon_dms.minutes / 4)
-			      );
-
-    result[old_len + 3] = char(
-			       ((lat_dms.minutes % 4) << 6) |
-			       ((lon_dms.minutes % 4) << 4) |
-			       ((lat_dms.seconds / 15) << 2) |
-			       (lon_dms.seconds / 15)
-			      );
-
-    result[old_len + 4] = char(
-			       ((lat_dms.seconds % 15) << 4) |
-			       (lon_dms.seconds % 15)
-			      );
-
-    result[old_len + 5] = char(
-			       (lat_dms.sec16ths << 4) |
-			       lon_dms.sec16ths
-			      );
-
+    int size = cell_16ths[len];
+    bounds.min_lat = lat_16ths / 57600.0 - 90.0;
+    bounds.min_lon = lon_16ths / 57600.0;
+    bounds.max_lat = min(90.0, (lat_16ths + size) / 57600.0 - 90.0);
+    bounds.max_lon = (lon_16ths + size) / 57600.0;
     return true;
 }
 
-void
-GeoEncode::decode(const char * value, size_t len,
-		  double & lat_ref, double & lon_ref)
-{
-    const unsigned char * ptr
-	    = reinterpret_cast<const unsigned char *>(value);
-    unsigned tmp = (ptr[0] & 0xff) << 8 | (ptr[1] & 0xff);
-    lat_ref = tmp % 181;
-    lon_ref = tmp / 181;
-    if (len > 2) {
-	tmp = ptr[2];
-	double lat_m = (tmp >> 4) * 4;
-	double lon_m = (tmp & 0xf) * 4;
-
-	if (len > 3) {
-	    tmp = ptr[3];
-	    lat_m += (tmp >> 6) & 3;
-	    lon_m += (tmp >> 4) & 3;
-	    double lat_s = ((tmp >> 2) & 3) * 15;
-	    double lon_s = (tmp & 3) * 15;
-
-	    if (len > 4) {
-		tmp = ptr[4];
-		lat_s += (tmp >> 4) & 0xf;
-		lon_s += tmp & 0xf;
-
-		if (len > 5) {
-		    tmp = ptr[5];
-		    lat_s += ((tmp >> 4) / 16.0);
-		    lon_s += ((tmp & 0xf) / 16.0);
-		}
-	    }
-
-	    lat_m += lat_s / 60.0;
-	    lon_m += lon_s / 60.0;
-	}
-
-	lat_ref += lat_m / 60.0;
-	lon_ref += lon_m / 60.0;
-    }
-
-    lat_ref -= 90.0;
-}
-
 /// Calc latitude and longitude in integral number of 16ths of a second
 static void
 calc_latlon_16ths(double lat, double lon, int & lat_16ths, int & lon_16ths)
@@ -222,47 +119,143 @@ GeoEncode::DecoderWithBoundingBox::DecoderWithBoundingBox
     discontinuous_longitude_range = (lon1 > lon2);
 }
 
+#ifdef GEOENCODE_DECODER_STATS
+
+namespace {
+
+/// The counts kept for DecoderStats, in the order of its fields.
+enum DecoderStat {
+    STAT_CALLS,
+    STAT_PREFILTER_REJECTS,
+    STAT_FULL_DECODES,
+    STAT_LAT_REJECTS,
+    STAT_LON_REJECTS,
+    STAT_ACCEPTS,
+    STAT_POLE_ACCEPTS,
+    STAT_COUNT
+};
+
+/// Distinguishes the decoder statistics' shards from those of other counters.
+struct DecoderStatsTag { };
+
+}
+
+/// The decoder statistics of all threads.
+typedef GeoEncode::ShardedCounters<DecoderStatsTag, STAT_COUNT>
+	DecoderCounters;
+
+# define DECODER_STATS_DECLARE \
+	DecoderCounters::Shard & stats = DecoderCounters::local()
+# define DECODER_STATS_ADD(STAT) stats.add(STAT, 1)
+
+#else
+
+# define DECODER_STATS_DECLARE (void)0
+# define DECODER_STATS_ADD(STAT) (void)0
+
+#endif
+
+bool
+GeoEncode::get_decoder_stats(DecoderStats & stats)
+{
+    stats = DecoderStats();
+#ifdef GEOENCODE_DECODER_STATS
+    uint64_t totals[STAT_COUNT];
+    DecoderCounters::totals(totals);
+    stats.calls = totals[STAT_CALLS];
+    stats.prefilter_rejects = totals[STAT_PREFILTER_REJECTS];
+    stats.full_decodes = totals[STAT_FULL_DECODES];
+    stats.lat_rejects = totals[STAT_LAT_REJECTS];
+    stats.lon_rejects = totals[STAT_LON_REJECTS];
+    stats.accepts = totals[STAT_ACCEPTS];
+    stats.pole_accepts = totals[STAT_POLE_ACCEPTS];
+    return true;
+#else
+    return false;
+#endif
+}
+
+void
+GeoEncode::reset_decoder_stats()
+{
+#ifdef GEOENCODE_DECODER_STATS
+    DecoderCounters::reset();
+#endif
+}
+
 bool
-GeoEncode::DecoderWithBoundingBox::decode(const std::string & value,
+GeoEncode::DecoderWithBoundingBox::decode(const char * value, size_t len,
 					  double & lat_ref,
 					  double & lon_ref) const
 {
+    DECODER_STATS_DECLARE;
+    DECODER_STATS_ADD(STAT_CALLS);
     unsigned char start = value[0];
     if (discontinuous_longitude_range) {
 	// start must be outside range of (start2..start1)
 	// (start2 will be > start1)
 	if (start2 < start && start < start1) {
-	    if (!(include_poles && start == 0))
+	    if (!(include_poles && start == 0)) {
+		DECODER_STATS_ADD(STAT_PREFILTER_REJECTS);
 		return false;
+	    }
 	}
     } else {
 	// start must be inside range of [start1..start2] (inclusive of ends).
 	if (start < start1 || start2 < start) {
-	    if (!(include_poles && start == 0))
+	    if (!(include_poles && start == 0)) {
+		DECODER_STATS_ADD(STAT_PREFILTER_REJECTS);
 		return false;
+	    }
 	}
     }
+    DECODER_STATS_ADD(STAT_FULL_DECODES);
     double lat, lon;
-    GeoEncode::decode(value, lat, lon);
+    GeoEncode::decode(value, len, lat, lon);
     if (lat < min_lat || lat > max_lat) {
+	DECODER_STATS_ADD(STAT_LAT_REJECTS);
 	return false;
     }
     if (lat == -90 || lat == 90) {
 	// It's a pole, so the longitude isn't meaningful (will be zero)
 	// and we've already checked that the latitude is in range.
+	DECODER_STATS_ADD(STAT_POLE_ACCEPTS);
+	DECODER_STATS_ADD(STAT_ACCEPTS);
 	lat_ref = lat;
 	lon_ref = 0;
 	return true;
     }
     if (discontinuous_longitude_range) {
-	if (lon2 < lon && lon < lon1)
+	if (lon2 < lon && lon < lon1) {
+	    DECODER_STATS_ADD(STAT_LON_REJECTS);
 	    return false;
+	}
     } else {
-	if (lon < lon1 || lon2 < lon)
+	if (lon < lon1 || lon2 < lon) {
+	    DECODER_STATS_ADD(STAT_LON_REJECTS);
 	    return false;
+	}
     }
 
+    DECODER_STATS_ADD(STAT_ACCEPTS);
     lat_ref = lat;
     lon_ref = lon;
     return true;
 }
+
+bool
+GeoEncode::DecoderWithBoundingBox::might_contain_range(PackedCode first,
+						       PackedCode last) const
+{
+    unsigned char first_start = (first >> 40) & 0xff;
+    unsigned char last_start = (last >> 40) & 0xff;
+    if (include_poles && first_start == 0) {
+	return true;
+    }
+    if (discontinuous_longitude_range) {
+	// Every start byte in the range falls strictly between start2 and
+	// start1.
+	return !(start2 < first_start && last_start < start1);
+    }
+    return first_start <= start2 && start1 <= last_start;
+}
@@ -27,9 +27,73 @@
 #define GEOENCODE_INCLUDED_H
 
 #include <string>
+#include <stdint.h>
 
 namespace GeoEncode {
 
+/** An encoded coordinate packed into an integer.
+ *
+ *  The 6 bytes of the encoded form are held in the low 48 bits, first byte
+ *  most significant, so packed codes sort in the same order as the encoded
+ *  strings and prefixes of the encoding correspond to ranges of codes.
+ */
+typedef uint64_t PackedCode;
+
+/** Pack an encoded coordinate into an integer.
+ *
+ * @param value A pointer to the start of the encoded coordinate.
+ * @param len The length of the encoded coordinate in bytes.  Encodings
+ *            shorter than 6 bytes are padded with zero bytes, giving the
+ *            lowest code in the cell they represent; any bytes after the
+ *            first 6 are ignored.
+ */
+inline PackedCode
+pack(const char * value, size_t len = 6)
+{
+    const unsigned char * ptr
+	    = reinterpret_cast<const unsigned char *>(value);
+    PackedCode code = 0;
+    for (size_t i = 0; i != 6; ++i) {
+	code <<= 8;
+	if (i < len) code |= ptr[i];
+    }
+    return code;
+}
+
+/** Unpack a packed code into its 6 byte encoded form.
+ *
+ * @param code The packed code.
+ * @param result A buffer of at least 6 bytes to write the encoded form to.
+ */
+inline void
+unpack(PackedCode code, char * result)
+{
+    for (int i = 5; i >= 0; --i) {
+	result[i] = char(code & 0xff);
+	code >>= 8;
+    }
+}
+
+/** Unpack a packed code, appending the 6 byte encoded form to a string.
+ */
+inline void
+unpack(PackedCode code, std::string & result)
+{
+    char buf[6];
+    unpack(code, buf);
+    result.append(buf, 6);
+}
+
+#ifdef GEOENCODE_HEADER_ONLY
+/** The inline definitions of encode() and decode().
+ *
+ * Their names are in this namespace, so they are different from those of the
+ * library's out of line definitions, and translation units built with and
+ * without GEOENCODE_HEADER_ONLY can be linked together.
+ */
+inline namespace HeaderOnly {
+#endif
+
 /** Encode a coordinate and append it to a string.
  *
  * @param lat The latitude coordinate in degrees (ranging from -90 to +90)
@@ -42,6 +106,17 @@ namespace GeoEncode {
  * If there was an error, the result value will be unmodified.  The only cause
  * of error is out-of-range latitudes.  If there was no error, the string will
  * have been extended by 6 bytes.
+ *
+ * This and decode() are small enough that a call costs a good part of
+ * their time.  If GEOENCODE_HEADER_ONLY is defined, they are defined inline
+ * in this header, so they can be inlined and vectorised in loops.  Only
+ * these two functions are defined in the header, so the library must still
+ * be linked.  The inline definitions are in the inline namespace
+ * HeaderOnly, so they don't clash with the library's, and code built with
+ * the macro can be linked with a library built without it.  A library
+ * built with it has no out of line definitions, so code built without the
+ * macro fails to link with it.  "make check-header-only" runs the tests
+ * built this way.
  */
 extern bool
 encode(double lat, double lon, std::string & result);
@@ -82,6 +157,159 @@ decode(const std::string & value, double & lat_ref, double & lon_ref)
     return GeoEncode::decode(value.data(), value.size(), lat_ref, lon_ref);
 }
 
+#ifdef GEOENCODE_HEADER_ONLY
+}
+#endif
+
+/** Decode a packed code to whole degrees and 16ths of a second.
+ *
+ * @param code The packed code to decode.
+ * @param lat_deg_ref A reference to a value to return the whole degrees of
+ *                    latitude north of the south pole in (0 to 180).
+ * @param lat_offset_ref A reference to a value to return the rest of the
+ *                       latitude in, as 16ths of a second (0 to 57599).
+ * @param lon_deg_ref A reference to a value to return the whole degrees of
+ *                    longitude east of the meridian in (0 to 359 for valid
+ *                    codes).
+ * @param lon_offset_ref A reference to a value to return the rest of the
+ *                       longitude in, as 16ths of a second (0 to 57599).
+ *
+ * This is useful for indexing tables by degree.
+ */
+inline void
+decode_degrees(PackedCode code, int & lat_deg_ref, int & lat_offset_ref,
+	       int & lon_deg_ref, int & lon_offset_ref)
+{
+    unsigned dd = (code >> 32) & 0xffff;
+    unsigned minutes = (code >> 24) & 0xff;
+    unsigned mixed = (code >> 16) & 0xff;
+    unsigned seconds = (code >> 8) & 0xff;
+    unsigned sec16ths = code & 0xff;
+
+    int lat_m = (minutes >> 4) * 4 + ((mixed >> 6) & 3);
+    int lon_m = (minutes & 0xf) * 4 + ((mixed >> 4) & 3);
+    int lat_s = ((mixed >> 2) & 3) * 15 + (seconds >> 4);
+    int lon_s = (mixed & 3) * 15 + (seconds & 0xf);
+
+    lat_deg_ref = dd % 181;
+    lon_deg_ref = dd / 181;
+    lat_offset_ref = (lat_m * 60 + lat_s) * 16 + (sec16ths >> 4);
+    lon_offset_ref = (lon_m * 60 + lon_s) * 16 + (sec16ths & 0xf);
+}
+
+/** Decode a packed code to integral numbers of 16ths of a second.
+ *
+ * @param code The packed code to decode.
+ * @param lat_16ths_ref A reference to a value to return the latitude in, as
+ *                      16ths of a second north of the south pole (ie, in the
+ *                      range 0 to 180 * 57600 inclusive).
+ * @param lon_16ths_ref A reference to a value to return the longitude in, as
+ *                      16ths of a second east of the meridian (ie, in the
+ *                      range 0 to 360 * 57600 exclusive for valid codes).
+ *
+ * This is exact, unlike decoding to degrees, so it is useful for indexing.
+ */
+inline void
+decode_16ths(PackedCode code, int & lat_16ths_ref, int & lon_16ths_ref)
+{
+    int lat_deg, lat_offset, lon_deg, lon_offset;
+    decode_degrees(code, lat_deg, lat_offset, lon_deg, lon_offset);
+    lat_16ths_ref = lat_deg * 57600 + lat_offset;
+    lon_16ths_ref = lon_deg * 57600 + lon_offset;
+}
+
+/** Encode a coordinate given as integral numbers of 16ths of a second.
+ *
+ * This is the inverse of decode_16ths().  At the poles, encode() always
+ * uses a longitude of 0, so pass 0 there to get the same code.
+ *
+ * @param lat_16ths The latitude, as 16ths of a second north of the south
+ *                  pole (0 to 180 * 57600 inclusive).
+ * @param lon_16ths The longitude, as 16ths of a second east of the meridian
+ *                  (0 to 360 * 57600 exclusive).
+ *
+ * @returns The packed code.
+ */
+inline PackedCode
+encode_16ths(int lat_16ths, int lon_16ths)
+{
+    int lat_deg = lat_16ths / 57600;
+    int lon_deg = lon_16ths / 57600;
+    int lat_rest = lat_16ths - lat_deg * 57600;
+    int lon_rest = lon_16ths - lon_deg * 57600;
+    int lat_m = lat_rest / 960;
+    int lon_m = lon_rest / 960;
+    int lat_s = (lat_rest >> 4) % 60;
+    int lon_s = (lon_rest >> 4) % 60;
+
+    unsigned dd = lat_deg + lon_deg * 181;
+    unsigned minutes = ((lat_m / 4) << 4) | (lon_m / 4);
+    unsigned mixed = ((lat_m % 4) << 6) | ((lon_m % 4) << 4) |
+	    ((lat_s / 15) << 2) | (lon_s / 15);
+    unsigned seconds = ((lat_s % 15) << 4) | (lon_s % 15);
+    unsigned sec16ths = ((lat_rest & 15) << 4) | (lon_rest & 15);
+    return (PackedCode(dd) << 32) | (PackedCode(minutes) << 24) |
+	    (mixed << 16) | (seconds << 8) | sec16ths;
+}
+
+/** The extent of the cell denoted by a prefix of an encoded coordinate.
+ *
+ * The decoded coordinates of all codes starting with the prefix lie in the
+ * cell, with latitudes in [min_lat, max_lat) and longitudes in
+ * [min_lon, max_lon), except that the cell holding the north pole has
+ * min_lat = max_lat = 90.
+ */
+struct CellBounds {
+    /** The latitude of the southern edge of the cell.
+     */
+    double min_lat;
+
+    /** The longitude of the western edge of the cell, in [0,360).
+     */
+    double min_lon;
+
+    /** The latitude of the northern edge of the cell.
+     */
+    double max_lat;
+
+    /** The longitude of the eastern edge of the cell, in (0,360].
+     */
+    double max_lon;
+};
+
+/** Calculate the extent of the cell denoted by a truncated encoding.
+ *
+ * A 2 byte prefix denotes a 1 degree cell, 3 bytes a 4 minute cell, 4 bytes
+ * a 15 second cell, 5 bytes a 1 second cell, and the full 6 bytes a cell of
+ * 1/16th of a second.
+ *
+ * @param value A pointer to the start of the prefix.
+ * @param len The length of the prefix in bytes (2 to 6).
+ * @param bounds A reference to a value to return the extent in.
+ *
+ * @returns false if the length is out of range or the prefix can't be the
+ *          start of a valid encoding.
+ */
+extern bool
+cell_bounds(const char * value, size_t len, CellBounds & bounds);
+
+/** Calculate the extent of the cell denoted by a prefix of a packed code.
+ *
+ * @param code The packed code; bytes after the prefix are ignored.
+ * @param len The length of the prefix in bytes (2 to 6).
+ * @param bounds A reference to a value to return the extent in.
+ *
+ * @returns false if the length is out of range or the prefix can't be the
+ *          start of a valid encoding.
+ */
+inline bool
+cell_bounds(PackedCode code, size_t len, CellBounds & bounds)
+{
+    char encoded[6];
+    unpack(code, encoded);
+    return cell_bounds(encoded, len, bounds);
+}
+
 /** A class for decoding coordinates within a bounding box.
  *
  *  This class aborts decoding if it is easily able to determine that the
@@ -150,10 +378,134 @@ class DecoderWithBoundingBox {
      *  may not have been updated, or may have been updated to incorrect
      *  values, due to aborting decoding of the coordinate part-way through.
      */
-    bool decode(const std::string & value,
+    bool decode(const char * value, size_t len,
 		double & lat_ref, double & lon_ref) const;
+
+    /** Decode a coordinate.
+     *
+     *  As decode(const char *, size_t, double &, double &), but taking the
+     *  coordinate as a string.
+     */
+    bool decode(const std::string & value,
+		double & lat_ref, double & lon_ref) const {
+	return decode(value.data(), value.size(), lat_ref, lon_ref);
+    }
+
+    /** Check whether any code in a range might lie in the bounding box.
+     *
+     *  @param first The lowest packed code in the range.
+     *  @param last The highest packed code in the range.
+     *
+     *  @returns false if every code in the range [first, last] would be
+     *           rejected by the first-byte check made by decode(), so the
+     *           range can be skipped without looking at its members.  A
+     *           return value of true doesn't mean that any code in the range
+     *           is actually inside the box.
+     */
+    bool might_contain_range(PackedCode first, PackedCode last) const;
+
+    /** Test whether a decoded coordinate is in the bounding box.
+     *
+     *  This is the test decode() makes once it has decoded a coordinate in
+     *  full, without the shortcuts before it, so it serves as the reference
+     *  for checking them.
+     */
+    bool contains(double lat, double lon) const {
+	if (lat < min_lat || lat > max_lat) return false;
+	// At the poles the longitude isn't meaningful.
+	if (lat == -90 || lat == 90) return true;
+	if (discontinuous_longitude_range) return !(lon2 < lon && lon < lon1);
+	return !(lon < lon1 || lon2 < lon);
+    }
+
+    /** Get the bounding box, with longitudes wrapped to [0,360).
+     */
+    void get_box(double & lat1_ref, double & lon1_ref,
+		 double & lat2_ref, double & lon2_ref) const {
+	lat1_ref = min_lat;
+	lon1_ref = lon1;
+	lat2_ref = max_lat;
+	lon2_ref = lon2;
+    }
+
+    /** Get the number of bytes of memory used by the decoder.
+     *
+     *  The decoder uses no tables or other memory outside the object.
+     */
+    size_t memory_used() const { return sizeof(*this); }
+};
+
+/** Counts of the outcomes of DecoderWithBoundingBox::decode().
+ *
+ *  These are only collected if the library is compiled with
+ *  GEOENCODE_DECODER_STATS defined; otherwise decode() contains no counting
+ *  code at all, and get_decoder_stats() reports nothing.  They show how
+ *  often the check on the first byte avoids decoding, so query shapes which
+ *  defeat it can be found.
+ *
+ *  Each call is either rejected by the first byte check or fully decoded,
+ *  and each full decode is rejected by latitude, rejected by longitude, or
+ *  accepted.
+ */
+struct DecoderStats {
+    /** The number of calls to decode().
+     */
+    uint64_t calls;
+
+    /** Calls rejected by the check on the first byte.
+     */
+    uint64_t prefilter_rejects;
+
+    /** Calls which passed the first byte check and decoded the coordinate.
+     */
+    uint64_t full_decodes;
+
+    /** Decoded coordinates rejected because of their latitude.
+     */
+    uint64_t lat_rejects;
+
+    /** Decoded coordinates rejected because of their longitude.
+     */
+    uint64_t lon_rejects;
+
+    /** Decoded coordinates accepted (including those at poles).
+     */
+    uint64_t accepts;
+
+    /** Coordinates accepted at a pole without checking the longitude.
+     */
+    uint64_t pole_accepts;
+
+    DecoderStats()
+	: calls(0), prefilter_rejects(0), full_decodes(0), lat_rejects(0),
+	  lon_rejects(0), accepts(0), pole_accepts(0) { }
 };
 
+/** Get the decoder statistics, summed over all threads.
+ *
+ *  Each thread counts into its own thread-local statistics, so counting
+ *  needs no locks or atomic read-modify-write operations; this function
+ *  adds them up, along with those of threads which have exited.  Counts
+ *  from threads decoding at the time may be slightly behind.
+ *
+ *  @param stats A reference to return the statistics since the last call
+ *               to reset_decoder_stats() in.
+ *
+ *  @returns false if the library was compiled without
+ *           GEOENCODE_DECODER_STATS, in which case @a stats is all zero.
+ */
+extern bool
+get_decoder_stats(DecoderStats & stats);
+
+/** Restart the decoder statistics from zero.
+ */
+extern void
+reset_decoder_stats();
+
 }
 
+#ifdef GEOENCODE_HEADER_ONLY
+# include "geoencode_inline.h"
+#endif
+
 #endif /* GEOENCODE_INCLUDED_H */
@@ -0,0 +1,181 @@
+/** @file geoencode_bench.cc
+ * @brief Benchmarks for encoding, decoding and bounding box filtering.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "bench.h"
+#include "geoencode.h"
+#include "workload.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/// Default number of points in each benchmark.
+static const size_t DEFAULT_POINTS = 1000000;
+
+/// Seed for generating the points, so runs are comparable.
+static const uint64_t POINTS_SEED = 42;
+
+/// Seed for generating the query boxes.
+static const uint64_t BOXES_SEED = 4242;
+
+/// Number of boxes of each selectivity to time.
+static const size_t BOXES = 4;
+
+/// Proportions of the points which the bounding boxes should contain.
+static const double SELECTIVITIES[] = {
+    0.0001, 0.01, 0.1, 0.5
+};
+
+/** Encode coordinates into a buffer of 6 bytes each.
+ */
+static void
+encode_all(const vector<pair<double, double> > & points, string & encoded)
+{
+    encoded.clear();
+    encoded.reserve(points.size() * 6);
+    for (size_t i = 0; i != points.size(); ++i) {
+	GeoEncode::encode(points[i].first, points[i].second, encoded);
+    }
+}
+
+/** Benchmark decoding with bounding boxes of a given selectivity.
+ *
+ *  Each operation decodes one point with one box; the points are decoded
+ *  with each of the boxes in turn.
+ */
+static void
+bench_bounding_box(GeoEncode::BenchRunner & runner, const char * workload,
+		   const vector<pair<double, double> > & points,
+		   const string & encoded, double selectivity)
+{
+    char name[80];
+    snprintf(name, sizeof(name), "bbox_decode/%s/selectivity=%g", workload,
+	     selectivity);
+    if (!runner.wanted(name)) return;
+
+    vector<GeoEncode::QueryBox> boxes;
+    GeoEncode::make_query_boxes(points, selectivity, BOXES, BOXES_SEED,
+				boxes);
+    vector<GeoEncode::DecoderWithBoundingBox> decoders;
+    double mean_selectivity = 0;
+    for (size_t b = 0; b != boxes.size(); ++b) {
+	const GeoEncode::QueryBox & box = boxes[b];
+	decoders.push_back(GeoEncode::DecoderWithBoundingBox(
+		box.lat1, box.lon1, box.lat2, box.lon2));
+	mean_selectivity += box.selectivity / boxes.size();
+    }
+
+    size_t n = points.size();
+    GeoEncode::reset_decoder_stats();
+    GeoEncode::BenchResult * result =
+	    runner.run(name, n * decoders.size(), [&]() {
+	const char * ptr = encoded.data();
+	size_t count = 0;
+	double sum = 0;
+	for (size_t b = 0; b != decoders.size(); ++b) {
+	    const GeoEncode::DecoderWithBoundingBox & bb = decoders[b];
+	    for (size_t i = 0; i != n; ++i) {
+		double lat, lon;
+		if (bb.decode(ptr + i * 6, 6, lat, lon)) {
+		    ++count;
+		    sum += lat;
+		}
+	    }
+	}
+	return count + size_t(sum);
+    });
+    if (result) {
+	result->extra.push_back(make_pair("selectivity", mean_selectivity));
+	// With decoder statistics compiled in, report how many points the
+	// first byte check rejected.
+	GeoEncode::DecoderStats stats;
+	if (GeoEncode::get_decoder_stats(stats) && stats.calls) {
+	    double rejected = double(stats.prefilter_rejects) / stats.calls;
+	    result->extra.push_back(make_pair("prefilter_rejects", rejected));
+	    printf("    prefilter rejects %.4f, full decodes %.4f\n",
+		   rejected, double(stats.full_decodes) / stats.calls);
+	}
+    }
+}
+
+int main(int argc, char ** argv) {
+    GeoEncode::BenchRunner runner;
+    if (!runner.parse_args(argc, argv)) {
+	return 1;
+    }
+    size_t n = runner.points ? runner.points : DEFAULT_POINTS;
+
+    vector<pair<double, double> > points;
+    GeoEncode::make_workload(GeoEncode::WORKLOAD_UNIFORM, n, POINTS_SEED,
+			     points);
+    string encoded;
+    encode_all(points, encoded);
+
+    runner.run("encode", n, [&]() {
+	string result;
+	result.reserve(n * 6);
+	for (size_t i = 0; i != n; ++i) {
+	    GeoEncode::encode(points[i].first, points[i].second, result);
+	}
+	return size_t(result[n * 3]);
+    });
+
+    // Decoding prefixes of each width gives the coordinate at the corner of
+    // a successively smaller cell.
+    for (size_t len = 2; len <= 6; ++len) {
+	char name[32];
+	snprintf(name, sizeof(name), "decode/len=%zu", len);
+	runner.run(name, n, [&]() {
+	    const char * ptr = encoded.data();
+	    double sum = 0;
+	    for (size_t i = 0; i != n; ++i) {
+		double lat, lon;
+		GeoEncode::decode(ptr + i * 6, len, lat, lon);
+		sum += lat + lon;
+	    }
+	    return size_t(sum);
+	});
+    }
+
+    // Bounding boxes on each kind of workload, since how soon decoding can
+    // reject a point depends on where the points are.
+    const size_t nsel = sizeof(SELECTIVITIES) / sizeof(SELECTIVITIES[0]);
+    for (unsigned k = 0; k != GeoEncode::WORKLOAD_KINDS; ++k) {
+	GeoEncode::WorkloadKind kind = GeoEncode::WorkloadKind(k);
+	const char * workload = GeoEncode::workload_name(kind);
+	if (kind != GeoEncode::WORKLOAD_UNIFORM) {
+	    GeoEncode::make_workload(kind, n, POINTS_SEED, points);
+	    encode_all(points, encoded);
+	}
+	for (size_t i = 0; i != nsel; ++i) {
+	    bench_bounding_box(runner, workload, points, encoded,
+			       SELECTIVITIES[i]);
+	}
+    }
+
+    return runner.finish() ? 0 : 1;
+}
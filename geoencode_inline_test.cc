@@ -0,0 +1,83 @@
+/** @file geoencode_inline_test.cc
+ * @brief Tests of the inline definitions of encode() and decode().
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+// Programs using the library include geoencode.h but not config.h, so this
+// does the same.  It always uses the inline definitions, and is linked with
+// the library built with or without them, so that checks that they can be
+// mixed.
+#ifndef GEOENCODE_HEADER_ONLY
+# define GEOENCODE_HEADER_ONLY
+#endif
+#include "geoencode.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+
+int main() {
+    bool ok = true;
+
+    // The inline definitions have names of their own.
+    bool (*inline_encode)(double, double, string &) =
+	    &GeoEncode::HeaderOnly::encode;
+
+    // DecoderWithBoundingBox::decode() calls the library's decode(), which
+    // is the out of line one unless the library was built header only.
+    GeoEncode::DecoderWithBoundingBox bbox(-90, 0, 90, 359.5);
+    for (int i = 0; i != 100000; ++i) {
+	double lat = random() * (180.0 / RAND_MAX) - 90;
+	double lon = random() * (359.0 / RAND_MAX);
+	string encoded;
+	if (!inline_encode(lat, lon, encoded)) {
+	    fprintf(stderr, "encode(%.9g, %.9g) failed\n", lat, lon);
+	    ok = false;
+	    break;
+	}
+	double lat1, lon1, lat2, lon2;
+	GeoEncode::decode(encoded, lat1, lon1);
+	if (fabs(lat1 - lat) > 1.0 / 57600 || fabs(lon1 - lon) > 1.0 / 57600) {
+	    fprintf(stderr, "encode(%.9g, %.9g) decoded to %.9g, %.9g\n",
+		    lat, lon, lat1, lon1);
+	    ok = false;
+	    break;
+	}
+	if (!bbox.decode(encoded, lat2, lon2) || lat2 != lat1 ||
+	    lon2 != lon1) {
+	    fprintf(stderr, "library decoded %.9g, %.9g differently\n",
+		    lat, lon);
+	    ok = false;
+	    break;
+	}
+    }
+
+    string encoded;
+    if (GeoEncode::encode(90.5, 0, encoded) || !encoded.empty()) {
+	fprintf(stderr, "out of range latitude accepted\n");
+	ok = false;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -29,6 +29,7 @@
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <thread>
 
 using namespace std;
 
@@ -77,6 +78,74 @@ bool check_fail(double lat, double lon) {
     return true;
 }
 
+/** Check that decode_16ths() agrees with decode() for a lat, lon pair, and
+ *  that encode_16ths() reverses it.
+ */
+bool check_16ths(double lat, double lon) {
+    string encoded;
+    if (!GeoEncode::encode(lat, lon, encoded)) {
+	fprintf(stderr, "encoding failed\n");
+	return false;
+    }
+    double decoded_lat, decoded_lon;
+    GeoEncode::decode(encoded, decoded_lat, decoded_lon);
+    int lat_16ths, lon_16ths;
+    GeoEncode::decode_16ths(GeoEncode::pack(encoded.data()),
+			    lat_16ths, lon_16ths);
+    if (lat_16ths != round((decoded_lat + 90.0) * 57600.0) ||
+	lon_16ths != round(decoded_lon * 57600.0)) {
+	fprintf(stderr, "decode_16ths gave %d,%d for %.15g,%.15g "
+		"(input=%.15g,%.15g)\n", lat_16ths, lon_16ths,
+		decoded_lat, decoded_lon, lat, lon);
+	return false;
+    }
+    if (GeoEncode::encode_16ths(lat_16ths, lon_16ths) !=
+	GeoEncode::pack(encoded.data())) {
+	fprintf(stderr, "encode_16ths(%d,%d) doesn't match encode(%.15g,%.15g)\n",
+		lat_16ths, lon_16ths, lat, lon);
+	return false;
+    }
+    return true;
+}
+
+/** Check that the cells denoted by each prefix of an encoded coordinate
+ *  contain the decoded coordinate, and have the expected size.
+ */
+bool check_cells(double lat, double lon) {
+    static const double sizes[7] = {
+	0, 0, 1.0, 4.0 / 60, 15.0 / 3600, 1.0 / 3600, 1.0 / 57600
+    };
+    string encoded;
+    if (!GeoEncode::encode(lat, lon, encoded)) {
+	fprintf(stderr, "encoding failed\n");
+	return false;
+    }
+    double decoded_lat, decoded_lon;
+    GeoEncode::decode(encoded, decoded_lat, decoded_lon);
+    for (size_t len = 2; len <= 6; ++len) {
+	GeoEncode::CellBounds cell;
+	if (!GeoEncode::cell_bounds(encoded.data(), len, cell)) {
+	    fprintf(stderr, "cell_bounds failed for %zu bytes of %.15g,%.15g\n",
+		    len, lat, lon);
+	    return false;
+	}
+	bool north_pole = (decoded_lat == 90);
+	if (decoded_lat < cell.min_lat - 1e-9 ||
+	    (!north_pole && decoded_lat >= cell.max_lat - 1e-9) ||
+	    decoded_lon < cell.min_lon - 1e-9 ||
+	    decoded_lon >= cell.max_lon - 1e-9 ||
+	    fabs(cell.max_lon - cell.min_lon - sizes[len]) > 1e-9 ||
+	    (!north_pole &&
+	     fabs(cell.max_lat - cell.min_lat - sizes[len]) > 1e-9)) {
+	    fprintf(stderr, "cell (%.15g,%.15g)-(%.15g,%.15g) for %zu bytes "
+		    "doesn't fit %.15g,%.15g\n", cell.min_lat, cell.min_lon,
+		    cell.max_lat, cell.max_lon, len, decoded_lat, decoded_lon);
+	    return false;
+	}
+    }
+    return true;
+}
+
 /** Check that encoding and then decoding a lat, lon pair with a bounding box
  *  returns the appropriate value.
  */
@@ -114,7 +183,75 @@ bool check_bb(GeoEncode::DecoderWithBoundingBox & bb, double lat, double lon,
     return true;
 }
 
+/** Decode a coordinate with a bounding box, ignoring the result.
+ */
+static void
+decode_bb(const GeoEncode::DecoderWithBoundingBox & bb, double lat, double lon)
+{
+    string encoded;
+    GeoEncode::encode(lat, lon, encoded);
+    double decoded_lat, decoded_lon;
+    (void)bb.decode(encoded, decoded_lat, decoded_lon);
+}
+
+/** Check the decoder statistics, if they are compiled in.
+ */
+static bool
+check_decoder_stats()
+{
+    GeoEncode::reset_decoder_stats();
+    GeoEncode::DecoderWithBoundingBox bb(-10, 0, 10, 50);
+    decode_bb(bb, 0, 10);	// accepted
+    decode_bb(bb, 0, 200);	// rejected by the first byte
+    decode_bb(bb, 20, 10);	// rejected by latitude
+    decode_bb(bb, 0, 50.5);	// rejected by longitude
+    GeoEncode::DecoderWithBoundingBox south(-90, -60, 10, 50);
+    decode_bb(south, -90, 0);	// accepted at the pole
+
+    // Counts from a thread which has exited are kept.
+    thread other([]() {
+	GeoEncode::DecoderWithBoundingBox box(-10, 0, 10, 50);
+	for (int i = 0; i != 100; ++i) decode_bb(box, 0, 10);
+    });
+    other.join();
+
+    GeoEncode::DecoderStats stats;
+    if (!GeoEncode::get_decoder_stats(stats)) {
+	if (stats.calls != 0) {
+	    fprintf(stderr, "decoder stats aren't compiled in, but counted\n");
+	    return false;
+	}
+	return true;
+    }
+    if (stats.calls != 105 || stats.prefilter_rejects != 1 ||
+	stats.full_decodes != 104 || stats.lat_rejects != 1 ||
+	stats.lon_rejects != 1 || stats.accepts != 102 ||
+	stats.pole_accepts != 1) {
+	fprintf(stderr, "decoder stats: calls %llu, prefilter rejects %llu, "
+		"full decodes %llu, lat rejects %llu, lon rejects %llu, "
+		"accepts %llu, pole accepts %llu\n",
+		(unsigned long long)stats.calls,
+		(unsigned long long)stats.prefilter_rejects,
+		(unsigned long long)stats.full_decodes,
+		(unsigned long long)stats.lat_rejects,
+		(unsigned long long)stats.lon_rejects,
+		(unsigned long long)stats.accepts,
+		(unsigned long long)stats.pole_accepts);
+	return false;
+    }
+
+    GeoEncode::reset_decoder_stats();
+    GeoEncode::get_decoder_stats(stats);
+    if (stats.calls != 0) {
+	fprintf(stderr, "decoder stats weren't reset\n");
+	return false;
+    }
+    return true;
+}
+
 int main() {
+    bool ok = true;
+
     // Check some roundtrips of things which encode precisely.
     // (encoding resolution is 16ths of a second).
     check(0, 0);
@@ -161,6 +298,54 @@ int main() {
 	     );
     }
 
+    // Check decoding to 16ths of a second.
+    ok &= check_16ths(-90, 0);
+    ok &= check_16ths(90, 0);
+    ok &= check_16ths(0, 359.9999);
+    for (int i = 0; i != 100000; ++i) {
+	double lat = ((random() * 180.0) / RAND_MAX) - 90.0;
+	double lon = ((random() * 360.0) / RAND_MAX);
+	ok &= check_16ths(lat, lon);
+    }
+
+    // Check the extents of cells denoted by prefixes.
+    ok &= check_cells(-90, 0);
+    ok &= check_cells(90, 0);
+    ok &= check_cells(0, 359.9999);
+    for (int i = 0; i != 100000; ++i) {
+	double lat = ((random() * 180.0) / RAND_MAX) - 90.0;
+	double lon = ((random() * 360.0) / RAND_MAX);
+	ok &= check_cells(lat, lon);
+    }
+    {
+	GeoEncode::CellBounds cell;
+	string encoded;
+	GeoEncode::encode(10, 10, encoded);
+	if (GeoEncode::cell_bounds(encoded.data(), 1, cell) ||
+	    GeoEncode::cell_bounds(encoded.data(), 7, cell) ||
+	    GeoEncode::cell_bounds("\xff\xff", 2, cell) ||
+	    GeoEncode::cell_bounds((string(encoded, 0, 2) + "\xf0").data(), 3,
+				   cell)) {
+	    fprintf(stderr, "cell_bounds accepted an invalid prefix\n");
+	    ok = false;
+	}
+
+	// Bytes after the prefix aren't looked at, even if they would make
+	// a full code invalid.
+	const char buf[6] = { 0, 5, 0, 0, 0x0f, 0 };
+	for (size_t len = 2; len <= 4; ++len) {
+	    if (!GeoEncode::cell_bounds(buf, len, cell)) {
+		fprintf(stderr, "cell_bounds rejected a valid %zu byte "
+			"prefix\n", len);
+		ok = false;
+	    }
+	}
+	if (GeoEncode::cell_bounds(buf, 5, cell)) {
+	    fprintf(stderr, "cell_bounds accepted an invalid 5 byte prefix\n");
+	    ok = false;
+	}
+    }
+
     // Check decoding using a bounding box which includes the south pole.
     GeoEncode::DecoderWithBoundingBox bb(-90, -60, 10, 50);
     check_bb(bb, -90, 0, true);
@@ -350,5 +535,7 @@ int main() {
 	check_bb(bb, lat, lon, in_box);
     }
 
-    return 0;
+    ok &= check_decoder_stats();
+
+    return ok ? 0 : 1;
 }
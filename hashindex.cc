@@ -0,0 +1,311 @@
+/** @file hashindex.cc
+ * @brief Exact-match hash index from encoded coordinates to IDs.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "hashindex.h"
+
+#include "metrics.h"
+#include "serialise.h"
+#include "simd.h"
+#include "splitmix.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#if GEOENCODE_X86_SIMD && defined __SSE2__
+# include <emmintrin.h>
+# define GEOENCODE_SSE2_PROBE 1
+#endif
+
+using namespace std;
+using GeoEncode::PackedCode;
+using GeoEncode::CodeHashIndex;
+
+/// Number of slots in a group.
+static const size_t GROUP_SIZE = 16;
+
+/// Control byte of an empty slot.
+static const unsigned char CTRL_EMPTY = 0x80;
+
+/// Flag set in a value which is the offset of a list of IDs.
+static const CodeHashIndex::Id LIST_FLAG = 0x80000000;
+
+/// Mask for the valid bits of a packed code.
+static const PackedCode CODE_MASK = (PackedCode(1) << 48) - 1;
+
+/// Mix the bits of a code, so that every bit of the hash depends on it.
+static inline uint64_t
+hash_code(PackedCode code)
+{
+    return GeoEncode::mix64(code);
+}
+
+/** Find the slots in a group whose control byte has a given value.
+ *
+ *  @returns A mask with bit i set if slot i matches.
+ */
+static inline uint32_t
+match_group(const unsigned char * group, unsigned char byte, bool simd)
+{
+#ifdef GEOENCODE_SSE2_PROBE
+    if (simd) {
+	__m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl,
+						_mm_set1_epi8(char(byte))));
+    }
+#else
+    (void)simd;
+#endif
+    uint32_t mask = 0;
+    for (unsigned i = 0; i != GROUP_SIZE; ++i) {
+	if (group[i] == byte) {
+	    mask |= 1u << i;
+	}
+    }
+    return mask;
+}
+
+/// Get the code stored in a slot.
+static inline PackedCode
+load_key(const unsigned char * keys, size_t slot)
+{
+    return GeoEncode::load_le64(reinterpret_cast<const char *>(keys) +
+				slot * 6) & CODE_MASK;
+}
+
+/// Store a code in a slot.
+static inline void
+store_key(unsigned char * keys, size_t slot, PackedCode code)
+{
+    for (size_t i = 0; i != 6; ++i) {
+	keys[slot * 6 + i] = (code >> (8 * i)) & 0xff;
+    }
+}
+
+GeoEncode::CodeHashIndex::CodeHashIndex()
+	: count(0), ids(0)
+{
+}
+
+size_t
+GeoEncode::CodeHashIndex::find_slot(PackedCode code, uint64_t hash,
+				    size_t & empty_ref) const
+{
+    size_t groups = ctrl.size() / GROUP_SIZE;
+    empty_ref = SIZE_MAX;
+    if (groups == 0) {
+	return SIZE_MAX;
+    }
+    bool simd = simd_level() != SIMD_NONE;
+    size_t mask = groups - 1;
+    size_t g = (hash >> 7) & mask;
+    unsigned char h2 = hash & 0x7f;
+    // Probe groups in triangular steps, which visits every group when the
+    // number of groups is a power of two.
+    for (size_t step = 1; ; ++step) {
+	const unsigned char * group = &ctrl[g * GROUP_SIZE];
+	uint32_t matches = match_group(group, h2, simd);
+	while (matches) {
+	    size_t slot = g * GROUP_SIZE + __builtin_ctz(matches);
+	    if (load_key(&keys[0], slot) == code) {
+		return slot;
+	    }
+	    matches &= matches - 1;
+	}
+	uint32_t empty = match_group(group, CTRL_EMPTY, simd);
+	if (empty) {
+	    empty_ref = g * GROUP_SIZE + __builtin_ctz(empty);
+	    return SIZE_MAX;
+	}
+	g = (g + step) & mask;
+    }
+}
+
+size_t
+GeoEncode::CodeHashIndex::slot_ids(size_t slot, const Id *& ids_ref) const
+{
+    Id value = values[slot];
+    if (!(value & LIST_FLAG)) {
+	ids_ref = &values[slot];
+	return 1;
+    }
+    size_t offset = value & ~LIST_FLAG;
+    ids_ref = &arena[offset + 2];
+    return arena[offset];
+}
+
+void
+GeoEncode::CodeHashIndex::rehash(size_t groups)
+{
+    vector<unsigned char> old_ctrl, old_keys;
+    vector<Id> old_values;
+    old_ctrl.swap(ctrl);
+    old_keys.swap(keys);
+    old_values.swap(values);
+    ctrl.assign(groups * GROUP_SIZE, CTRL_EMPTY);
+    // Two bytes of padding let a key be read with a single 8 byte load.
+    keys.assign(groups * GROUP_SIZE * 6 + 2, 0);
+    values.assign(groups * GROUP_SIZE, 0);
+
+    for (size_t slot = 0; slot != old_ctrl.size(); ++slot) {
+	if (old_ctrl[slot] == CTRL_EMPTY) {
+	    continue;
+	}
+	PackedCode code = load_key(&old_keys[0], slot);
+	uint64_t hash = hash_code(code);
+	size_t empty;
+	find_slot(code, hash, empty);
+	ctrl[empty] = hash & 0x7f;
+	store_key(&keys[0], empty, code);
+	values[empty] = old_values[slot];
+    }
+}
+
+void
+GeoEncode::CodeHashIndex::reserve(size_t n)
+{
+    size_t groups = max(size_t(1), ctrl.size() / GROUP_SIZE);
+    while (groups * GROUP_SIZE * 7 / 8 < n) {
+	groups *= 2;
+    }
+    if (groups * GROUP_SIZE != ctrl.size()) {
+	rehash(groups);
+    }
+}
+
+bool
+GeoEncode::CodeHashIndex::insert(PackedCode code, Id id)
+{
+    if (rare((code & ~CODE_MASK) || (id & LIST_FLAG))) {
+	return false;
+    }
+    if ((count + 1) * 8 > ctrl.size() * 7) {
+	rehash(max(size_t(1), ctrl.size() / GROUP_SIZE * 2));
+    }
+
+    uint64_t hash = hash_code(code);
+    size_t empty;
+    size_t slot = find_slot(code, hash, empty);
+    if (slot == SIZE_MAX) {
+	ctrl[empty] = hash & 0x7f;
+	store_key(&keys[0], empty, code);
+	values[empty] = id;
+	++count;
+	++ids;
+	return true;
+    }
+
+    Id & value = values[slot];
+    if (!(value & LIST_FLAG)) {
+	// Move the single ID into a new list.
+	size_t offset = arena.size();
+	if (rare(offset + 6 > LIST_FLAG)) {
+	    return false;
+	}
+	Id old_id = value;
+	arena.resize(offset + 6);
+	arena[offset] = 2;
+	arena[offset + 1] = 4;
+	arena[offset + 2] = old_id;
+	arena[offset + 3] = id;
+	value = LIST_FLAG | offset;
+    } else {
+	size_t offset = value & ~LIST_FLAG;
+	size_t len = arena[offset];
+	size_t capacity = arena[offset + 1];
+	if (len == capacity) {
+	    // Move the list to the end of the arena with twice the capacity;
+	    // the old copy is left unused.
+	    size_t new_offset = arena.size();
+	    if (rare(new_offset + 2 + capacity * 2 > LIST_FLAG)) {
+		return false;
+	    }
+	    arena.resize(new_offset + 2 + capacity * 2);
+	    copy(arena.begin() + offset, arena.begin() + offset + 2 + len,
+		 arena.begin() + new_offset);
+	    arena[new_offset + 1] = capacity * 2;
+	    offset = new_offset;
+	    value = LIST_FLAG | offset;
+	}
+	arena[offset + 2 + len] = id;
+	arena[offset] = len + 1;
+    }
+    ++ids;
+    return true;
+}
+
+size_t
+GeoEncode::CodeHashIndex::find(PackedCode code, const Id *& ids_ref) const
+{
+    size_t empty;
+    size_t slot = find_slot(code, hash_code(code), empty);
+    if (slot == SIZE_MAX) {
+	ids_ref = NULL;
+	return 0;
+    }
+    return slot_ids(slot, ids_ref);
+}
+
+void
+GeoEncode::CodeHashIndex::find_batch(const PackedCode * codes, size_t n,
+				     const Id ** ids_out,
+				     size_t * counts) const
+{
+    MetricScope metric(METRIC_HASH_FIND_BATCH, n, n * sizeof(PackedCode));
+    // Number of lookups to prefetch ahead.
+    const size_t AHEAD = 16;
+    size_t groups = ctrl.size() / GROUP_SIZE;
+    uint64_t hashes[AHEAD];
+    for (size_t start = 0; start < n; start += AHEAD) {
+	size_t end = min(n, start + AHEAD);
+	for (size_t i = start; i != end; ++i) {
+	    uint64_t hash = hash_code(codes[i]);
+	    hashes[i - start] = hash;
+	    if (groups) {
+		size_t g = (hash >> 7) & (groups - 1);
+		__builtin_prefetch(&ctrl[g * GROUP_SIZE]);
+		__builtin_prefetch(&keys[g * GROUP_SIZE * 6]);
+		__builtin_prefetch(&keys[g * GROUP_SIZE * 6 + 64]);
+		__builtin_prefetch(&values[g * GROUP_SIZE]);
+	    }
+	}
+	for (size_t i = start; i != end; ++i) {
+	    size_t empty;
+	    size_t slot = find_slot(codes[i], hashes[i - start], empty);
+	    if (slot == SIZE_MAX) {
+		ids_out[i] = NULL;
+		counts[i] = 0;
+	    } else {
+		counts[i] = slot_ids(slot, ids_out[i]);
+	    }
+	}
+    }
+}
+
+size_t
+GeoEncode::CodeHashIndex::memory_used() const
+{
+    return sizeof(*this) + ctrl.capacity() + keys.capacity() +
+	    (values.capacity() + arena.capacity()) * sizeof(Id);
+}
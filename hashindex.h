@@ -0,0 +1,173 @@
+/** @file hashindex.h
+ * @brief Exact-match hash index from encoded coordinates to IDs.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GEOENCODE_INCLUDED_HASHINDEX_H
+#define GEOENCODE_INCLUDED_HASHINDEX_H
+
+#include "geoencode.h"
+
+#include <vector>
+
+namespace GeoEncode {
+
+/** A hash index from packed codes to the IDs stored at them.
+ *
+ *  This is an open-addressing table in the style of a Swiss table: each slot
+ *  has a control byte holding 7 bits of the hash of its code, and a lookup
+ *  compares the control bytes of a group of 16 slots at once with SIMD
+ *  instructions, only looking at the codes of slots whose control byte
+ *  matches.
+ *
+ *  It is designed to use little memory per entry.  Each slot takes 11
+ *  bytes: the control byte, the code in 6 bytes, and a 4 byte value.  If
+ *  only one ID is stored for a code, the value is that ID; otherwise it is
+ *  the offset of a list of IDs in a separate arena.  The table grows when
+ *  it is 7/8 full.
+ *
+ *  Codes can't be removed from the index.
+ */
+class CodeHashIndex {
+  public:
+    /** Type of the IDs stored in the index.
+     *
+     *  IDs must be less than 2^31.
+     */
+    typedef uint32_t Id;
+
+  private:
+    /** The control byte for each slot.
+     */
+    std::vector<unsigned char> ctrl;
+
+    /** The code for each slot, as 6 little-endian bytes, plus padding.
+     */
+    std::vector<unsigned char> keys;
+
+    /** The value for each slot.
+     */
+    std::vector<Id> values;
+
+    /** Lists of IDs for codes with more than one ID.
+     *
+     *  Each list is stored as its length, its capacity, and then the IDs.
+     */
+    std::vector<Id> arena;
+
+    /** Number of codes in the index.
+     */
+    size_t count;
+
+    /** Number of IDs in the index.
+     */
+    size_t ids;
+
+    /** Find the slot holding a code.
+     *
+     *  @param code The code to look for.
+     *  @param hash The hash of @a code.
+     *  @param empty_ref A reference to a value to return the first empty
+     *                   slot found in, if the code isn't in the index.
+     *
+     *  @returns The slot, or SIZE_MAX if the code isn't in the index.
+     */
+    size_t find_slot(PackedCode code, uint64_t hash, size_t & empty_ref) const;
+
+    /** Get the IDs stored in a slot.
+     */
+    size_t slot_ids(size_t slot, const Id *& ids_ref) const;
+
+    /** Resize the table to a number of groups of slots, and reinsert.
+     */
+    void rehash(size_t groups);
+
+  public:
+    /** Create an empty index.
+     */
+    CodeHashIndex();
+
+    /** Make room for a number of distinct codes without further growth.
+     */
+    void reserve(size_t n);
+
+    /** Add an ID at a code.
+     *
+     *  @param code The code to add the ID at.
+     *  @param id The ID to add.  Adding the same ID at the same code more
+     *            than once stores it more than once.
+     *
+     *  @returns false if @a code isn't a valid packed code or @a id isn't
+     *           less than 2^31, in which case the index is unmodified.
+     */
+    bool insert(PackedCode code, Id id);
+
+    /** Find the IDs stored at a code.
+     *
+     *  @param code The code to look up.
+     *  @param ids_ref A reference to a pointer to return the IDs in.  The
+     *                 pointer is valid until the index is next modified.
+     *
+     *  @returns The number of IDs stored at the code (0 if it isn't in the
+     *           index).
+     */
+    size_t find(PackedCode code, const Id *& ids_ref) const;
+
+    /** Check whether any IDs are stored at a code.
+     */
+    bool contains(PackedCode code) const {
+	const Id * ignored;
+	return find(code, ignored) != 0;
+    }
+
+    /** Look up a batch of codes.
+     *
+     *  This is equivalent to calling find() for each code, but prefetches
+     *  the memory for several lookups ahead, so that their cache misses
+     *  overlap.
+     *
+     *  @param codes The codes to look up.
+     *  @param n The number of codes.
+     *  @param ids An array of @a n pointers to return the IDs for each code
+     *             in.
+     *  @param counts An array of @a n values to return the number of IDs for
+     *                each code in.
+     */
+    void find_batch(const PackedCode * codes, size_t n,
+		    const Id ** ids, size_t * counts) const;
+
+    /** Get the number of distinct codes in the index.
+     */
+    size_t size() const { return count; }
+
+    /** Get the number of IDs in the index.
+     */
+    size_t id_count() const { return ids; }
+
+    /** Get the number of bytes of memory used by the index.
+     */
+    size_t memory_used() const;
+};
+
+}
+
+#endif /* GEOENCODE_INCLUDED_HASHINDEX_H */
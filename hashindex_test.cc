@@ -0,0 +1,156 @@
+/** @file hashindex_test.cc
+ * @brief Tests for the hash index.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "hashindex.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+
+using namespace std;
+using GeoEncode::PackedCode;
+typedef GeoEncode::CodeHashIndex::Id Id;
+
+/** Check that the IDs returned for a code are as expected.
+ */
+static bool
+check_ids(PackedCode code, const Id * ids, size_t n,
+	  const map<PackedCode, vector<Id> > & expected)
+{
+    map<PackedCode, vector<Id> >::const_iterator i = expected.find(code);
+    if (i == expected.end()) {
+	if (n != 0 || ids != NULL) {
+	    fprintf(stderr, "found %zu IDs for missing code %llx\n", n,
+		    (unsigned long long)code);
+	    return false;
+	}
+	return true;
+    }
+    if (vector<Id>(ids, ids + n) != i->second) {
+	fprintf(stderr, "wrong IDs for code %llx: got %zu, expected %zu\n",
+		(unsigned long long)code, n, i->second.size());
+	return false;
+    }
+    return true;
+}
+
+/** Fill an index with random codes and IDs, and check lookups.
+ */
+static bool
+check_index(size_t n, PackedCode code_range)
+{
+    GeoEncode::CodeHashIndex index;
+    map<PackedCode, vector<Id> > expected;
+    size_t nids = 0;
+    for (size_t i = 0; i != n; ++i) {
+	PackedCode code = ((PackedCode(random()) << 24) ^ random()) %
+		code_range;
+	Id id = random();
+	if (!index.insert(code, id)) {
+	    fprintf(stderr, "insert failed\n");
+	    return false;
+	}
+	expected[code].push_back(id);
+	++nids;
+    }
+    if (index.size() != expected.size() || index.id_count() != nids) {
+	fprintf(stderr, "index has %zu codes and %zu IDs, expected %zu and "
+		"%zu\n", index.size(), index.id_count(), expected.size(),
+		nids);
+	return false;
+    }
+
+    vector<PackedCode> probes;
+    map<PackedCode, vector<Id> >::const_iterator i;
+    for (i = expected.begin(); i != expected.end(); ++i) {
+	probes.push_back(i->first);
+	probes.push_back(i->first + 1);
+    }
+    for (size_t j = probes.size(); j > 1; --j) {
+	swap(probes[j - 1], probes[random() % j]);
+    }
+    for (size_t j = 0; j != probes.size(); ++j) {
+	const Id * ids;
+	size_t count = index.find(probes[j], ids);
+	if (!check_ids(probes[j], ids, count, expected)) {
+	    return false;
+	}
+	if (index.contains(probes[j]) != (count != 0)) {
+	    fprintf(stderr, "contains() disagrees with find()\n");
+	    return false;
+	}
+    }
+
+    vector<const Id *> batch_ids(probes.size());
+    vector<size_t> batch_counts(probes.size());
+    index.find_batch(probes.empty() ? NULL : &probes[0], probes.size(),
+		     batch_ids.empty() ? NULL : &batch_ids[0],
+		     batch_counts.empty() ? NULL : &batch_counts[0]);
+    for (size_t j = 0; j != probes.size(); ++j) {
+	if (!check_ids(probes[j], batch_ids[j], batch_counts[j], expected)) {
+	    return false;
+	}
+    }
+    return true;
+}
+
+int main() {
+    bool ok = true;
+    GeoEncode::SimdLevel levels[] = {
+	GeoEncode::SIMD_NONE, GeoEncode::SIMD_AVX512
+    };
+    for (int l = 0; l != 2; ++l) {
+	GeoEncode::set_simd_limit(levels[l]);
+	ok &= check_index(0, 1000);
+	ok &= check_index(1, 1000);
+	ok &= check_index(100, 1000000);
+	// Many IDs per code.
+	ok &= check_index(20000, 50);
+	ok &= check_index(200000, PackedCode(1) << 48);
+	ok &= check_index(200000, 100000);
+    }
+    GeoEncode::set_simd_limit(GeoEncode::SIMD_AVX512);
+
+    // Invalid codes and IDs are rejected.
+    GeoEncode::CodeHashIndex index;
+    if (index.insert(PackedCode(1) << 48, 1) ||
+	index.insert(1, 0x80000000) || index.size() != 0) {
+	fprintf(stderr, "invalid insert succeeded\n");
+	ok = false;
+    }
+
+    // Reserving space doesn't lose entries.
+    index.insert(123, 4);
+    index.reserve(100000);
+    const Id * ids;
+    if (index.find(123, ids) != 1 || ids[0] != 4) {
+	fprintf(stderr, "entry lost by reserve()\n");
+	ok = false;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,255 @@
+/** @file join.cc
+ * @brief Distance joins between sorted arrays of packed codes.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "join.h"
+
+#include "distance.h"
+#include "metrics.h"
+#include "neighbours.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+using namespace std;
+using GeoEncode::PackedCode;
+
+/// Number of 16ths of a second in a degree.
+static const int DEGREE_16THS = 57600;
+
+/// The most cells to gather codes from for a cell before using larger cells.
+static const size_t MAX_NEIGHBOURS = 256;
+
+namespace {
+
+/// A contiguous range of positions in an array of codes.
+struct PositionRange {
+    size_t begin;
+    size_t end;
+};
+
+/// The shared state of a join.
+class DistanceJoin {
+    /// The first array of codes.
+    const PackedCode * left;
+
+    /// The number of codes in left.
+    size_t left_n;
+
+    /// The second array of codes.
+    const PackedCode * right;
+
+    /// The number of codes in right.
+    size_t right_n;
+
+    /// The distance in metres.
+    double distance;
+
+    /// The squared chord length for the distance on a unit sphere.
+    double max_chord_squared;
+
+    /// The length of the prefixes used to bucket codes.
+    unsigned len;
+
+    /// The ranges of left holding each degree cell, one per task.
+    vector<PositionRange> tasks;
+
+    /// The index of the next task to start.
+    atomic<size_t> next_task;
+
+    /// The pairs found by each task.
+    vector<vector<pair<size_t, size_t> > > results;
+
+    /// The number of codes read from both arrays by the tasks.
+    atomic<size_t> codes_read;
+
+    void run_task(size_t task, vector<PackedCode> & candidates,
+		  vector<size_t> & candidate_positions,
+		  vector<double> & chords);
+
+  public:
+    DistanceJoin(const PackedCode * left_, size_t left_n_,
+		 const PackedCode * right_, size_t right_n_,
+		 double distance_);
+
+    void worker();
+
+    void append_results(vector<pair<size_t, size_t> > & pairs) const;
+
+    size_t task_count() const { return tasks.size(); }
+
+    size_t codes_scanned() const { return codes_read; }
+};
+
+}
+
+DistanceJoin::DistanceJoin(const PackedCode * left_, size_t left_n_,
+			   const PackedCode * right_, size_t right_n_,
+			   double distance_)
+    : left(left_), left_n(left_n_), right(right_), right_n(right_n_),
+      distance(distance_), next_task(0), codes_read(0)
+{
+    double radians = min(distance / GeoEncode::EARTH_RADIUS, M_PI);
+    double s = sin(radians * 0.5);
+    max_chord_squared = 4 * s * s;
+
+    len = 2;
+    while (len < 5 && GeoEncode::cell_height(len + 1) * 3 >= distance) {
+	++len;
+    }
+
+    size_t pos = 0;
+    while (pos != left_n) {
+	PositionRange task;
+	task.begin = pos;
+	PackedCode next = ((left[pos] >> 32) + 1) << 32;
+	pos = lower_bound(left + pos, left + left_n, next) - left;
+	task.end = pos;
+	tasks.push_back(task);
+    }
+    results.resize(tasks.size());
+}
+
+/** Join the codes in a degree cell of the left array with the right array.
+ *
+ *  The buffers are passed in so that they can be reused between tasks.
+ */
+void
+DistanceJoin::run_task(size_t task, vector<PackedCode> & candidates,
+		       vector<size_t> & candidate_positions,
+		       vector<double> & chords)
+{
+    vector<pair<size_t, size_t> > & found = results[task];
+    vector<PackedCode> prefixes;
+    unsigned shift = (6 - len) * 8;
+    size_t pos = tasks[task].begin;
+    const size_t end = tasks[task].end;
+    size_t read = end - pos;
+    while (pos != end) {
+	PackedCode prefix = (left[pos] >> shift) << shift;
+	size_t cell_end = lower_bound(left + pos, left + end,
+				      prefix + (PackedCode(1) << shift)) - left;
+
+	// Gather the codes from the right which might be near the cell.
+	prefixes.clear();
+	unsigned found_len = GeoEncode::cells_within_distance(
+		prefix, len, distance, MAX_NEIGHBOURS, prefixes);
+	PackedCode span = PackedCode(1) << ((6 - found_len) * 8);
+	candidates.clear();
+	candidate_positions.clear();
+	size_t r = 0;
+	for (size_t i = 0; i != prefixes.size(); ++i) {
+	    PackedCode first = prefixes[i];
+	    PackedCode last = first + span;
+	    // Merge cells which are adjacent in code order.
+	    while (i + 1 != prefixes.size() && prefixes[i + 1] == last) {
+		last += span;
+		++i;
+	    }
+	    r = lower_bound(right + r, right + right_n, first) - right;
+	    size_t r_end = lower_bound(right + r, right + right_n, last) - right;
+	    for ( ; r != r_end; ++r) {
+		candidates.push_back(right[r]);
+		candidate_positions.push_back(r);
+	    }
+	}
+
+	read += candidates.size();
+	if (!candidates.empty()) {
+	    chords.resize(candidates.size());
+	    for ( ; pos != cell_end; ++pos) {
+		int lat_16ths, lon_16ths;
+		GeoEncode::decode_16ths(left[pos], lat_16ths, lon_16ths);
+		double lat = double(lat_16ths) / DEGREE_16THS - 90;
+		double lon = double(lon_16ths) / DEGREE_16THS;
+		GeoEncode::chord_squared_batch(lat, lon, &candidates[0],
+					       candidates.size(), &chords[0]);
+		size_t first = found.size();
+		for (size_t i = 0; i != candidates.size(); ++i) {
+		    if (chords[i] <= max_chord_squared) {
+			found.push_back(make_pair(pos, candidate_positions[i]));
+		    }
+		}
+		sort(found.begin() + first, found.end());
+	    }
+	}
+	pos = cell_end;
+    }
+    codes_read += read;
+}
+
+/// Run tasks until there are none left.
+void
+DistanceJoin::worker()
+{
+    vector<PackedCode> candidates;
+    vector<size_t> candidate_positions;
+    vector<double> chords;
+    while (true) {
+	size_t task = next_task++;
+	if (task >= tasks.size()) {
+	    break;
+	}
+	run_task(task, candidates, candidate_positions, chords);
+    }
+}
+
+/// Append the pairs found by all the tasks, in order.
+void
+DistanceJoin::append_results(vector<pair<size_t, size_t> > & pairs) const
+{
+    for (size_t i = 0; i != results.size(); ++i) {
+	pairs.insert(pairs.end(), results[i].begin(), results[i].end());
+    }
+}
+
+void
+GeoEncode::distance_join(const PackedCode * left, size_t left_n,
+			 const PackedCode * right, size_t right_n,
+			 double distance,
+			 vector<pair<size_t, size_t> > & pairs,
+			 unsigned threads)
+{
+    MetricScope metric(METRIC_DISTANCE_JOIN, left_n + right_n);
+    if (left_n == 0 || right_n == 0 || distance < 0) {
+	return;
+    }
+    DistanceJoin join(left, left_n, right, right_n, distance);
+    if (threads == 0) {
+	threads = max(1u, thread::hardware_concurrency());
+    }
+    threads = unsigned(min(size_t(threads), join.task_count()));
+    vector<thread> workers;
+    for (unsigned i = 1; i < threads; ++i) {
+	workers.push_back(thread(&DistanceJoin::worker, &join));
+    }
+    join.worker();
+    for (size_t i = 0; i != workers.size(); ++i) {
+	workers[i].join();
+    }
+    join.append_results(pairs);
+    metric.add_bytes(join.codes_scanned() * sizeof(PackedCode));
+}
@@ -0,0 +1,80 @@
+/** @file join.h
+ * @brief Distance joins between sorted arrays of packed codes.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GEOENCODE_INCLUDED_JOIN_H
+#define GEOENCODE_INCLUDED_JOIN_H
+
+#include "geoencode.h"
+
+#include <utility>
+#include <vector>
+
+namespace GeoEncode {
+
+/** Find all pairs of codes from two sorted arrays within a distance.
+ *
+ * The codes in each array are bucketed by cells of the encoding, using the
+ * longest prefix whose cells are at least a third of @a distance tall: 1
+ * degree, 4 minute, 15 second or 1 second cells.  Small cells keep the number
+ * of candidates tested for each code low.  Each cell of @a left is joined with
+ * the cells of @a right which come within the distance of it (its
+ * neighbours, or more of them in longitude near the poles), by gathering
+ * their codes and testing them against each code in the cell with
+ * chord_squared_batch().
+ *
+ * The work is divided between threads by the degree cells of @a left.
+ *
+ * @param left The first array of codes, in ascending order.
+ * @param left_n The number of codes in @a left.
+ * @param right The second array of codes, in ascending order.
+ * @param right_n The number of codes in @a right.
+ * @param distance The distance in metres.
+ * @param pairs A vector to append (position in @a left, position in
+ *              @a right) pairs to, for each pair whose decoded coordinates
+ *              are within @a distance, in ascending order.
+ * @param threads The number of threads to use, or 0 to use one for each
+ *                processor.
+ */
+extern void
+distance_join(const PackedCode * left, size_t left_n,
+	      const PackedCode * right, size_t right_n, double distance,
+	      std::vector<std::pair<size_t, size_t> > & pairs,
+	      unsigned threads = 0);
+
+/** Find all pairs of codes from two sorted vectors within a distance.
+ */
+inline void
+distance_join(const std::vector<PackedCode> & left,
+	      const std::vector<PackedCode> & right, double distance,
+	      std::vector<std::pair<size_t, size_t> > & pairs,
+	      unsigned threads = 0)
+{
+    distance_join(left.empty() ? NULL : &left[0], left.size(),
+		  right.empty() ? NULL : &right[0], right.size(),
+		  distance, pairs, threads);
+}
+
+}
+
+#endif /* GEOENCODE_INCLUDED_JOIN_H */
@@ -0,0 +1,130 @@
+/** @file join_test.cc
+ * @brief Tests for distance joins between sorted arrays of codes.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "join.h"
+#include "distance.h"
+#include "testutils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+using GeoEncode::PackedCode;
+
+/** Decode a packed code to degrees.
+ */
+static void
+decode_code(PackedCode code, double & lat, double & lon)
+{
+    string encoded;
+    GeoEncode::unpack(code, encoded);
+    GeoEncode::decode(encoded, lat, lon);
+}
+
+/** Check distance_join() against testing every pair.
+ *
+ *  Pairs within a millimetre of the distance may go either way.
+ */
+static bool
+check_join(const vector<PackedCode> & left, const vector<PackedCode> & right,
+	   double distance, unsigned threads)
+{
+    vector<pair<size_t, size_t> > pairs;
+    GeoEncode::distance_join(left, right, distance, pairs, threads);
+    if (!is_sorted(pairs.begin(), pairs.end())) {
+	fprintf(stderr, "join results aren't sorted\n");
+	return false;
+    }
+
+    vector<double> right_lat(right.size()), right_lon(right.size());
+    for (size_t j = 0; j != right.size(); ++j) {
+	decode_code(right[j], right_lat[j], right_lon[j]);
+    }
+    size_t p = 0;
+    for (size_t i = 0; i != left.size(); ++i) {
+	double lat, lon;
+	decode_code(left[i], lat, lon);
+	for (size_t j = 0; j != right.size(); ++j) {
+	    double d = GeoEncode::haversine_distance(lat, lon, right_lat[j],
+						     right_lon[j]);
+	    bool found = (p != pairs.size() && pairs[p] == make_pair(i, j));
+	    if (found) ++p;
+	    if (fabs(d - distance) > 0.001 && found != (d <= distance)) {
+		fprintf(stderr, "join within %g m: (%.9g,%.9g)-(%.9g,%.9g) at "
+			"%.9g m was %s\n", distance, lat, lon, right_lat[j],
+			right_lon[j], d, found ? "included" : "missed");
+		return false;
+	    }
+	}
+    }
+    if (p != pairs.size()) {
+	fprintf(stderr, "join returned unexpected pairs\n");
+	return false;
+    }
+    return true;
+}
+
+int main() {
+    bool ok = true;
+    vector<PackedCode> left, right;
+
+    // Empty inputs.
+    make_codes(100, 0, 0, 180, right);
+    ok &= check_join(left, right, 1000, 1);
+
+    // Each cell size, with one thread and several.
+    double distances[] = { 20, 300, 5000, 100000, 1000000 };
+    for (int i = 0; i != 5; ++i) {
+	double spread = distances[i] * 40 / GeoEncode::EARTH_RADIUS / M_PI *
+		180;
+	make_codes(1500, 51.5, -0.1, spread, left);
+	make_codes(1500, 51.5, -0.1, spread, right);
+	ok &= check_join(left, right, distances[i], 1);
+	ok &= check_join(left, right, distances[i], 4);
+    }
+
+    // Across the antimeridian and the 0/360 boundary, and near the poles.
+    make_codes(1500, 10, 180, 0.1, left);
+    make_codes(1500, 10, 180, 0.1, right);
+    ok &= check_join(left, right, 2000, 3);
+    make_codes(1500, 0, 0, 0.1, left);
+    make_codes(1500, 0, 0, 0.1, right);
+    ok &= check_join(left, right, 2000, 3);
+    make_codes(1500, 89.9, 0, 0.5, left);
+    make_codes(1500, 89.9, 180, 0.5, right);
+    ok &= check_join(left, right, 5000, 3);
+    make_codes(1500, -89.99, 0, 0.05, left);
+    make_codes(1500, -89.99, 90, 0.05, right);
+    ok &= check_join(left, right, 200, 3);
+
+    // Uniform points at a large distance.
+    make_codes(1000, 0, 0, 180, left);
+    make_codes(1000, 0, 0, 180, right);
+    ok &= check_join(left, right, 800000, 2);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,313 @@
+/** @file knn.cc
+ * @brief Nearest neighbour search over sorted arrays of packed codes.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "knn.h"
+
+#include "distance.h"
+#include "metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+
+using namespace std;
+using GeoEncode::PackedCode;
+
+/// Number of degree cells, including the one holding the north pole.
+static const unsigned DEGREE_CELLS = 181 * 360;
+
+/// Cells holding at most this many codes are scanned rather than split.
+static const size_t SCAN_SIZE = 32;
+
+/** Find the first position in a range of codes which isn't less than a code.
+ *
+ *  This searches forwards from the start of the range with exponentially
+ *  increasing steps, so it is cheap when the position is near the start, as
+ *  it is when splitting a cell into its children.
+ */
+static size_t
+gallop(const PackedCode * codes, size_t begin, size_t end, PackedCode code)
+{
+    size_t lo = begin;
+    size_t hi = begin;
+    size_t step = 1;
+    while (hi < end && codes[hi] < code) {
+	lo = hi + 1;
+	hi += step;
+	step <<= 1;
+    }
+    if (hi > end) hi = end;
+    return lower_bound(codes + lo, codes + hi, code) - codes;
+}
+
+namespace {
+
+/// A cell waiting to be visited.
+struct QueueItem {
+    /// Lower bound on the rank of the distance to points in the cell.
+    double rank;
+
+    /// The first code in the cell.
+    PackedCode prefix;
+
+    /** Length of the prefix denoting the cell, in bytes.
+     *
+     *  Degree cells (with a length of 2) are queued before their codes are
+     *  located, so begin and end are only set for smaller cells.
+     */
+    unsigned len;
+
+    /// Position of the first code in the cell.
+    size_t begin;
+
+    /// Position after the last code in the cell.
+    size_t end;
+
+    bool operator>(const QueueItem & o) const { return rank > o.rank; }
+};
+
+/// The state of a single search.
+class KnnSearch {
+    /// The codes being searched.
+    const PackedCode * codes;
+
+    /// The number of codes.
+    size_t n;
+
+    /// The latitude of the coordinate.
+    double lat;
+
+    /// The longitude of the coordinate.
+    double lon;
+
+    /// The number of codes to find.
+    size_t k;
+
+    /// Bounds on the distances from the coordinate to cells.
+    GeoEncode::CellDistanceBounds bounds;
+
+    /// Cells to visit, nearest first.
+    priority_queue<QueueItem, vector<QueueItem>, greater<QueueItem> > queue;
+
+    /// The nearest codes found so far, as a max-heap of (rank, position).
+    vector<pair<double, size_t> > best;
+
+    /// Which degree cells have been considered for the queue.
+    vector<bool> seen;
+
+    /// The number of codes compared with the coordinate.
+    size_t scanned;
+
+    /// Rank above which cells and codes can't improve on the results.
+    double limit() const {
+	return best.size() == k ? best.front().first : HUGE_VAL;
+    }
+
+    void add_degree_cell(unsigned lat_deg, unsigned lon_deg);
+
+    void add_neighbours(unsigned lat_deg, unsigned lon_deg);
+
+    void add_children(const QueueItem & item);
+
+    void scan(size_t begin, size_t end);
+
+  public:
+    KnnSearch(const PackedCode * codes_, size_t n_,
+	      double lat_, double lon_, size_t k_)
+	: codes(codes_), n(n_), lat(lat_), lon(lon_), k(k_),
+	  bounds(lat_, lon_), seen(DEGREE_CELLS), scanned(0) {}
+
+    void run(vector<pair<double, size_t> > & result);
+
+    size_t codes_scanned() const { return scanned; }
+};
+
+}
+
+/// Queue a degree cell, unless it has been seen or is too far away.
+void
+KnnSearch::add_degree_cell(unsigned lat_deg, unsigned lon_deg)
+{
+    unsigned dd = lat_deg + lon_deg * 181;
+    if (seen[dd]) {
+	return;
+    }
+    // A cell which is too far away now will still be too far away later,
+    // since the limit only decreases, so it needn't be considered again.
+    seen[dd] = true;
+    QueueItem item;
+    item.prefix = PackedCode(dd) << 32;
+    GeoEncode::CellBounds cell;
+    GeoEncode::cell_bounds(item.prefix, 2, cell);
+    item.rank = bounds.min_rank(cell);
+    if (item.rank >= limit()) {
+	return;
+    }
+    item.len = 2;
+    item.begin = item.end = 0;
+    queue.push(item);
+}
+
+/** Queue the degree cells adjacent to a degree cell.
+ *
+ *  The cells within a degree of a pole touch the cells on the opposite side
+ *  of the pole, as well as their neighbours in latitude and longitude.  The
+ *  north pole has a degree cell of its own, holding only the pole, which is
+ *  adjacent to all the cells around it, but nothing needs to be reached
+ *  through it.
+ */
+void
+KnnSearch::add_neighbours(unsigned lat_deg, unsigned lon_deg)
+{
+    if (lat_deg == 180) {
+	return;
+    }
+    unsigned west = lon_deg == 0 ? 359 : lon_deg - 1;
+    unsigned east = lon_deg == 359 ? 0 : lon_deg + 1;
+    unsigned south = lat_deg == 0 ? 0 : lat_deg - 1;
+    unsigned north = lat_deg == 179 ? 179 : lat_deg + 1;
+    for (unsigned i = south; i <= north; ++i) {
+	add_degree_cell(i, west);
+	add_degree_cell(i, lon_deg);
+	add_degree_cell(i, east);
+    }
+    if (lat_deg == 0 || lat_deg == 179) {
+	unsigned opposite = (lon_deg + 180) % 360;
+	add_degree_cell(lat_deg, (opposite + 359) % 360);
+	add_degree_cell(lat_deg, opposite);
+	add_degree_cell(lat_deg, (opposite + 1) % 360);
+	if (lat_deg == 179) {
+	    add_degree_cell(180, 0);
+	}
+    }
+}
+
+/// Queue the non-empty cells one byte longer than a cell.
+void
+KnnSearch::add_children(const QueueItem & item)
+{
+    QueueItem child;
+    child.len = item.len + 1;
+    unsigned shift = (6 - child.len) * 8;
+    size_t pos = item.begin;
+    while (pos != item.end) {
+	PackedCode prefix = codes[pos] >> shift;
+	child.prefix = prefix << shift;
+	child.begin = pos;
+	child.end = gallop(codes, pos + 1, item.end, (prefix + 1) << shift);
+	pos = child.end;
+	GeoEncode::CellBounds cell;
+	if (!GeoEncode::cell_bounds(child.prefix, child.len, cell)) {
+	    // Not a valid code; give it no bound so it is scanned anyway.
+	    child.rank = 0;
+	} else {
+	    child.rank = bounds.min_rank(cell);
+	    if (child.rank >= limit()) {
+		continue;
+	    }
+	}
+	queue.push(child);
+    }
+}
+
+/// Compare the codes in a range with the nearest found so far.
+void
+KnnSearch::scan(size_t begin, size_t end)
+{
+    double chords[SCAN_SIZE];
+    scanned += end - begin;
+    while (begin != end) {
+	size_t len = min(end - begin, SCAN_SIZE);
+	GeoEncode::chord_squared_batch(lat, lon, codes + begin, len, chords);
+	for (size_t i = 0; i != len; ++i) {
+	    // The rank is the haversine, which is a quarter of the squared
+	    // chord.
+	    double rank = chords[i] * 0.25;
+	    if (best.size() < k) {
+		best.push_back(make_pair(rank, begin + i));
+		push_heap(best.begin(), best.end());
+	    } else if (rank < best.front().first) {
+		pop_heap(best.begin(), best.end());
+		best.back() = make_pair(rank, begin + i);
+		push_heap(best.begin(), best.end());
+	    }
+	}
+	begin += len;
+    }
+}
+
+void
+KnnSearch::run(vector<pair<double, size_t> > & result)
+{
+    // Start from the degree cell holding the coordinate.  The cell holding
+    // the north pole leads nowhere, so start next to it there.
+    double lat_offset = min(max(lat, -90.0), 90.0) + 90;
+    unsigned lat_deg = min(unsigned(lat_offset), 179u);
+    double wrapped = fmod(lon, 360.0);
+    if (wrapped < 0) wrapped += 360;
+    unsigned lon_deg = min(unsigned(wrapped), 359u);
+    add_degree_cell(lat_deg, lon_deg);
+
+    while (!queue.empty()) {
+	QueueItem item = queue.top();
+	queue.pop();
+	if (item.rank >= limit()) {
+	    break;
+	}
+	if (item.len == 2) {
+	    unsigned dd = unsigned(item.prefix >> 32);
+	    add_neighbours(dd % 181, dd / 181);
+	    item.begin = lower_bound(codes, codes + n, item.prefix) - codes;
+	    item.end = gallop(codes, item.begin, n,
+			      item.prefix + (PackedCode(1) << 32));
+	}
+	if (item.end - item.begin <= SCAN_SIZE || item.len == 6) {
+	    scan(item.begin, item.end);
+	} else {
+	    add_children(item);
+	}
+    }
+
+    sort_heap(best.begin(), best.end());
+    for (size_t i = 0; i != best.size(); ++i) {
+	result.push_back(make_pair(GeoEncode::rank_to_distance(best[i].first),
+				   best[i].second));
+    }
+}
+
+void
+GeoEncode::knn_search(const PackedCode * codes, size_t n,
+		      double lat, double lon, size_t k,
+		      vector<pair<double, size_t> > & result)
+{
+    MetricScope metric(METRIC_KNN_SEARCH, n);
+    if (n == 0 || k == 0) {
+	return;
+    }
+    KnnSearch search(codes, n, lat, lon, k);
+    search.run(result);
+    metric.add_bytes(search.codes_scanned() * sizeof(PackedCode));
+}
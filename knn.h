@@ -0,0 +1,78 @@
+/** @file knn.h
+ * @brief Nearest neighbour search over sorted arrays of packed codes.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GEOENCODE_INCLUDED_KNN_H
+#define GEOENCODE_INCLUDED_KNN_H
+
+#include "geoencode.h"
+
+#include <utility>
+#include <vector>
+
+namespace GeoEncode {
+
+/** Find the codes in a sorted array nearest to a coordinate.
+ *
+ * The codes for the points in a cell of the encoding are contiguous in a
+ * sorted array, so the array can be searched as a tree of cells without
+ * building an index: degree cells, then the 4 minute, 15 second, 1 second
+ * and 1/16 second cells within them.  Cells are visited best-first, in order
+ * of the lower bound on their distance from CellDistanceBounds, and the k
+ * nearest points found so far are kept in a bounded max-heap, so the search
+ * stops as soon as no unvisited cell can hold a point nearer than the k-th.
+ *
+ * Degree cells are reached by spreading out from the cell holding the
+ * coordinate to adjacent cells, with longitude wrapping at 360 and the cells
+ * within a degree of a pole adjacent to those on the opposite side of it, so
+ * searches work across the antimeridian and over the poles.  Each degree cell visited
+ * costs a binary search of the array, and smaller cells are found by
+ * searching within their parent.  Cells holding a few codes are scanned
+ * with chord_squared_batch().
+ *
+ * @param codes The codes, in ascending order (duplicates are allowed).
+ * @param n The number of codes.
+ * @param lat The latitude of the coordinate in degrees.
+ * @param lon The longitude of the coordinate in degrees.
+ * @param k The number of codes to find.
+ * @param result A vector to append (distance in metres, position) pairs to,
+ *               nearest first.  Fewer than @a k are appended if there are
+ *               fewer than @a k codes.
+ */
+extern void
+knn_search(const PackedCode * codes, size_t n, double lat, double lon,
+	   size_t k, std::vector<std::pair<double, size_t> > & result);
+
+/** Find the codes in a sorted vector nearest to a coordinate.
+ */
+inline void
+knn_search(const std::vector<PackedCode> & codes, double lat, double lon,
+	   size_t k, std::vector<std::pair<double, size_t> > & result)
+{
+    knn_search(codes.empty() ? NULL : &codes[0], codes.size(), lat, lon, k,
+	       result);
+}
+
+}
+
+#endif /* GEOENCODE_INCLUDED_KNN_H */
@@ -0,0 +1,148 @@
+/** @file knn_test.cc
+ * @brief Tests for nearest neighbour search over sorted arrays of codes.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "knn.h"
+#include "distance.h"
+#include "testutils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+using GeoEncode::PackedCode;
+
+/** Check knn_search() against the distances to every code.
+ */
+static bool
+check_knn(const vector<PackedCode> & codes, double lat, double lon, size_t k)
+{
+    vector<double> distances;
+    for (size_t i = 0; i != codes.size(); ++i) {
+	string encoded;
+	GeoEncode::unpack(codes[i], encoded);
+	double p_lat, p_lon;
+	GeoEncode::decode(encoded, p_lat, p_lon);
+	distances.push_back(GeoEncode::haversine_distance(lat, lon,
+							  p_lat, p_lon));
+    }
+    vector<double> expected(distances);
+    sort(expected.begin(), expected.end());
+    if (expected.size() > k) expected.resize(k);
+
+    vector<pair<double, size_t> > result;
+    GeoEncode::knn_search(codes, lat, lon, k, result);
+    if (result.size() != expected.size()) {
+	fprintf(stderr, "knn(%g,%g,%zu) over %zu codes found %zu, "
+		"expected %zu\n", lat, lon, k, codes.size(), result.size(),
+		expected.size());
+	return false;
+    }
+    for (size_t i = 0; i != result.size(); ++i) {
+	double d = result[i].first;
+	// Within about 100 km of the antipode, the haversine formula loses
+	// precision.
+	double tolerance = (d < GeoEncode::EARTH_RADIUS * M_PI - 100000) ?
+		1e-6 : 1.0;
+	if (fabs(d - expected[i]) > tolerance ||
+	    fabs(d - distances[result[i].second]) > tolerance) {
+	    fprintf(stderr, "knn(%g,%g,%zu) result %zu: got %.10g at %zu "
+		    "(%.10g), expected %.10g\n", lat, lon, k, i, d,
+		    result[i].second, distances[result[i].second],
+		    expected[i]);
+	    return false;
+	}
+    }
+    return true;
+}
+
+int main() {
+    bool ok = true;
+
+    // Empty arrays and k of zero find nothing.
+    vector<PackedCode> codes;
+    ok &= check_knn(codes, 10, 20, 5);
+    make_codes(100, 0, 0, 180, codes);
+    ok &= check_knn(codes, 10, 20, 0);
+    // Fewer codes than requested.
+    ok &= check_knn(codes, 10, 20, 1000);
+
+    // Uniform points, and queries far from any point.
+    make_codes(50000, 0, 0, 180, codes);
+    for (int i = 0; i != 100; ++i) {
+	double lat = ((random() * 180.0) / RAND_MAX) - 90.0;
+	double lon = ((random() * 360.0) / RAND_MAX) - 180.0;
+	ok &= check_knn(codes, lat, lon, 1 + i % 20);
+    }
+    make_codes(1000, 0, 0, 180, codes);
+    for (int i = 0; i != 50; ++i) {
+	double lat = ((random() * 180.0) / RAND_MAX) - 90.0;
+	double lon = ((random() * 360.0) / RAND_MAX);
+	ok &= check_knn(codes, lat, lon, 1 + i * 20);
+    }
+
+    // Clustered points, queried from inside and far outside the cluster.
+    make_codes(100000, 51.5, -0.1, 0.2, codes);
+    ok &= check_knn(codes, 51.5, -0.1, 10);
+    ok &= check_knn(codes, 51.501, 359.899, 100);
+    ok &= check_knn(codes, -40, 170, 10);
+
+    // Across the antimeridian and the 0/360 boundary.
+    make_codes(100000, 10, 180, 0.5, codes);
+    ok &= check_knn(codes, 10, 179.99, 10);
+    ok &= check_knn(codes, 10, -179.99, 10);
+    ok &= check_knn(codes, 10.4, 179.6, 50);
+    make_codes(100000, 0, 0, 0.5, codes);
+    ok &= check_knn(codes, 0, 359.999, 10);
+    ok &= check_knn(codes, 0.2, 0.001, 10);
+
+    // Near and over the poles, where points on the far side of the pole
+    // may be nearest.
+    make_codes(100000, 89.5, 0, 1, codes);
+    codes.push_back(pack_coord(90, 0));
+    sort(codes.begin(), codes.end());
+    ok &= check_knn(codes, 90, 0, 10);
+    ok &= check_knn(codes, 89.99, 180, 10);
+    ok &= check_knn(codes, 89.9, 90, 30);
+    ok &= check_knn(codes, 88, 180, 10);
+    for (int i = 0; i != 20; ++i) {
+	codes.push_back(pack_coord(-89.999, i * 18.0));
+    }
+    codes.push_back(pack_coord(-90, 0));
+    sort(codes.begin(), codes.end());
+    ok &= check_knn(codes, -90, 0, 5);
+    ok &= check_knn(codes, -89.9995, 275, 3);
+    ok &= check_knn(codes, -88, 100, 30);
+
+    // Duplicate codes.
+    codes.assign(100, pack_coord(30, 40));
+    codes.push_back(pack_coord(30.001, 40));
+    sort(codes.begin(), codes.end());
+    ok &= check_knn(codes, 30.001, 40, 3);
+    ok &= check_knn(codes, 30.001, 40, 101);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,300 @@
+/** @file learnedindex.cc
+ * @brief Learned piecewise-linear index over sorted packed codes.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "learnedindex.h"
+
+#include "serialise.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+using GeoEncode::PackedCode;
+
+/// Magic bytes at the start of a serialised index.
+static const char INDEX_MAGIC[4] = { 'G', 'E', 'L', 'I' };
+
+/// Version of the serialised format.
+static const unsigned INDEX_VERSION = 1;
+
+/// Bytes stored for each segment.
+static const size_t SEGMENT_BYTES = 24;
+
+void
+GeoEncode::LearnedIndex::fit(const PackedCode * keys, size_t n,
+			     unsigned max_error, vector<Segment> & segments)
+{
+    // Fit with a little less than the allowed error, to leave room for
+    // rounding the prediction.
+    const double eps = max_error - 1;
+    segments.clear();
+
+    PackedCode x0 = 0;
+    double y0 = 0, slope_lo = 0, slope_hi = 0;
+    bool open = false;
+
+    // The points fitted are (key, position of its first occurrence).  If
+    // there is a gap before a key, (previous key + 1, position) is fitted
+    // too, so that predictions for codes between the keys are also within
+    // the error.
+    for (size_t i = 0; i != n; ++i) {
+	if (i && keys[i] == keys[i - 1]) {
+	    continue;
+	}
+	PackedCode xs[2];
+	int npoints = 0;
+	if (i && keys[i - 1] + 1 != keys[i]) {
+	    xs[npoints++] = keys[i - 1] + 1;
+	}
+	xs[npoints++] = keys[i];
+	for (int j = 0; j != npoints; ++j) {
+	    PackedCode x = xs[j];
+	    double y = i;
+	    if (open) {
+		double dx = double(x - x0);
+		double lo = (y - eps - y0) / dx;
+		double hi = (y + eps - y0) / dx;
+		if (lo <= slope_hi && hi >= slope_lo) {
+		    slope_lo = max(slope_lo, lo);
+		    slope_hi = min(slope_hi, hi);
+		    continue;
+		}
+		segments.back().slope = (slope_lo + slope_hi) * 0.5;
+	    }
+	    // Start a new segment at this point.
+	    Segment segment;
+	    segment.key = x;
+	    segment.slope = 0;
+	    segment.position = i;
+	    segments.push_back(segment);
+	    x0 = x;
+	    y0 = y;
+	    slope_lo = 0;
+	    slope_hi = HUGE_VAL;
+	    open = true;
+	}
+    }
+    if (open && slope_hi != HUGE_VAL) {
+	segments.back().slope = (slope_lo + slope_hi) * 0.5;
+    }
+}
+
+size_t
+GeoEncode::LearnedIndex::predict(const vector<Segment> & segments,
+				 size_t index, PackedCode key, size_t n)
+{
+    const Segment & segment = segments[index];
+    double upper = (index + 1 == segments.size()) ?
+	    n : segments[index + 1].position;
+    double p = segment.position + segment.slope * double(key - segment.key);
+    p = min(upper, max(double(segment.position), p));
+    return size_t(p + 0.5);
+}
+
+bool
+GeoEncode::LearnedIndex::build(const PackedCode * codes, size_t n,
+			       unsigned max_error)
+{
+    levels.clear();
+    count = 0;
+    last_code = 0;
+    error = 0;
+    if (max_error < 2) {
+	return false;
+    }
+    for (size_t i = 1; i < n; ++i) {
+	if (rare(codes[i] < codes[i - 1])) {
+	    return false;
+	}
+    }
+    count = n;
+    error = max_error;
+    if (n == 0) {
+	return true;
+    }
+    last_code = codes[n - 1];
+
+    levels.resize(1);
+    fit(codes, n, error, levels[0]);
+    while (levels.back().size() > 1) {
+	const vector<Segment> & below = levels.back();
+	vector<PackedCode> keys(below.size());
+	for (size_t i = 0; i != below.size(); ++i) {
+	    keys[i] = below[i].key;
+	}
+	vector<Segment> above;
+	fit(&keys[0], keys.size(), error, above);
+	if (above.size() >= below.size()) {
+	    // No further reduction is possible; the top level will be binary
+	    // searched.
+	    break;
+	}
+	levels.push_back(above);
+    }
+    return true;
+}
+
+namespace {
+
+/// Compare a key with the key of a segment, for upper_bound().
+struct KeyLess {
+    template<typename S>
+    bool operator()(PackedCode key, const S & segment) const {
+	return key < segment.key;
+    }
+};
+
+}
+
+size_t
+GeoEncode::LearnedIndex::lower_bound(const PackedCode * codes,
+				     PackedCode code) const
+{
+    if (count == 0 || code > last_code) {
+	return count;
+    }
+    if (code <= codes[0]) {
+	return 0;
+    }
+
+    // Find the segment in the top level.
+    const vector<Segment> & top = levels.back();
+    size_t seg = upper_bound(top.begin(), top.end(), code, KeyLess()) -
+	    top.begin() - 1;
+
+    // Work down the levels; at each, find the last segment whose key isn't
+    // more than code, which is one before the lower bound of code + 1.
+    for (size_t l = levels.size() - 1; l != 0; --l) {
+	const vector<Segment> & below = levels[l - 1];
+	size_t pos = predict(levels[l], seg, code + 1, below.size());
+	size_t lo = pos > error ? pos - error : 0;
+	size_t hi = min(below.size(), pos + error + 1);
+	seg = upper_bound(below.begin() + lo, below.begin() + hi, code,
+			  KeyLess()) - below.begin() - 1;
+    }
+
+    size_t pos = predict(levels[0], seg, code, count);
+    size_t lo = pos > error ? pos - error : 0;
+    size_t hi = min(count, pos + error + 1);
+    return std::lower_bound(codes + lo, codes + hi, code) - codes;
+}
+
+size_t
+GeoEncode::LearnedIndex::memory_used() const
+{
+    size_t total = sizeof(*this);
+    for (size_t l = 0; l != levels.size(); ++l) {
+	total += levels[l].capacity() * sizeof(Segment);
+    }
+    return total;
+}
+
+void
+GeoEncode::LearnedIndex::serialise(string & result) const
+{
+    result.append(INDEX_MAGIC, 4);
+    append_uint(result, INDEX_VERSION, 1);
+    append_uint(result, error, 4);
+    append_uint(result, count, 8);
+    append_uint(result, last_code, 8);
+    append_uint(result, levels.size(), 1);
+    for (size_t l = 0; l != levels.size(); ++l) {
+	append_uint(result, levels[l].size(), 8);
+	for (size_t i = 0; i != levels[l].size(); ++i) {
+	    const Segment & segment = levels[l][i];
+	    uint64_t slope_bits;
+	    memcpy(&slope_bits, &segment.slope, 8);
+	    append_uint(result, segment.key, 8);
+	    append_uint(result, slope_bits, 8);
+	    append_uint(result, segment.position, 8);
+	}
+    }
+}
+
+bool
+GeoEncode::LearnedIndex::unserialise(const char * ptr, size_t len)
+{
+    *this = LearnedIndex();
+
+    const char * end = ptr + len;
+    if (len < 4 || memcmp(ptr, INDEX_MAGIC, 4) != 0) {
+	return false;
+    }
+    ptr += 4;
+    uint64_t version, max_error, n, last, nlevels;
+    if (!read_uint(ptr, end, version, 1) || version != INDEX_VERSION ||
+	!read_uint(ptr, end, max_error, 4) || max_error < 2 ||
+	!read_uint(ptr, end, n, 8) ||
+	!read_uint(ptr, end, last, 8) ||
+	!read_uint(ptr, end, nlevels, 1) ||
+	(n == 0) != (nlevels == 0)) {
+	return false;
+    }
+
+    vector<vector<Segment> > new_levels(nlevels);
+    uint64_t limit = n;
+    for (size_t l = 0; l != nlevels; ++l) {
+	uint64_t nsegments;
+	if (!read_uint(ptr, end, nsegments, 8) || nsegments == 0 ||
+	    nsegments > uint64_t(end - ptr) / SEGMENT_BYTES) {
+	    return false;
+	}
+	vector<Segment> & segments = new_levels[l];
+	segments.resize(nsegments);
+	for (size_t i = 0; i != nsegments; ++i) {
+	    uint64_t key, slope_bits, position;
+	    if (!read_uint(ptr, end, key, 8) ||
+		!read_uint(ptr, end, slope_bits, 8) ||
+		!read_uint(ptr, end, position, 8)) {
+		return false;
+	    }
+	    Segment & segment = segments[i];
+	    segment.key = key;
+	    memcpy(&segment.slope, &slope_bits, 8);
+	    segment.position = position;
+	    // Positions must increase within the range of the level below,
+	    // and keys mustn't decrease.
+	    if (position > limit || !(segment.slope >= 0) ||
+		(i && (position < segments[i - 1].position ||
+		       key < segments[i - 1].key))) {
+		return false;
+	    }
+	}
+	if (segments[0].position != 0) {
+	    return false;
+	}
+	limit = nsegments;
+    }
+    if (ptr != end) {
+	return false;
+    }
+
+    levels.swap(new_levels);
+    count = n;
+    last_code = last;
+    error = max_error;
+    return true;
+}
@@ -0,0 +1,162 @@
+/** @file learnedindex.h
+ * @brief Learned piecewise-linear index over sorted packed codes.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GEOENCODE_INCLUDED_LEARNEDINDEX_H
+#define GEOENCODE_INCLUDED_LEARNEDINDEX_H
+
+#include "geoencode.h"
+
+#include <string>
+#include <vector>
+
+namespace GeoEncode {
+
+/** A learned index over a sorted array of packed codes.
+ *
+ *  The index is a piecewise-linear model of the position of each code in
+ *  the array, built so that its prediction is never more than a fixed
+ *  error from the true position.  Looking up a code evaluates the model and
+ *  then binary searches a window of the array around the prediction, which
+ *  touches a couple of cache lines instead of the ~30 which a binary search
+ *  over a billion codes needs.
+ *
+ *  The segments of the model are themselves indexed by a smaller model, and
+ *  so on until a single segment remains, so a lookup never searches more
+ *  than a small window at any level.
+ *
+ *  The index doesn't hold a copy of the codes; the same array must be
+ *  passed to lower_bound() as was passed to build().
+ */
+class LearnedIndex {
+    /** A segment of the model.
+     */
+    struct Segment {
+	/** The first code covered by the segment.
+	 */
+	PackedCode key;
+
+	/** Change in position per unit increase of code.
+	 */
+	double slope;
+
+	/** Position of the first code covered by the segment.
+	 */
+	size_t position;
+    };
+
+    /** The levels of the model.
+     *
+     *  Level 0 predicts positions in the array of codes; each higher level
+     *  predicts positions in the level below, and the top level holds a
+     *  single segment.
+     */
+    std::vector<std::vector<Segment> > levels;
+
+    /** Number of codes in the array.
+     */
+    size_t count;
+
+    /** Last code in the array.
+     */
+    PackedCode last_code;
+
+    /** Maximum error of a prediction.
+     */
+    unsigned error;
+
+    /** Fit segments to a sorted array of keys, in one pass.
+     */
+    static void fit(const PackedCode * keys, size_t n, unsigned error,
+		    std::vector<Segment> & segments);
+
+    /** Predict the lower bound of a key, using a segment.
+     *
+     *  The prediction is clamped to the positions covered by the segment.
+     *
+     *  @param segments The level containing the segment.
+     *  @param index The index of the segment in @a segments.
+     *  @param key The key to predict the position of.
+     *  @param n The number of keys modelled by @a segments.
+     */
+    static size_t predict(const std::vector<Segment> & segments,
+			  size_t index, PackedCode key, size_t n);
+
+  public:
+    /** Create an empty index.
+     */
+    LearnedIndex() : count(0), last_code(0), error(0) {}
+
+    /** Build the index.
+     *
+     *  @param codes The codes, which must be sorted in ascending order
+     *               (duplicates are allowed).
+     *  @param n The number of codes.
+     *  @param max_error The maximum distance of a predicted position from
+     *                   the true position.  Larger values give a smaller
+     *                   index but longer local searches.
+     *
+     *  @returns false if the codes weren't sorted or @a max_error was less
+     *           than 2, in which case the index is left empty.
+     */
+    bool build(const PackedCode * codes, size_t n, unsigned max_error = 32);
+
+    /** Find the position of the first code which isn't less than a code.
+     *
+     *  @param codes The array of codes the index was built from.
+     *  @param code The code to look for.
+     *
+     *  @returns The position, or the number of codes if all are less than
+     *           @a code.
+     */
+    size_t lower_bound(const PackedCode * codes, PackedCode code) const;
+
+    /** Get the number of codes the index was built over.
+     */
+    size_t size() const { return count; }
+
+    /** Get the number of segments at the lowest level of the model.
+     */
+    size_t segment_count() const {
+	return levels.empty() ? 0 : levels[0].size();
+    }
+
+    /** Get the number of bytes of memory used by the model.
+     */
+    size_t memory_used() const;
+
+    /** Serialise the index, appending it to a string.
+     */
+    void serialise(std::string & result) const;
+
+    /** Replace the contents of the index with a serialised index.
+     *
+     *  @returns false if the serialised form is invalid, in which case the
+     *           index is left empty.
+     */
+    bool unserialise(const char * ptr, size_t len);
+};
+
+}
+
+#endif /* GEOENCODE_INCLUDED_LEARNEDINDEX_H */
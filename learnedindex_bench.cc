@@ -0,0 +1,109 @@
+/** @file learnedindex_bench.cc
+ * @brief Benchmark of the learned index against binary search.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "learnedindex.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+using GeoEncode::PackedCode;
+
+/// Time probes with a lookup function, returning ns per probe.
+template<typename F>
+static double
+time_probes(const vector<PackedCode> & probes, F lookup, size_t & checksum)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (size_t i = 0; i != probes.size(); ++i) {
+	checksum += lookup(probes[i]);
+    }
+    chrono::duration<double, nano> elapsed =
+	    chrono::steady_clock::now() - start;
+    return elapsed.count() / probes.size();
+}
+
+/// Run the benchmark on one dataset.
+static void
+run(const char * name, const vector<PackedCode> & codes, size_t nprobes)
+{
+    vector<PackedCode> probes;
+    for (size_t i = 0; i != nprobes; ++i) {
+	probes.push_back(codes[(size_t(random()) << 16 ^ random()) %
+			       codes.size()] + random() % 2);
+    }
+
+    const PackedCode * data = &codes[0];
+    size_t checksum1 = 0, checksum2 = 0;
+    double binary_ns = time_probes(probes, [&](PackedCode code) {
+	return size_t(lower_bound(codes.begin(), codes.end(), code) -
+		      codes.begin());
+    }, checksum1);
+
+    unsigned errors[] = { 16, 32, 64, 128 };
+    for (size_t e = 0; e != 4; ++e) {
+	GeoEncode::LearnedIndex index;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	index.build(data, codes.size(), errors[e]);
+	chrono::duration<double> build =
+		chrono::steady_clock::now() - start;
+	checksum2 = 0;
+	double learned_ns = time_probes(probes, [&](PackedCode code) {
+	    return index.lower_bound(data, code);
+	}, checksum2);
+	printf("%-10s n=%zu error=%u: binary search %.1f ns/probe, learned "
+	       "%.1f ns/probe (%.2fx), %zu segments, %zu bytes, built in "
+	       "%.2fs%s\n", name, codes.size(), errors[e], binary_ns,
+	       learned_ns, binary_ns / learned_ns, index.segment_count(),
+	       index.memory_used(), build.count(),
+	       checksum1 == checksum2 ? "" : " MISMATCH");
+    }
+}
+
+int main(int argc, char ** argv) {
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+    size_t nprobes = 1000000;
+
+    vector<PackedCode> codes;
+    codes.reserve(n);
+    for (size_t i = 0; i != n; ++i) {
+	codes.push_back(((PackedCode(random()) << 24) ^ random()) &
+			((PackedCode(1) << 48) - 1));
+    }
+    sort(codes.begin(), codes.end());
+    run("uniform", codes, nprobes);
+
+    codes.clear();
+    for (size_t i = 0; i != n; ++i) {
+	// A few dense cities within a handful of degree cells.
+	PackedCode centre = (PackedCode(random() % 50) * 1000) << 32;
+	codes.push_back(centre + (PackedCode(random()) % 100000000));
+    }
+    sort(codes.begin(), codes.end());
+    run("clustered", codes, nprobes);
+    return 0;
+}
@@ -0,0 +1,158 @@
+/** @file learnedindex_test.cc
+ * @brief Tests for the learned index.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "learnedindex.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+using GeoEncode::PackedCode;
+
+/// Make a random code, uniform over the valid range.
+static PackedCode
+random_code()
+{
+    return ((PackedCode(random()) << 24) ^ random()) &
+	    ((PackedCode(1) << 48) - 1);
+}
+
+/** Check lookups in an index against std::lower_bound().
+ */
+static bool
+check_index(const GeoEncode::LearnedIndex & index,
+	    const vector<PackedCode> & codes)
+{
+    const PackedCode * data = codes.empty() ? NULL : &codes[0];
+    vector<PackedCode> probes;
+    for (size_t i = 0; i != codes.size() && i < 20000; ++i) {
+	PackedCode code = codes[random() % codes.size()];
+	probes.push_back(code);
+	probes.push_back(code + 1);
+	if (code) probes.push_back(code - 1);
+    }
+    for (int i = 0; i != 2000; ++i) {
+	probes.push_back(random_code());
+    }
+    probes.push_back(0);
+    probes.push_back((PackedCode(1) << 48) - 1);
+    probes.push_back(~PackedCode(0));
+    for (size_t i = 0; i != probes.size(); ++i) {
+	size_t expected = lower_bound(codes.begin(), codes.end(), probes[i]) -
+		codes.begin();
+	size_t got = index.lower_bound(data, probes[i]);
+	if (got != expected) {
+	    fprintf(stderr, "lower_bound(%llx) = %zu, expected %zu "
+		    "(%zu codes)\n", (unsigned long long)probes[i], got,
+		    expected, codes.size());
+	    return false;
+	}
+    }
+    return true;
+}
+
+/** Build an index over some codes and check it, and its serialised form.
+ */
+static bool
+check_codes(const vector<PackedCode> & codes, unsigned max_error)
+{
+    GeoEncode::LearnedIndex index;
+    if (!index.build(codes.empty() ? NULL : &codes[0], codes.size(),
+		     max_error)) {
+	fprintf(stderr, "build failed\n");
+	return false;
+    }
+    if (!check_index(index, codes)) {
+	return false;
+    }
+
+    string serialised;
+    index.serialise(serialised);
+    GeoEncode::LearnedIndex index2;
+    if (!index2.unserialise(serialised.data(), serialised.size())) {
+	fprintf(stderr, "unserialise failed\n");
+	return false;
+    }
+    // Every truncation is rejected.
+    size_t min_len = serialised.size() < 2000 ? 0 : serialised.size() - 1;
+    for (size_t len = min_len; len < serialised.size(); ++len) {
+	if (index2.unserialise(serialised.data(), len)) {
+	    fprintf(stderr, "unserialise of %zu of %zu bytes succeeded\n",
+		    len, serialised.size());
+	    return false;
+	}
+    }
+    index2.unserialise(serialised.data(), serialised.size());
+    return check_index(index2, codes);
+}
+
+int main() {
+    bool ok = true;
+    unsigned errors[] = { 2, 8, 64 };
+    size_t sizes[] = { 0, 1, 2, 10, 1000, 300000 };
+    for (size_t e = 0; e != 3; ++e) {
+	for (size_t s = 0; s != sizeof(sizes) / sizeof(sizes[0]); ++s) {
+	    size_t n = sizes[s];
+	    vector<PackedCode> codes;
+
+	    // Uniform codes.
+	    for (size_t i = 0; i != n; ++i) {
+		codes.push_back(random_code());
+	    }
+	    sort(codes.begin(), codes.end());
+	    ok &= check_codes(codes, errors[e]);
+
+	    // Clustered codes, with many duplicates.
+	    codes.clear();
+	    for (size_t i = 0; i != n; ++i) {
+		PackedCode centre = PackedCode(random() % 20) << 40;
+		PackedCode offset = random() % ((random() % 3) ? 1000 : 100000);
+		codes.push_back(centre + offset);
+	    }
+	    sort(codes.begin(), codes.end());
+	    ok &= check_codes(codes, errors[e]);
+
+	    // Consecutive codes.
+	    codes.clear();
+	    for (size_t i = 0; i != n; ++i) {
+		codes.push_back(1000 + i);
+	    }
+	    ok &= check_codes(codes, errors[e]);
+	}
+    }
+
+    // Unsorted input and too small an error are rejected.
+    {
+	PackedCode codes[] = { 3, 2 };
+	GeoEncode::LearnedIndex index;
+	if (index.build(codes, 2) || index.build(codes, 1, 1)) {
+	    fprintf(stderr, "invalid build succeeded\n");
+	    ok = false;
+	}
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,450 @@
+/** @file lsmindex.cc
+ * @brief Updatable index of encoded points.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "lsmindex.h"
+
+#include "cover.h"
+#include "metrics.h"
+
+#include <algorithm>
+
+using namespace std;
+using GeoEncode::PackedCode;
+
+/// Flag set in the code of a record for a delete.
+static const PackedCode TOMBSTONE = PackedCode(1) << 63;
+
+/// Mask for the valid bits of a packed code.
+static const PackedCode CODE_MASK = (PackedCode(1) << 48) - 1;
+
+/// Number of runs, as a multiple of max_runs, above which updates wait.
+static const size_t RUN_LIMIT_FACTOR = 8;
+
+namespace {
+
+/// A record from one of the sources searched by a query.
+struct Candidate {
+    PackedCode code;
+    GeoEncode::LsmIndex::Id id;
+    /// Age of the record's source: lower is newer.
+    size_t age;
+    bool tombstone;
+
+    bool operator<(const Candidate & other) const {
+	if (code != other.code) return code < other.code;
+	if (id != other.id) return id < other.id;
+	return age < other.age;
+    }
+};
+
+/// Compare records by (code, ID), ignoring the tombstone flag.
+template<typename R>
+bool
+record_less(const R & a, const R & b)
+{
+    PackedCode code_a = a.code & CODE_MASK, code_b = b.code & CODE_MASK;
+    if (code_a != code_b) return code_a < code_b;
+    return a.id < b.id;
+}
+
+/// Check whether two records are for the same (code, ID) pair.
+template<typename R>
+bool
+record_same(const R & a, const R & b)
+{
+    return (a.code & CODE_MASK) == (b.code & CODE_MASK) && a.id == b.id;
+}
+
+/** Find the records in a buffer which lie inside a bounding box.
+ *
+ *  Later records are newer, and get lower ages, starting from @a age.
+ *
+ *  @returns The age following those given to the records.
+ */
+template<typename R>
+size_t
+scan_records(const vector<R> & records,
+	     const GeoEncode::DecoderWithBoundingBox & bbox, size_t age,
+	     vector<Candidate> & candidates)
+{
+    size_t n = records.size();
+    for (size_t i = 0; i != n; ++i) {
+	char encoded[6];
+	GeoEncode::unpack(records[i].code & CODE_MASK, encoded);
+	double lat, lon;
+	if (bbox.decode(encoded, 6, lat, lon)) {
+	    Candidate c = {
+		records[i].code & CODE_MASK, records[i].id, age + n - 1 - i,
+		(records[i].code & TOMBSTONE) != 0
+	    };
+	    candidates.push_back(c);
+	}
+    }
+    return age + n;
+}
+
+/// Sort records by (code, ID), keeping only the last record for each pair.
+template<typename R>
+void
+sort_records(vector<R> & records)
+{
+    stable_sort(records.begin(), records.end(), record_less<R>);
+    size_t out = 0;
+    for (size_t i = 0; i != records.size(); ++i) {
+	if (i + 1 != records.size() && record_same(records[i], records[i + 1])) {
+	    continue;
+	}
+	records[out++] = records[i];
+    }
+    records.resize(out);
+}
+
+}
+
+GeoEncode::LsmIndex::LsmIndex(size_t buffer_size_, size_t max_runs_,
+			      bool background_)
+	: buffer_size(max(buffer_size_, size_t(1))),
+	  max_runs(max(max_runs_, size_t(2))),
+	  run_limit(max_runs * RUN_LIMIT_FACTOR),
+	  stopping(false)
+{
+    buffer.reserve(buffer_size);
+    if (background_) {
+	worker = thread(&LsmIndex::background, this);
+    }
+}
+
+GeoEncode::LsmIndex::~LsmIndex()
+{
+    if (worker.joinable()) {
+	{
+	    lock_guard<std::mutex> lock(mutex);
+	    stopping = true;
+	}
+	wakeup.notify_all();
+	worker.join();
+    }
+}
+
+bool
+GeoEncode::LsmIndex::add(PackedCode code, Id id, bool tombstone)
+{
+    if (rare(code & ~CODE_MASK)) {
+	return false;
+    }
+    Record record;
+    record.code = tombstone ? (code | TOMBSTONE) : code;
+    record.id = id;
+    unique_lock<std::mutex> lock(mutex);
+    buffer.push_back(record);
+    if (rare(buffer.size() >= buffer_size)) {
+	flush_locked(lock);
+    }
+    return true;
+}
+
+void
+GeoEncode::LsmIndex::flush_locked(unique_lock<std::mutex> & lock)
+{
+    if (buffer.empty()) {
+	return;
+    }
+    // Hand the buffer over as a batch, which queries search until its run
+    // is added, and sort a copy of it without the mutex held.
+    shared_ptr<vector<Record> > records = make_shared<vector<Record> >();
+    records->swap(buffer);
+    buffer.reserve(buffer_size);
+    Batch batch;
+    batch.records = records;
+    batches.push_back(batch);
+    lock.unlock();
+    shared_ptr<Run> run = make_shared<Run>(*records);
+    sort_records(*run);
+    lock.lock();
+
+    // Runs are added in the order their buffers were filled, so a batch
+    // sorted before an older one waits for it.
+    for (size_t i = 0; i != batches.size(); ++i) {
+	if (batches[i].records == records) {
+	    batches[i].run = run;
+	    break;
+	}
+    }
+    size_t ready = 0;
+    while (ready != batches.size() && batches[ready].run) {
+	runs.push_back(batches[ready].run);
+	++ready;
+    }
+    batches.erase(batches.begin(), batches.begin() + ready);
+
+    if (worker.joinable()) {
+	if (merge_start_locked() != runs.size()) {
+	    wakeup.notify_one();
+	}
+	while (rare(runs.size() > run_limit)) {
+	    merged.wait(lock);
+	}
+    } else {
+	while (merge_start_locked() != runs.size()) {
+	    lock.unlock();
+	    merge_runs(false);
+	    lock.lock();
+	}
+    }
+}
+
+void
+GeoEncode::LsmIndex::flush()
+{
+    unique_lock<std::mutex> lock(mutex);
+    flush_locked(lock);
+}
+
+unsigned
+GeoEncode::LsmIndex::tier(size_t size) const
+{
+    unsigned result = 0;
+    for (size_t limit = buffer_size; size > limit; limit *= max_runs) {
+	++result;
+    }
+    return result;
+}
+
+size_t
+GeoEncode::LsmIndex::merge_start_locked() const
+{
+    // Merge from the oldest run which has at least max_runs runs of its
+    // tier among it and the newer runs, and no newer run of a higher tier.
+    // The newer runs of lower tiers are small, so are merged along with
+    // them.
+    size_t start = runs.size();
+    vector<size_t> counts;
+    unsigned top = 0;
+    for (size_t i = runs.size(); i != 0; --i) {
+	unsigned t = tier(runs[i - 1]->size());
+	if (t >= counts.size()) {
+	    counts.resize(t + 1);
+	}
+	++counts[t];
+	if (t >= top) {
+	    top = t;
+	    if (counts[t] >= max_runs) {
+		start = i - 1;
+	    }
+	}
+    }
+    // If nothing else brings the number of runs down, merge them all.
+    if (start == runs.size() && runs.size() > run_limit) {
+	start = 0;
+    }
+    return start;
+}
+
+void
+GeoEncode::LsmIndex::merge_runs(bool all)
+{
+    lock_guard<std::mutex> merging(merge_mutex);
+
+    // Only merges remove runs, so the inputs stay at the same positions
+    // while the merge runs; runs flushed meanwhile are appended after them.
+    vector<shared_ptr<const Run> > inputs;
+    size_t first;
+    {
+	lock_guard<std::mutex> lock(mutex);
+	first = all ? 0 : merge_start_locked();
+	inputs.assign(runs.begin() + first, runs.end());
+    }
+    if (inputs.size() < 2) {
+	return;
+    }
+
+    // Merge the runs in pairs, in rounds, newest first.  std::merge takes
+    // equal records from its first range first, so for a pair present in
+    // several runs the copy from the newest run comes first, and the others
+    // are then skipped.  If the merge includes the oldest run, nothing
+    // older can be hidden by a tombstone, so tombstones are dropped.
+    bool drop_tombstones = (first == 0);
+    vector<shared_ptr<const Run> > parts(inputs.rbegin(), inputs.rend());
+    shared_ptr<Run> result;
+    while (parts.size() > 1) {
+	vector<shared_ptr<const Run> > next;
+	for (size_t i = 0; i != parts.size(); i += 2) {
+	    if (i + 1 == parts.size()) {
+		next.push_back(parts[i]);
+		break;
+	    }
+	    const Run & newer = *parts[i];
+	    const Run & older = *parts[i + 1];
+	    result = make_shared<Run>(newer.size() + older.size());
+	    merge(newer.begin(), newer.end(), older.begin(), older.end(),
+		  result->begin(), record_less<Record>);
+	    next.push_back(result);
+	}
+	parts.swap(next);
+    }
+
+    // The last round's merge made the only part left.
+    size_t out = 0;
+    for (size_t i = 0; i != result->size(); ++i) {
+	const Record & record = (*result)[i];
+	if (i && record_same((*result)[i - 1], record)) {
+	    continue;
+	}
+	if (!drop_tombstones || !(record.code & TOMBSTONE)) {
+	    (*result)[out++] = record;
+	}
+    }
+    result->resize(out);
+
+    {
+	lock_guard<std::mutex> lock(mutex);
+	runs.erase(runs.begin() + first,
+		   runs.begin() + first + inputs.size());
+	runs.insert(runs.begin() + first, result);
+    }
+    merged.notify_all();
+}
+
+void
+GeoEncode::LsmIndex::background()
+{
+    unique_lock<std::mutex> lock(mutex);
+    while (true) {
+	while (!stopping && merge_start_locked() == runs.size()) {
+	    wakeup.wait(lock);
+	}
+	if (stopping) {
+	    return;
+	}
+	lock.unlock();
+	merge_runs(false);
+	lock.lock();
+    }
+}
+
+void
+GeoEncode::LsmIndex::compact()
+{
+    flush();
+    merge_runs(true);
+}
+
+size_t
+GeoEncode::LsmIndex::run_count() const
+{
+    lock_guard<std::mutex> lock(mutex);
+    return runs.size();
+}
+
+size_t
+GeoEncode::LsmIndex::memory_used() const
+{
+    lock_guard<std::mutex> lock(mutex);
+    size_t total = sizeof(*this) + buffer.capacity() * sizeof(Record) +
+	    runs.capacity() * sizeof(runs[0]) +
+	    batches.capacity() * sizeof(Batch);
+    for (size_t b = 0; b != batches.size(); ++b) {
+	total += batches[b].records->capacity() * sizeof(Record);
+	if (batches[b].run) {
+	    total += sizeof(Run) + batches[b].run->capacity() * sizeof(Record);
+	}
+    }
+    for (size_t r = 0; r != runs.size(); ++r) {
+	total += sizeof(Run) + runs[r]->capacity() * sizeof(Record);
+    }
+    return total;
+}
+
+void
+GeoEncode::LsmIndex::box_query(double lat1, double lon1,
+			       double lat2, double lon2,
+			       vector<pair<PackedCode, Id> > & results) const
+{
+    MetricScope metric(METRIC_LSM_QUERY);
+    size_t old_size = results.size();
+    DecoderWithBoundingBox bbox(lat1, lon1, lat2, lon2);
+    vector<Candidate> candidates;
+    vector<Batch> batch_snapshot;
+    vector<shared_ptr<const Run> > snapshot;
+    size_t age;
+
+    {
+	// The buffer is small, so it is scanned in full.
+	lock_guard<std::mutex> lock(mutex);
+	age = scan_records(buffer, bbox, 0, candidates);
+	metric.add_bytes(buffer.size() * sizeof(Record));
+	batch_snapshot = batches;
+	snapshot = runs;
+    }
+
+    // So are the buffers being sorted, which are no longer changed.
+    for (size_t b = batch_snapshot.size(); b != 0; --b) {
+	const vector<Record> & records = *batch_snapshot[b - 1].records;
+	age = scan_records(records, bbox, age, candidates);
+	metric.add_bytes(records.size() * sizeof(Record));
+    }
+
+    vector<CodeRange> ranges;
+    bounding_box_cover(lat1, lon1, lat2, lon2, ranges);
+    for (size_t r = snapshot.size(); r != 0; --r, ++age) {
+	const Run & run = *snapshot[r - 1];
+	for (size_t i = 0; i != ranges.size(); ++i) {
+	    Record probe;
+	    probe.code = ranges[i].first;
+	    probe.id = 0;
+	    Run::const_iterator it = lower_bound(run.begin(), run.end(), probe,
+						 record_less<Record>);
+	    for (; it != run.end(); ++it) {
+		PackedCode code = it->code & CODE_MASK;
+		if (code > ranges[i].last) {
+		    break;
+		}
+		metric.add_bytes(sizeof(Record));
+		char encoded[6];
+		unpack(code, encoded);
+		double lat, lon;
+		if (bbox.decode(encoded, 6, lat, lon)) {
+		    Candidate c = {
+			code, it->id, age, (it->code & TOMBSTONE) != 0
+		    };
+		    candidates.push_back(c);
+		}
+	    }
+	}
+    }
+
+    // The newest record for each pair decides whether it is present.
+    sort(candidates.begin(), candidates.end());
+    for (size_t i = 0; i != candidates.size(); ++i) {
+	if (i && candidates[i].code == candidates[i - 1].code &&
+	    candidates[i].id == candidates[i - 1].id) {
+	    continue;
+	}
+	if (!candidates[i].tombstone) {
+	    results.push_back(make_pair(candidates[i].code, candidates[i].id));
+	}
+    }
+    metric.add_points(results.size() - old_size);
+}
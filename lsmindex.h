@@ -0,0 +1,253 @@
+/** @file lsmindex.h
+ * @brief Updatable index of encoded points.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GEOENCODE_INCLUDED_LSMINDEX_H
+#define GEOENCODE_INCLUDED_LSMINDEX_H
+
+#include "geoencode.h"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace GeoEncode {
+
+/** An updatable index of (code, ID) pairs, organised as a log-structured
+ *  merge tree.
+ *
+ *  Inserts and deletes are appended to an in-memory buffer.  When the buffer
+ *  is full it is sorted and written out as an immutable sorted run.  Runs
+ *  are merged by size tier: once there are enough runs of similar size, the
+ *  newest of them are merged into one run of the next tier, by a background
+ *  thread unless the index was created without one.  So each record is
+ *  rewritten once per tier rather than once per merge, and the large old
+ *  runs are left alone by most merges.  If the merges fall behind, inserts
+ *  and deletes wait for them.  Deletes are recorded as tombstones, which are
+ *  dropped when they are merged into the oldest run.
+ *
+ *  Queries search the buffer, any full buffers still being sorted, and each
+ *  run for the ranges of codes covering the query box, and the newest record
+ *  for each (code, ID) pair decides whether it is present.
+ *
+ *  Inserts, deletes and queries may be called from several threads at once.
+ */
+class LsmIndex {
+  public:
+    /** Type of the IDs stored in the index.
+     */
+    typedef uint64_t Id;
+
+  private:
+    /** An insert or delete of a (code, ID) pair.
+     */
+    struct Record {
+	/** The code, with TOMBSTONE set if this is a delete.
+	 */
+	PackedCode code;
+
+	/** The ID.
+	 */
+	Id id;
+    };
+
+    /** A sorted run of records, with at most one record for each pair.
+     */
+    typedef std::vector<Record> Run;
+
+    /** A full buffer being sorted into a run.
+     */
+    struct Batch {
+	/** The records from the buffer, in the order they were made.
+	 */
+	std::shared_ptr<const std::vector<Record> > records;
+
+	/** The sorted run, or NULL until it has been made.
+	 */
+	std::shared_ptr<const Run> run;
+    };
+
+    /** Protects buffer, batches and runs, and the flags below.
+     */
+    mutable std::mutex mutex;
+
+    /** Held while merging runs, so that only one merge happens at a time.
+     */
+    std::mutex merge_mutex;
+
+    /** Signalled when the background thread has work to do.
+     */
+    std::condition_variable wakeup;
+
+    /** Signalled when a merge has replaced some runs.
+     */
+    std::condition_variable merged;
+
+    /** Records not yet written to a run, in the order they were made.
+     */
+    std::vector<Record> buffer;
+
+    /** Full buffers being sorted without the mutex held, oldest first.  They
+     *  are searched by queries until their runs are added to runs, which
+     *  happens in order.
+     */
+    std::vector<Batch> batches;
+
+    /** The sorted runs, oldest first.
+     */
+    std::vector<std::shared_ptr<const Run> > runs;
+
+    /** Number of records in the buffer which causes it to be flushed.
+     */
+    size_t buffer_size;
+
+    /** Number of runs of the same size tier which are merged into one.
+     */
+    size_t max_runs;
+
+    /** Number of runs above which inserts and deletes wait for merges.
+     */
+    size_t run_limit;
+
+    /** True if the background thread should exit.
+     */
+    bool stopping;
+
+    /** The background merging thread, if any.
+     */
+    std::thread worker;
+
+    /// Don't allow copying.
+    LsmIndex(const LsmIndex &);
+
+    /// Don't allow assignment.
+    void operator=(const LsmIndex &);
+
+    /** Add a record to the buffer.
+     */
+    bool add(PackedCode code, Id id, bool tombstone);
+
+    /** Write the buffer out as a run.  Must be called with mutex held,
+     *  which is released while the buffer is sorted.
+     */
+    void flush_locked(std::unique_lock<std::mutex> & lock);
+
+    /** Get the size tier of a run: 0 for runs no bigger than the buffer, and
+     *  one more for each factor of max_runs above that.
+     */
+    unsigned tier(size_t size) const;
+
+    /** Find the first of the runs to merge next.  Must be called with mutex
+     *  held.
+     *
+     *  @returns The index of the oldest run which, with all the runs newer
+     *           than it, is to be merged, or the number of runs if no merge
+     *           is needed.
+     */
+    size_t merge_start_locked() const;
+
+    /** Merge the runs chosen by merge_start_locked(), or all the runs.
+     *
+     *  @param all If true, merge all the current runs into one.
+     */
+    void merge_runs(bool all);
+
+    /** Body of the background thread.
+     */
+    void background();
+
+  public:
+    /** Create an empty index.
+     *
+     *  @param buffer_size The number of records to hold in memory before
+     *                     writing a sorted run.
+     *  @param max_runs The number of runs of similar size which are merged
+     *                  into one.  Inserts and deletes wait for merges while
+     *                  there are more than eight times this many runs.
+     *  @param background If true, merge runs on a background thread;
+     *                    otherwise merge them in the thread which flushes
+     *                    the buffer.
+     */
+    LsmIndex(size_t buffer_size = 16384, size_t max_runs = 4,
+	     bool background = true);
+
+    /** Destroy the index, stopping the background thread.
+     */
+    ~LsmIndex();
+
+    /** Insert a (code, ID) pair.
+     *
+     *  @returns false if @a code isn't a valid packed code.
+     */
+    bool insert(PackedCode code, Id id) { return add(code, id, false); }
+
+    /** Delete a (code, ID) pair.
+     *
+     *  To move a point, delete it at its old code and insert it at the new
+     *  one.
+     *
+     *  @returns false if @a code isn't a valid packed code.
+     */
+    bool erase(PackedCode code, Id id) { return add(code, id, true); }
+
+    /** Write any buffered records out as a run.
+     */
+    void flush();
+
+    /** Flush the buffer and merge all runs into one, before returning.
+     */
+    void compact();
+
+    /** Find the pairs whose codes lie inside a bounding box.
+     *
+     *  The box has the same meaning as for DecoderWithBoundingBox.
+     *
+     *  @param lat1 The latitude of the southern edge of the bounding box.
+     *  @param lon1 The longitude of the western edge of the bounding box.
+     *  @param lat2 The latitude of the northern edge of the bounding box.
+     *  @param lon2 The longitude of the eastern edge of the bounding box.
+     *  @param results A vector to append the pairs found to, in ascending
+     *                 order.
+     */
+    void box_query(double lat1, double lon1, double lat2, double lon2,
+		   std::vector<std::pair<PackedCode, Id> > & results) const;
+
+    /** Get the number of sorted runs.
+     */
+    size_t run_count() const;
+
+    /** Get the number of bytes of memory used by the buffer and runs.
+     *
+     *  A run being merged is counted once it has replaced the runs it was
+     *  merged from; the runs replaced are freed once no query is using
+     *  them.
+     */
+    size_t memory_used() const;
+};
+
+}
+
+#endif /* GEOENCODE_INCLUDED_LSMINDEX_H */
@@ -0,0 +1,157 @@
+/** @file lsmindex_test.cc
+ * @brief Tests for the updatable index of encoded points.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "lsmindex.h"
+#include "testutils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+
+using namespace std;
+using GeoEncode::PackedCode;
+
+typedef vector<pair<PackedCode, GeoEncode::LsmIndex::Id> > Results;
+
+/** Check a box query against the expected contents of the index.
+ */
+static bool
+check_query(const GeoEncode::LsmIndex & index,
+	    const map<GeoEncode::LsmIndex::Id, PackedCode> & points,
+	    double lat1, double lon1, double lat2, double lon2)
+{
+    GeoEncode::DecoderWithBoundingBox bb(lat1, lon1, lat2, lon2);
+    Results expected;
+    map<GeoEncode::LsmIndex::Id, PackedCode>::const_iterator i;
+    for (i = points.begin(); i != points.end(); ++i) {
+	string encoded;
+	GeoEncode::unpack(i->second, encoded);
+	double lat, lon;
+	if (bb.decode(encoded, lat, lon)) {
+	    expected.push_back(make_pair(i->second, i->first));
+	}
+    }
+    sort(expected.begin(), expected.end());
+
+    Results results;
+    index.box_query(lat1, lon1, lat2, lon2, results);
+    if (results != expected) {
+	fprintf(stderr, "box_query(%g,%g,%g,%g) found %zu points, "
+		"expected %zu\n",
+		lat1, lon1, lat2, lon2, results.size(), expected.size());
+	return false;
+    }
+    return true;
+}
+
+/** Move points around at random, checking queries as they move.
+ */
+static bool
+check_moving(bool background, double spread)
+{
+    GeoEncode::LsmIndex index(100, 3, background);
+    map<GeoEncode::LsmIndex::Id, PackedCode> points;
+    bool ok = true;
+    for (int step = 0; step != 20000; ++step) {
+	GeoEncode::LsmIndex::Id id = random() % 2000;
+	map<GeoEncode::LsmIndex::Id, PackedCode>::iterator i = points.find(id);
+	if (i != points.end()) {
+	    index.erase(i->second, id);
+	    if (random() % 10 == 0) {
+		points.erase(i);
+		continue;
+	    }
+	}
+	PackedCode code = random_code_near(51.5, -0.1, spread);
+	index.insert(code, id);
+	points[id] = code;
+
+	if (step % 1000 == 999) {
+	    // Merges keep the number of runs under the limit on updates.
+	    if (index.run_count() > 3 * 8) {
+		fprintf(stderr, "%zu runs after %d steps\n",
+			index.run_count(), step + 1);
+		ok = false;
+	    }
+	    ok &= check_query(index, points, -90, 0, 90, 359.999);
+	    ok &= check_query(index, points, -10, 350, 60, 20);
+	    ok &= check_query(index, points, 20, 100, 90, 120);
+	    ok &= check_query(index, points, 51.4, -0.5, 51.6, 0.2);
+	    if (!ok) break;
+	}
+    }
+
+    index.compact();
+    if (index.run_count() != 1) {
+	fprintf(stderr, "%zu runs after compact\n", index.run_count());
+	ok = false;
+    }
+    ok &= check_query(index, points, -90, 0, 90, 359.999);
+    ok &= check_query(index, points, 51.45, -0.2, 51.55, 0);
+    return ok;
+}
+
+int main() {
+    bool ok = true;
+
+    ok &= check_moving(false, 180);
+    ok &= check_moving(false, 1);
+    ok &= check_moving(true, 180);
+    ok &= check_moving(true, 1);
+
+    // Buffered records are visible before they are flushed, and a later
+    // delete hides an earlier insert.
+    {
+	GeoEncode::LsmIndex index;
+	PackedCode code = random_code_near(51.5, -0.1, 1);
+	index.insert(code, 7);
+	index.insert(code, 8);
+	index.erase(code, 7);
+	Results results;
+	index.box_query(50, -2, 53, 2, results);
+	if (results.size() != 1 || results[0].second != 8) {
+	    fprintf(stderr, "buffered records not found\n");
+	    ok = false;
+	}
+	if (index.run_count() != 0) {
+	    fprintf(stderr, "buffer was flushed early\n");
+	    ok = false;
+	}
+	index.flush();
+	results.clear();
+	index.box_query(50, -2, 53, 2, results);
+	if (results.size() != 1 || results[0].second != 8) {
+	    fprintf(stderr, "flushed records not found\n");
+	    ok = false;
+	}
+	if (index.insert(PackedCode(1) << 48, 1)) {
+	    fprintf(stderr, "out of range code was accepted\n");
+	    ok = false;
+	}
+    }
+
+    return ok ? 0 : 1;
+}
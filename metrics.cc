@@ -0,0 +1,234 @@
+/** @file metrics.cc
+ * @brief Call counts and latency histograms for the library's operations.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#ifndef GEOENCODE_NO_METRICS
+# include "shards.h"
+#endif
+
+using namespace std;
+using GeoEncode::METRIC_BUCKETS;
+using GeoEncode::METRIC_OP_COUNT;
+
+/// The names of the operations, indexed by MetricOp.
+static const char * const op_names[] = {
+    "column_build",
+    "column_decode",
+    "column_filter",
+    "corridor_filter",
+    "unit_vectors",
+    "distance_batch",
+    "sort_keys",
+    "neighbours_batch",
+    "box_cover",
+    "hash_find_batch",
+    "rtree_query",
+    "lsm_query",
+    "knn_search",
+    "distance_join",
+    "dbscan",
+    "sample_aggregate"
+};
+
+/// The values kept for each operation, before its histogram.
+enum {
+    FIELD_CALLS,
+    FIELD_POINTS,
+    FIELD_BYTES,
+    FIELD_TOTAL_NS,
+    FIELD_HISTOGRAM,
+    FIELD_COUNT = FIELD_HISTOGRAM + METRIC_BUCKETS
+};
+
+void
+GeoEncode::metric_bucket_bounds(unsigned bucket, uint64_t & lo_ref,
+				uint64_t & hi_ref)
+{
+    if (bucket < 4) {
+	lo_ref = hi_ref = bucket;
+	return;
+    }
+    unsigned shift = bucket / 4 - 1;
+    uint64_t sub = bucket % 4;
+    lo_ref = (4 + sub) << shift;
+    // This wraps to the largest value for the last bucket.
+    hi_ref = ((5 + sub) << shift) - 1;
+}
+
+double
+GeoEncode::OpMetrics::percentile(double fraction) const
+{
+    if (calls == 0 || histogram.empty()) {
+	return 0;
+    }
+    uint64_t target = uint64_t(ceil(fraction * calls));
+    if (target == 0) target = 1;
+    uint64_t seen = 0;
+    for (unsigned b = 0; b != histogram.size(); ++b) {
+	seen += histogram[b];
+	if (seen >= target) {
+	    uint64_t lo, hi;
+	    metric_bucket_bounds(b, lo, hi);
+	    return b < 4 ? double(lo) : sqrt(double(lo) * (double(hi) + 1));
+	}
+    }
+    return 0;
+}
+
+#ifndef GEOENCODE_NO_METRICS
+
+/// Find the histogram bucket for a latency.
+static inline unsigned
+bucket_of(uint64_t ns)
+{
+    if (ns < 4) return unsigned(ns);
+    unsigned e = 63 - __builtin_clzll(ns);
+    return 4 * (e - 1) + unsigned((ns >> (e - 2)) & 3);
+}
+
+namespace {
+
+/// Distinguishes the metrics' shards from those of other counters.
+struct MetricsTag { };
+
+}
+
+/// The values kept for each thread, FIELD_COUNT for each operation.
+typedef GeoEncode::ShardedCounters<MetricsTag, METRIC_OP_COUNT * FIELD_COUNT>
+	Metrics;
+
+void
+GeoEncode::record_metric(MetricOp op, uint64_t ns, uint64_t points,
+			 uint64_t bytes)
+{
+    Metrics::Shard & s = Metrics::local();
+    size_t base = size_t(op) * FIELD_COUNT;
+    s.add(base + FIELD_CALLS, 1);
+    s.add(base + FIELD_POINTS, points);
+    s.add(base + FIELD_BYTES, bytes);
+    s.add(base + FIELD_TOTAL_NS, ns);
+    s.add(base + FIELD_HISTOGRAM + bucket_of(ns), 1);
+}
+
+#endif
+
+bool
+GeoEncode::get_metrics(vector<OpMetrics> & result)
+{
+    result.clear();
+#ifndef GEOENCODE_NO_METRICS
+    uint64_t totals[METRIC_OP_COUNT][FIELD_COUNT];
+    Metrics::totals(&totals[0][0]);
+    result.resize(METRIC_OP_COUNT);
+    for (unsigned op = 0; op != METRIC_OP_COUNT; ++op) {
+	OpMetrics & m = result[op];
+	m.name = op_names[op];
+	m.calls = totals[op][FIELD_CALLS];
+	m.points = totals[op][FIELD_POINTS];
+	m.bytes = totals[op][FIELD_BYTES];
+	m.total_ns = totals[op][FIELD_TOTAL_NS];
+	m.histogram.assign(&totals[op][FIELD_HISTOGRAM],
+			   &totals[op][FIELD_HISTOGRAM] + METRIC_BUCKETS);
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+size_t
+GeoEncode::metrics_memory_used()
+{
+#ifndef GEOENCODE_NO_METRICS
+    return Metrics::memory_used();
+#else
+    return 0;
+#endif
+}
+
+void
+GeoEncode::reset_metrics()
+{
+#ifndef GEOENCODE_NO_METRICS
+    Metrics::reset();
+#endif
+}
+
+string
+GeoEncode::metrics_to_text()
+{
+    vector<OpMetrics> metrics;
+    get_metrics(metrics);
+    string out;
+    char buf[160];
+    snprintf(buf, sizeof(buf), "%-18s %10s %12s %14s %10s %10s %10s %10s\n",
+	     "operation", "calls", "points", "bytes", "mean_ns", "p50_ns",
+	     "p99_ns", "p999_ns");
+    out += buf;
+    for (size_t i = 0; i != metrics.size(); ++i) {
+	const OpMetrics & m = metrics[i];
+	if (m.calls == 0) continue;
+	snprintf(buf, sizeof(buf),
+		 "%-18s %10llu %12llu %14llu %10.0f %10.0f %10.0f %10.0f\n",
+		 m.name, (unsigned long long)m.calls,
+		 (unsigned long long)m.points, (unsigned long long)m.bytes,
+		 double(m.total_ns) / m.calls, m.percentile(0.5),
+		 m.percentile(0.99), m.percentile(0.999));
+	out += buf;
+    }
+    return out;
+}
+
+string
+GeoEncode::metrics_to_json()
+{
+    vector<OpMetrics> metrics;
+    get_metrics(metrics);
+    string out = "{\"metrics\": [";
+    bool first = true;
+    char buf[320];
+    for (size_t i = 0; i != metrics.size(); ++i) {
+	const OpMetrics & m = metrics[i];
+	if (m.calls == 0) continue;
+	snprintf(buf, sizeof(buf),
+		 "%s\n  {\"name\": \"%s\", \"calls\": %llu, \"points\": %llu, "
+		 "\"bytes\": %llu, \"total_ns\": %llu, \"mean_ns\": %.1f, "
+		 "\"p50_ns\": %.1f, \"p99_ns\": %.1f, \"p999_ns\": %.1f}",
+		 first ? "" : ",", m.name, (unsigned long long)m.calls,
+		 (unsigned long long)m.points, (unsigned long long)m.bytes,
+		 (unsigned long long)m.total_ns,
+		 double(m.total_ns) / m.calls, m.percentile(0.5),
+		 m.percentile(0.99), m.percentile(0.999));
+	out += buf;
+	first = false;
+    }
+    out += first ? "]}\n" : "\n]}\n";
+    return out;
+}
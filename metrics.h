@@ -0,0 +1,234 @@
+/** @file metrics.h
+ * @brief Call counts and latency histograms for the library's operations.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GEOENCODE_INCLUDED_METRICS_H
+#define GEOENCODE_INCLUDED_METRICS_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#ifndef GEOENCODE_NO_METRICS
+# include <chrono>
+#endif
+
+namespace GeoEncode {
+
+/** The operations which metrics are kept for.
+ *
+ *  These are the entry points which work on many codes at once, so the cost
+ *  of recording a call is small beside the call itself.  Calls which one
+ *  operation makes to another, such as knn_search() calling
+ *  chord_squared_batch() for each cell, are recorded for both.
+ */
+enum MetricOp {
+    METRIC_COLUMN_BUILD,
+    METRIC_COLUMN_DECODE,
+    METRIC_COLUMN_FILTER,
+    METRIC_CORRIDOR_FILTER,
+    METRIC_UNIT_VECTORS,
+    METRIC_DISTANCE_BATCH,
+    METRIC_SORT_KEYS,
+    METRIC_NEIGHBOURS_BATCH,
+    METRIC_BOX_COVER,
+    METRIC_HASH_FIND_BATCH,
+    METRIC_RTREE_QUERY,
+    METRIC_LSM_QUERY,
+    METRIC_KNN_SEARCH,
+    METRIC_DISTANCE_JOIN,
+    METRIC_DBSCAN,
+    METRIC_SAMPLE_AGGREGATE,
+    METRIC_OP_COUNT
+};
+
+/** The number of buckets in a latency histogram.
+ *
+ *  Latencies below 4 ns each have a bucket; above that, each power of two
+ *  is split into 4 buckets, so a bucket's bounds differ by at most 25%.
+ */
+const unsigned METRIC_BUCKETS = 252;
+
+/** The metrics of one operation.
+ */
+struct OpMetrics {
+    /** The name of the operation, such as "column_filter".
+     */
+    const char * name;
+
+    /** The number of calls.
+     */
+    uint64_t calls;
+
+    /** The number of codes given to the calls, or for index queries, the
+     *  number of results returned.
+     */
+    uint64_t points;
+
+    /** The number of bytes of code data read by the calls.
+     */
+    uint64_t bytes;
+
+    /** The total time spent in the calls, in nanoseconds.
+     */
+    uint64_t total_ns;
+
+    /** The number of calls taking each range of time; see
+     *  metric_bucket_bounds().
+     */
+    std::vector<uint64_t> histogram;
+
+    OpMetrics() : name(""), calls(0), points(0), bytes(0), total_ns(0) { }
+
+    /** Estimate a percentile of the latency from the histogram.
+     *
+     *  @param fraction The percentile as a fraction, such as 0.99.
+     *
+     *  @returns The latency in nanoseconds, as the geometric middle of the
+     *           bucket holding the percentile, or 0 if there were no calls.
+     */
+    double percentile(double fraction) const;
+};
+
+/** Get the range of latencies counted in a histogram bucket.
+ *
+ *  @param bucket The bucket, from 0 to METRIC_BUCKETS - 1.
+ *  @param lo_ref A reference to return the smallest latency in, in ns.
+ *  @param hi_ref A reference to return the largest latency in, in ns.
+ */
+extern void
+metric_bucket_bounds(unsigned bucket, uint64_t & lo_ref, uint64_t & hi_ref);
+
+/** Get the metrics of every operation.
+ *
+ *  Each thread records its calls in its own shard, so recording needs no
+ *  locks or atomic read-modify-write operations; this adds up the shards,
+ *  including those of threads which have exited.
+ *
+ *  @param result A vector to replace the contents of with the metrics since
+ *                the last reset_metrics(), indexed by MetricOp.
+ *
+ *  @returns false if the library was compiled with GEOENCODE_NO_METRICS,
+ *           in which case no metrics are recorded and @a result is empty.
+ */
+extern bool
+get_metrics(std::vector<OpMetrics> & result);
+
+/** Restart the metrics from zero.
+ */
+extern void
+reset_metrics();
+
+/** Format the metrics of the operations which have been called as a text
+ *  table, with a line for each operation giving its counts and its mean,
+ *  median, 99th and 99.9th percentile latencies.
+ */
+extern std::string
+metrics_to_text();
+
+/** Format the metrics of the operations which have been called as JSON.
+ *
+ *  The result is an object with a "metrics" member holding an array with
+ *  an object for each operation, with "name", "calls", "points", "bytes",
+ *  "total_ns", "mean_ns", "p50_ns", "p99_ns" and "p999_ns" members.
+ */
+extern std::string
+metrics_to_json();
+
+/** Get the number of bytes of memory used to record metrics.
+ *
+ *  Each thread which has recorded a call has a shard holding its counts
+ *  and histograms, of the same size; this is the total for the threads
+ *  running, or 0 if the library was compiled with GEOENCODE_NO_METRICS.
+ */
+extern size_t
+metrics_memory_used();
+
+#ifndef GEOENCODE_NO_METRICS
+
+/** Record a call to an operation.
+ *
+ *  @param op The operation.
+ *  @param ns The time the call took in nanoseconds.
+ *  @param points The number of codes the call processed.
+ *  @param bytes The number of bytes of code data the call read.
+ */
+extern void
+record_metric(MetricOp op, uint64_t ns, uint64_t points, uint64_t bytes);
+
+/** Time a call to an operation, recording it when it goes out of scope.
+ *
+ *  This is used by the library's entry points.  With GEOENCODE_NO_METRICS
+ *  defined, it is an empty class whose calls compile to nothing.
+ */
+class MetricScope {
+    MetricOp op;
+
+    std::chrono::steady_clock::time_point start;
+
+    uint64_t points;
+
+    uint64_t bytes;
+
+    /// Copying isn't allowed.
+    MetricScope(const MetricScope &);
+
+    /// Assignment isn't allowed.
+    void operator=(const MetricScope &);
+
+  public:
+    MetricScope(MetricOp op_, uint64_t points_ = 0, uint64_t bytes_ = 0)
+	: op(op_), start(std::chrono::steady_clock::now()),
+	  points(points_), bytes(bytes_) { }
+
+    ~MetricScope() {
+	std::chrono::nanoseconds elapsed =
+		std::chrono::steady_clock::now() - start;
+	record_metric(op, uint64_t(elapsed.count()), points, bytes);
+    }
+
+    /** Add to the number of codes processed.
+     */
+    void add_points(uint64_t n) { points += n; }
+
+    /** Add to the number of bytes read.
+     */
+    void add_bytes(uint64_t n) { bytes += n; }
+};
+
+#else
+
+class MetricScope {
+  public:
+    MetricScope(MetricOp, uint64_t = 0, uint64_t = 0) { }
+
+    void add_points(uint64_t) { }
+
+    void add_bytes(uint64_t) { }
+};
+
+#endif
+
+}
+
+#endif /* GEOENCODE_INCLUDED_METRICS_H */
@@ -0,0 +1,289 @@
+/** @file metrics_test.cc
+ * @brief Tests for the metrics registry.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "metrics.h"
+#include "codecolumn.h"
+#include "knn.h"
+#include "sortkey.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+using namespace std;
+using GeoEncode::OpMetrics;
+using GeoEncode::PackedCode;
+
+/** Check that the histogram buckets cover every latency, in order, and
+ *  that each is at most 25% wider than its lower bound.
+ */
+static bool
+check_bucket_bounds()
+{
+    uint64_t next = 0;
+    for (unsigned b = 0; b != GeoEncode::METRIC_BUCKETS; ++b) {
+	uint64_t lo, hi;
+	GeoEncode::metric_bucket_bounds(b, lo, hi);
+	if (lo != next || hi < lo) {
+	    fprintf(stderr, "bucket %u is [%llu, %llu], expected to start at "
+		    "%llu\n", b, (unsigned long long)lo,
+		    (unsigned long long)hi, (unsigned long long)next);
+	    return false;
+	}
+	if (b >= 4 && double(hi - lo + 1) > 0.25 * lo) {
+	    fprintf(stderr, "bucket %u is [%llu, %llu], which is too wide\n",
+		    b, (unsigned long long)lo, (unsigned long long)hi);
+	    return false;
+	}
+	next = hi + 1;
+    }
+    if (next != 0) {
+	fprintf(stderr, "the last bucket ends at %llu\n",
+		(unsigned long long)(next - 1));
+	return false;
+    }
+    return true;
+}
+
+/** Check percentiles calculated from a histogram.
+ */
+static bool
+check_percentile()
+{
+    OpMetrics m;
+    if (m.percentile(0.5) != 0) {
+	fprintf(stderr, "percentile of no calls isn't 0\n");
+	return false;
+    }
+    // 990 calls taking 2ns and 10 calls in the bucket holding 1000ns.
+    m.histogram.assign(GeoEncode::METRIC_BUCKETS, 0);
+    m.histogram[2] = 990;
+    unsigned slow = 0;
+    uint64_t lo, hi;
+    do {
+	GeoEncode::metric_bucket_bounds(++slow, lo, hi);
+    } while (hi < 1000);
+    m.histogram[slow] = 10;
+    m.calls = 1000;
+
+    bool ok = true;
+    if (m.percentile(0.5) != 2 || m.percentile(0.99) != 2) {
+	fprintf(stderr, "p50 %g and p99 %g, expected 2\n",
+		m.percentile(0.5), m.percentile(0.99));
+	ok = false;
+    }
+    double p999 = m.percentile(0.999);
+    if (p999 < lo || p999 > hi + 1) {
+	fprintf(stderr, "p999 %g isn't in [%llu, %llu]\n", p999,
+		(unsigned long long)lo, (unsigned long long)hi);
+	ok = false;
+    }
+    return ok;
+}
+
+#ifndef GEOENCODE_NO_METRICS
+
+/// Find the metrics of an operation by name.
+static const OpMetrics *
+find_op(const vector<OpMetrics> & metrics, const char * name)
+{
+    for (size_t i = 0; i != metrics.size(); ++i) {
+	if (strcmp(metrics[i].name, name) == 0) {
+	    return &metrics[i];
+	}
+    }
+    return NULL;
+}
+
+/** Check the calls and points recorded for an operation.
+ */
+static bool
+check_op(const char * name, uint64_t calls, uint64_t points)
+{
+    vector<OpMetrics> metrics;
+    GeoEncode::get_metrics(metrics);
+    const OpMetrics * m = find_op(metrics, name);
+    if (!m) {
+	fprintf(stderr, "no metrics for %s\n", name);
+	return false;
+    }
+    uint64_t histogram_calls = 0;
+    for (size_t b = 0; b != m->histogram.size(); ++b) {
+	histogram_calls += m->histogram[b];
+    }
+    if (m->calls != calls || m->points != points ||
+	histogram_calls != calls) {
+	fprintf(stderr, "%s: %llu calls (%llu in histogram) and %llu points, "
+		"expected %llu and %llu\n", name,
+		(unsigned long long)m->calls,
+		(unsigned long long)histogram_calls,
+		(unsigned long long)m->points, (unsigned long long)calls,
+		(unsigned long long)points);
+	return false;
+    }
+    return true;
+}
+
+/** Check the metrics recorded by the library's entry points, and that
+ *  reset_metrics() clears them.
+ */
+static bool
+check_hooks()
+{
+    vector<PackedCode> codes;
+    for (unsigned i = 0; i != 1000; ++i) {
+	string encoded;
+	GeoEncode::encode(-60 + i * 0.1, i * 0.3, encoded);
+	codes.push_back(GeoEncode::pack(encoded.data()));
+    }
+    sort(codes.begin(), codes.end());
+
+    GeoEncode::reset_metrics();
+    GeoEncode::CodeColumn column;
+    column.build(codes);
+    GeoEncode::DecoderWithBoundingBox bbox(-10, 0, 10, 360);
+    vector<size_t> positions;
+    column.filter(bbox, positions);
+    column.filter(bbox, positions);
+    GeoEncode::DistanceKeyMaker key_maker(0, 0);
+    string keys;
+    key_maker.make_keys(&codes[0], codes.size(), keys);
+
+    bool ok = true;
+    ok &= check_op("column_build", 1, 1000);
+    ok &= check_op("column_filter", 2, 2000);
+    // make_keys() works in blocks, but is only recorded once.
+    ok &= check_op("sort_keys", 1, 1000);
+    ok &= check_op("column_decode", 0, 0);
+
+    vector<OpMetrics> metrics;
+    GeoEncode::get_metrics(metrics);
+    const OpMetrics * filter = find_op(metrics, "column_filter");
+    if (filter && (filter->bytes == 0 ||
+		   filter->bytes > column.compressed_size() * 2)) {
+	fprintf(stderr, "column_filter read %llu bytes of a %zu byte column\n",
+		(unsigned long long)filter->bytes, column.compressed_size());
+	ok = false;
+    }
+
+    // A k-nearest-neighbour search only reads the codes near the point.
+    vector<pair<double, size_t> > nearest;
+    GeoEncode::knn_search(&codes[0], codes.size(), 0, 180, 5, nearest);
+    GeoEncode::get_metrics(metrics);
+    const OpMetrics * knn = find_op(metrics, "knn_search");
+    if (knn && (knn->bytes < 5 * sizeof(PackedCode) ||
+		knn->bytes >= codes.size() * sizeof(PackedCode) / 10)) {
+	fprintf(stderr, "knn_search read %llu bytes of %zu codes\n",
+		(unsigned long long)knn->bytes, codes.size());
+	ok = false;
+    }
+
+    string text = GeoEncode::metrics_to_text();
+    string json = GeoEncode::metrics_to_json();
+    if (text.find("column_filter") == string::npos ||
+	text.find("column_decode") != string::npos) {
+	fprintf(stderr, "unexpected text output:\n%s", text.c_str());
+	ok = false;
+    }
+    if (json.find("\"name\": \"column_filter\", \"calls\": 2, "
+		  "\"points\": 2000") == string::npos) {
+	fprintf(stderr, "unexpected JSON output:\n%s", json.c_str());
+	ok = false;
+    }
+
+    GeoEncode::reset_metrics();
+    ok &= check_op("column_filter", 0, 0);
+    column.filter(bbox, positions);
+    ok &= check_op("column_filter", 1, 1000);
+    return ok;
+}
+
+/// Record calls from a thread, which then exits.
+static void
+record_calls(unsigned calls)
+{
+    for (unsigned i = 0; i != calls; ++i) {
+	GeoEncode::record_metric(GeoEncode::METRIC_DBSCAN, i, 10, 60);
+    }
+}
+
+/** Check that calls from several threads are all counted, including those
+ *  of threads which have exited.
+ */
+static bool
+check_threads()
+{
+    GeoEncode::reset_metrics();
+    thread t1(record_calls, 100);
+    thread t2(record_calls, 200);
+    record_calls(50);
+    t1.join();
+    t2.join();
+    // The main thread's shard is still live; the others have been retired.
+    bool ok = check_op("dbscan", 350, 3500);
+
+    vector<OpMetrics> metrics;
+    GeoEncode::get_metrics(metrics);
+    const OpMetrics * m = find_op(metrics, "dbscan");
+    if (m && (m->bytes != 350 * 60 || m->histogram[3] != 3)) {
+	fprintf(stderr, "dbscan: %llu bytes and %llu calls taking 3ns\n",
+		(unsigned long long)m->bytes,
+		(unsigned long long)m->histogram[3]);
+	ok = false;
+    }
+    return ok;
+}
+
+#endif
+
+int main() {
+    bool ok = true;
+    ok &= check_bucket_bounds();
+    ok &= check_percentile();
+
+    vector<OpMetrics> metrics;
+#ifndef GEOENCODE_NO_METRICS
+    if (!GeoEncode::get_metrics(metrics) ||
+	metrics.size() != GeoEncode::METRIC_OP_COUNT) {
+	fprintf(stderr, "get_metrics() failed\n");
+	return 1;
+    }
+    ok &= check_hooks();
+    ok &= check_threads();
+#else
+    if (GeoEncode::get_metrics(metrics) || !metrics.empty()) {
+	fprintf(stderr, "get_metrics() succeeded without metrics\n");
+	ok = false;
+    }
+    if (GeoEncode::metrics_to_json() != "{\"metrics\": []}\n") {
+	fprintf(stderr, "unexpected JSON output without metrics\n");
+	ok = false;
+    }
+#endif
+
+    return ok ? 0 : 1;
+}
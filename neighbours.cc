@@ -0,0 +1,369 @@
+/** @file neighbours.cc
+ * @brief Enumerating the cells around a cell of the encoding.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "neighbours.h"
+
+#include "distance.h"
+#include "metrics.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using GeoEncode::PackedCode;
+
+/// Radians per degree.
+static const double RADIANS = M_PI / 180.0;
+
+double
+GeoEncode::cell_height(unsigned len)
+{
+    return cell_size_16ths(len) * (RADIANS / 57600) * EARTH_RADIUS;
+}
+
+bool
+GeoEncode::cell_position(PackedCode prefix, unsigned len,
+			 int & row_ref, int & col_ref)
+{
+    if (rare(len < 2 || len > 6)) {
+	return false;
+    }
+    unsigned shift = (6 - len) * 8;
+    prefix = (prefix >> shift) << shift;
+    if (rare((prefix >> 32) >= 181 * 360)) {
+	return false;
+    }
+    // Nibbles holding groups of 4 minutes or whole seconds only go up to 14.
+    unsigned groups = (prefix >> 24) & 0xff;
+    if (len > 2 && rare(((groups >> 4) == 15 || (groups & 15) == 15))) {
+	return false;
+    }
+    unsigned seconds = (prefix >> 8) & 0xff;
+    if (len > 4 && rare(((seconds >> 4) == 15 || (seconds & 15) == 15))) {
+	return false;
+    }
+
+    int lat_16ths, lon_16ths;
+    decode_16ths(prefix, lat_16ths, lon_16ths);
+    int size = cell_size_16ths(len);
+    int row = lat_16ths / size;
+    if (rare(row > cell_pole_row(len))) {
+	return false;
+    }
+    row_ref = row;
+    // Any longitude given with the north pole is the pole's cell.
+    col_ref = row == cell_pole_row(len) ? 0 : lon_16ths / size;
+    return true;
+}
+
+/** Get the part of the code for a cell which depends on its row.
+ *
+ *  The fields of a code for latitude and longitude occupy separate bits,
+ *  except in the first two bytes which hold lat_deg + lon_deg * 181, so a
+ *  code is the sum of a part for its row and a part for its column.  This
+ *  lets the codes for a block of cells be found with one encoding for each
+ *  row and each column, rather than one for each cell.
+ */
+static inline PackedCode
+row_part(unsigned len, long row)
+{
+    return GeoEncode::encode_16ths(int(row) * GeoEncode::cell_size_16ths(len),
+				   0);
+}
+
+/// Get the part of the code for a cell which depends on its column.
+static inline PackedCode
+column_part(unsigned len, long col)
+{
+    return GeoEncode::encode_16ths(0,
+				   int(col) * GeoEncode::cell_size_16ths(len));
+}
+
+/// Order two codes, without branching.
+static inline void
+order(PackedCode & a, PackedCode & b)
+{
+    PackedCode lo = a < b ? a : b;
+    PackedCode hi = a < b ? b : a;
+    a = lo;
+    b = hi;
+}
+
+/** Sort 8 codes, as found for the 8-neighbourhood away from the poles.
+ *
+ *  This uses Batcher's 19 comparator sorting network, which avoids the
+ *  unpredictable branches of an insertion sort.
+ */
+static void
+sort8(PackedCode * c)
+{
+    static const unsigned char network[19][2] = {
+	{0, 1}, {2, 3}, {4, 5}, {6, 7},
+	{0, 2}, {1, 3}, {4, 6}, {5, 7},
+	{1, 2}, {5, 6}, {0, 4}, {3, 7},
+	{1, 5}, {2, 6},
+	{1, 4}, {3, 6},
+	{2, 4}, {3, 5},
+	{3, 4}
+    };
+    for (int i = 0; i != 19; ++i) {
+	order(c[network[i][0]], c[network[i][1]]);
+    }
+}
+
+/** Append the cells in a block of rows and columns around a cell.
+ *
+ *  @param len The length of the prefixes.
+ *  @param row The row of the cell.
+ *  @param col The column of the cell.
+ *  @param row_steps The number of rows either side of the cell.
+ *  @param col_steps The number of columns either side of the cell.
+ *  @param result A vector to append the first codes of the cells to, in
+ *                ascending order.
+ */
+static void
+add_neighbours(unsigned len, int row, int col,
+	       unsigned row_steps, unsigned col_steps,
+	       vector<PackedCode> & result)
+{
+    const int pole_row = GeoEncode::cell_pole_row(len);
+    const long columns = GeoEncode::cell_columns(len);
+    // Beyond this many steps every row has been reached.
+    long steps = min(long(row_steps), 2L * pole_row);
+    size_t start = result.size();
+
+    if (row == pole_row) {
+	// The north pole touches every cell of the row below it.
+	for (long r = max(0L, pole_row - steps); r != pole_row; ++r) {
+	    PackedCode row_code = row_part(len, r);
+	    for (long c = 0; c != columns; ++c) {
+		result.push_back(row_code + column_part(len, c));
+	    }
+	}
+	sort(result.begin() + start, result.end());
+	return;
+    }
+    if (row == 0 && col == 0) {
+	// The south pole is encoded at longitude 0, in this cell, and touches
+	// every cell of its row.  The rest of the cell's block follows.
+	for (long r = 0; r != min(steps, long(pole_row)); ++r) {
+	    PackedCode row_code = row_part(len, r);
+	    for (long c = 0; c != columns; ++c) {
+		result.push_back(row_code + column_part(len, c));
+	    }
+	}
+    }
+
+    // The columns in the block, and the ones opposite them over a pole.
+    long first_col = col - long(col_steps);
+    long count = 2 * long(col_steps) + 1;
+    bool wrapped = count >= columns;
+    if (wrapped) {
+	first_col = 0;
+	count = columns;
+    }
+    PackedCode local[2][16];
+    vector<PackedCode> buffer;
+    PackedCode * near = local[0];
+    PackedCode * far = local[1];
+    if (count > 16) {
+	buffer.resize(count * 2);
+	near = &buffer[0];
+	far = near + count;
+    }
+    bool near_pole = row - steps < 0 || row + steps >= pole_row;
+    long u = first_col % columns;
+    if (u < 0) u += columns;
+    long self = -1;
+    for (long i = 0; i != count; ++i) {
+	near[i] = column_part(len, u);
+	if (u == col) self = i;
+	if (near_pole) {
+	    far[i] = column_part(len, (u + columns / 2) % columns);
+	}
+	if (++u == columns) u = 0;
+    }
+
+    for (long r = row - steps; r <= row + steps; ++r) {
+	long t = r;
+	const PackedCode * parts = near;
+	if (t < 0) {
+	    // Over the south pole, to the opposite side.
+	    t = -1 - t;
+	    parts = far;
+	} else if (t >= pole_row) {
+	    // Over the north pole, to the opposite side.
+	    t = 2L * pole_row - 1 - t;
+	    parts = far;
+	}
+	// Steps which go right over the earth only reach rows already seen.
+	t = max(0L, min(t, long(pole_row - 1)));
+	PackedCode row_code = row_part(len, t);
+	for (long i = 0; i != count; ++i) {
+	    if (t != row || i != self || parts != near) {
+		result.push_back(row_code + parts[i]);
+	    }
+	}
+    }
+    if (row + steps >= pole_row) {
+	result.push_back(GeoEncode::cell_at(len, pole_row, 0));
+    }
+    if (row - steps < 0) {
+	// The cell holding the south pole.
+	result.push_back(GeoEncode::cell_at(len, 0, 0));
+    }
+
+    if (result.size() - start == 8) {
+	sort8(&result[start]);
+    } else if (result.size() - start <= 16) {
+	// Insertion sort is quickest for the usual small neighbourhoods.
+	for (size_t i = start + 1; i < result.size(); ++i) {
+	    PackedCode code = result[i];
+	    size_t j = i;
+	    while (j != start && result[j - 1] > code) {
+		result[j] = result[j - 1];
+		--j;
+	    }
+	    result[j] = code;
+	}
+    } else {
+	sort(result.begin() + start, result.end());
+    }
+    if (near_pole || wrapped) {
+	// Blocks which cross a pole or wrap round can meet themselves.
+	vector<PackedCode>::iterator end = unique(result.begin() + start,
+						  result.end());
+	result.erase(end, result.end());
+	PackedCode self_code = GeoEncode::cell_at(len, row, col);
+	end = remove(result.begin() + start, result.end(), self_code);
+	result.erase(end, result.end());
+    }
+}
+
+bool
+GeoEncode::cell_neighbours(PackedCode prefix, unsigned len, unsigned k,
+			   vector<PackedCode> & result)
+{
+    int row, col;
+    if (!cell_position(prefix, len, row, col)) {
+	return false;
+    }
+    if (k != 0) {
+	add_neighbours(len, row, col, k, k, result);
+    }
+    return true;
+}
+
+bool
+GeoEncode::cell_neighbours(PackedCode prefix, unsigned len,
+			   unsigned row_steps, unsigned col_steps,
+			   vector<PackedCode> & result)
+{
+    int row, col;
+    if (!cell_position(prefix, len, row, col)) {
+	return false;
+    }
+    if (row_steps != 0 || col_steps != 0) {
+	add_neighbours(len, row, col, row_steps, col_steps, result);
+    }
+    return true;
+}
+
+unsigned
+GeoEncode::cells_within_distance(PackedCode prefix, unsigned len,
+				 double distance, size_t max_cells,
+				 vector<PackedCode> & result)
+{
+    int row, col;
+    if (!cell_position(prefix, len, row, col)) {
+	return 0;
+    }
+    CellBounds bounds;
+    cell_bounds(prefix, len, bounds);
+    double angle = min(distance / EARTH_RADIUS, M_PI) / RADIANS;
+    double min_lat = max(-90.0, bounds.min_lat - angle);
+    double max_lat = min(90.0, bounds.max_lat + angle);
+    // How far the box extends in longitude either side of the cell, at the
+    // edge nearest a pole.
+    double margin = 360;
+    if (min_lat > -90 && max_lat < 90) {
+	double cos_max = cos(max(-min_lat, max_lat) * RADIANS);
+	double sin_angle = sin(angle * RADIANS);
+	if (sin_angle < cos_max) {
+	    margin = asin(sin_angle / cos_max) / RADIANS;
+	}
+    }
+
+    unsigned l = len;
+    unsigned row_steps, col_steps;
+    while (true) {
+	double size = double(cell_size_16ths(l)) / 57600;
+	size_t columns = cell_columns(l);
+	row_steps = unsigned(ceil(angle / size));
+	col_steps = margin >= 180 ? unsigned(columns / 2) :
+		unsigned(ceil(margin / size));
+	size_t rows = 2 * size_t(row_steps) + 1;
+	size_t cols = min(2 * size_t(col_steps) + 1, columns);
+	if (l == 2 || rows * cols <= max_cells) break;
+	--l;
+    }
+
+    // The cell of this length holding the cell, which for the north pole
+    // is always in column 0.
+    cell_position(prefix, l, row, col);
+    PackedCode self = cell_at(l, row, col);
+    size_t start = result.size();
+    add_neighbours(l, row, col, row_steps, col_steps, result);
+    result.insert(lower_bound(result.begin() + start, result.end(), self),
+		  self);
+    return l;
+}
+
+bool
+GeoEncode::cell_neighbours_batch(const PackedCode * prefixes, size_t n,
+				 unsigned len, unsigned k,
+				 vector<PackedCode> & result,
+				 vector<size_t> & offsets)
+{
+    MetricScope metric(METRIC_NEIGHBOURS_BATCH, n, n * sizeof(PackedCode));
+    bool ok = true;
+    if (k == 1) {
+	result.reserve(result.size() + n * 8);
+    }
+    offsets.reserve(offsets.size() + n + 1);
+    for (size_t i = 0; i != n; ++i) {
+	offsets.push_back(result.size());
+	int row, col;
+	if (!cell_position(prefixes[i], len, row, col)) {
+	    ok = false;
+	    continue;
+	}
+	if (k != 0) {
+	    add_neighbours(len, row, col, k, k, result);
+	}
+    }
+    offsets.push_back(result.size());
+    return ok;
+}
@@ -0,0 +1,214 @@
+/** @file neighbours.h
+ * @brief Enumerating the cells around a cell of the encoding.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GEOENCODE_INCLUDED_NEIGHBOURS_H
+#define GEOENCODE_INCLUDED_NEIGHBOURS_H
+
+#include "geoencode.h"
+
+#include <vector>
+
+namespace GeoEncode {
+
+/** Get the size of the cells denoted by prefixes of a length.
+ *
+ * @param len The length of the prefixes in bytes (2 to 6).
+ *
+ * @returns The height and width of the cells in 16ths of a second: 57600
+ *          for 1 degree cells, 3840 for 4 minute cells, 240 for 15 second
+ *          cells, 16 for 1 second cells and 1 for full codes.
+ */
+inline int
+cell_size_16ths(unsigned len)
+{
+    static const int sizes[7] = { 0, 0, 57600, 3840, 240, 16, 1 };
+    return sizes[len];
+}
+
+/** Get the height of the cells denoted by prefixes of a length, in metres.
+ */
+extern double
+cell_height(unsigned len);
+
+/** Get the row holding the north pole in the grid of cells of a size.
+ *
+ * Rows 0 to cell_pole_row(len) - 1 each span the full circle of longitude.
+ * The final row only holds the cell of the north pole, in column 0, since
+ * the pole is always encoded with a longitude of 0.
+ */
+inline int
+cell_pole_row(unsigned len)
+{
+    return 180 * 57600 / cell_size_16ths(len);
+}
+
+/** Get the number of columns in the grid of cells of a size.
+ */
+inline int
+cell_columns(unsigned len)
+{
+    return 360 * 57600 / cell_size_16ths(len);
+}
+
+/** Find the row and column of the cell denoted by a prefix.
+ *
+ * The cells denoted by prefixes of each length form a grid, with row 0 just
+ * north of the south pole and column 0 just east of the meridian.  The
+ * position is found with integer arithmetic on the fields of the code, which
+ * takes care of the carries between degrees, groups of 4 minutes, minutes
+ * and seconds.
+ *
+ * @param prefix The packed code; bytes after the prefix are ignored.
+ * @param len The length of the prefix in bytes (2 to 6).
+ * @param row_ref A reference to a value to return the row in (0 to
+ *                cell_pole_row(len)).
+ * @param col_ref A reference to a value to return the column in (0 to
+ *                cell_columns(len) - 1).
+ *
+ * @returns false if the length is out of range or the prefix can't be the
+ *          start of a valid encoding.
+ */
+extern bool
+cell_position(PackedCode prefix, unsigned len, int & row_ref, int & col_ref);
+
+/** Get the prefix of the cell at a position in the grid.
+ *
+ * This is the inverse of cell_position().
+ *
+ * @param len The length of the prefix in bytes (2 to 6).
+ * @param row The row (0 to cell_pole_row(len)).
+ * @param col The column (0 to cell_columns(len) - 1, and 0 in the row of
+ *            the north pole).
+ *
+ * @returns The first code in the cell, with the bytes after the prefix 0.
+ */
+inline PackedCode
+cell_at(unsigned len, int row, int col)
+{
+    int size = cell_size_16ths(len);
+    return encode_16ths(row * size, col * size);
+}
+
+/** Find the cells within a number of steps of a cell.
+ *
+ * With @a k of 1 this is the 8 cells surrounding the cell, and with larger
+ * @a k the (2k+1) x (2k+1) block of cells centred on it (less the cell
+ * itself), which are the cells any code within k cell heights of the cell
+ * must lie in (and more besides, except near the equator).
+ *
+ * Longitude wraps at 360.  Stepping south from row 0 leads over the south
+ * pole to row 0 on the opposite side of the earth (180 degrees round), and
+ * likewise stepping north from the row below the north pole, so cells near
+ * a pole have their neighbours on both sides of it.  The cell of the north
+ * pole touches every cell in the row below it, so it is a neighbour of all
+ * of them, and all of them are its neighbours: for long prefixes that is a
+ * great many cells.  The south pole is encoded at longitude 0, so it lies in
+ * the cell in row 0 and column 0, which is likewise a neighbour of every
+ * cell in row 0, and has all of them as neighbours.
+ *
+ * @param prefix The packed code; bytes after the prefix are ignored.
+ * @param len The length of the prefix in bytes (2 to 6).
+ * @param k The number of steps (1 for the 8-neighbourhood).
+ * @param result A vector to append the first code of each neighbouring
+ *               cell to (with the bytes after the prefix 0), in ascending
+ *               order and without duplicates.
+ *
+ * @returns false if the length is out of range or the prefix can't be the
+ *          start of a valid encoding, in which case nothing is appended.
+ */
+extern bool
+cell_neighbours(PackedCode prefix, unsigned len, unsigned k,
+		std::vector<PackedCode> & result);
+
+/** Find the cells in a block of rows and columns centred on a cell.
+ *
+ * This is like cell_neighbours() with @a k steps, but allows a different
+ * number of steps in latitude and longitude, since cells away from the
+ * equator are narrower than they are tall.  A block around the north pole's
+ * cell spans the full circle of longitude whatever @a col_steps is.
+ *
+ * @param prefix The packed code; bytes after the prefix are ignored.
+ * @param len The length of the prefix in bytes (2 to 6).
+ * @param row_steps The number of rows either side of the cell.
+ * @param col_steps The number of columns either side of the cell.
+ * @param result A vector to append the first code of each cell in the
+ *               block other than the cell itself to, in ascending order and
+ *               without duplicates.
+ *
+ * @returns false if the length is out of range or the prefix can't be the
+ *          start of a valid encoding, in which case nothing is appended.
+ */
+extern bool
+cell_neighbours(PackedCode prefix, unsigned len,
+		unsigned row_steps, unsigned col_steps,
+		std::vector<PackedCode> & result);
+
+/** Find the cells which might hold codes within a distance of a cell.
+ *
+ * The cell is widened by the distance to a box of latitudes and longitudes,
+ * and the block of rows and columns covering the box is found with
+ * cell_neighbours().  If the block would have more than @a max_cells cells,
+ * which happens near the poles, where the box is widest in longitude, or
+ * when the distance is many cells across, it is made of larger cells.
+ *
+ * @param prefix The packed code; bytes after the prefix are ignored.
+ * @param len The length of the prefix in bytes (2 to 6).
+ * @param distance The distance in metres.
+ * @param max_cells The most cells to find before using larger cells.
+ * @param result A vector to append the first code of each cell in the block
+ *               to, including the one holding the cell itself, in
+ *               ascending order and without duplicates.
+ *
+ * @returns The length of the prefixes of the cells found, which is at most
+ *          @a len, or 0 if the length is out of range or the prefix can't
+ *          be the start of a valid encoding, in which case nothing is
+ *          appended.
+ */
+extern unsigned
+cells_within_distance(PackedCode prefix, unsigned len, double distance,
+		      size_t max_cells, std::vector<PackedCode> & result);
+
+/** Find the cells within a number of steps of each of an array of cells.
+ *
+ * @param prefixes The packed codes; bytes after the prefixes are ignored.
+ * @param n The number of codes.
+ * @param len The length of the prefixes in bytes (2 to 6).
+ * @param k The number of steps (1 for the 8-neighbourhood).
+ * @param result A vector to append the neighbours of each cell to, as for
+ *               cell_neighbours().
+ * @param offsets A vector to append @a n + 1 positions in @a result to: the
+ *                neighbours of prefixes[i] are between offsets i and i + 1
+ *                of those appended.
+ *
+ * @returns false if any of the prefixes was invalid (nothing is appended
+ *          to @a result for those), otherwise true.
+ */
+extern bool
+cell_neighbours_batch(const PackedCode * prefixes, size_t n, unsigned len,
+		      unsigned k, std::vector<PackedCode> & result,
+		      std::vector<size_t> & offsets);
+
+}
+
+#endif /* GEOENCODE_INCLUDED_NEIGHBOURS_H */
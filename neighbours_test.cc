@@ -0,0 +1,414 @@
+/** @file neighbours_test.cc
+ * @brief Tests for enumerating the cells around a cell.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "neighbours.h"
+#include "distance.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+using GeoEncode::PackedCode;
+
+/** Get the prefix of a length of the code for a coordinate.
+ */
+static PackedCode
+prefix_of(double lat, double lon, unsigned len)
+{
+    string encoded;
+    GeoEncode::encode(lat, lon, encoded);
+    unsigned shift = (6 - len) * 8;
+    return (GeoEncode::pack(encoded.data()) >> shift) << shift;
+}
+
+/** Pick a random cell, which may be in any row except the north pole's.
+ */
+static PackedCode
+random_cell(unsigned len)
+{
+    int row = random() % GeoEncode::cell_pole_row(len);
+    int col = random() % GeoEncode::cell_columns(len);
+    return GeoEncode::cell_at(len, row, col);
+}
+
+/** Check the 8-neighbourhood of a cell away from the poles against the
+ *  cells found by decoding its centre, offsetting it and encoding again.
+ */
+static bool
+check_against_offsets(PackedCode prefix, unsigned len)
+{
+    GeoEncode::CellBounds cell;
+    if (!GeoEncode::cell_bounds(prefix, len, cell)) {
+	fprintf(stderr, "cell_bounds failed for %llx/%u\n",
+		(unsigned long long)prefix, len);
+	return false;
+    }
+    double lat = (cell.min_lat + cell.max_lat) / 2;
+    double lon = (cell.min_lon + cell.max_lon) / 2;
+    double size = cell.max_lat - cell.min_lat;
+    vector<PackedCode> expected;
+    for (int dlat = -1; dlat <= 1; ++dlat) {
+	for (int dlon = -1; dlon <= 1; ++dlon) {
+	    if (dlat == 0 && dlon == 0) continue;
+	    double l = fmod(lon + dlon * size + 360, 360);
+	    expected.push_back(prefix_of(lat + dlat * size, l, len));
+	}
+    }
+    sort(expected.begin(), expected.end());
+
+    vector<PackedCode> got;
+    if (!GeoEncode::cell_neighbours(prefix, len, 1, got) || got != expected) {
+	fprintf(stderr, "neighbours of %llx/%u wrong (%zu found)\n",
+		(unsigned long long)prefix, len, got.size());
+	return false;
+    }
+    return true;
+}
+
+/** Check that a cell is a neighbour of each of its neighbours.
+ */
+static bool
+check_symmetric(PackedCode prefix, unsigned len, unsigned k)
+{
+    vector<PackedCode> neighbours;
+    GeoEncode::cell_neighbours(prefix, len, k, neighbours);
+    if (!is_sorted(neighbours.begin(), neighbours.end()) ||
+	adjacent_find(neighbours.begin(), neighbours.end()) !=
+	    neighbours.end() ||
+	binary_search(neighbours.begin(), neighbours.end(), prefix)) {
+	fprintf(stderr, "neighbours of %llx/%u not sorted and unique\n",
+		(unsigned long long)prefix, len);
+	return false;
+    }
+    int pole_row = GeoEncode::cell_pole_row(len);
+    PackedCode pole = GeoEncode::cell_at(len, pole_row, 0);
+    PackedCode south_pole = GeoEncode::cell_at(len, 0, 0);
+    for (size_t i = 0; i != neighbours.size(); ++i) {
+	// The poles have too many neighbours to check with small cells.
+	if (len > 3 && (neighbours[i] == pole || neighbours[i] == south_pole)) {
+	    continue;
+	}
+	vector<PackedCode> back;
+	GeoEncode::cell_neighbours(neighbours[i], len, k, back);
+	if (!binary_search(back.begin(), back.end(), prefix)) {
+	    fprintf(stderr, "%llx/%u is a neighbour of %llx but not back\n",
+		    (unsigned long long)neighbours[i], len,
+		    (unsigned long long)prefix);
+	    return false;
+	}
+    }
+    return true;
+}
+
+/** Check the neighbours of a degree cell against an expected list of
+ *  (lat_deg, lon_deg) cells.
+ */
+static bool
+check_degree_cell(int lat_deg, int lon_deg, unsigned k,
+		  const int * expected, size_t n)
+{
+    vector<PackedCode> want;
+    for (size_t i = 0; i != n; ++i) {
+	want.push_back(GeoEncode::cell_at(2, expected[i * 2],
+					  expected[i * 2 + 1]));
+    }
+    sort(want.begin(), want.end());
+    vector<PackedCode> got;
+    GeoEncode::cell_neighbours(GeoEncode::cell_at(2, lat_deg, lon_deg), 2, k,
+			       got);
+    if (got != want) {
+	fprintf(stderr, "neighbours of degree cell %d,%d: %zu found, "
+		"expected %zu\n", lat_deg, lon_deg, got.size(), want.size());
+	return false;
+    }
+    return true;
+}
+
+/** Check that cells_within_distance() finds the cells of random points
+ *  within the distance of a coordinate.
+ */
+static bool
+check_within_distance(double lat, double lon, unsigned len, double distance)
+{
+    PackedCode prefix = prefix_of(lat, lon, len);
+    vector<PackedCode> got;
+    unsigned l = GeoEncode::cells_within_distance(prefix, len, distance, 256,
+						  got);
+    if (l < 2 || l > len || !is_sorted(got.begin(), got.end()) ||
+	adjacent_find(got.begin(), got.end()) != got.end()) {
+	fprintf(stderr, "cells within %g m of %.9g,%.9g/%u: %zu cells of "
+		"length %u\n", distance, lat, lon, len, got.size(), l);
+	return false;
+    }
+    double phi = lat * M_PI / 180;
+    for (int i = 0; i != 200; ++i) {
+	// A point at a random distance and bearing.
+	double delta = distance * random() / RAND_MAX /
+		GeoEncode::EARTH_RADIUS;
+	double theta = 2 * M_PI * random() / RAND_MAX;
+	double phi2 = asin(sin(phi) * cos(delta) +
+			   cos(phi) * sin(delta) * cos(theta));
+	double dlon = atan2(sin(theta) * sin(delta) * cos(phi),
+			    cos(delta) - sin(phi) * sin(phi2));
+	double lat2 = phi2 * 180 / M_PI;
+	double lon2 = fmod(lon + dlon * 180 / M_PI + 720, 360);
+	PackedCode cell = prefix_of(lat2, lon2, l);
+	if (!binary_search(got.begin(), got.end(), cell)) {
+	    fprintf(stderr, "cells within %g m of %.9g,%.9g/%u miss "
+		    "%.9g,%.9g\n", distance, lat, lon, len, lat2, lon2);
+	    return false;
+	}
+    }
+    return true;
+}
+
+int main() {
+    bool ok = true;
+
+    // Positions round trip, with the carries between fields.
+    for (unsigned len = 2; len <= 6; ++len) {
+	for (int i = 0; i != 10000; ++i) {
+	    PackedCode prefix = random_cell(len);
+	    int row, col;
+	    if (!GeoEncode::cell_position(prefix, len, row, col) ||
+		GeoEncode::cell_at(len, row, col) != prefix) {
+		fprintf(stderr, "cell_position(%llx, %u) failed\n",
+			(unsigned long long)prefix, len);
+		ok = false;
+		break;
+	    }
+	}
+    }
+
+    // Cells away from the poles, including ones on the edges of degrees,
+    // groups of 4 minutes, minutes and 15 second groups.
+    for (unsigned len = 2; len <= 5; ++len) {
+	int size = GeoEncode::cell_size_16ths(len);
+	for (int i = 0; i != 2000; ++i) {
+	    int row = 1 + random() % (GeoEncode::cell_pole_row(len) - 2);
+	    int col = random() % GeoEncode::cell_columns(len);
+	    ok &= check_against_offsets(GeoEncode::cell_at(len, row, col), len);
+	}
+	int edges[] = { 57600, 3840, 960, 240, 16 };
+	for (int e = 0; e != 5; ++e) {
+	    if (edges[e] < size) continue;
+	    int row = (45 * 57600 + edges[e]) / size;
+	    int col = (100 * 57600 + edges[e]) / size;
+	    for (int d = -1; d <= 0; ++d) {
+		for (int d2 = -1; d2 <= 0; ++d2) {
+		    PackedCode p = GeoEncode::cell_at(len, row + d, col + d2);
+		    ok &= check_against_offsets(p, len);
+		}
+	    }
+	}
+	// Longitude wrap at 360.
+	int columns = GeoEncode::cell_columns(len);
+	ok &= check_against_offsets(GeoEncode::cell_at(len, 100, 0), len);
+	ok &= check_against_offsets(GeoEncode::cell_at(len, 100, columns - 1),
+				    len);
+    }
+
+    // The poles, with degree cells.
+    {
+	// Next to the south pole: the row above, over the pole, and the
+	// cell holding the pole.
+	static const int south[] = {
+	    0, 9, 0, 11, 1, 9, 1, 10, 1, 11, 0, 189, 0, 190, 0, 191, 0, 0
+	};
+	ok &= check_degree_cell(0, 10, 1, south, 9);
+	// The cell holding the south pole touches the whole of its row.
+	vector<int> south_pole;
+	for (int lon = 1; lon != 360; ++lon) {
+	    south_pole.push_back(0);
+	    south_pole.push_back(lon);
+	}
+	static const int above[] = { 1, 359, 1, 0, 1, 1 };
+	south_pole.insert(south_pole.end(), above, above + 6);
+	ok &= check_degree_cell(0, 0, 1, &south_pole[0], 362);
+	// Whatever longitude it is given with, the south pole is in the
+	// 8-neighbourhood of the cells of row 0.
+	for (unsigned len = 2; len <= 5; ++len) {
+	    int size = GeoEncode::cell_size_16ths(len);
+	    PackedCode cell = GeoEncode::cell_at(len, 0, 100 * 57600 / size);
+	    PackedCode pole = prefix_of(-90, 100, len);
+	    vector<PackedCode> got;
+	    GeoEncode::cell_neighbours(cell, len, 1, got);
+	    if (!binary_search(got.begin(), got.end(), pole)) {
+		fprintf(stderr, "south pole not next to row 0 at length %u\n",
+			len);
+		ok = false;
+	    }
+	}
+	// Next to the north pole, at the antimeridian: the row below, over
+	// the pole, and the pole's own cell.
+	static const int north[] = {
+	    179, 358, 179, 0, 178, 358, 178, 359, 178, 0,
+	    179, 178, 179, 179, 179, 180, 180, 0
+	};
+	ok &= check_degree_cell(179, 359, 1, north, 9);
+	// The north pole touches the whole row below it.
+	vector<int> pole;
+	for (int lon = 0; lon != 360; ++lon) {
+	    pole.push_back(179);
+	    pole.push_back(lon);
+	}
+	ok &= check_degree_cell(180, 0, 1, &pole[0], 360);
+	// A longitude given with the north pole is ignored.
+	vector<PackedCode> a, b;
+	GeoEncode::cell_neighbours(GeoEncode::cell_at(2, 180, 0), 2, 1, a);
+	GeoEncode::cell_neighbours(GeoEncode::cell_at(2, 180, 77), 2, 1, b);
+	if (a != b) {
+	    fprintf(stderr, "north pole neighbours depend on longitude\n");
+	    ok = false;
+	}
+    }
+
+    // Neighbourhoods are symmetric, near the poles and everywhere else.
+    for (unsigned len = 2; len <= 5; ++len) {
+	int pole_row = GeoEncode::cell_pole_row(len);
+	for (unsigned k = 1; k <= 3; ++k) {
+	    for (int i = 0; i != 20; ++i) {
+		ok &= check_symmetric(random_cell(len), len, k);
+		int row = (i % 2) ? random() % 3 : pole_row - 1 - random() % 3;
+		int col = random() % GeoEncode::cell_columns(len);
+		ok &= check_symmetric(GeoEncode::cell_at(len, row, col), len, k);
+	    }
+	}
+	if (len <= 3) {
+	    ok &= check_symmetric(GeoEncode::cell_at(len, pole_row, 0), len, 1);
+	    ok &= check_symmetric(GeoEncode::cell_at(len, 0, 0), len, 1);
+	}
+    }
+
+    // k-rings away from the poles are square, and a ring so big it wraps
+    // holds every column once.
+    for (unsigned k = 0; k <= 5; ++k) {
+	vector<PackedCode> got;
+	PackedCode p = GeoEncode::cell_at(4, 40000, 123);
+	GeoEncode::cell_neighbours(p, 4, k, got);
+	if (got.size() != (2 * k + 1) * (2 * k + 1) - 1) {
+	    fprintf(stderr, "%zu cells within %u steps\n", got.size(), k);
+	    ok = false;
+	}
+    }
+    {
+	// Blocks with more steps in longitude than latitude.
+	vector<PackedCode> got;
+	PackedCode p = GeoEncode::cell_at(4, 40000, 2);
+	GeoEncode::cell_neighbours(p, 4, 1, 3, got);
+	vector<PackedCode> want;
+	for (int row = 39999; row <= 40001; ++row) {
+	    for (int col = -1; col <= 5; ++col) {
+		if (row == 40000 && col == 2) continue;
+		want.push_back(GeoEncode::cell_at(4, row, (col + 86400) % 86400));
+	    }
+	}
+	sort(want.begin(), want.end());
+	if (got != want) {
+	    fprintf(stderr, "%zu cells in 3 by 7 block\n", got.size());
+	    ok = false;
+	}
+    }
+    {
+	vector<PackedCode> got;
+	GeoEncode::cell_neighbours(GeoEncode::cell_at(2, 90, 0), 2, 200, got);
+	if (got.size() != 180 * 360) {
+	    fprintf(stderr, "%zu cells within 200 degrees\n", got.size());
+	    ok = false;
+	}
+    }
+
+    // The batch version gives the same cells.
+    {
+	vector<PackedCode> prefixes;
+	for (int i = 0; i != 1000; ++i) {
+	    prefixes.push_back(random_cell(3));
+	}
+	prefixes.push_back(PackedCode(0xffff) << 32);
+	vector<PackedCode> result;
+	vector<size_t> offsets;
+	if (GeoEncode::cell_neighbours_batch(&prefixes[0], prefixes.size(), 3,
+					     2, result, offsets) ||
+	    offsets.size() != prefixes.size() + 1) {
+	    fprintf(stderr, "batch didn't report invalid prefix\n");
+	    ok = false;
+	} else {
+	    for (size_t i = 0; i != prefixes.size(); ++i) {
+		vector<PackedCode> one;
+		GeoEncode::cell_neighbours(prefixes[i], 3, 2, one);
+		if (!equal(one.begin(), one.end(), result.begin() + offsets[i]) ||
+		    offsets[i + 1] - offsets[i] != one.size()) {
+		    fprintf(stderr, "batch differs for %llx\n",
+			    (unsigned long long)prefixes[i]);
+		    ok = false;
+		    break;
+		}
+	    }
+	}
+    }
+
+    // Cells within distances, near and far, away from and at the poles and
+    // across the 0/360 boundary.
+    for (unsigned len = 2; len <= 5; ++len) {
+	double height = GeoEncode::cell_height(len);
+	for (int i = 0; i != 50; ++i) {
+	    double lat = ((random() * 180.0) / RAND_MAX) - 90.0;
+	    double lon = ((random() * 360.0) / RAND_MAX);
+	    ok &= check_within_distance(lat, lon, len, height * 0.3);
+	    ok &= check_within_distance(lat, lon, len, height * 3);
+	    ok &= check_within_distance(lat, lon, len, height * 100);
+	}
+	ok &= check_within_distance(89.9999, 10, len, height * 2);
+	ok &= check_within_distance(-89.9999, 200, len, height * 2);
+	ok &= check_within_distance(90, 0, len, height * 2);
+	ok &= check_within_distance(30, 359.99999, len, height * 2);
+    }
+    {
+	vector<PackedCode> got;
+	if (GeoEncode::cells_within_distance(PackedCode(181 * 360) << 32, 2,
+					     1000, 256, got) != 0 ||
+	    !got.empty()) {
+	    fprintf(stderr, "cells within distance of invalid prefix\n");
+	    ok = false;
+	}
+    }
+
+    // Invalid prefixes and lengths.
+    {
+	vector<PackedCode> got;
+	if (GeoEncode::cell_neighbours(PackedCode(181 * 360) << 32, 2, 1, got) ||
+	    GeoEncode::cell_neighbours(PackedCode(0xf0) << 24, 3, 1, got) ||
+	    GeoEncode::cell_neighbours(PackedCode(0x0f) << 8, 5, 1, got) ||
+	    GeoEncode::cell_neighbours(0, 1, 1, got) ||
+	    GeoEncode::cell_neighbours(0, 7, 1, got) || !got.empty()) {
+	    fprintf(stderr, "invalid prefix accepted\n");
+	    ok = false;
+	}
+    }
+
+    return ok ? 0 : 1;
+}
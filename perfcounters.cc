@@ -0,0 +1,199 @@
+/** @file perfcounters.cc
+ * @brief Hardware performance counters for benchmarks.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "perfcounters.h"
+
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+# include <linux/perf_event.h>
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+#endif
+
+using namespace std;
+
+/// The names of the counters.
+static const char * const counter_names[] = {
+    "cycles", "instructions", "branch_misses", "l1d_misses", "llc_misses"
+};
+
+#ifdef __linux__
+
+/// A value read from a counter, with the times used to scale it.
+struct Reading {
+    uint64_t value;
+    uint64_t time_enabled;
+    uint64_t time_running;
+};
+
+/** Open a counter for the calling thread.
+ *
+ *  @returns The file descriptor, or -1 with errno set.
+ */
+static int
+open_counter(uint32_t type, uint64_t config)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+	    PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+/// Read a counter.
+static bool
+read_counter(int fd, Reading & reading)
+{
+    return read(fd, &reading, sizeof(reading)) == ssize_t(sizeof(reading));
+}
+
+#endif
+
+GeoEncode::PerfCounters::PerfCounters()
+{
+    for (unsigned i = 0; i != COUNTER_COUNT; ++i) {
+	fds[i] = -1;
+	totals[i] = 0;
+	start_enabled[i] = start_running[i] = 0;
+    }
+}
+
+GeoEncode::PerfCounters::~PerfCounters()
+{
+#ifdef __linux__
+    for (unsigned i = 0; i != COUNTER_COUNT; ++i) {
+	if (fds[i] != -1) close(fds[i]);
+    }
+#endif
+}
+
+bool
+GeoEncode::PerfCounters::open()
+{
+#ifdef __linux__
+    static const struct { uint32_t type; uint64_t config; } events[] = {
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+	{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+	  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+	  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES }
+    };
+    int first_errno = 0;
+    for (unsigned i = 0; i != COUNTER_COUNT; ++i) {
+	if (fds[i] != -1) continue;
+	fds[i] = open_counter(events[i].type, events[i].config);
+	if (fds[i] == -1 && first_errno == 0) first_errno = errno;
+    }
+    if (any_available()) {
+	return true;
+    }
+    error = "perf_event_open failed: ";
+    error += strerror(first_errno);
+    if (first_errno == EACCES || first_errno == EPERM) {
+	error += " (see /proc/sys/kernel/perf_event_paranoid)";
+    } else if (first_errno == ENOENT || first_errno == ENODEV ||
+	       first_errno == EOPNOTSUPP) {
+	error += " (no hardware counters, as in many virtual machines)";
+    }
+#else
+    error = "performance counters aren't supported on this platform";
+#endif
+    return false;
+}
+
+bool
+GeoEncode::PerfCounters::any_available() const
+{
+    for (unsigned i = 0; i != COUNTER_COUNT; ++i) {
+	if (fds[i] != -1) return true;
+    }
+    return false;
+}
+
+void
+GeoEncode::PerfCounters::reset()
+{
+    for (unsigned i = 0; i != COUNTER_COUNT; ++i) {
+	totals[i] = 0;
+    }
+}
+
+void
+GeoEncode::PerfCounters::start()
+{
+#ifdef __linux__
+    for (unsigned i = 0; i != COUNTER_COUNT; ++i) {
+	if (fds[i] == -1) continue;
+	// Resetting clears the count but not the times, so note those.
+	ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+	Reading reading;
+	if (read_counter(fds[i], reading)) {
+	    start_enabled[i] = reading.time_enabled;
+	    start_running[i] = reading.time_running;
+	}
+    }
+    for (unsigned i = 0; i != COUNTER_COUNT; ++i) {
+	if (fds[i] != -1) ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+void
+GeoEncode::PerfCounters::stop()
+{
+#ifdef __linux__
+    for (unsigned i = 0; i != COUNTER_COUNT; ++i) {
+	if (fds[i] != -1) ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+    for (unsigned i = 0; i != COUNTER_COUNT; ++i) {
+	Reading reading;
+	if (fds[i] == -1 || !read_counter(fds[i], reading)) continue;
+	uint64_t enabled = reading.time_enabled - start_enabled[i];
+	uint64_t running = reading.time_running - start_running[i];
+	double value = double(reading.value);
+	if (running != 0 && running < enabled) {
+	    value *= double(enabled) / running;
+	}
+	totals[i] += value;
+    }
+#endif
+}
+
+const char *
+GeoEncode::PerfCounters::name(Counter counter)
+{
+    return unsigned(counter) < COUNTER_COUNT ? counter_names[counter] : "";
+}
@@ -0,0 +1,137 @@
+/** @file perfcounters.h
+ * @brief Hardware performance counters for benchmarks.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GEOENCODE_INCLUDED_PERFCOUNTERS_H
+#define GEOENCODE_INCLUDED_PERFCOUNTERS_H
+
+#include <string>
+#include <stdint.h>
+
+namespace GeoEncode {
+
+/** Hardware performance counters for the calling thread.
+ *
+ *  On Linux these are read with perf_event_open(2), counting in user space
+ *  only, so they work at the default perf_event_paranoid setting of 2.
+ *  Each counter is opened separately, so one which the processor or a
+ *  virtual machine doesn't support is simply left out.  On other platforms,
+ *  or where the system doesn't permit counting, no counters are available,
+ *  and starting and stopping them does nothing.
+ *
+ *  If the kernel has to multiplex more counters than the processor has, the
+ *  counts are scaled up by the proportion of the time each was running.
+ */
+class PerfCounters {
+  public:
+    /** The events which are counted.
+     */
+    enum Counter {
+	CYCLES,
+	INSTRUCTIONS,
+	BRANCH_MISSES,
+	L1D_MISSES,
+	LLC_MISSES,
+	COUNTER_COUNT
+    };
+
+  private:
+    /** The file descriptor for each counter, or -1 if it isn't open.
+     */
+    int fds[COUNTER_COUNT];
+
+    /** The counts accumulated since the last reset().
+     */
+    double totals[COUNTER_COUNT];
+
+    /** The time enabled and running for each counter when it was last
+     *  started.
+     */
+    uint64_t start_enabled[COUNTER_COUNT], start_running[COUNTER_COUNT];
+
+    /** The reason the counters couldn't be opened.
+     */
+    std::string error;
+
+    /// Copying isn't allowed.
+    PerfCounters(const PerfCounters &);
+
+    /// Assignment isn't allowed.
+    void operator=(const PerfCounters &);
+
+  public:
+    PerfCounters();
+
+    ~PerfCounters();
+
+    /** Open the counters.
+     *
+     *  @returns true if any of the counters could be opened.  If none
+     *           could, get_error() describes why.
+     */
+    bool open();
+
+    /** Check whether a counter is open.
+     */
+    bool available(Counter counter) const {
+	return fds[counter] != -1;
+    }
+
+    /** Check whether any counter is open.
+     */
+    bool any_available() const;
+
+    /** Get the reason the counters couldn't be opened.
+     */
+    const std::string & get_error() const { return error; }
+
+    /** Clear the accumulated counts.
+     */
+    void reset();
+
+    /** Start counting.
+     */
+    void start();
+
+    /** Stop counting, and add the counts since start() to the totals.
+     */
+    void stop();
+
+    /** Get the count accumulated for a counter since reset().
+     *
+     *  @returns false if the counter isn't available.
+     */
+    bool get(Counter counter, double & value) const {
+	if (!available(counter)) return false;
+	value = totals[counter];
+	return true;
+    }
+
+    /** Get a short name for a counter, such as "branch_misses".
+     */
+    static const char * name(Counter counter);
+};
+
+}
+
+#endif /* GEOENCODE_INCLUDED_PERFCOUNTERS_H */
@@ -0,0 +1,467 @@
+/** @file rtree.cc
+ * @brief Static packed R-tree over encoded coordinates.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "rtree.h"
+
+#include "distance.h"
+#include "metrics.h"
+#include "serialise.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+
+using namespace std;
+using GeoEncode::PackedCode;
+
+/// Magic bytes at the start of a serialised tree.
+static const char RTREE_MAGIC[4] = { 'G', 'E', 'R', 'T' };
+
+/// Version of the serialised format.
+static const unsigned RTREE_VERSION = 1;
+
+/// Bytes of bounds stored for each node.
+static const size_t NODE_BYTES = 16;
+
+/// Latitude of the north pole in 16ths of a second.
+static const int NORTH_POLE_16THS = 57600 * 180;
+
+/// Amount to widen node bounds by, in degrees.
+static const double BOUNDS_SLACK = 1e-9;
+
+/// Position of a point along a Hilbert curve filling a 65536 x 65536 grid.
+static uint64_t
+hilbert_index(uint32_t x, uint32_t y)
+{
+    uint64_t d = 0;
+    for (uint32_t s = 1 << 15; s != 0; s >>= 1) {
+	uint32_t rx = (x & s) ? 1 : 0;
+	uint32_t ry = (y & s) ? 1 : 0;
+	d += uint64_t(s) * s * ((3 * rx) ^ ry);
+	if (ry == 0) {
+	    if (rx == 1) {
+		x = 0xffff - x;
+		y = 0xffff - y;
+	    }
+	    swap(x, y);
+	}
+    }
+    return d;
+}
+
+namespace {
+
+/// An entry being sorted into the tree.
+struct Entry {
+    uint64_t hilbert;
+    PackedCode code;
+    size_t index;
+    int lat_16ths;
+    int lon_16ths;
+
+    bool operator<(const Entry & other) const {
+	if (hilbert != other.hilbert) return hilbert < other.hilbert;
+	if (code != other.code) return code < other.code;
+	return index < other.index;
+    }
+};
+
+/// Bounds of a node, in 16ths of a second.
+struct Bounds {
+    int min_lat, min_lon, max_lat, max_lon;
+
+    void set(int lat, int lon) {
+	min_lat = max_lat = lat;
+	min_lon = max_lon = lon;
+    }
+
+    void extend(const Bounds & other) {
+	min_lat = min(min_lat, other.min_lat);
+	min_lon = min(min_lon, other.min_lon);
+	max_lat = max(max_lat, other.max_lat);
+	max_lon = max(max_lon, other.max_lon);
+    }
+};
+
+/// An item on the queue used by knn_query().
+struct QueueItem {
+    double distance;
+    size_t level;
+    size_t index;
+
+    bool operator>(const QueueItem & other) const {
+	return distance > other.distance;
+    }
+};
+
+}
+
+GeoEncode::RTree::RTree()
+	: codes(NULL), nodes(NULL), count(0), node_size(2)
+{
+    level_starts.push_back(0);
+}
+
+bool
+GeoEncode::RTree::build(const PackedCode * input, size_t n,
+			string & result, vector<size_t> * order,
+			unsigned node_size)
+{
+    if (node_size < 2 || node_size > 0xffff) {
+	return false;
+    }
+
+    vector<Entry> entries(n);
+    for (size_t i = 0; i != n; ++i) {
+	Entry & entry = entries[i];
+	if (input[i] >> 48) {
+	    return false;
+	}
+	decode_16ths(input[i], entry.lat_16ths, entry.lon_16ths);
+	if (entry.lat_16ths > NORTH_POLE_16THS ||
+	    entry.lon_16ths >= 57600 * 360) {
+	    return false;
+	}
+	uint32_t x = uint64_t(entry.lon_16ths) * 65536 / (57600 * 360);
+	uint32_t y = uint64_t(entry.lat_16ths) * 65535 / NORTH_POLE_16THS;
+	entry.hilbert = hilbert_index(x, y);
+	entry.code = input[i];
+	entry.index = i;
+    }
+    sort(entries.begin(), entries.end());
+
+    // Build the levels from the bottom up.
+    vector<vector<Bounds> > levels;
+    if (n) {
+	vector<Bounds> level((n + node_size - 1) / node_size);
+	for (size_t i = 0; i != n; ++i) {
+	    Bounds b;
+	    b.set(entries[i].lat_16ths, entries[i].lon_16ths);
+	    if (i % node_size == 0) {
+		level[i / node_size] = b;
+	    } else {
+		level[i / node_size].extend(b);
+	    }
+	}
+	levels.push_back(level);
+	while (levels.back().size() > 1) {
+	    const vector<Bounds> & below = levels.back();
+	    vector<Bounds> above((below.size() + node_size - 1) / node_size);
+	    for (size_t i = 0; i != below.size(); ++i) {
+		if (i % node_size == 0) {
+		    above[i / node_size] = below[i];
+		} else {
+		    above[i / node_size].extend(below[i]);
+		}
+	    }
+	    levels.push_back(above);
+	}
+	reverse(levels.begin(), levels.end());
+    }
+
+    result.append(RTREE_MAGIC, 4);
+    append_uint(result, RTREE_VERSION, 1);
+    append_uint(result, node_size, 2);
+    append_uint(result, n, 8);
+    append_uint(result, levels.size(), 1);
+    for (size_t l = 0; l != levels.size(); ++l) {
+	append_uint(result, levels[l].size(), 8);
+    }
+    for (size_t l = 0; l != levels.size(); ++l) {
+	for (size_t i = 0; i != levels[l].size(); ++i) {
+	    const Bounds & b = levels[l][i];
+	    append_uint(result, uint32_t(b.min_lat), 4);
+	    append_uint(result, uint32_t(b.min_lon), 4);
+	    append_uint(result, uint32_t(b.max_lat), 4);
+	    append_uint(result, uint32_t(b.max_lon), 4);
+	}
+    }
+    for (size_t i = 0; i != n; ++i) {
+	unpack(entries[i].code, result);
+    }
+
+    if (order) {
+	order->resize(n);
+	for (size_t i = 0; i != n; ++i) {
+	    (*order)[i] = entries[i].index;
+	}
+    }
+    return true;
+}
+
+size_t
+GeoEncode::RTree::memory_used() const
+{
+    return sizeof(*this) + level_starts.capacity() * sizeof(size_t) +
+	    level_starts.back() * NODE_BYTES + count * 6;
+}
+
+bool
+GeoEncode::RTree::open(const char * data, size_t len)
+{
+    *this = RTree();
+
+    const char * end = data + len;
+    if (len < 4 || memcmp(data, RTREE_MAGIC, 4) != 0) {
+	return false;
+    }
+    data += 4;
+    uint64_t version, size, n, nlevels;
+    if (!read_uint(data, end, version, 1) || version != RTREE_VERSION ||
+	!read_uint(data, end, size, 2) || size < 2 ||
+	!read_uint(data, end, n, 8) ||
+	!read_uint(data, end, nlevels, 1) || n > len / 6) {
+	return false;
+    }
+
+    if ((n != 0) != (nlevels != 0)) {
+	return false;
+    }
+    vector<uint64_t> sizes(nlevels);
+    for (size_t l = 0; l != nlevels; ++l) {
+	if (!read_uint(data, end, sizes[l], 8)) {
+	    return false;
+	}
+    }
+    // Check that the level sizes are those build() would produce.
+    uint64_t expected = n;
+    for (size_t l = nlevels; l != 0; --l) {
+	expected = (expected + size - 1) / size;
+	if (sizes[l - 1] != expected || (expected == 1) != (l == 1)) {
+	    return false;
+	}
+    }
+    vector<size_t> starts(nlevels + 1);
+    size_t total = 0;
+    for (size_t l = 0; l != nlevels; ++l) {
+	starts[l] = total;
+	total += sizes[l];
+    }
+    starts[nlevels] = total;
+
+    if (uint64_t(end - data) != total * NODE_BYTES + n * 6) {
+	return false;
+    }
+    nodes = data;
+    codes = data + total * NODE_BYTES;
+    count = n;
+    node_size = size;
+    level_starts = starts;
+    return true;
+}
+
+void
+GeoEncode::RTree::children(size_t level, size_t index,
+			   size_t & begin, size_t & end) const
+{
+    size_t limit;
+    if (level + 2 == level_starts.size()) {
+	limit = count;
+    } else {
+	limit = level_starts[level + 2] - level_starts[level + 1];
+    }
+    begin = index * node_size;
+    end = min(limit, begin + node_size);
+}
+
+void
+GeoEncode::RTree::node_bounds_16ths(size_t level, size_t index,
+				    int & min_lat, int & min_lon,
+				    int & max_lat, int & max_lon) const
+{
+    const char * p = nodes + (level_starts[level] + index) * NODE_BYTES;
+    min_lat = int(load_le32(p));
+    min_lon = int(load_le32(p + 4));
+    max_lat = int(load_le32(p + 8));
+    max_lon = int(load_le32(p + 12));
+}
+
+void
+GeoEncode::RTree::node_bounds(size_t level, size_t index,
+			      double & min_lat, double & min_lon,
+			      double & max_lat, double & max_lon) const
+{
+    int lat1, lon1, lat2, lon2;
+    node_bounds_16ths(level, index, lat1, lon1, lat2, lon2);
+    min_lat = lat1 / 57600.0 - 90.0 - BOUNDS_SLACK;
+    max_lat = lat2 / 57600.0 - 90.0 + BOUNDS_SLACK;
+    min_lon = lon1 / 57600.0 - BOUNDS_SLACK;
+    max_lon = lon2 / 57600.0 + BOUNDS_SLACK;
+}
+
+void
+GeoEncode::RTree::box_query(double lat1, double lon1,
+			    double lat2, double lon2,
+			    vector<size_t> & positions) const
+{
+    MetricScope metric(METRIC_RTREE_QUERY);
+    if (count == 0) {
+	return;
+    }
+    DecoderWithBoundingBox bbox(lat1, lon1, lat2, lon2);
+
+    lon1 = fmod(lon1, 360.0);
+    if (lon1 < 0) lon1 += 360;
+    lon2 = fmod(lon2, 360.0);
+    if (lon2 < 0) lon2 += 360;
+    bool wraps = lon1 > lon2;
+    bool south_pole = (lat1 <= -90 + BOUNDS_SLACK);
+    bool north_pole = (lat2 >= 90 - BOUNDS_SLACK);
+
+    size_t leaf_level = level_starts.size() - 2;
+    vector<pair<size_t, size_t> > stack;
+    stack.push_back(make_pair(size_t(0), size_t(0)));
+    while (!stack.empty()) {
+	size_t level = stack.back().first;
+	size_t index = stack.back().second;
+	stack.pop_back();
+
+	double min_lat, min_lon, max_lat, max_lon;
+	node_bounds(level, index, min_lat, min_lon, max_lat, max_lon);
+	if (max_lat < lat1 || min_lat > lat2) {
+	    continue;
+	}
+	// Coordinates at a pole are accepted whatever their longitude.
+	bool pole = (south_pole && min_lat <= -90) ||
+		(north_pole && max_lat >= 90);
+	if (!pole) {
+	    if (wraps ? (max_lon < lon1 && min_lon > lon2)
+		      : (max_lon < lon1 || min_lon > lon2)) {
+		continue;
+	    }
+	}
+
+	size_t begin, end;
+	children(level, index, begin, end);
+	if (level == leaf_level) {
+	    metric.add_bytes((end - begin) * 6);
+	    for (size_t i = begin; i != end; ++i) {
+		double lat, lon;
+		if (bbox.decode(codes + i * 6, 6, lat, lon)) {
+		    positions.push_back(i);
+		    metric.add_points(1);
+		}
+	    }
+	} else {
+	    // Push in reverse, so results come out in leaf order.
+	    for (size_t i = end; i != begin; --i) {
+		stack.push_back(make_pair(level + 1, i - 1));
+	    }
+	}
+    }
+}
+
+void
+GeoEncode::RTree::radius_query(double lat, double lon, double radius,
+			       vector<size_t> & positions) const
+{
+    MetricScope metric(METRIC_RTREE_QUERY);
+    if (count == 0) {
+	return;
+    }
+    size_t leaf_level = level_starts.size() - 2;
+    vector<pair<size_t, size_t> > stack;
+    stack.push_back(make_pair(size_t(0), size_t(0)));
+    while (!stack.empty()) {
+	size_t level = stack.back().first;
+	size_t index = stack.back().second;
+	stack.pop_back();
+
+	double min_lat, min_lon, max_lat, max_lon;
+	node_bounds(level, index, min_lat, min_lon, max_lat, max_lon);
+	if (box_min_distance(lat, lon, min_lat, min_lon,
+			     max_lat, max_lon) > radius) {
+	    continue;
+	}
+
+	size_t begin, end;
+	children(level, index, begin, end);
+	if (level == leaf_level) {
+	    metric.add_bytes((end - begin) * 6);
+	    for (size_t i = begin; i != end; ++i) {
+		double entry_lat, entry_lon;
+		decode(codes + i * 6, 6, entry_lat, entry_lon);
+		if (haversine_distance(lat, lon, entry_lat, entry_lon) <=
+		    radius) {
+		    positions.push_back(i);
+		    metric.add_points(1);
+		}
+	    }
+	} else {
+	    for (size_t i = end; i != begin; --i) {
+		stack.push_back(make_pair(level + 1, i - 1));
+	    }
+	}
+    }
+}
+
+void
+GeoEncode::RTree::knn_query(double lat, double lon, size_t k,
+			    vector<pair<double, size_t> > & result) const
+{
+    MetricScope metric(METRIC_RTREE_QUERY);
+    if (count == 0 || k == 0) {
+	return;
+    }
+    // Items at level level_starts.size() - 1 are leaf entries.
+    size_t entry_level = level_starts.size() - 1;
+    priority_queue<QueueItem, vector<QueueItem>, greater<QueueItem> > queue;
+    QueueItem root = { 0.0, 0, 0 };
+    queue.push(root);
+    size_t found = 0;
+    while (!queue.empty()) {
+	QueueItem item = queue.top();
+	queue.pop();
+	if (item.level == entry_level) {
+	    result.push_back(make_pair(item.distance, item.index));
+	    metric.add_points(1);
+	    if (++found == k) {
+		break;
+	    }
+	    continue;
+	}
+
+	size_t begin, end;
+	children(item.level, item.index, begin, end);
+	for (size_t i = begin; i != end; ++i) {
+	    QueueItem child = { 0.0, item.level + 1, i };
+	    if (child.level == entry_level) {
+		metric.add_bytes(6);
+		double entry_lat, entry_lon;
+		decode(codes + i * 6, 6, entry_lat, entry_lon);
+		child.distance = haversine_distance(lat, lon,
+						    entry_lat, entry_lon);
+	    } else {
+		double min_lat, min_lon, max_lat, max_lon;
+		node_bounds(child.level, i, min_lat, min_lon,
+			    max_lat, max_lon);
+		child.distance = box_min_distance(lat, lon, min_lat, min_lon,
+						  max_lat, max_lon);
+	    }
+	    queue.push(child);
+	}
+    }
+}
@@ -0,0 +1,186 @@
+/** @file rtree.h
+ * @brief Static packed R-tree over encoded coordinates.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GEOENCODE_INCLUDED_RTREE_H
+#define GEOENCODE_INCLUDED_RTREE_H
+
+#include "geoencode.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace GeoEncode {
+
+/** A read-only packed R-tree over encoded coordinates.
+ *
+ *  The tree is bulk-loaded by sorting the coordinates along a Hilbert curve
+ *  and packing them into full nodes, so clustered data produces tight,
+ *  non-overlapping node bounds whatever the shape of a query.
+ *
+ *  The serialised form is a flat buffer containing no pointers: node bounds
+ *  are stored as integral 16ths of a second, the children of a node are
+ *  found from its position in its level, and the leaves hold the 6 byte
+ *  encoded coordinates.  An RTree object is just a view onto such a buffer,
+ *  so the buffer can be mmapped from a file and queried directly.
+ *
+ *  Query results are positions in the tree's leaf order; the order vector
+ *  returned by build() maps these back to the positions of the input codes.
+ */
+class RTree {
+    /** The leaf entries, as 6 byte encoded coordinates.
+     */
+    const char * codes;
+
+    /** The node bounds, level by level starting at the root.
+     */
+    const char * nodes;
+
+    /** Number of leaf entries.
+     */
+    size_t count;
+
+    /** Maximum number of children of each node.
+     */
+    unsigned node_size;
+
+    /** Index in nodes of the first node of each level.
+     *
+     *  This has one more element than there are levels, the last holding
+     *  the total number of nodes.
+     */
+    std::vector<size_t> level_starts;
+
+    /** Find the range of children of a node.
+     */
+    void children(size_t level, size_t index,
+		  size_t & begin, size_t & end) const;
+
+    /** Get the bounds of a node, in degrees.
+     *
+     *  The bounds are widened very slightly, so that rounding in decode()
+     *  can't put a coordinate outside its node.
+     */
+    void node_bounds(size_t level, size_t index,
+		     double & min_lat, double & min_lon,
+		     double & max_lat, double & max_lon) const;
+
+    /** Get the bounds of a node, in 16ths of a second.
+     */
+    void node_bounds_16ths(size_t level, size_t index,
+			   int & min_lat, int & min_lon,
+			   int & max_lat, int & max_lon) const;
+
+  public:
+    /** Create a tree with no entries.
+     */
+    RTree();
+
+    /** Build a serialised tree.
+     *
+     *  @param codes The codes to put in the tree.
+     *  @param n The number of codes.
+     *  @param result The string to append the serialised tree to.
+     *  @param order If non-NULL, this is set to hold, for each position in
+     *               the tree, the index in @a codes of the code stored
+     *               there.
+     *  @param node_size The maximum number of children of each node, which
+     *                   must be between 2 and 65535.
+     *
+     *  @returns true if the tree was built, or false if any of the codes
+     *           weren't valid or @a node_size was out of range, in which
+     *           case @a result is unmodified.
+     */
+    static bool build(const PackedCode * codes, size_t n,
+		      std::string & result,
+		      std::vector<size_t> * order = NULL,
+		      unsigned node_size = 16);
+
+    /** Open a serialised tree.
+     *
+     *  The buffer isn't copied, so it must remain valid (and unmodified)
+     *  while the tree is in use.  It needn't be aligned.
+     *
+     *  @returns false if the buffer doesn't hold a valid tree, in which case
+     *           the tree is left empty.
+     */
+    bool open(const char * data, size_t len);
+
+    /** Get the number of entries in the tree.
+     */
+    size_t size() const { return count; }
+
+    /** Get the number of bytes of memory used by the tree.
+     *
+     *  This includes the nodes and codes of the buffer the tree was opened
+     *  on, although the tree doesn't own them.
+     */
+    size_t memory_used() const;
+
+    /** Get the code stored at a position in the tree.
+     */
+    PackedCode code(size_t position) const {
+	return pack(codes + position * 6);
+    }
+
+    /** Find the entries inside a bounding box.
+     *
+     *  The box has the same meaning as for DecoderWithBoundingBox, and
+     *  exactly the entries which it would accept are returned.
+     *
+     *  @param lat1 The latitude of the southern edge of the bounding box.
+     *  @param lon1 The longitude of the western edge of the bounding box.
+     *  @param lat2 The latitude of the northern edge of the bounding box.
+     *  @param lon2 The longitude of the eastern edge of the bounding box.
+     *  @param positions A vector to append the positions of the entries to.
+     */
+    void box_query(double lat1, double lon1, double lat2, double lon2,
+		   std::vector<size_t> & positions) const;
+
+    /** Find the entries within a distance of a coordinate.
+     *
+     *  @param lat The latitude of the centre.
+     *  @param lon The longitude of the centre.
+     *  @param radius The distance in metres.
+     *  @param positions A vector to append the positions of the entries to.
+     */
+    void radius_query(double lat, double lon, double radius,
+		      std::vector<size_t> & positions) const;
+
+    /** Find the entries nearest to a coordinate.
+     *
+     *  @param lat The latitude of the coordinate.
+     *  @param lon The longitude of the coordinate.
+     *  @param k The number of entries to find.
+     *  @param result A vector to append (distance in metres, position)
+     *                pairs to, nearest first.  Fewer than @a k are appended
+     *                if the tree holds fewer than @a k entries.
+     */
+    void knn_query(double lat, double lon, size_t k,
+		   std::vector<std::pair<double, size_t> > & result) const;
+};
+
+}
+
+#endif /* GEOENCODE_INCLUDED_RTREE_H */
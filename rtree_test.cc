@@ -0,0 +1,272 @@
+/** @file rtree_test.cc
+ * @brief Tests for the packed R-tree.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "rtree.h"
+#include "distance.h"
+#include "testutils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+using GeoEncode::PackedCode;
+
+/** Make codes for random points, either uniform or in a few clusters.
+ */
+static void
+make_codes(size_t n, bool clustered, vector<PackedCode> & codes)
+{
+    codes.clear();
+    for (size_t i = 0; i != n; ++i) {
+	double lat, lon;
+	if (clustered) {
+	    static const double centres[][2] = {
+		{ 51.5, -0.1 }, { 40.7, -74.0 }, { -33.9, 151.2 },
+		{ 0.0, 179.9 }, { 89.9, 10.0 }
+	    };
+	    const double * c = centres[random() % 5];
+	    lat = c[0] + ((random() * 0.4) / RAND_MAX) - 0.2;
+	    lon = c[1] + ((random() * 0.4) / RAND_MAX) - 0.2;
+	    if (lat > 90) lat = 90;
+	} else {
+	    lat = ((random() * 180.0) / RAND_MAX) - 90.0;
+	    lon = ((random() * 360.0) / RAND_MAX);
+	}
+	if (random() % 500 == 0) {
+	    lat = (random() % 2) ? 90 : -90;
+	}
+	codes.push_back(pack_coord(lat, lon));
+    }
+}
+
+/** Check a box query against the bounding box decoder.
+ */
+static bool
+check_box(const GeoEncode::RTree & tree, const vector<PackedCode> & codes,
+	  const vector<size_t> & order,
+	  double lat1, double lon1, double lat2, double lon2)
+{
+    GeoEncode::DecoderWithBoundingBox bb(lat1, lon1, lat2, lon2);
+    vector<size_t> expected;
+    for (size_t i = 0; i != codes.size(); ++i) {
+	string encoded;
+	GeoEncode::unpack(codes[i], encoded);
+	double lat, lon;
+	if (bb.decode(encoded, lat, lon)) {
+	    expected.push_back(i);
+	}
+    }
+    vector<size_t> positions;
+    tree.box_query(lat1, lon1, lat2, lon2, positions);
+    vector<size_t> got;
+    for (size_t i = 0; i != positions.size(); ++i) {
+	got.push_back(order[positions[i]]);
+    }
+    sort(got.begin(), got.end());
+    if (got != expected) {
+	fprintf(stderr, "box_query(%g,%g,%g,%g) found %zu, expected %zu\n",
+		lat1, lon1, lat2, lon2, got.size(), expected.size());
+	return false;
+    }
+    return true;
+}
+
+/** Check radius and nearest neighbour queries against brute force.
+ */
+static bool
+check_distance(const GeoEncode::RTree & tree,
+	       const vector<PackedCode> & codes,
+	       const vector<size_t> & order,
+	       double lat, double lon, double radius, size_t k)
+{
+    vector<double> distances;
+    vector<size_t> expected;
+    for (size_t i = 0; i != codes.size(); ++i) {
+	string encoded;
+	GeoEncode::unpack(codes[i], encoded);
+	double p_lat, p_lon;
+	GeoEncode::decode(encoded, p_lat, p_lon);
+	double d = GeoEncode::haversine_distance(lat, lon, p_lat, p_lon);
+	distances.push_back(d);
+	if (d <= radius) {
+	    expected.push_back(i);
+	}
+    }
+
+    vector<size_t> positions;
+    tree.radius_query(lat, lon, radius, positions);
+    vector<size_t> got;
+    for (size_t i = 0; i != positions.size(); ++i) {
+	got.push_back(order[positions[i]]);
+    }
+    sort(got.begin(), got.end());
+    if (got != expected) {
+	fprintf(stderr, "radius_query(%g,%g,%g) found %zu, expected %zu\n",
+		lat, lon, radius, got.size(), expected.size());
+	return false;
+    }
+
+    sort(distances.begin(), distances.end());
+    vector<pair<double, size_t> > nearest;
+    tree.knn_query(lat, lon, k, nearest);
+    if (nearest.size() != min(k, codes.size())) {
+	fprintf(stderr, "knn_query(%g,%g,%zu) returned %zu results\n",
+		lat, lon, k, nearest.size());
+	return false;
+    }
+    for (size_t i = 0; i != nearest.size(); ++i) {
+	double d = distances[i];
+	if (nearest[i].first != d) {
+	    fprintf(stderr, "knn_query(%g,%g,%zu): result %zu at %.10g, "
+		    "expected %.10g\n", lat, lon, k, i, nearest[i].first, d);
+	    return false;
+	}
+	string encoded;
+	GeoEncode::unpack(tree.code(nearest[i].second), encoded);
+	double p_lat, p_lon;
+	GeoEncode::decode(encoded, p_lat, p_lon);
+	if (GeoEncode::haversine_distance(lat, lon, p_lat, p_lon) != d) {
+	    fprintf(stderr, "knn_query returned wrong distance\n");
+	    return false;
+	}
+    }
+    return true;
+}
+
+int main() {
+    bool ok = true;
+
+    for (int clustered = 0; clustered != 2; ++clustered) {
+	unsigned node_sizes[] = { 2, 5, 16, 64 };
+	for (size_t s = 0; s != 4; ++s) {
+	    vector<PackedCode> codes;
+	    make_codes(s == 0 ? 3000 : 20000, clustered, codes);
+	    string serialised;
+	    vector<size_t> order;
+	    if (!GeoEncode::RTree::build(&codes[0], codes.size(), serialised,
+					 &order, node_sizes[s])) {
+		fprintf(stderr, "build failed\n");
+		return 1;
+	    }
+
+	    // Query from a copy in a separately allocated buffer, as if
+	    // it had been mmapped.
+	    char * buffer = new char[serialised.size()];
+	    memcpy(buffer, serialised.data(), serialised.size());
+	    GeoEncode::RTree tree;
+	    if (!tree.open(buffer, serialised.size()) ||
+		tree.size() != codes.size()) {
+		fprintf(stderr, "open failed\n");
+		return 1;
+	    }
+	    for (size_t i = 0; i != codes.size(); ++i) {
+		if (tree.code(i) != codes[order[i]]) {
+		    fprintf(stderr, "order doesn't match tree contents\n");
+		    ok = false;
+		    break;
+		}
+	    }
+	    // The tree's memory is mostly the buffer, less its header.
+	    if (tree.memory_used() > serialised.size() + 1024 ||
+		tree.memory_used() < codes.size() * 6) {
+		fprintf(stderr, "tree of %zu bytes uses %zu bytes of memory\n",
+			serialised.size(), tree.memory_used());
+		ok = false;
+	    }
+
+	    ok &= check_box(tree, codes, order, -90, -60, 10, 50);
+	    ok &= check_box(tree, codes, order, -10, 350, 10, 5);
+	    ok &= check_box(tree, codes, order, 51.4, -0.3, 51.6, 0.1);
+	    ok &= check_box(tree, codes, order, -1, 179, 1, -179);
+	    ok &= check_box(tree, codes, order, 80, 100, 90, 120);
+	    for (int i = 0; i != 30; ++i) {
+		double lat1 = ((random() * 180.0) / RAND_MAX) - 90.0;
+		double lat2 = lat1 + ((random() * 30.0) / RAND_MAX);
+		if (lat2 > 90 || random() % 10 == 0) lat2 = 90;
+		if (random() % 10 == 0) lat1 = -90;
+		double lon1 = ((random() * 720.0) / RAND_MAX) - 360.0;
+		double lon2 = lon1 + ((random() * 60.0) / RAND_MAX);
+		ok &= check_box(tree, codes, order, lat1, lon1, lat2, lon2);
+	    }
+
+	    ok &= check_distance(tree, codes, order, 51.5, -0.1, 5000, 10);
+	    ok &= check_distance(tree, codes, order, 0, 180, 30000, 10);
+	    ok &= check_distance(tree, codes, order, 90, 0, 100000, 5);
+	    ok &= check_distance(tree, codes, order, -90, 0, 2000000, 3);
+	    for (int i = 0; i != 30; ++i) {
+		double lat = ((random() * 180.0) / RAND_MAX) - 90.0;
+		double lon = ((random() * 360.0) / RAND_MAX);
+		ok &= check_distance(tree, codes, order, lat, lon,
+				     (random() * 2000000.0) / RAND_MAX,
+				     1 + random() % 50);
+	    }
+
+	    // Truncated buffers are rejected.
+	    GeoEncode::RTree tree2;
+	    if (tree2.open(buffer, serialised.size() - 1) ||
+		tree2.open(buffer + 1, serialised.size() - 1)) {
+		fprintf(stderr, "open of truncated tree succeeded\n");
+		ok = false;
+	    }
+	    delete [] buffer;
+	}
+    }
+
+    // An empty tree.
+    {
+	string serialised;
+	GeoEncode::RTree tree;
+	if (!GeoEncode::RTree::build(NULL, 0, serialised) ||
+	    !tree.open(serialised.data(), serialised.size()) ||
+	    tree.size() != 0) {
+	    fprintf(stderr, "empty tree failed\n");
+	    ok = false;
+	}
+	vector<size_t> positions;
+	tree.box_query(-90, 0, 90, 360, positions);
+	vector<pair<double, size_t> > nearest;
+	tree.knn_query(0, 0, 10, nearest);
+	if (!positions.empty() || !nearest.empty()) {
+	    fprintf(stderr, "empty tree returned results\n");
+	    ok = false;
+	}
+    }
+
+    // Invalid codes are rejected.
+    {
+	PackedCode bad = PackedCode(1) << 48;
+	string serialised;
+	if (GeoEncode::RTree::build(&bad, 1, serialised) ||
+	    !serialised.empty()) {
+	    fprintf(stderr, "invalid code was accepted\n");
+	    ok = false;
+	}
+    }
+
+    return ok ? 0 : 1;
+}
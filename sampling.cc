@@ -0,0 +1,590 @@
+/** @file sampling.cc
+ * @brief Approximate aggregates over regions from stratified samples.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "sampling.h"
+
+#include "metrics.h"
+#include "splitmix.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using GeoEncode::AggregateEstimate;
+using GeoEncode::AggregateRegion;
+using GeoEncode::CellBounds;
+using GeoEncode::PackedCode;
+
+/// Margin in degrees by which a cell must clear an edge to be classified.
+static const double EDGE_MARGIN = 1e-9;
+
+/// Mask for the 3 byte prefix of a packed code.
+static const PackedCode CELL_MASK = PackedCode(0xffffff) << 24;
+
+/// Mask for the 2 byte prefix of a packed code.
+static const PackedCode DEGREE_MASK = PackedCode(0xffff) << 32;
+
+/** A source of random numbers for choosing samples.
+ *
+ *  This uses splitmix64(), like the benchmark workloads, so a seed chooses
+ *  the same sample on every platform.
+ */
+class SampleRandom {
+    uint64_t state;
+
+  public:
+    explicit SampleRandom(uint64_t seed) : state(seed) { }
+
+    /// A uniform integer in [0, n).
+    uint64_t below(uint64_t n) {
+	double u = GeoEncode::unit_interval(GeoEncode::splitmix64(state));
+	return uint64_t(u * n);
+    }
+};
+
+/** Calculate the multiple of the standard error which gives a two-sided
+ *  confidence interval at a level, from the normal distribution.
+ */
+static double
+normal_quantile(double confidence)
+{
+    if (!(confidence > 0)) {
+	return 0;
+    }
+    if (confidence >= 1) {
+	return HUGE_VAL;
+    }
+    // erf(z / sqrt(2)) is the probability of lying within z standard
+    // deviations; it's increasing, so bisect for it.
+    double lo = 0, hi = 40;
+    for (int i = 0; i != 100; ++i) {
+	double mid = (lo + hi) / 2;
+	if (erf(mid * M_SQRT1_2) < confidence) {
+	    lo = mid;
+	} else {
+	    hi = mid;
+	}
+    }
+    return (lo + hi) / 2;
+}
+
+/** Test whether a polygon edge comes within EDGE_MARGIN of a rectangle.
+ *
+ *  This clips the edge to the rectangle, by the Liang-Barsky method.
+ */
+static bool
+edge_meets_rectangle(double y1, double x1, double y2, double x2,
+		     double min_y, double min_x, double max_y, double max_x)
+{
+    min_y -= EDGE_MARGIN;
+    min_x -= EDGE_MARGIN;
+    max_y += EDGE_MARGIN;
+    max_x += EDGE_MARGIN;
+    double dx = x2 - x1, dy = y2 - y1;
+    double p[4] = { -dx, dx, -dy, dy };
+    double q[4] = { x1 - min_x, max_x - x1, y1 - min_y, max_y - y1 };
+    double t0 = 0, t1 = 1;
+    for (int i = 0; i != 4; ++i) {
+	if (p[i] == 0) {
+	    if (q[i] < 0) {
+		return false;
+	    }
+	} else {
+	    double t = q[i] / p[i];
+	    if (p[i] < 0) {
+		t0 = max(t0, t);
+	    } else {
+		t1 = min(t1, t);
+	    }
+	    if (t0 > t1) {
+		return false;
+	    }
+	}
+    }
+    return true;
+}
+
+/** Move a longitude into [base, base + 360) by adding or subtracting 360.
+ */
+static double
+wrap_longitude(double lon, double base)
+{
+    while (lon < base) {
+	lon += 360;
+    }
+    while (lon >= base + 360) {
+	lon -= 360;
+    }
+    return lon;
+}
+
+/** Test whether a point is inside a polygon, by the even-odd rule.
+ *
+ *  This counts the edges crossed by a ray eastwards from the point.
+ */
+static bool
+point_in_polygon(const vector<pair<double, double> > & vertices,
+		 double lat, double lon)
+{
+    bool inside = false;
+    size_t j = vertices.size() - 1;
+    for (size_t i = 0; i != vertices.size(); j = i++) {
+	double lat_i = vertices[i].first, lon_i = vertices[i].second;
+	double lat_j = vertices[j].first, lon_j = vertices[j].second;
+	if ((lat_i > lat) != (lat_j > lat) &&
+	    lon < lon_i + (lat - lat_i) * (lon_j - lon_i) / (lat_j - lat_i)) {
+	    inside = !inside;
+	}
+    }
+    return inside;
+}
+
+GeoEncode::AggregateRegion::AggregateRegion(double lat1, double lon1_,
+					    double lat2, double lon2_)
+	: decoder(lat1, lon1_, lat2, lon2_),
+	  min_lat(lat1), max_lat(lat2), lon1(fmod(lon1_, 360.0)),
+	  lon2(fmod(lon2_, 360.0)), base_lon(0)
+{
+    // Wrap longitudes to [0,360), as DecoderWithBoundingBox does.
+    if (lon1 < 0) {
+	lon1 += 360;
+    }
+    if (lon2 < 0) {
+	lon2 += 360;
+    }
+}
+
+GeoEncode::AggregateRegion::AggregateRegion(
+	const vector<pair<double, double> > & polygon)
+	: decoder(1, 0, -1, 0), min_lat(1), max_lat(-1), lon1(0), lon2(0),
+	  base_lon(0)
+{
+    if (polygon.size() < 3) {
+	// The decoder's box is empty, so nothing is in the region.
+	return;
+    }
+    vertices = polygon;
+    min_lat = max_lat = polygon[0].first;
+    base_lon = polygon[0].second;
+    double top_lon = base_lon;
+    for (size_t i = 1; i != polygon.size(); ++i) {
+	min_lat = min(min_lat, polygon[i].first);
+	max_lat = max(max_lat, polygon[i].first);
+	base_lon = min(base_lon, polygon[i].second);
+	top_lon = max(top_lon, polygon[i].second);
+    }
+    decoder = DecoderWithBoundingBox(min_lat, base_lon, max_lat, top_lon);
+}
+
+bool
+GeoEncode::AggregateRegion::contains(PackedCode code) const
+{
+    char encoded[6];
+    unpack(code, encoded);
+    double lat, lon;
+    if (!decoder.decode(encoded, 6, lat, lon)) {
+	return false;
+    }
+    if (vertices.empty()) {
+	return true;
+    }
+    return point_in_polygon(vertices, lat, wrap_longitude(lon, base_lon));
+}
+
+AggregateRegion::Overlap
+GeoEncode::AggregateRegion::classify_box(const CellBounds & bounds) const
+{
+    // The decoded coordinates of the cell's codes are in
+    // [min_lat, max_lat) x [min_lon, max_lon) (or exactly 90 in the north
+    // pole's cell), and the box's edges are inclusive.
+    if (bounds.max_lat < min_lat - EDGE_MARGIN ||
+	bounds.min_lat > max_lat + EDGE_MARGIN) {
+	return OUTSIDE;
+    }
+    bool lat_inside = (bounds.min_lat - EDGE_MARGIN >= min_lat &&
+		       bounds.max_lat + EDGE_MARGIN <= max_lat);
+
+    bool lon_inside, lon_outside;
+    if (lon1 > lon2) {
+	// The box crosses the 0/360 boundary.
+	lon_inside = (bounds.min_lon - EDGE_MARGIN >= lon1 ||
+		      bounds.max_lon + EDGE_MARGIN <= lon2);
+	lon_outside = (bounds.min_lon > lon2 + EDGE_MARGIN &&
+		       bounds.max_lon < lon1 - EDGE_MARGIN);
+    } else {
+	lon_inside = (bounds.min_lon - EDGE_MARGIN >= lon1 &&
+		      bounds.max_lon + EDGE_MARGIN <= lon2);
+	lon_outside = (bounds.max_lon < lon1 - EDGE_MARGIN ||
+		       bounds.min_lon > lon2 + EDGE_MARGIN);
+    }
+    if (lat_inside && lon_inside) {
+	return INSIDE;
+    }
+    if (lon_outside && bounds.min_lat != -90 && bounds.min_lat != 90) {
+	// The decoder accepts the poles whatever the longitude, so only
+	// cells which can't hold a pole are outside by longitude.
+	return OUTSIDE;
+    }
+    return PARTIAL;
+}
+
+AggregateRegion::Overlap
+GeoEncode::AggregateRegion::classify_polygon(const CellBounds & bounds) const
+{
+    if (bounds.max_lat < min_lat - EDGE_MARGIN ||
+	bounds.min_lat > max_lat + EDGE_MARGIN) {
+	return OUTSIDE;
+    }
+    double min_lon = wrap_longitude(bounds.min_lon, base_lon);
+    double max_lon = min_lon + (bounds.max_lon - bounds.min_lon);
+    if (max_lon > base_lon + 360) {
+	// The cell straddles the point where longitudes wrap.
+	return PARTIAL;
+    }
+
+    size_t j = vertices.size() - 1;
+    for (size_t i = 0; i != vertices.size(); j = i++) {
+	if (edge_meets_rectangle(vertices[j].first, vertices[j].second,
+				 vertices[i].first, vertices[i].second,
+				 bounds.min_lat, min_lon,
+				 bounds.max_lat, max_lon)) {
+	    return PARTIAL;
+	}
+    }
+
+    // No edge comes near the cell, so it's wholly inside or outside: test
+    // its centre.
+    if (point_in_polygon(vertices, (bounds.min_lat + bounds.max_lat) / 2,
+			 (min_lon + max_lon) / 2)) {
+	return INSIDE;
+    }
+    return OUTSIDE;
+}
+
+AggregateRegion::Overlap
+GeoEncode::AggregateRegion::classify(const CellBounds & bounds) const
+{
+    if (min_lat > max_lat) {
+	// An empty box, or a polygon with too few vertices.
+	return OUTSIDE;
+    }
+    if (vertices.empty()) {
+	return classify_box(bounds);
+    }
+    return classify_polygon(bounds);
+}
+
+GeoEncode::StratifiedSample::StratifiedSample()
+	: total(0)
+{
+}
+
+bool
+GeoEncode::StratifiedSample::build(const PackedCode * codes,
+				   const double * values, size_t n,
+				   size_t sample_size, uint64_t seed)
+{
+    cells.clear();
+    degrees.clear();
+    sample_codes.clear();
+    sample_values.clear();
+    total = 0;
+    for (size_t i = 0; i != n; ++i) {
+	if ((codes[i] >> 32) >= 181 * 360 ||
+	    (i != 0 && codes[i] < codes[i - 1])) {
+	    return false;
+	}
+    }
+
+    // Find the cells, and total them.
+    vector<Cell> new_cells;
+    for (size_t i = 0; i != n; ++i) {
+	PackedCode prefix = codes[i] & CELL_MASK;
+	if (new_cells.empty() || new_cells.back().prefix != prefix) {
+	    Cell cell;
+	    cell.prefix = prefix;
+	    cell.first = i;
+	    cell.count = 0;
+	    cell.sum = 0;
+	    cell.sample_begin = 0;
+	    new_cells.push_back(cell);
+	}
+	++new_cells.back().count;
+	new_cells.back().sum += values[i];
+    }
+
+    // Give each cell its share of the sample, and fill it from a reservoir
+    // over the cell's codes.  The codes of a cell are contiguous, so each
+    // reservoir only lives while its cell is read.
+    SampleRandom random(seed);
+    vector<PackedCode> new_codes;
+    vector<double> new_values;
+    vector<size_t> reservoir;
+    double share = n ? double(sample_size) / n : 0;
+    for (size_t c = 0; c != new_cells.size(); ++c) {
+	Cell & cell = new_cells[c];
+	cell.sample_begin = new_codes.size();
+	uint64_t k = uint64_t(llround(cell.count * share));
+	k = min(cell.count, max(k, uint64_t(MIN_CELL_SAMPLE)));
+	reservoir.clear();
+	for (uint64_t i = 0; i != cell.count; ++i) {
+	    if (i < k) {
+		reservoir.push_back(cell.first + i);
+	    } else {
+		uint64_t r = random.below(i + 1);
+		if (r < k) {
+		    reservoir[r] = cell.first + i;
+		}
+	    }
+	}
+	sort(reservoir.begin(), reservoir.end());
+	for (size_t i = 0; i != reservoir.size(); ++i) {
+	    new_codes.push_back(codes[reservoir[i]]);
+	    new_values.push_back(values[reservoir[i]]);
+	}
+
+	if (degrees.empty() ||
+	    degrees.back().prefix != (cell.prefix & DEGREE_MASK)) {
+	    Degree degree;
+	    degree.prefix = cell.prefix & DEGREE_MASK;
+	    degree.cells_begin = c;
+	    degree.cells_end = c;
+	    degree.count = 0;
+	    degree.sum = 0;
+	    degrees.push_back(degree);
+	}
+	Degree & degree = degrees.back();
+	degree.cells_end = c + 1;
+	degree.count += cell.count;
+	degree.sum += cell.sum;
+    }
+
+    cells.swap(new_cells);
+    sample_codes.swap(new_codes);
+    sample_values.swap(new_values);
+    total = n;
+    return true;
+}
+
+namespace {
+
+/** The estimate for one cell on the edge of a region.
+ */
+struct EdgeCell {
+    /** The index of the cell.
+     */
+    size_t cell;
+
+    /** The estimated count and sum of the part in the region.
+     */
+    double count, sum;
+
+    /** The variances of the estimates, and their covariance.
+     */
+    double count_var, sum_var, covariance;
+
+    bool operator<(const EdgeCell & o) const {
+	if (sum_var != o.sum_var) {
+	    return sum_var > o.sum_var;
+	}
+	return count_var > o.count_var;
+    }
+};
+
+}
+
+bool
+GeoEncode::StratifiedSample::estimate(const AggregateRegion & region,
+				      const PackedCode * codes,
+				      const double * values, size_t n,
+				      uint64_t max_points, double confidence,
+				      AggregateEstimate & result) const
+{
+    MetricScope metric(METRIC_SAMPLE_AGGREGATE);
+    result = AggregateEstimate();
+    if (codes && n != total) {
+	return false;
+    }
+
+    vector<EdgeCell> edges;
+    for (size_t d = 0; d != degrees.size(); ++d) {
+	const Degree & degree = degrees[d];
+	CellBounds bounds;
+	cell_bounds(degree.prefix, 2, bounds);
+	AggregateRegion::Overlap overlap = region.classify(bounds);
+	if (overlap == AggregateRegion::OUTSIDE) {
+	    continue;
+	}
+	if (overlap == AggregateRegion::INSIDE) {
+	    result.count += degree.count;
+	    result.sum += degree.sum;
+	    result.exact_cells += degree.cells_end - degree.cells_begin;
+	    continue;
+	}
+
+	for (size_t c = degree.cells_begin; c != degree.cells_end; ++c) {
+	    const Cell & cell = cells[c];
+	    cell_bounds(cell.prefix, 3, bounds);
+	    overlap = region.classify(bounds);
+	    if (overlap == AggregateRegion::OUTSIDE) {
+		continue;
+	    }
+	    if (overlap == AggregateRegion::INSIDE) {
+		result.count += cell.count;
+		result.sum += cell.sum;
+		++result.exact_cells;
+		continue;
+	    }
+
+	    // Estimate the part of the cell in the region from its sample:
+	    // x is 1 for a point in the region, and y is its value.
+	    size_t begin = cell.sample_begin;
+	    size_t end = (c + 1 == cells.size()) ?
+		    sample_codes.size() : cells[c + 1].sample_begin;
+	    double m = double(end - begin);
+	    double sx = 0, sy = 0, syy = 0;
+	    for (size_t i = begin; i != end; ++i) {
+		if (region.contains(sample_codes[i])) {
+		    double y = sample_values[i];
+		    sx += 1;
+		    sy += y;
+		    syy += y * y;
+		}
+	    }
+	    metric.add_points(end - begin);
+	    metric.add_bytes((end - begin) * sizeof(PackedCode));
+	    EdgeCell edge;
+	    edge.cell = c;
+	    edge.count = cell.count * sx / m;
+	    edge.sum = cell.count * sy / m;
+	    if (end - begin == cell.count) {
+		// The sample is the whole cell.
+		result.count += edge.count;
+		result.sum += edge.sum;
+		++result.exact_cells;
+		continue;
+	    }
+	    // Sample variances and covariance of x and y (x * x == x), with
+	    // the finite population correction.
+	    double vxx = (sx - sx * sx / m) / (m - 1);
+	    double vyy = (syy - sy * sy / m) / (m - 1);
+	    double vxy = (sy - sx * sy / m) / (m - 1);
+	    double w = double(cell.count) * cell.count *
+		    (1 - m / cell.count) / m;
+	    edge.count_var = w * vxx;
+	    edge.sum_var = w * vyy;
+	    edge.covariance = w * vxy;
+	    edges.push_back(edge);
+	}
+    }
+
+    if (codes && max_points != 0) {
+	// Replace the estimates for the cells contributing most to the error
+	// by scanning their codes.
+	sort(edges.begin(), edges.end());
+	vector<EdgeCell>::iterator e = edges.begin();
+	for ( ; e != edges.end(); ++e) {
+	    const Cell & cell = cells[e->cell];
+	    if (cell.count > max_points - result.points_scanned) {
+		break;
+	    }
+	    if (cell.first + cell.count > n ||
+		(codes[cell.first] & CELL_MASK) != cell.prefix ||
+		(codes[cell.first + cell.count - 1] & CELL_MASK) !=
+		cell.prefix) {
+		return false;
+	    }
+	    for (uint64_t i = cell.first; i != cell.first + cell.count; ++i) {
+		if (region.contains(codes[i])) {
+		    result.count += 1;
+		    result.sum += values[i];
+		}
+	    }
+	    result.points_scanned += cell.count;
+	    ++result.exact_cells;
+	}
+	metric.add_points(result.points_scanned);
+	metric.add_bytes(result.points_scanned * sizeof(PackedCode));
+	edges.erase(edges.begin(), e);
+    }
+
+    double count_var = 0, sum_var = 0, covariance = 0;
+    for (size_t i = 0; i != edges.size(); ++i) {
+	result.count += edges[i].count;
+	result.sum += edges[i].sum;
+	count_var += edges[i].count_var;
+	sum_var += edges[i].sum_var;
+	covariance += edges[i].covariance;
+    }
+    result.estimated_cells = edges.size();
+
+    double z = normal_quantile(confidence);
+    result.count_error = z * sqrt(count_var);
+    result.sum_error = z * sqrt(sum_var);
+    if (result.count > 0) {
+	// The variance of the ratio sum / count, by the delta method.
+	double mean = result.sum / result.count;
+	double mean_var = (sum_var - 2 * mean * covariance +
+			   mean * mean * count_var) /
+		(result.count * result.count);
+	result.mean = mean;
+	result.mean_error = z * sqrt(max(mean_var, 0.0));
+    }
+    if (edges.empty()) {
+	// Avoid infinities when asked for a confidence of 1.
+	result.count_error = result.sum_error = result.mean_error = 0;
+    }
+    return true;
+}
+
+AggregateEstimate
+GeoEncode::StratifiedSample::aggregate(const AggregateRegion & region,
+				       double confidence) const
+{
+    AggregateEstimate result;
+    estimate(region, NULL, NULL, 0, 0, confidence, result);
+    return result;
+}
+
+bool
+GeoEncode::StratifiedSample::refine(const AggregateRegion & region,
+				    const PackedCode * codes,
+				    const double * values, size_t n,
+				    uint64_t max_points,
+				    AggregateEstimate & result,
+				    double confidence) const
+{
+    return estimate(region, codes, values, n, max_points, confidence,
+		    result);
+}
+
+size_t
+GeoEncode::StratifiedSample::memory_used() const
+{
+    return sizeof(*this) + cells.capacity() * sizeof(Cell) +
+	    degrees.capacity() * sizeof(Degree) +
+	    sample_codes.capacity() * sizeof(PackedCode) +
+	    sample_values.capacity() * sizeof(double);
+}
@@ -0,0 +1,360 @@
+/** @file sampling.h
+ * @brief Approximate aggregates over regions from stratified samples.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GEOENCODE_INCLUDED_SAMPLING_H
+#define GEOENCODE_INCLUDED_SAMPLING_H
+
+#include "geoencode.h"
+
+#include <utility>
+#include <vector>
+
+namespace GeoEncode {
+
+/** A region to aggregate over: a bounding box or a polygon.
+ */
+class AggregateRegion {
+  public:
+    /** How a cell lies relative to the region.
+     */
+    enum Overlap {
+	/// No code in the cell is in the region.
+	OUTSIDE,
+
+	/// Some codes in the cell may be in the region and some not.
+	PARTIAL,
+
+	/// Every code in the cell is in the region.
+	INSIDE
+    };
+
+  private:
+    /** A decoder for the box, or for the bounding box of the polygon.
+     */
+    DecoderWithBoundingBox decoder;
+
+    /** Minimum latitude in the box.
+     */
+    double min_lat;
+
+    /** Maximum latitude in the box.
+     */
+    double max_lat;
+
+    /** Longitude at the western edge of the box, in [0,360).
+     */
+    double lon1;
+
+    /** Longitude at the eastern edge of the box, in [0,360).
+     */
+    double lon2;
+
+    /** The vertices of the polygon, as (latitude, longitude) pairs, with
+     *  longitudes in [base_lon, base_lon + 360).  Empty for a box.
+     */
+    std::vector<std::pair<double, double> > vertices;
+
+    /** The smallest longitude of a vertex of the polygon.
+     */
+    double base_lon;
+
+    /** Classify a cell against the box.
+     */
+    Overlap classify_box(const CellBounds & bounds) const;
+
+    /** Classify a cell against the polygon.
+     */
+    Overlap classify_polygon(const CellBounds & bounds) const;
+
+  public:
+    /** Create a region for a bounding box.
+     *
+     *  A code is in the region if DecoderWithBoundingBox accepts it for the
+     *  same box, so the box may cross the 0/360 boundary.
+     *
+     *  @param lat1 The latitude of the southern edge of the bounding box.
+     *  @param lon1 The longitude of the western edge of the bounding box.
+     *  @param lat2 The latitude of the northern edge of the bounding box.
+     *  @param lon2 The longitude of the eastern edge of the bounding box.
+     */
+    AggregateRegion(double lat1, double lon1, double lat2, double lon2);
+
+    /** Create a region for a polygon.
+     *
+     *  The edges of the polygon are straight lines in latitude and
+     *  longitude, and a code is in the region if its decoded coordinate is
+     *  inside the polygon by the even-odd rule.  The longitudes of the
+     *  vertices must lie in a range less than 360 degrees wide, but it may
+     *  extend past 0 or 360 (such as -10 to 10); decoded longitudes are
+     *  moved into that range by adding or subtracting 360.
+     *
+     *  @param polygon The vertices, as (latitude, longitude) pairs in
+     *                 degrees.  The last vertex is joined to the first.  A
+     *                 polygon with fewer than 3 vertices contains nothing.
+     */
+    explicit
+    AggregateRegion(const std::vector<std::pair<double, double> > & polygon);
+
+    /** Test whether a code is in the region.
+     */
+    bool contains(PackedCode code) const;
+
+    /** Classify a cell against the region.
+     *
+     *  This may return PARTIAL for a cell which is wholly inside or outside
+     *  the region, but never INSIDE or OUTSIDE wrongly.
+     */
+    Overlap classify(const CellBounds & bounds) const;
+};
+
+/** An estimate of aggregates over the codes in a region.
+ *
+ *  The errors are the half-widths of confidence intervals at the requested
+ *  level, from a normal approximation: the exact value is in
+ *  [count - count_error, count + count_error] with (approximately) that
+ *  probability, and similarly for the sum and mean.  They are 0 when the
+ *  estimate is exact.
+ */
+struct AggregateEstimate {
+    /** The estimated number of codes in the region.
+     */
+    double count;
+
+    /** The estimated sum of the values of the codes in the region.
+     */
+    double sum;
+
+    /** The estimated mean of the values, or 0 if count is 0.
+     */
+    double mean;
+
+    /** The error in the count.
+     */
+    double count_error;
+
+    /** The error in the sum.
+     */
+    double sum_error;
+
+    /** The error in the mean.
+     */
+    double mean_error;
+
+    /** The number of cells whose part of the aggregates is exact.
+     */
+    size_t exact_cells;
+
+    /** The number of cells whose part of the aggregates is estimated from
+     *  their samples.
+     */
+    size_t estimated_cells;
+
+    /** The number of codes in the table read by refine().
+     */
+    uint64_t points_scanned;
+
+    AggregateEstimate()
+	: count(0), sum(0), mean(0), count_error(0), sum_error(0),
+	  mean_error(0), exact_cells(0), estimated_cells(0),
+	  points_scanned(0) { }
+
+    /** Check whether the aggregates are exact.
+     */
+    bool exact() const { return estimated_cells == 0; }
+};
+
+/** A stratified sample of a table of codes with values, for estimating
+ *  counts, sums and means over regions.
+ *
+ *  The table is divided into strata by the 4 minute cells denoted by 3 byte
+ *  prefixes.  For each cell, the sample holds the exact number of codes and
+ *  sum of their values, and a reservoir sample of the codes and values whose
+ *  size is proportional to the number of codes in the cell; the 1 degree
+ *  cells above them hold the totals of their 4 minute cells.
+ *
+ *  A query adds up the totals of the cells wholly inside the region, at the
+ *  coarsest level which allows it, and estimates the part of each cell on
+ *  the edge of the region from that cell's sample.  The errors in the
+ *  estimates come only from the cells on the edge, so they shrink relative
+ *  to the answer as the region grows.  With the table it was built from,
+ *  the estimate can be refined by scanning the codes of edge cells, those
+ *  contributing most to the error first, up to the exact answer.
+ */
+class StratifiedSample {
+    /** A 4 minute cell.
+     */
+    struct Cell {
+	/** The code of the first point in the cell, with the bytes after
+	 *  the 3 byte prefix cleared.
+	 */
+	PackedCode prefix;
+
+	/** The position of the cell's first code in the table.
+	 */
+	uint64_t first;
+
+	/** The number of codes in the cell.
+	 */
+	uint64_t count;
+
+	/** The sum of the values of the codes in the cell.
+	 */
+	double sum;
+
+	/** The start of the cell's sample in sample_codes.  The sample
+	 *  ends at the start of the next cell's.
+	 */
+	size_t sample_begin;
+    };
+
+    /** A 1 degree cell.
+     */
+    struct Degree {
+	/** The code of the first point in the cell, with the bytes after
+	 *  the 2 byte prefix cleared.
+	 */
+	PackedCode prefix;
+
+	/** The first of the cell's 4 minute cells.
+	 */
+	size_t cells_begin;
+
+	/** The end of the cell's 4 minute cells.
+	 */
+	size_t cells_end;
+
+	/** The number of codes in the cell.
+	 */
+	uint64_t count;
+
+	/** The sum of the values of the codes in the cell.
+	 */
+	double sum;
+    };
+
+    /** The non-empty 4 minute cells, in ascending order.
+     */
+    std::vector<Cell> cells;
+
+    /** The non-empty 1 degree cells, in ascending order.
+     */
+    std::vector<Degree> degrees;
+
+    /** The codes of the sampled points.
+     */
+    std::vector<PackedCode> sample_codes;
+
+    /** The values of the sampled points.
+     */
+    std::vector<double> sample_values;
+
+    /** The number of codes in the table.
+     */
+    uint64_t total;
+
+    /** Estimate aggregates, scanning up to @a max_points codes of the
+     *  table if it is given.
+     */
+    bool estimate(const AggregateRegion & region,
+		  const PackedCode * codes, const double * values,
+		  size_t n, uint64_t max_points, double confidence,
+		  AggregateEstimate & result) const;
+
+  public:
+    /** The smallest sample kept for a cell (or all of its codes, if it has
+     *  fewer), so that the variance within each cell can be estimated.
+     */
+    static const unsigned MIN_CELL_SAMPLE = 4;
+
+    /** Create an empty sample.
+     */
+    StratifiedSample();
+
+    /** Build the sample from a table of codes with values.
+     *
+     *  @param codes The codes, in ascending order (duplicates allowed).
+     *  @param values The value for each code.
+     *  @param n The number of codes.
+     *  @param sample_size The number of points to sample, shared between
+     *                     the cells in proportion to the number of codes in
+     *                     each.  Each cell also gets at least
+     *                     MIN_CELL_SAMPLE points, so the sample may be
+     *                     bigger than this if there are many sparse cells.
+     *  @param seed The seed for choosing the sample.
+     *
+     *  @returns false if the codes aren't in ascending order or any isn't a
+     *           valid packed code, in which case the sample is left empty.
+     */
+    bool build(const PackedCode * codes, const double * values, size_t n,
+	       size_t sample_size, uint64_t seed = 1);
+
+    /** Estimate aggregates over the codes in a region.
+     *
+     *  @param region The region.
+     *  @param confidence The confidence level of the errors, between 0 and
+     *                    1, such as 0.95.
+     */
+    AggregateEstimate aggregate(const AggregateRegion & region,
+				double confidence = 0.95) const;
+
+    /** Estimate aggregates over the codes in a region, refining the
+     *  estimate by scanning the table.
+     *
+     *  The cells on the edge of the region are scanned in descending order
+     *  of their contribution to the variance of the sum (then of the
+     *  count), until the next would take the number of codes scanned over
+     *  @a max_points.  Pass UINT64_MAX to get the exact answer.
+     *
+     *  @param region The region.
+     *  @param codes The codes of the table the sample was built from.
+     *  @param values The values of the table the sample was built from.
+     *  @param n The number of codes in the table.
+     *  @param max_points The most codes to scan.
+     *  @param result A reference to return the estimate in.
+     *  @param confidence The confidence level of the errors.
+     *
+     *  @returns false if the table isn't the one the sample was built from
+     *           (as far as can be cheaply checked).
+     */
+    bool refine(const AggregateRegion & region,
+		const PackedCode * codes, const double * values, size_t n,
+		uint64_t max_points, AggregateEstimate & result,
+		double confidence = 0.95) const;
+
+    /** Get the number of codes in the table the sample was built from.
+     */
+    uint64_t size() const { return total; }
+
+    /** Get the number of points in the sample.
+     */
+    size_t sample_size() const { return sample_codes.size(); }
+
+    /** Get the number of bytes of memory used by the sample.
+     */
+    size_t memory_used() const;
+};
+
+}
+
+#endif /* GEOENCODE_INCLUDED_SAMPLING_H */
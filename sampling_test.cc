@@ -0,0 +1,315 @@
+/** @file sampling_test.cc
+ * @brief Tests for approximate aggregates from stratified samples.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "sampling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
+using namespace std;
+using GeoEncode::AggregateEstimate;
+using GeoEncode::AggregateRegion;
+using GeoEncode::PackedCode;
+
+/** A table of codes, in ascending order, with a value for each.
+ */
+struct Table {
+    vector<PackedCode> codes;
+    vector<double> values;
+};
+
+/** Make a table of random points, mostly in a few clusters, with values
+ *  which depend on the latitude.
+ */
+static void
+make_table(size_t n, Table & table)
+{
+    vector<pair<PackedCode, double> > rows;
+    for (size_t i = 0; i != n; ++i) {
+	double lat, lon;
+	if (random() % 4) {
+	    static const double centres[][2] = {
+		{ 51.5, -0.1 }, { 40.7, -74.0 }, { -33.9, 151.2 },
+		{ 0.0, 179.9 }, { 89.5, 10.0 }
+	    };
+	    const double * c = centres[random() % 5];
+	    lat = c[0] + ((random() * 3.0) / RAND_MAX) - 1.5;
+	    lon = c[1] + ((random() * 3.0) / RAND_MAX) - 1.5;
+	    if (lat > 90) lat = 90;
+	} else {
+	    lat = ((random() * 180.0) / RAND_MAX) - 90.0;
+	    lon = ((random() * 360.0) / RAND_MAX);
+	}
+	if (random() % 1000 == 0) {
+	    lat = (random() % 2) ? 90 : -90;
+	}
+	string encoded;
+	GeoEncode::encode(lat, lon, encoded);
+	double value = 100 + lat + ((random() * 20.0) / RAND_MAX);
+	rows.push_back(make_pair(GeoEncode::pack(encoded.data()), value));
+    }
+    sort(rows.begin(), rows.end());
+    table.codes.clear();
+    table.values.clear();
+    for (size_t i = 0; i != rows.size(); ++i) {
+	table.codes.push_back(rows[i].first);
+	table.values.push_back(rows[i].second);
+    }
+}
+
+/** Check that two sums agree, allowing for the order of addition.
+ */
+static bool
+sums_agree(double a, double b)
+{
+    return fabs(a - b) <= 1e-9 * max(1.0, fabs(b));
+}
+
+/** Check the exact refinement of an aggregate against a scan of the table,
+ *  and the estimate from the sample against the exact answer.
+ *
+ *  @param box The bounding box, if the region is one, to scan the table
+ *             with the bounding box decoder independently of the region;
+ *             otherwise NULL.
+ *
+ *  @returns false if a check failed.  @a covered_ref is incremented if
+ *           the estimated count's interval contains the exact count.
+ */
+static bool
+check_region(const GeoEncode::StratifiedSample & sample, const Table & table,
+	     const AggregateRegion & region, const double * box,
+	     const char * name, size_t & covered_ref)
+{
+    double count = 0, sum = 0;
+    for (size_t i = 0; i != table.codes.size(); ++i) {
+	bool inside;
+	if (box) {
+	    GeoEncode::DecoderWithBoundingBox bb(box[0], box[1], box[2],
+						 box[3]);
+	    char encoded[6];
+	    GeoEncode::unpack(table.codes[i], encoded);
+	    double lat, lon;
+	    inside = bb.decode(encoded, 6, lat, lon);
+	} else {
+	    inside = region.contains(table.codes[i]);
+	}
+	if (inside) {
+	    count += 1;
+	    sum += table.values[i];
+	}
+    }
+
+    AggregateEstimate exact;
+    if (!sample.refine(region, &table.codes[0], &table.values[0],
+		       table.codes.size(), UINT64_MAX, exact)) {
+	fprintf(stderr, "%s: refine failed\n", name);
+	return false;
+    }
+    if (!exact.exact() || exact.count != count ||
+	!sums_agree(exact.sum, sum) || exact.count_error != 0) {
+	fprintf(stderr, "%s: refined to count %g, sum %g, expected %g, %g\n",
+		name, exact.count, exact.sum, count, sum);
+	return false;
+    }
+
+    AggregateEstimate estimate = sample.aggregate(region, 0.95);
+    if (fabs(estimate.count - count) <= estimate.count_error) {
+	++covered_ref;
+    }
+    if (estimate.exact() &&
+	(estimate.count != count || !sums_agree(estimate.sum, sum))) {
+	fprintf(stderr, "%s: exact estimate of count %g, expected %g\n",
+		name, estimate.count, count);
+	return false;
+    }
+
+    // A partial refinement scans no more than it is allowed, and is
+    // between the estimate and the exact answer in how many cells are
+    // estimated.
+    AggregateEstimate partial;
+    sample.refine(region, &table.codes[0], &table.values[0],
+		  table.codes.size(), 2000, partial);
+    if (partial.points_scanned > 2000 ||
+	partial.estimated_cells > estimate.estimated_cells ||
+	partial.exact_cells + partial.estimated_cells !=
+	estimate.exact_cells + estimate.estimated_cells ||
+	partial.count_error > estimate.count_error + 1e-9) {
+	fprintf(stderr, "%s: partial refinement scanned %llu codes, leaving "
+		"%zu of %zu cells estimated\n", name,
+		(unsigned long long)partial.points_scanned,
+		partial.estimated_cells, estimate.estimated_cells);
+	return false;
+    }
+    return true;
+}
+
+int main() {
+    bool ok = true;
+
+    Table table;
+    make_table(200000, table);
+    GeoEncode::StratifiedSample sample;
+    if (!sample.build(&table.codes[0], &table.values[0], table.codes.size(),
+		      20000)) {
+	fprintf(stderr, "build failed\n");
+	return 1;
+    }
+    if (sample.size() != table.codes.size() ||
+	sample.sample_size() < 20000 ||
+	sample.sample_size() > table.codes.size() ||
+	sample.memory_used() < sample.sample_size() * 16) {
+	fprintf(stderr, "sample of %zu codes from %llu\n",
+		sample.sample_size(), (unsigned long long)sample.size());
+	ok = false;
+    }
+
+    // Fixed boxes, including boxes over the poles and the 0/360 boundary,
+    // and random boxes.
+    static const double boxes[][4] = {
+	{ 50, -2, 53, 1 },
+	{ 51.2, -0.5, 51.8, 0.3 },
+	{ -90, -60, 10, 50 },
+	{ -30, 350, 30, 10 },
+	{ 85, 0, 90, 360 },
+	{ 89, 20, 90, 30 },
+	{ -91, 0, 91, 360 },
+	{ 10, 10, -10, 20 }
+    };
+    size_t covered = 0, regions = 0;
+    for (size_t b = 0; b != sizeof(boxes) / sizeof(boxes[0]); ++b) {
+	AggregateRegion region(boxes[b][0], boxes[b][1], boxes[b][2],
+			       boxes[b][3]);
+	ok &= check_region(sample, table, region, boxes[b], "box", covered);
+	++regions;
+    }
+    for (int i = 0; i != 100; ++i) {
+	double box[4];
+	box[0] = ((random() * 170.0) / RAND_MAX) - 90.0;
+	box[2] = box[0] + ((random() * 20.0) / RAND_MAX);
+	box[1] = ((random() * 360.0) / RAND_MAX);
+	box[3] = box[1] + ((random() * 40.0) / RAND_MAX);
+	AggregateRegion region(box[0], box[1], box[2], box[3]);
+	ok &= check_region(sample, table, region, box, "random box", covered);
+	++regions;
+    }
+
+    // Polygons, including one across the 0/360 boundary.
+    {
+	vector<pair<double, double> > polygon;
+	polygon.push_back(make_pair(50.0, -3.0));
+	polygon.push_back(make_pair(53.0, -1.0));
+	polygon.push_back(make_pair(51.5, 0.0));
+	polygon.push_back(make_pair(52.5, 2.0));
+	polygon.push_back(make_pair(49.5, 1.0));
+	ok &= check_region(sample, table, AggregateRegion(polygon), NULL,
+			   "polygon", covered);
+	++regions;
+
+	polygon.clear();
+	polygon.push_back(make_pair(-40.0, 140.0));
+	polygon.push_back(make_pair(-20.0, 150.0));
+	polygon.push_back(make_pair(-40.0, 160.0));
+	ok &= check_region(sample, table, AggregateRegion(polygon), NULL,
+			   "triangle", covered);
+	++regions;
+
+	polygon.clear();
+	polygon.push_back(make_pair(0.0, 0.0));
+	ok &= check_region(sample, table, AggregateRegion(polygon), NULL,
+			   "degenerate polygon", covered);
+	++regions;
+    }
+
+    // Most of the 95% confidence intervals contain the exact count.  The
+    // normal approximation is rough for cells with few sampled points in
+    // the region, so allow some slack.
+    if (covered < regions * 8 / 10) {
+	fprintf(stderr, "%zu of %zu intervals contained the count\n",
+		covered, regions);
+	ok = false;
+    }
+
+    // Higher confidence levels give wider intervals.
+    {
+	AggregateRegion region(50.01, -1.99, 52.99, 0.99);
+	AggregateEstimate narrow = sample.aggregate(region, 0.5);
+	AggregateEstimate wide = sample.aggregate(region, 0.99);
+	if (narrow.estimated_cells == 0 ||
+	    !(narrow.count_error < wide.count_error) ||
+	    !(narrow.mean_error < wide.mean_error) ||
+	    narrow.count != wide.count) {
+	    fprintf(stderr, "intervals don't widen with the confidence "
+		    "level\n");
+	    ok = false;
+	}
+	if (fabs(wide.mean - (100 + 51.5 + 10)) > 2) {
+	    fprintf(stderr, "estimated mean %g\n", wide.mean);
+	    ok = false;
+	}
+    }
+
+    // A sample of the whole table gives exact answers.
+    {
+	GeoEncode::StratifiedSample full;
+	full.build(&table.codes[0], &table.values[0], table.codes.size(),
+		   table.codes.size());
+	AggregateEstimate estimate =
+		full.aggregate(AggregateRegion(-30, 350, 30, 10));
+	if (!estimate.exact() || estimate.count_error != 0) {
+	    fprintf(stderr, "full sample gave an inexact estimate\n");
+	    ok = false;
+	}
+    }
+
+    // Bad input is rejected.
+    {
+	AggregateEstimate estimate;
+	if (sample.refine(AggregateRegion(50, -2, 53, 1), &table.codes[0],
+			  &table.values[0], table.codes.size() - 1,
+			  UINT64_MAX, estimate)) {
+	    fprintf(stderr, "refine accepted the wrong table\n");
+	    ok = false;
+	}
+	vector<PackedCode> codes;
+	codes.push_back(2);
+	codes.push_back(1);
+	double values[2] = { 0, 0 };
+	GeoEncode::StratifiedSample bad;
+	if (bad.build(&codes[0], values, 2, 10) || bad.size() != 0) {
+	    fprintf(stderr, "unsorted codes were accepted\n");
+	    ok = false;
+	}
+	codes.assign(1, PackedCode(181 * 360) << 32);
+	if (bad.build(&codes[0], values, 1, 10)) {
+	    fprintf(stderr, "out of range code was accepted\n");
+	    ok = false;
+	}
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+/** @file serialise.h
+ * @brief Helpers for serialising index structures.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GEOENCODE_INCLUDED_SERIALISE_H
+#define GEOENCODE_INCLUDED_SERIALISE_H
+
+#include <cstring>
+#include <string>
+#include <stdint.h>
+
+namespace GeoEncode {
+
+/** Append an unsigned integer to a string, as @a bytes little-endian bytes.
+ */
+inline void
+append_uint(std::string & result, uint64_t value, unsigned bytes)
+{
+    for (unsigned i = 0; i != bytes; ++i) {
+	result += char(value & 0xff);
+	value >>= 8;
+    }
+}
+
+/** Read an unsigned integer stored by append_uint().
+ *
+ *  @param ptr The position to read from; advanced past the value read.
+ *  @param end The end of the buffer.
+ *  @param value_ref A reference to a value to return the integer in.
+ *  @param bytes The number of bytes the integer was stored in.
+ *
+ *  @returns false if the buffer was too short.
+ */
+inline bool
+read_uint(const char *& ptr, const char * end, uint64_t & value_ref,
+	  unsigned bytes)
+{
+    if (size_t(end - ptr) < bytes) {
+	return false;
+    }
+    const unsigned char * p = reinterpret_cast<const unsigned char *>(ptr);
+    uint64_t value = 0;
+    for (unsigned i = bytes; i != 0; --i) {
+	value = (value << 8) | p[i - 1];
+    }
+    value_ref = value;
+    ptr += bytes;
+    return true;
+}
+
+/** Load 4 little-endian bytes from a possibly unaligned address.
+ */
+inline uint32_t
+load_le32(const char * ptr)
+{
+    uint32_t value;
+    std::memcpy(&value, ptr, 4);
+#if defined __BYTE_ORDER__ && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap32(value);
+#endif
+    return value;
+}
+
+/** Load 8 little-endian bytes from a possibly unaligned address.
+ */
+inline uint64_t
+load_le64(const char * ptr)
+{
+    uint64_t value;
+    std::memcpy(&value, ptr, 8);
+#if defined __BYTE_ORDER__ && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+    return value;
+}
+
+}
+
+#endif /* GEOENCODE_INCLUDED_SERIALISE_H */
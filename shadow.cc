@@ -0,0 +1,265 @@
+/** @file shadow.cc
+ * @brief Checking sampled calls of the fast kernels against references.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "shadow.h"
+
+#include "splitmix.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <mutex>
+
+using namespace std;
+using GeoEncode::SHADOW_KERNEL_COUNT;
+using GeoEncode::ShadowMismatch;
+using GeoEncode::ShadowStats;
+
+/// The names of the kernels, indexed by ShadowKernel.
+static const char * const kernel_names[] = {
+    "column_decode",
+    "column_filter",
+    "unit_vectors",
+    "distance_batch"
+};
+
+/** The mean number of calls between checks of a kernel, or 0 if checking
+ *  is off.
+ */
+static atomic<uint32_t> shadow_interval(0);
+
+namespace {
+
+/** The counts and mismatches recorded, shared by all threads.
+ *
+ *  Only checked calls update this, so a lock is cheap enough.
+ */
+struct Registry {
+    mutex lock;
+
+    ShadowStats stats[SHADOW_KERNEL_COUNT];
+
+    vector<ShadowMismatch> mismatches;
+
+    Registry() {
+	for (unsigned k = 0; k != SHADOW_KERNEL_COUNT; ++k) {
+	    stats[k].name = kernel_names[k];
+	}
+    }
+};
+
+/** The state for choosing which calls a thread checks.
+ */
+struct Sampler {
+    /** State of the random number generator (SplitMix64).
+     */
+    uint64_t state;
+
+    /** The interval the countdowns were drawn for.
+     */
+    uint32_t interval;
+
+    /** The calls left until the next check of each kernel.
+     */
+    uint64_t countdown[SHADOW_KERNEL_COUNT];
+
+    /** The value each countdown started from.
+     */
+    uint64_t drawn[SHADOW_KERNEL_COUNT];
+
+    Sampler() : state(0), interval(0) {
+	static atomic<uint64_t> threads(0);
+	state = uint64_t(reinterpret_cast<uintptr_t>(this)) ^
+		(threads.fetch_add(1, memory_order_relaxed) << 48);
+	for (unsigned k = 0; k != SHADOW_KERNEL_COUNT; ++k) {
+	    countdown[k] = drawn[k] = 0;
+	}
+    }
+
+    uint64_t next() { return GeoEncode::splitmix64(state); }
+
+    /** Draw the number of calls until the next check, uniformly from 1 to
+     *  2 * interval - 1, so the mean is the interval.
+     */
+    void draw(unsigned k) {
+	uint64_t spread = 2 * uint64_t(interval) - 1;
+	countdown[k] = drawn[k] = 1 + next() % spread;
+    }
+};
+
+}
+
+/** Get the registry.
+ *
+ *  This is never destroyed, so that kernels called during static
+ *  destruction can still record checks.
+ */
+static Registry &
+registry()
+{
+    static Registry * r = new Registry;
+    return *r;
+}
+
+static thread_local Sampler sampler;
+
+void
+GeoEncode::set_shadow_fraction(double fraction)
+{
+    uint32_t interval = 0;
+    if (fraction >= 1) {
+	interval = 1;
+    } else if (fraction > 0) {
+	interval = uint32_t(min(llround(1 / fraction), 0x7fffffffLL));
+    }
+    shadow_interval.store(interval, memory_order_relaxed);
+}
+
+double
+GeoEncode::get_shadow_fraction()
+{
+    uint32_t interval = shadow_interval.load(memory_order_relaxed);
+    return interval ? 1.0 / interval : 0.0;
+}
+
+GeoEncode::ShadowCheck::ShadowCheck(ShadowKernel kernel_)
+	: kernel(kernel_), calls(0), differed(false)
+{
+    uint32_t interval = shadow_interval.load(memory_order_relaxed);
+    if (interval == 0) {
+	return;
+    }
+    Sampler & s = sampler;
+    if (s.interval != interval) {
+	s.interval = interval;
+	for (unsigned k = 0; k != SHADOW_KERNEL_COUNT; ++k) {
+	    s.draw(k);
+	}
+    }
+    if (--s.countdown[kernel] != 0) {
+	return;
+    }
+    calls = s.drawn[kernel];
+    s.draw(kernel);
+    start = fast_end = chrono::steady_clock::now();
+}
+
+GeoEncode::ShadowCheck::~ShadowCheck()
+{
+    if (!calls) {
+	return;
+    }
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    chrono::nanoseconds fast = fast_end - start;
+    chrono::nanoseconds check = end - fast_end;
+    Registry & r = registry();
+    lock_guard<mutex> guard(r.lock);
+    ShadowStats & stats = r.stats[kernel];
+    stats.calls += calls;
+    ++stats.checks;
+    stats.fast_ns += uint64_t(fast.count());
+    stats.check_ns += uint64_t(check.count());
+    if (differed) {
+	++stats.mismatches;
+    }
+}
+
+void
+GeoEncode::ShadowCheck::mismatch(const string & description)
+{
+    if (differed) {
+	return;
+    }
+    differed = true;
+    Registry & r = registry();
+    lock_guard<mutex> guard(r.lock);
+    if (r.mismatches.size() < SHADOW_MAX_MISMATCHES) {
+	ShadowMismatch m;
+	m.kernel = kernel;
+	m.description = description;
+	r.mismatches.push_back(m);
+    }
+}
+
+void
+GeoEncode::get_shadow_stats(vector<ShadowStats> & result)
+{
+    Registry & r = registry();
+    lock_guard<mutex> guard(r.lock);
+    result.assign(r.stats, r.stats + SHADOW_KERNEL_COUNT);
+}
+
+void
+GeoEncode::get_shadow_mismatches(vector<ShadowMismatch> & result)
+{
+    Registry & r = registry();
+    lock_guard<mutex> guard(r.lock);
+    result = r.mismatches;
+}
+
+void
+GeoEncode::reset_shadow()
+{
+    Registry & r = registry();
+    lock_guard<mutex> guard(r.lock);
+    for (unsigned k = 0; k != SHADOW_KERNEL_COUNT; ++k) {
+	r.stats[k] = ShadowStats();
+	r.stats[k].name = kernel_names[k];
+    }
+    r.mismatches.clear();
+}
+
+string
+GeoEncode::shadow_report()
+{
+    vector<ShadowStats> stats;
+    get_shadow_stats(stats);
+    vector<ShadowMismatch> mismatches;
+    get_shadow_mismatches(mismatches);
+
+    string result;
+    char buf[160];
+    snprintf(buf, sizeof(buf), "%-16s %12s %10s %10s %9s\n",
+	     "kernel", "calls", "checks", "mismatches", "overhead");
+    result += buf;
+    for (size_t k = 0; k != stats.size(); ++k) {
+	const ShadowStats & s = stats[k];
+	if (s.checks == 0) {
+	    continue;
+	}
+	snprintf(buf, sizeof(buf), "%-16s %12llu %10llu %10llu %8.1f%%\n",
+		 s.name, (unsigned long long)s.calls,
+		 (unsigned long long)s.checks,
+		 (unsigned long long)s.mismatches, s.overhead() * 100);
+	result += buf;
+    }
+    for (size_t i = 0; i != mismatches.size(); ++i) {
+	result += kernel_names[mismatches[i].kernel];
+	result += ": ";
+	result += mismatches[i].description;
+	result += '\n';
+    }
+    return result;
+}
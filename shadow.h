@@ -0,0 +1,224 @@
+/** @file shadow.h
+ * @brief Checking sampled calls of the fast kernels against references.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GEOENCODE_INCLUDED_SHADOW_H
+#define GEOENCODE_INCLUDED_SHADOW_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace GeoEncode {
+
+/** The kernels which can be checked.
+ *
+ *  Each is compared with a reference built on decode() and libm, so that a
+ *  fast path which drifts from the semantics of decode() (at the poles, or
+ *  where longitudes wrap from 360 to 0, say) shows up as a mismatch.
+ */
+enum ShadowKernel {
+    /** Unpacking the blocks of a CodeColumn in CodeColumn::decode_all(),
+     *  compared with the scalar unpacker.
+     */
+    SHADOW_COLUMN_DECODE,
+
+    /** CodeColumn::filter(), with its block skipping, SIMD unpacking and
+     *  the prefilter of DecoderWithBoundingBox, compared with decoding
+     *  every code with decode() and testing it with
+     *  DecoderWithBoundingBox::contains().
+     */
+    SHADOW_COLUMN_FILTER,
+
+    /** code_unit_vector_batch(), compared with unit_vector() of the decoded
+     *  coordinates.
+     */
+    SHADOW_UNIT_VECTORS,
+
+    /** code_distance_batch() and chord_squared_batch(), compared with
+     *  haversine_distance() and the unit vectors of the decoded
+     *  coordinates, within the accuracy each documents.
+     */
+    SHADOW_DISTANCE_BATCH,
+
+    SHADOW_KERNEL_COUNT
+};
+
+/** The counts for one kernel.
+ */
+struct ShadowStats {
+    /** The name of the kernel, such as "column_filter".
+     */
+    const char * name;
+
+    /** The estimated number of calls while checking was enabled.
+     */
+    uint64_t calls;
+
+    /** The number of calls checked.
+     */
+    uint64_t checks;
+
+    /** The number of checked calls whose results differed from the
+     *  reference.
+     */
+    uint64_t mismatches;
+
+    /** The time spent in the kernel in the checked calls, in nanoseconds.
+     */
+    uint64_t fast_ns;
+
+    /** The time spent running the reference and comparing the results, in
+     *  nanoseconds.
+     */
+    uint64_t check_ns;
+
+    ShadowStats()
+	: name(""), calls(0), checks(0), mismatches(0), fast_ns(0),
+	  check_ns(0) { }
+
+    /** Estimate the time added to the kernel's calls by checking, as a
+     *  fraction of the time they take, or 0 if none were checked.
+     */
+    double overhead() const {
+	if (checks == 0 || fast_ns == 0) return 0;
+	return double(check_ns) * checks / (double(fast_ns) * calls);
+    }
+};
+
+/** A call whose results differed from the reference.
+ */
+struct ShadowMismatch {
+    /** The kernel.
+     */
+    ShadowKernel kernel;
+
+    /** A description of the call's inputs and the first result which
+     *  differed, with the value from the kernel and from the reference.
+     */
+    std::string description;
+};
+
+/** The most mismatches kept for get_shadow_mismatches(); later ones are
+ *  only counted.
+ */
+const size_t SHADOW_MAX_MISMATCHES = 64;
+
+/** Set the fraction of kernel calls to check.
+ *
+ *  Checking is off (a fraction of 0) until this is called.  Checked calls
+ *  are chosen at random, separately for each kernel and thread, so that a
+ *  periodic workload can't hide a mismatch; each check costs about as much
+ *  as a call to the reference, which is several times the kernel's own
+ *  cost.  While checking is off, each kernel call pays for one relaxed
+ *  atomic load.
+ *
+ *  @param fraction The fraction of calls to check, from 0 to 1.
+ */
+extern void
+set_shadow_fraction(double fraction);
+
+/** Get the fraction of kernel calls being checked.
+ */
+extern double
+get_shadow_fraction();
+
+/** Get the counts for each kernel since the last reset_shadow().
+ *
+ *  @param result A vector to replace the contents of with the counts,
+ *                indexed by ShadowKernel.
+ */
+extern void
+get_shadow_stats(std::vector<ShadowStats> & result);
+
+/** Get the first mismatches found since the last reset_shadow().
+ *
+ *  @param result A vector to replace the contents of with up to
+ *                SHADOW_MAX_MISMATCHES mismatches, in the order they were
+ *                found.
+ */
+extern void
+get_shadow_mismatches(std::vector<ShadowMismatch> & result);
+
+/** Restart the counts and forget the mismatches found.
+ */
+extern void
+reset_shadow();
+
+/** Format the counts for the kernels which have been checked as a text
+ *  table, followed by the mismatches kept.
+ */
+extern std::string
+shadow_report();
+
+/** Decide whether to check a call, and time it if so.
+ *
+ *  This is used by the kernels: the fast code runs, then if active() is
+ *  true, fast_done() is called and the reference is run and compared,
+ *  calling mismatch() if the results differ.  The times and the outcome
+ *  are recorded when the object goes out of scope.
+ */
+class ShadowCheck {
+    ShadowKernel kernel;
+
+    /** The number of calls since the last check of this kernel by this
+     *  thread, or 0 if this call isn't checked.
+     */
+    uint64_t calls;
+
+    std::chrono::steady_clock::time_point start;
+
+    std::chrono::steady_clock::time_point fast_end;
+
+    bool differed;
+
+    /// Copying isn't allowed.
+    ShadowCheck(const ShadowCheck &);
+
+    /// Assignment isn't allowed.
+    void operator=(const ShadowCheck &);
+
+  public:
+    explicit ShadowCheck(ShadowKernel kernel_);
+
+    ~ShadowCheck();
+
+    /** Check whether this call is to be checked.
+     */
+    bool active() const { return calls != 0; }
+
+    /** Note that the kernel has finished, and the check is starting.
+     */
+    void fast_done() { fast_end = std::chrono::steady_clock::now(); }
+
+    /** Record that the results differed from the reference.
+     *
+     *  Only the first description given for a call is kept.
+     */
+    void mismatch(const std::string & description);
+};
+
+}
+
+#endif /* GEOENCODE_INCLUDED_SHADOW_H */
@@ -0,0 +1,252 @@
+/** @file shadow_test.cc
+ * @brief Tests for checking the fast kernels against references.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "shadow.h"
+#include "codecolumn.h"
+#include "distance.h"
+#include "simd.h"
+#include "testutils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+using namespace std;
+using GeoEncode::PackedCode;
+using GeoEncode::ShadowStats;
+
+/** Make sorted codes for random points, with some at the poles and at
+ *  longitudes which round to 360 and wrap to 0.
+ */
+static void
+make_codes(size_t n, vector<PackedCode> & codes)
+{
+    codes.clear();
+    for (size_t i = 0; i != n; ++i) {
+	double lat = ((random() * 180.0) / RAND_MAX) - 90.0;
+	double lon = ((random() * 360.0) / RAND_MAX);
+	switch (random() % 20) {
+	    case 0: lat = 90; break;
+	    case 1: lat = -90; break;
+	    case 2: lon = 360 - 1e-7; break;
+	    case 3: lat = 90 - 1e-7; break;
+	    case 4: lon = -1e-7; break;
+	}
+	codes.push_back(pack_coord(lat, lon));
+    }
+    sort(codes.begin(), codes.end());
+}
+
+/** Run each of the checked kernels once on some codes.
+ */
+static void
+run_kernels(const vector<PackedCode> & codes)
+{
+    GeoEncode::CodeColumn column;
+    column.build(codes);
+    vector<PackedCode> decoded;
+    column.decode_all(decoded);
+
+    static const double boxes[][4] = {
+	{ -10, 0, 10, 50 },
+	{ -30, 350, 30, 10 },
+	{ 80, 100, 90, 120 },
+	{ -90, 359, -80, 1 }
+    };
+    for (size_t b = 0; b != sizeof(boxes) / sizeof(boxes[0]); ++b) {
+	GeoEncode::DecoderWithBoundingBox bb(boxes[b][0], boxes[b][1],
+					     boxes[b][2], boxes[b][3]);
+	vector<size_t> positions;
+	column.filter(bb, positions);
+    }
+
+    size_t n = codes.size();
+    vector<double> xyz(n * 3), result(n);
+    vector<float> xyz_float(n * 3), result_float(n);
+    GeoEncode::code_unit_vector_batch(&codes[0], n, &xyz[0]);
+    GeoEncode::code_unit_vector_batch(&codes[0], n, &xyz_float[0]);
+
+    static const double points[][2] = {
+	{ 51.5, -0.1 }, { 90, 0 }, { -90, 0 }, { -51.5, 179.9 },
+	{ 10, 359.9999999 }
+    };
+    for (size_t p = 0; p != sizeof(points) / sizeof(points[0]); ++p) {
+	double lat = points[p][0], lon = points[p][1];
+	GeoEncode::code_distance_batch(lat, lon, &codes[0], n, &result[0]);
+	GeoEncode::code_distance_batch(lat, lon, &codes[0], n,
+				       &result_float[0]);
+	GeoEncode::chord_squared_batch(lat, lon, &codes[0], n, &result[0]);
+	GeoEncode::chord_squared_batch(lat, lon, &codes[0], n,
+				       &result_float[0]);
+    }
+}
+
+/** Check that every kernel was checked on every call, without mismatches.
+ */
+static bool
+check_all_agree(const vector<PackedCode> & codes, const char * level)
+{
+    GeoEncode::reset_shadow();
+    GeoEncode::set_shadow_fraction(1);
+    run_kernels(codes);
+    GeoEncode::set_shadow_fraction(0);
+
+    // The calls made by each kernel in run_kernels().
+    static const uint64_t expected_calls[] = { 1, 4, 2, 20 };
+    bool ok = true;
+    vector<ShadowStats> stats;
+    GeoEncode::get_shadow_stats(stats);
+    for (size_t k = 0; k != stats.size(); ++k) {
+	if (stats[k].checks != expected_calls[k] ||
+	    stats[k].calls != expected_calls[k] ||
+	    stats[k].mismatches != 0) {
+	    fprintf(stderr, "%s %s: %llu calls, %llu checks, %llu "
+		    "mismatches\n", level, stats[k].name,
+		    (unsigned long long)stats[k].calls,
+		    (unsigned long long)stats[k].checks,
+		    (unsigned long long)stats[k].mismatches);
+	    ok = false;
+	}
+	if (stats[k].check_ns == 0 || stats[k].overhead() <= 0) {
+	    fprintf(stderr, "%s %s: no time recorded for checks\n", level,
+		    stats[k].name);
+	    ok = false;
+	}
+    }
+    if (!ok) {
+	fputs(GeoEncode::shadow_report().c_str(), stderr);
+    }
+    return ok;
+}
+
+int main() {
+    bool ok = true;
+
+    vector<PackedCode> codes;
+    make_codes(20000, codes);
+
+    // Checking is off by default.
+    if (GeoEncode::get_shadow_fraction() != 0) {
+	fprintf(stderr, "checking is on by default\n");
+	ok = false;
+    }
+    run_kernels(codes);
+    vector<ShadowStats> stats;
+    GeoEncode::get_shadow_stats(stats);
+    for (size_t k = 0; k != stats.size(); ++k) {
+	if (stats[k].checks != 0) {
+	    fprintf(stderr, "%s was checked while checking was off\n",
+		    stats[k].name);
+	    ok = false;
+	}
+    }
+
+    // Every kernel agrees with its reference at each SIMD level.
+    ok &= check_all_agree(codes, "avx512");
+    GeoEncode::set_simd_limit(GeoEncode::SIMD_AVX2);
+    ok &= check_all_agree(codes, "avx2");
+    GeoEncode::set_simd_limit(GeoEncode::SIMD_NONE);
+    ok &= check_all_agree(codes, "scalar");
+    GeoEncode::set_simd_limit(GeoEncode::SIMD_AVX512);
+
+    // A fraction of the calls are checked, and the calls are estimated,
+    // including those made in other threads.
+    {
+	GeoEncode::reset_shadow();
+	GeoEncode::set_shadow_fraction(0.1);
+	if (GeoEncode::get_shadow_fraction() != 0.1) {
+	    fprintf(stderr, "fraction is %g\n",
+		    GeoEncode::get_shadow_fraction());
+	    ok = false;
+	}
+	vector<double> xyz(30);
+	for (int i = 0; i != 5000; ++i) {
+	    GeoEncode::code_unit_vector_batch(&codes[i], 10, &xyz[0]);
+	}
+	thread t([&codes]() {
+	    vector<double> xyz2(30);
+	    for (int i = 0; i != 5000; ++i) {
+		GeoEncode::code_unit_vector_batch(&codes[i], 10, &xyz2[0]);
+	    }
+	});
+	t.join();
+	GeoEncode::set_shadow_fraction(0);
+	GeoEncode::get_shadow_stats(stats);
+	const ShadowStats & s = stats[GeoEncode::SHADOW_UNIT_VECTORS];
+	if (s.checks < 700 || s.checks > 1300 ||
+	    s.calls < 8000 || s.calls > 10000 || s.mismatches != 0) {
+	    fprintf(stderr, "checked %llu of about %llu calls\n",
+		    (unsigned long long)s.checks,
+		    (unsigned long long)s.calls);
+	    ok = false;
+	}
+    }
+
+    // Mismatches are counted and reported with their descriptions.
+    {
+	GeoEncode::reset_shadow();
+	GeoEncode::set_shadow_fraction(1);
+	for (size_t i = 0; i != GeoEncode::SHADOW_MAX_MISMATCHES + 10; ++i) {
+	    GeoEncode::ShadowCheck check(GeoEncode::SHADOW_COLUMN_FILTER);
+	    if (check.active()) {
+		check.fast_done();
+		check.mismatch("first difference");
+		check.mismatch("second difference");
+	    }
+	}
+	GeoEncode::set_shadow_fraction(0);
+	GeoEncode::get_shadow_stats(stats);
+	vector<GeoEncode::ShadowMismatch> mismatches;
+	GeoEncode::get_shadow_mismatches(mismatches);
+	const ShadowStats & s = stats[GeoEncode::SHADOW_COLUMN_FILTER];
+	if (s.mismatches != GeoEncode::SHADOW_MAX_MISMATCHES + 10 ||
+	    mismatches.size() != GeoEncode::SHADOW_MAX_MISMATCHES ||
+	    mismatches[0].kernel != GeoEncode::SHADOW_COLUMN_FILTER ||
+	    mismatches[0].description != "first difference") {
+	    fprintf(stderr, "%llu mismatches counted, %zu kept\n",
+		    (unsigned long long)s.mismatches, mismatches.size());
+	    ok = false;
+	}
+	string report = GeoEncode::shadow_report();
+	if (report.find("column_filter") == string::npos ||
+	    report.find("column_filter: first difference") == string::npos) {
+	    fprintf(stderr, "report doesn't show the mismatches:\n%s",
+		    report.c_str());
+	    ok = false;
+	}
+
+	GeoEncode::reset_shadow();
+	GeoEncode::get_shadow_stats(stats);
+	GeoEncode::get_shadow_mismatches(mismatches);
+	if (stats[GeoEncode::SHADOW_COLUMN_FILTER].mismatches != 0 ||
+	    !mismatches.empty()) {
+	    fprintf(stderr, "reset didn't clear the mismatches\n");
+	    ok = false;
+	}
+    }
+
+    return ok ? 0 : 1;
+}
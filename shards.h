@@ -0,0 +1,181 @@
+/** @file shards.h
+ * @brief Counters which each thread adds to in a shard of its own.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GEOENCODE_INCLUDED_SHARDS_H
+#define GEOENCODE_INCLUDED_SHARDS_H
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <stdint.h>
+
+namespace GeoEncode {
+
+/** An array of counters, which each thread adds to in a shard of its own.
+ *
+ *  Adding to a counter needs no locks or atomic read-modify-write
+ *  operations, so the counters can be kept in the library's inner loops.
+ *  A thread's shard is registered when it first adds to it, and its values
+ *  are folded into the totals of exited threads when the thread exits.
+ *
+ *  @param Tag A type distinguishing this set of counters from others of
+ *             the same size; each set has its own shards.
+ *  @param N The number of counters.
+ */
+template<typename Tag, size_t N>
+class ShardedCounters {
+  public:
+    /** The counters of one thread.
+     *
+     *  Only the owning thread writes the values, so it can add to them with
+     *  a plain load and store; they are atomic only so that other threads
+     *  can read them for a snapshot.
+     */
+    class Shard {
+	friend class ShardedCounters;
+
+	std::atomic<uint64_t> values[N];
+
+	/// Copying isn't allowed.
+	Shard(const Shard &);
+
+	/// Assignment isn't allowed.
+	void operator=(const Shard &);
+
+      public:
+	Shard();
+
+	~Shard();
+
+	/// Add to a counter.
+	void add(size_t i, uint64_t n) {
+	    values[i].store(values[i].load(std::memory_order_relaxed) + n,
+			    std::memory_order_relaxed);
+	}
+    };
+
+    /// Get the calling thread's shard.
+    static Shard & local() {
+	static thread_local Shard shard;
+	return shard;
+    }
+
+    /** Get the totals of the counters since the last reset().
+     *
+     *  @param result An array of N values to write the totals to.
+     */
+    static void totals(uint64_t * result) {
+	Registry & r = registry();
+	std::lock_guard<std::mutex> guard(r.lock);
+	r.sum(result);
+	for (size_t i = 0; i != N; ++i) {
+	    result[i] -= r.baseline[i];
+	}
+    }
+
+    /// Restart the totals from zero.
+    static void reset() {
+	Registry & r = registry();
+	std::lock_guard<std::mutex> guard(r.lock);
+	r.sum(r.baseline);
+    }
+
+    /** Get the number of bytes of memory used by the shards of the running
+     *  threads and the registry of them.
+     */
+    static size_t memory_used() {
+	Registry & r = registry();
+	std::lock_guard<std::mutex> guard(r.lock);
+	return sizeof(Registry) + r.shards.capacity() * sizeof(const Shard *) +
+		r.shards.size() * sizeof(Shard);
+    }
+
+  private:
+    /// The shards of all threads.
+    struct Registry {
+	std::mutex lock;
+
+	/// The shards of the running threads.
+	std::vector<const Shard *> shards;
+
+	/// Totals from threads which have exited.
+	uint64_t retired[N];
+
+	/// Totals at the last reset, which are subtracted from snapshots.
+	uint64_t baseline[N];
+
+	Registry() {
+	    std::fill(retired, retired + N, 0);
+	    std::fill(baseline, baseline + N, 0);
+	}
+
+	/// Sum the values of all shards, with the lock held.
+	void sum(uint64_t * result) const {
+	    std::copy(retired, retired + N, result);
+	    for (size_t s = 0; s != shards.size(); ++s) {
+		const std::atomic<uint64_t> * values = shards[s]->values;
+		for (size_t i = 0; i != N; ++i) {
+		    result[i] += values[i].load(std::memory_order_relaxed);
+		}
+	    }
+	}
+    };
+
+    /** Get the registry of shards.
+     *
+     *  This is never destroyed, so that threads exiting during static
+     *  destruction can still fold their values into it.
+     */
+    static Registry & registry() {
+	static Registry * r = new Registry;
+	return *r;
+    }
+};
+
+template<typename Tag, size_t N>
+ShardedCounters<Tag, N>::Shard::Shard()
+{
+    for (size_t i = 0; i != N; ++i) {
+	values[i].store(0, std::memory_order_relaxed);
+    }
+    Registry & r = registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+    r.shards.push_back(this);
+}
+
+template<typename Tag, size_t N>
+ShardedCounters<Tag, N>::Shard::~Shard()
+{
+    Registry & r = registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+    for (size_t i = 0; i != N; ++i) {
+	r.retired[i] += values[i].load(std::memory_order_relaxed);
+    }
+    r.shards.erase(std::find(r.shards.begin(), r.shards.end(), this));
+}
+
+}
+
+#endif /* GEOENCODE_INCLUDED_SHARDS_H */
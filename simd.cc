@@ -0,0 +1,61 @@
+/** @file simd.cc
+ * @brief Runtime selection of SIMD kernels.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "simd.h"
+
+using namespace std;
+
+/// The limit set by set_simd_limit().
+static GeoEncode::SimdLevel simd_limit = GeoEncode::SIMD_AVX512;
+
+/// Find the highest SIMD level the processor supports.
+static GeoEncode::SimdLevel
+detect_simd_level()
+{
+#if GEOENCODE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") &&
+	__builtin_cpu_supports("avx512dq")) {
+	return GeoEncode::SIMD_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+	return GeoEncode::SIMD_AVX2;
+    }
+#endif
+    return GeoEncode::SIMD_NONE;
+}
+
+GeoEncode::SimdLevel
+GeoEncode::simd_level()
+{
+    static const SimdLevel detected = detect_simd_level();
+    return detected < simd_limit ? detected : simd_limit;
+}
+
+void
+GeoEncode::set_simd_limit(SimdLevel limit)
+{
+    simd_limit = limit;
+}
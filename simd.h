@@ -0,0 +1,72 @@
+/** @file simd.h
+ * @brief Runtime selection of SIMD kernels.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GEOENCODE_INCLUDED_SIMD_H
+#define GEOENCODE_INCLUDED_SIMD_H
+
+/** Defined to 1 if x86 SIMD kernels are compiled in.
+ *
+ *  The kernels are built with per-function target attributes, so the rest of
+ *  the library doesn't need to be compiled with -mavx2 and the same binary
+ *  runs on older processors.  Define GEOENCODE_NO_SIMD to leave them out.
+ */
+#if !defined GEOENCODE_NO_SIMD && defined __GNUC__ && \
+    (defined __x86_64__ || defined __i386__)
+# define GEOENCODE_X86_SIMD 1
+#else
+# define GEOENCODE_X86_SIMD 0
+#endif
+
+namespace GeoEncode {
+
+/** Levels of SIMD support which kernels can be dispatched to.
+ */
+enum SimdLevel {
+    SIMD_NONE = 0,
+    SIMD_AVX2 = 1,
+    SIMD_AVX512 = 2
+};
+
+/** Get the SIMD level which kernels should use.
+ *
+ *  This is the highest level supported by the processor, capped by any limit
+ *  set with set_simd_limit().
+ */
+extern SimdLevel
+simd_level();
+
+/** Limit the SIMD level used by kernels.
+ *
+ *  This is mainly useful for testing the scalar code paths on a machine
+ *  which supports SIMD, and for comparing their speed.  It should be called
+ *  before any kernels are run concurrently.
+ *
+ *  @param limit The highest level to use.
+ */
+extern void
+set_simd_limit(SimdLevel limit);
+
+}
+
+#endif /* GEOENCODE_INCLUDED_SIMD_H */
@@ -0,0 +1,183 @@
+/** @file sortkey.cc
+ * @brief Sort keys ordering encoded coordinates by distance.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "sortkey.h"
+#include "distance.h"
+#include "metrics.h"
+
+#include <cmath>
+#include <limits>
+
+using namespace std;
+using GeoEncode::PackedCode;
+
+/// The number of distinct values of the first two bytes of a valid code.
+static const unsigned DEGREE_CELLS = 181 * 360;
+
+/// The scale of the fixed-point keys: a rank of 1 would be 2^64.
+static const double KEY_SCALE = 18446744073709551616.0;
+
+/// The largest key for a coordinate, one less than MISSING_KEY.
+static const uint64_t MAX_KEY = ~uint64_t(0) - 1;
+
+/// The number of codes converted to unit vectors at once by compute_keys().
+static const size_t BLOCK_SIZE = 256;
+
+/** Convert the squared chord length between two unit vectors to a key.
+ *
+ *  A quarter of the squared chord length is the rank of the distance, in
+ *  the range 0 to 1.
+ */
+static inline uint64_t
+chord_squared_to_key(double chord_squared)
+{
+    double scaled = chord_squared * (KEY_SCALE * 0.25);
+    // Keys of the antipode (and anything rounded beyond it) are clamped,
+    // which also avoids converting an out of range double.
+    return scaled < double(MAX_KEY) ? uint64_t(scaled) : MAX_KEY;
+}
+
+/// Calculate the squared chord length between two unit vectors.
+static inline double
+chord_squared(const double * u, const double * v)
+{
+    double dx = u[0] - v[0], dy = u[1] - v[1], dz = u[2] - v[2];
+    return dx * dx + dy * dy + dz * dz;
+}
+
+/// Write a key to a buffer, big-endian.
+static inline void
+store_key(uint64_t key, char * ptr)
+{
+    for (int i = GeoEncode::DistanceKeyMaker::KEY_SIZE - 1; i >= 0; --i) {
+	ptr[i] = char(key & 0xff);
+	key >>= 8;
+    }
+}
+
+/** Calculate the keys of codes for the query with unit vector @a xyz.
+ *
+ *  This does the work of DistanceKeyMaker::key_values(), without recording
+ *  a call in the metrics, so that make_keys() is recorded only once.
+ */
+static void
+compute_keys(const double * xyz, const PackedCode * codes, size_t n,
+	     uint64_t * keys)
+{
+    double v[BLOCK_SIZE * 3];
+    for (size_t start = 0; start < n; start += BLOCK_SIZE) {
+	size_t m = min(BLOCK_SIZE, n - start);
+	GeoEncode::code_unit_vector_batch(codes + start, m, v);
+	for (size_t i = 0; i != m; ++i) {
+	    double c = chord_squared(xyz, v + i * 3);
+	    keys[start + i] = chord_squared_to_key(c);
+	}
+    }
+}
+
+GeoEncode::DistanceKeyMaker::DistanceKeyMaker(double lat, double lon)
+{
+    unit_vector(lat, lon, xyz);
+}
+
+uint64_t
+GeoEncode::DistanceKeyMaker::key_value(PackedCode code) const
+{
+    double v[3];
+    code_unit_vector(code, v);
+    return chord_squared_to_key(chord_squared(xyz, v));
+}
+
+void
+GeoEncode::DistanceKeyMaker::make_key(PackedCode code, char * key) const
+{
+    store_key(key_value(code), key);
+}
+
+void
+GeoEncode::DistanceKeyMaker::key_values(const PackedCode * codes, size_t n,
+					uint64_t * keys) const
+{
+    MetricScope metric(METRIC_SORT_KEYS, n, n * sizeof(PackedCode));
+    compute_keys(xyz, codes, n, keys);
+}
+
+void
+GeoEncode::DistanceKeyMaker::make_keys(const PackedCode * codes, size_t n,
+				       string & keys) const
+{
+    MetricScope metric(METRIC_SORT_KEYS, n, n * sizeof(PackedCode));
+    uint64_t values[BLOCK_SIZE];
+    size_t pos = keys.size();
+    keys.resize(pos + n * KEY_SIZE);
+    for (size_t start = 0; start < n; start += BLOCK_SIZE) {
+	size_t m = min(BLOCK_SIZE, n - start);
+	compute_keys(xyz, codes + start, m, values);
+	for (size_t i = 0; i != m; ++i) {
+	    store_key(values[i], &keys[pos]);
+	    pos += KEY_SIZE;
+	}
+    }
+}
+
+string
+GeoEncode::DistanceKeyMaker::operator()(const string & value) const
+{
+    uint64_t best = MISSING_KEY;
+    if (value.size() % 6 == 0) {
+	for (size_t pos = 0; pos != value.size(); pos += 6) {
+	    PackedCode code = pack(value.data() + pos);
+	    if (rare((code >> 32) >= DEGREE_CELLS)) {
+		// Not a valid code, so ignore the whole value.
+		best = MISSING_KEY;
+		break;
+	    }
+	    best = min(best, key_value(code));
+	}
+    }
+    string key(KEY_SIZE, '\0');
+    store_key(best, &key[0]);
+    return key;
+}
+
+double
+GeoEncode::key_to_distance(uint64_t key)
+{
+    if (key == DistanceKeyMaker::MISSING_KEY) {
+	return numeric_limits<double>::infinity();
+    }
+    return rank_to_distance(double(key) / KEY_SCALE);
+}
+
+double
+GeoEncode::key_to_distance(const char * key)
+{
+    const unsigned char * ptr = reinterpret_cast<const unsigned char *>(key);
+    uint64_t value = 0;
+    for (size_t i = 0; i != DistanceKeyMaker::KEY_SIZE; ++i) {
+	value = (value << 8) | ptr[i];
+    }
+    return key_to_distance(value);
+}
@@ -0,0 +1,151 @@
+/** @file sortkey.h
+ * @brief Sort keys ordering encoded coordinates by distance.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GEOENCODE_INCLUDED_SORTKEY_H
+#define GEOENCODE_INCLUDED_SORTKEY_H
+
+#include "geoencode.h"
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace GeoEncode {
+
+/** Make sort keys which order encoded coordinates by their distance from a
+ *  reference point.
+ *
+ *  This is intended for search engines such as Xapian, which sort results
+ *  by comparing a string key made for each document.  The key is the rank
+ *  of the distance (see code_distance_rank()) as a 64 bit fixed-point
+ *  number, stored big-endian, so comparing keys as byte strings orders them
+ *  by distance.  The resolution of the key is about 3 mm for nearby points,
+ *  and better at longer distances.
+ *
+ *  The unit vector of the reference point is calculated when the key maker
+ *  is created, and each code is converted with code_unit_vector(), so
+ *  making a key needs a table lookup and a few multiplications, and no
+ *  decoding to degrees or calls to libm.
+ */
+class DistanceKeyMaker {
+    /** The unit vector of the reference point.
+     */
+    double xyz[3];
+
+  public:
+    /** The length of a key in bytes.
+     */
+    static const size_t KEY_SIZE = 8;
+
+    /** The key value for a missing or invalid coordinate.
+     *
+     *  This sorts after the key for every coordinate, including the
+     *  antipode of the reference point.
+     */
+    static const uint64_t MISSING_KEY = ~uint64_t(0);
+
+    /** Create a key maker.
+     *
+     *  @param lat The latitude of the reference point in degrees.
+     *  @param lon The longitude of the reference point in degrees.
+     */
+    DistanceKeyMaker(double lat, double lon);
+
+    /** Calculate the key for a code, as an integer.
+     *
+     *  Integer keys compare in the same order as the byte strings.
+     */
+    uint64_t key_value(PackedCode code) const;
+
+    /** Write the key for a code to a buffer of KEY_SIZE bytes.
+     */
+    void make_key(PackedCode code, char * key) const;
+
+    /** Calculate the keys for an array of codes, as integers.
+     *
+     *  @param codes The codes.
+     *  @param n The number of codes.
+     *  @param keys An array of @a n values to write the keys to.  These are
+     *              the same as key_value() gives for each code.
+     */
+    void key_values(const PackedCode * codes, size_t n,
+		    uint64_t * keys) const;
+
+    /** Calculate the keys for an array of codes, appending them to a
+     *  string.
+     *
+     *  The string is extended by KEY_SIZE bytes for each code.
+     */
+    void make_keys(const PackedCode * codes, size_t n,
+		   std::string & keys) const;
+
+    /** Calculate the keys for a vector of codes, as integers.
+     */
+    void key_values(const std::vector<PackedCode> & codes,
+		    std::vector<uint64_t> & keys) const {
+	keys.resize(codes.size());
+	if (!codes.empty()) key_values(&codes[0], codes.size(), &keys[0]);
+    }
+
+    /** Get the number of bytes of memory used by the key maker.
+     *
+     *  The table of sines and cosines used to find the unit vectors of
+     *  codes is shared; see distance_tables_memory_used().
+     */
+    size_t memory_used() const { return sizeof(*this); }
+
+    /** Make the key for a stored value.
+     *
+     *  @param value One or more encoded coordinates, of 6 bytes each, such
+     *               as a document value holding the locations of a
+     *               document.
+     *
+     *  @returns The key for the nearest of the coordinates, or
+     *           MISSING_KEY if the value is empty, its length isn't a
+     *           multiple of 6, or it holds an invalid code.
+     */
+    std::string operator()(const std::string & value) const;
+};
+
+/** Convert a key from DistanceKeyMaker to a distance.
+ *
+ *  @param key The key value.
+ *
+ *  @returns The distance in metres, which is within about 3 mm of the
+ *           distance from code_distance() for the code the key was made
+ *           for, or infinity for DistanceKeyMaker::MISSING_KEY.
+ */
+extern double
+key_to_distance(uint64_t key);
+
+/** Convert a key string from DistanceKeyMaker to a distance.
+ *
+ *  @param key A buffer of DistanceKeyMaker::KEY_SIZE bytes.
+ */
+extern double
+key_to_distance(const char * key);
+
+}
+
+#endif /* GEOENCODE_INCLUDED_SORTKEY_H */
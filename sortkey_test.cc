@@ -0,0 +1,184 @@
+/** @file sortkey_test.cc
+ * @brief Tests for sort keys ordering encoded coordinates by distance.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "sortkey.h"
+#include "distance.h"
+#include "testutils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+using GeoEncode::PackedCode;
+
+/// Encode a coordinate as a packed code.
+/** Check the keys for some codes against code_distance(), and that the key
+ *  strings, integer keys and batch keys agree.
+ */
+static bool
+check_keys(double lat, double lon, const vector<PackedCode> & codes)
+{
+    GeoEncode::DistanceKeyMaker keymaker(lat, lon);
+    PackedCode ref = pack_coord(lat, lon);
+    vector<uint64_t> values;
+    keymaker.key_values(codes, values);
+    string keys;
+    keymaker.make_keys(codes.empty() ? NULL : &codes[0], codes.size(), keys);
+    if (keys.size() != codes.size() * GeoEncode::DistanceKeyMaker::KEY_SIZE) {
+	fprintf(stderr, "make_keys gave %zu bytes for %zu codes\n",
+		keys.size(), codes.size());
+	return false;
+    }
+
+    vector<pair<string, double> > sorted;
+    for (size_t i = 0; i != codes.size(); ++i) {
+	const char * key = keys.data() + i * 8;
+	uint64_t value = keymaker.key_value(codes[i]);
+	char buf[8];
+	keymaker.make_key(codes[i], buf);
+	string encoded;
+	GeoEncode::unpack(codes[i], encoded);
+	if (value != values[i] || memcmp(buf, key, 8) != 0 ||
+	    keymaker(encoded) != string(key, 8)) {
+	    fprintf(stderr, "keys for code %llx disagree\n",
+		    (unsigned long long)codes[i]);
+	    return false;
+	}
+
+	// The reference point is rounded by encoding, so allow for that.
+	double expected = GeoEncode::code_distance(ref, codes[i]);
+	double got = GeoEncode::key_to_distance(key);
+	if (fabs(got - expected) > 1 + expected * 1e-9 ||
+	    got != GeoEncode::key_to_distance(value)) {
+	    fprintf(stderr, "key distance %.6f from (%g,%g), expected %.6f\n",
+		    got, lat, lon, expected);
+	    return false;
+	}
+	sorted.push_back(make_pair(string(key, 8), expected));
+    }
+
+    // Sorting the keys as strings orders the codes by distance, apart from
+    // ties within the resolution of the keys.
+    sort(sorted.begin(), sorted.end());
+    for (size_t i = 1; i < sorted.size(); ++i) {
+	if (sorted[i].second < sorted[i - 1].second - 2) {
+	    fprintf(stderr, "keys out of order: %.6f after %.6f\n",
+		    sorted[i].second, sorted[i - 1].second);
+	    return false;
+	}
+    }
+    return true;
+}
+
+/** Check the resolution of keys for nearby points.
+ */
+static bool
+check_resolution()
+{
+    GeoEncode::DistanceKeyMaker keymaker(51.5, -0.1);
+    PackedCode ref = pack_coord(51.5, -0.1);
+    int lat16, lon16;
+    GeoEncode::decode_16ths(ref, lat16, lon16);
+    uint64_t previous = keymaker.key_value(ref);
+    for (int i = 1; i != 100; ++i) {
+	PackedCode code = GeoEncode::encode_16ths(lat16 + i, lon16);
+	uint64_t value = keymaker.key_value(code);
+	double expected = GeoEncode::code_distance(ref, code);
+	double got = GeoEncode::key_to_distance(value);
+	if (value <= previous || fabs(got - expected) > 0.01) {
+	    fprintf(stderr, "key for %d 16ths gives %.6f, expected %.6f\n",
+		    i, got, expected);
+	    return false;
+	}
+	previous = value;
+    }
+    return true;
+}
+
+/** Check keys for stored values holding several coordinates, or none.
+ */
+static bool
+check_values()
+{
+    GeoEncode::DistanceKeyMaker keymaker(10, 20);
+    string value;
+    GeoEncode::encode(-40, 100, value);
+    GeoEncode::encode(11, 21, value);
+    GeoEncode::encode(80, 300, value);
+    string key = keymaker(value);
+    char expected[8];
+    keymaker.make_key(pack_coord(11, 21), expected);
+    if (key != string(expected, 8)) {
+	fprintf(stderr, "key for several coordinates isn't for the nearest\n");
+	return false;
+    }
+
+    const string missing(8, '\xff');
+    if (keymaker(string()) != missing ||
+	keymaker(value.substr(0, 7)) != missing ||
+	keymaker(string(6, '\xff')) != missing) {
+	fprintf(stderr, "key for a bad value isn't the missing key\n");
+	return false;
+    }
+    if (!(GeoEncode::key_to_distance(missing.data()) > 1e100)) {
+	fprintf(stderr, "missing key doesn't give an infinite distance\n");
+	return false;
+    }
+
+    // The antipode sorts before a missing value.
+    string antipode;
+    GeoEncode::encode(-10, 200, antipode);
+    if (!(keymaker(antipode) < missing)) {
+	fprintf(stderr, "key for the antipode isn't below the missing key\n");
+	return false;
+    }
+    return true;
+}
+
+int main() {
+    bool ok = true;
+
+    vector<PackedCode> codes;
+    make_codes(3000, 51.5, -0.1, 0.01, codes);
+    ok &= check_keys(51.5, -0.1, codes);
+    make_codes(3000, 51.5, -0.1, 180, codes);
+    ok &= check_keys(51.5, -0.1, codes);
+    make_codes(1000, 0, 0, 1, codes);
+    ok &= check_keys(0, 0, codes);
+    ok &= check_keys(0, 359.99, codes);
+    make_codes(1000, 89.9, 0, 1, codes);
+    ok &= check_keys(90, 0, codes);
+    ok &= check_keys(-89.5, 45, codes);
+    codes.clear();
+    ok &= check_keys(0, 0, codes);
+
+    ok &= check_resolution();
+    ok &= check_values();
+
+    return ok ? 0 : 1;
+}
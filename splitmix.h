@@ -0,0 +1,68 @@
+/** @file splitmix.h
+ * @brief The random number generator used inside the library and benchmarks.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GEOENCODE_INCLUDED_SPLITMIX_H
+#define GEOENCODE_INCLUDED_SPLITMIX_H
+
+#include <stdint.h>
+
+namespace GeoEncode {
+
+/** Mix the bits of a 64-bit value, so that every bit of the result depends
+ *  on every bit of the value.
+ *
+ *  This is the output function of SplitMix64.
+ */
+inline uint64_t
+mix64(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/** Get the next value from a SplitMix64 generator.
+ *
+ *  SplitMix64 passes the usual statistical tests, needs only one word of
+ *  state, and gives the same sequence for a seed on every platform.
+ *
+ *  @param state The state of the generator, which is advanced.
+ */
+inline uint64_t
+splitmix64(uint64_t & state)
+{
+    return mix64(state += 0x9e3779b97f4a7c15ULL);
+}
+
+/** Get a uniform deviate in [0, 1) from 53 bits of a random value.
+ */
+inline double
+unit_interval(uint64_t value)
+{
+    return (value >> 11) * (1.0 / 9007199254740992.0);
+}
+
+}
+
+#endif /* GEOENCODE_INCLUDED_SPLITMIX_H */
@@ -0,0 +1,87 @@
+/** @file testutils.h
+ * @brief Helpers for making test data, shared by the tests.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GEOENCODE_INCLUDED_TESTUTILS_H
+#define GEOENCODE_INCLUDED_TESTUTILS_H
+
+#include "geoencode.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/** Get the packed code for a coordinate.
+ */
+inline GeoEncode::PackedCode
+pack_coord(double lat, double lon)
+{
+    std::string encoded;
+    GeoEncode::encode(lat, lon, encoded);
+    return GeoEncode::pack(encoded.data());
+}
+
+/** Get a random offset of up to @a spread either way.
+ */
+inline double
+random_offset(double spread)
+{
+    return ((random() * 2.0 * spread) / RAND_MAX) - spread;
+}
+
+/** Get the code for a random point within @a spread degrees of a centre, or
+ *  anywhere if @a spread is 180 or more.
+ *
+ *  Latitudes beyond a pole are moved to the pole.
+ */
+inline GeoEncode::PackedCode
+random_code_near(double lat, double lon, double spread)
+{
+    if (spread >= 180) {
+	lat = ((random() * 180.0) / RAND_MAX) - 90.0;
+	lon = ((random() * 360.0) / RAND_MAX);
+    } else {
+	lat += random_offset(spread);
+	lon += random_offset(spread);
+    }
+    return pack_coord(std::max(-90.0, std::min(90.0, lat)),
+		      std::fmod(lon + 360, 360));
+}
+
+/** Make a sorted set of codes for random points within @a spread degrees of
+ *  a centre, or anywhere if @a spread is 180 or more.
+ */
+inline void
+make_codes(size_t n, double lat, double lon, double spread,
+	   std::vector<GeoEncode::PackedCode> & codes)
+{
+    codes.clear();
+    for (size_t i = 0; i != n; ++i) {
+	codes.push_back(random_code_near(lat, lon, spread));
+    }
+    std::sort(codes.begin(), codes.end());
+}
+
+#endif /* GEOENCODE_INCLUDED_TESTUTILS_H */
@@ -0,0 +1,272 @@
+/** @file workingset_bench.cc
+ * @brief Report memory footprints, and time decoding at each working set
+ *        size from the L1 cache to main memory.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "bench.h"
+#include "codecolumn.h"
+#include "corridor.h"
+#include "distance.h"
+#include "geoencode.h"
+#include "hashindex.h"
+#include "learnedindex.h"
+#include "lsmindex.h"
+#include "metrics.h"
+#include "rtree.h"
+#include "sortkey.h"
+#include "workload.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace std;
+using GeoEncode::PackedCode;
+
+/// Default number of points for the footprint report.
+static const size_t DEFAULT_POINTS = 1000000;
+
+/// Seed for generating the points, so runs are comparable.
+static const uint64_t POINTS_SEED = 42;
+
+/// Seed for generating the query box.
+static const uint64_t BOX_SEED = 4242;
+
+/// The smallest working set swept, in bytes.
+static const uint64_t MIN_BYTES = 4096;
+
+/// The largest working set swept, in bytes, if there is memory for it.
+static const uint64_t MAX_BYTES = uint64_t(4) << 30;
+
+/// The most distinct points generated; larger sets repeat them.
+static const size_t MAX_DISTINCT = 1 << 20;
+
+/** The least number of operations in a repetition, so that small working
+ *  sets are timed over many passes.
+ */
+static const size_t MIN_OPS = 1 << 22;
+
+/// Format a number of bytes as a short label, such as "16KB".
+static string
+size_label(uint64_t bytes)
+{
+    static const char * const units[] = { "B", "KB", "MB", "GB", "TB" };
+    unsigned unit = 0;
+    while (bytes >= 1024 && bytes % 1024 == 0 && unit != 4) {
+	bytes /= 1024;
+	++unit;
+    }
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%llu%s", (unsigned long long)bytes,
+	     units[unit]);
+    return buf;
+}
+
+/// Print one line of the footprint report.
+static void
+report(const char * object, size_t bytes, size_t points)
+{
+    if (points) {
+	printf("%-32s %14zu bytes %10.2f bytes/point\n", object, bytes,
+	       double(bytes) / points);
+    } else {
+	printf("%-32s %14zu bytes\n", object, bytes);
+    }
+}
+
+/** Build each index over a set of points and report the memory it uses,
+ *  with that of the decoders and shared tables.
+ */
+static void
+report_footprints(const vector<pair<double, double> > & points)
+{
+    vector<PackedCode> codes;
+    GeoEncode::encode_workload(points, codes);
+    size_t n = codes.size();
+    printf("Memory used for %zu points:\n", n);
+    report("encoded codes", n * 6, n);
+
+    vector<PackedCode> sorted(codes);
+    sort(sorted.begin(), sorted.end());
+    {
+	GeoEncode::CodeColumn column;
+	column.build(sorted);
+	report("CodeColumn", column.memory_used(), n);
+    }
+    {
+	string serialised;
+	GeoEncode::RTree::build(&codes[0], n, serialised);
+	GeoEncode::RTree tree;
+	tree.open(serialised.data(), serialised.size());
+	report("RTree", tree.memory_used(), n);
+    }
+    {
+	GeoEncode::CodeHashIndex index;
+	for (size_t i = 0; i != n; ++i) {
+	    index.insert(codes[i], GeoEncode::CodeHashIndex::Id(i));
+	}
+	report("CodeHashIndex", index.memory_used(), n);
+    }
+    {
+	GeoEncode::LearnedIndex index;
+	index.build(&sorted[0], n);
+	report("LearnedIndex (without codes)", index.memory_used(), n);
+    }
+    {
+	GeoEncode::LsmIndex index;
+	for (size_t i = 0; i != n; ++i) {
+	    index.insert(codes[i], i);
+	}
+	index.flush();
+	report("LsmIndex", index.memory_used(), n);
+    }
+    {
+	vector<pair<double, double> > line;
+	line.push_back(make_pair(51.5, -0.1));
+	line.push_back(make_pair(48.9, 2.35));
+	line.push_back(make_pair(52.5, 13.4));
+	GeoEncode::Corridor corridor(line, 10000);
+	report("Corridor (3 points, 10 km)", corridor.memory_used(), 0);
+    }
+    GeoEncode::DecoderWithBoundingBox bbox(50, 0, 52, 2);
+    report("DecoderWithBoundingBox", bbox.memory_used(), 0);
+    GeoEncode::DistanceKeyMaker key_maker(51.5, -0.1);
+    report("DistanceKeyMaker", key_maker.memory_used(), 0);
+    GeoEncode::CellDistanceBounds bounds(51.5, -0.1);
+    report("CellDistanceBounds", bounds.memory_used(), 0);
+    report("distance tables", GeoEncode::distance_tables_memory_used(), 0);
+    report("metrics", GeoEncode::metrics_memory_used(), 0);
+    printf("\n");
+}
+
+/** Time decoding and filtering a working set of a given size.
+ *
+ *  Sequential decoding streams through the set, so the hardware prefetcher
+ *  hides much of the latency of each level of the memory hierarchy; random
+ *  decoding reads codes at random positions, so it slows sharply once the
+ *  set no longer fits in each cache.
+ */
+static void
+bench_size(GeoEncode::BenchRunner & runner, uint64_t bytes,
+	   const string & encoded,
+	   const GeoEncode::DecoderWithBoundingBox & bbox)
+{
+    size_t n = bytes / 6;
+    size_t passes = max(size_t(1), MIN_OPS / n);
+    string label = size_label(bytes);
+    const char * ptr = encoded.data();
+
+    GeoEncode::BenchResult * result =
+	    runner.run("decode/" + label, n * passes, [&]() {
+	double sum = 0;
+	for (size_t p = 0; p != passes; ++p) {
+	    for (size_t i = 0; i != n; ++i) {
+		double lat, lon;
+		GeoEncode::decode(ptr + i * 6, 6, lat, lon);
+		sum += lat + lon;
+	    }
+	}
+	return size_t(sum);
+    });
+    if (result) result->extra.push_back(make_pair("bytes", double(bytes)));
+
+    result = runner.run("decode_random/" + label, MIN_OPS, [&]() {
+	double sum = 0;
+	uint64_t x = 1;
+	for (size_t i = 0; i != MIN_OPS; ++i) {
+	    x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+	    size_t pos = size_t(((x >> 32) * n) >> 32);
+	    double lat, lon;
+	    GeoEncode::decode(ptr + pos * 6, 6, lat, lon);
+	    sum += lat + lon;
+	}
+	return size_t(sum);
+    });
+    if (result) result->extra.push_back(make_pair("bytes", double(bytes)));
+
+    result = runner.run("filter/" + label, n * passes, [&]() {
+	size_t count = 0;
+	for (size_t p = 0; p != passes; ++p) {
+	    for (size_t i = 0; i != n; ++i) {
+		double lat, lon;
+		count += bbox.decode(ptr + i * 6, 6, lat, lon);
+	    }
+	}
+	return count;
+    });
+    if (result) result->extra.push_back(make_pair("bytes", double(bytes)));
+}
+
+int main(int argc, char ** argv) {
+    GeoEncode::BenchRunner runner;
+    if (!runner.parse_args(argc, argv)) {
+	return 1;
+    }
+    size_t n = runner.points ? runner.points : DEFAULT_POINTS;
+
+    vector<pair<double, double> > points;
+    GeoEncode::make_workload(GeoEncode::WORKLOAD_UNIFORM, n, POINTS_SEED,
+			     points);
+    report_footprints(points);
+
+    // Keep the largest working set to half of the physical memory.
+    uint64_t max_bytes = MAX_BYTES;
+    long pages = sysconf(_SC_PHYS_PAGES), page_size = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && page_size > 0) {
+	uint64_t half = uint64_t(pages) * uint64_t(page_size) / 2;
+	while (max_bytes > half) max_bytes /= 4;
+    }
+    if (max_bytes < MAX_BYTES) {
+	printf("Sweeping up to %s, as there isn't memory for %s\n\n",
+	       size_label(max_bytes).c_str(), size_label(MAX_BYTES).c_str());
+    }
+
+    // Larger working sets repeat the distinct points, which still have to
+    // be read from memory.
+    GeoEncode::make_workload(GeoEncode::WORKLOAD_UNIFORM, MAX_DISTINCT,
+			     POINTS_SEED, points);
+    string distinct;
+    distinct.reserve(MAX_DISTINCT * 6);
+    for (size_t i = 0; i != points.size(); ++i) {
+	GeoEncode::encode(points[i].first, points[i].second, distinct);
+    }
+    vector<GeoEncode::QueryBox> boxes;
+    GeoEncode::make_query_boxes(points, 0.01, 1, BOX_SEED, boxes);
+    GeoEncode::DecoderWithBoundingBox bbox(boxes[0].lat1, boxes[0].lon1,
+					   boxes[0].lat2, boxes[0].lon2);
+
+    string encoded;
+    for (uint64_t bytes = MIN_BYTES; bytes <= max_bytes; bytes *= 4) {
+	size_t len = size_t(bytes / 6 * 6);
+	while (encoded.size() < len) {
+	    encoded.append(distinct, 0,
+			   min(distinct.size(), len - encoded.size()));
+	}
+	bench_size(runner, bytes, encoded, bbox);
+    }
+
+    return runner.finish() ? 0 : 1;
+}
@@ -0,0 +1,481 @@
+/** @file workload.cc
+ * @brief Generators of realistic point sets and queries for benchmarks.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "workload.h"
+
+#include "splitmix.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+using GeoEncode::PackedCode;
+
+typedef vector<pair<double, double> > Points;
+
+/// Kilometres per degree of latitude.
+static const double KM_PER_DEGREE = 111.195;
+
+/// Conversion factor from degrees to radians.
+static const double RADIANS = M_PI / 180.0;
+
+/// The number of points sampled when sizing query boxes.
+static const size_t BOX_SAMPLE = 20000;
+
+/// The names of the kinds of workload.
+static const char * const workload_names[] = {
+    "uniform", "cities", "roads", "polar", "antimeridian"
+};
+
+/** A centre of a cluster of points.
+ */
+struct Centre {
+    /** The coordinate of the centre in degrees.
+     */
+    double lat, lon;
+
+    /** The relative number of points around the centre.
+     */
+    double weight;
+
+    /** The standard deviation of the distance of points from the centre in
+     *  each direction, in kilometres.
+     */
+    double sigma;
+};
+
+/** Large cities, with populations of their urban areas in millions.
+ *
+ *  The spread is proportional to the square root of the population, so the
+ *  density at the centre is about the same for each.
+ */
+static const Centre cities[] = {
+    { 35.68, 139.69, 37, 0 }, { 28.61, 77.21, 31, 0 },
+    { 31.23, 121.47, 27, 0 }, { -23.55, -46.63, 22, 0 },
+    { 19.43, -99.13, 22, 0 }, { 30.04, 31.24, 21, 0 },
+    { 23.81, 90.41, 21, 0 }, { 19.08, 72.88, 20, 0 },
+    { 39.90, 116.41, 20, 0 }, { 34.69, 135.50, 19, 0 },
+    { 40.71, -74.01, 19, 0 }, { 24.86, 67.01, 16, 0 },
+    { -34.60, -58.38, 15, 0 }, { 41.01, 28.98, 15, 0 },
+    { 22.57, 88.36, 15, 0 }, { 6.52, 3.38, 14, 0 },
+    { 14.60, 120.98, 14, 0 }, { -22.91, -43.17, 13, 0 },
+    { 23.13, 113.26, 13, 0 }, { 34.05, -118.24, 12, 0 },
+    { 55.76, 37.62, 12, 0 }, { 48.86, 2.35, 11, 0 },
+    { -6.21, 106.85, 11, 0 }, { -12.05, -77.04, 11, 0 },
+    { 13.76, 100.50, 10, 0 }, { 37.57, 126.98, 10, 0 },
+    { 51.51, -0.13, 9, 0 }, { 41.88, -87.63, 9, 0 },
+    { 35.69, 51.39, 9, 0 }, { 40.42, -3.70, 7, 0 },
+    { -26.20, 28.05, 6, 0 }, { 43.65, -79.38, 6, 0 },
+    { 1.35, 103.82, 6, 0 }, { -33.87, 151.21, 5, 0 },
+    { -1.29, 36.82, 5, 0 }, { -36.85, 174.76, 1.7, 0 },
+    { 61.22, -149.90, 0.3, 0 }, { 64.15, -21.94, 0.2, 0 }
+};
+
+/** Settlements near the 180 degree meridian.
+ */
+static const Centre antimeridian_centres[] = {
+    { -18.14, 178.44, 3, 15 },	// Suva
+    { -17.80, 177.42, 1, 10 },	// Nadi
+    { 64.73, 177.51, 1, 5 },	// Anadyr
+    { -43.95, -176.55, 0.5, 8 },	// Chatham Islands
+    { -13.83, -171.76, 1, 10 },	// Apia
+    { 51.88, -176.66, 0.3, 5 },	// Adak
+    { -16.78, -179.33, 0.5, 20 }	// Taveuni and the dateline
+};
+
+namespace {
+
+/** A small random number generator giving the same sequence everywhere,
+ *  built on splitmix64().
+ */
+class Random {
+    uint64_t state;
+
+    /** A second normal deviate from the last pair generated.
+     */
+    double spare;
+
+    bool have_spare;
+
+  public:
+    explicit Random(uint64_t seed)
+	: state(seed), spare(0), have_spare(false) { }
+
+    uint64_t next() { return GeoEncode::splitmix64(state); }
+
+    /// A uniform deviate in [0, 1).
+    double uniform() { return GeoEncode::unit_interval(next()); }
+
+    /// A uniform deviate in [a, b).
+    double uniform(double a, double b) {
+	return a + (b - a) * uniform();
+    }
+
+    /// A uniform integer in [0, n).
+    size_t below(size_t n) {
+	return size_t(uniform() * n);
+    }
+
+    /// A standard normal deviate, by the Box-Muller transform.
+    double normal() {
+	if (have_spare) {
+	    have_spare = false;
+	    return spare;
+	}
+	double u = 1 - uniform();
+	double v = uniform();
+	double r = sqrt(-2 * log(u));
+	spare = r * sin(2 * M_PI * v);
+	have_spare = true;
+	return r * cos(2 * M_PI * v);
+    }
+};
+
+}
+
+/// Wrap a longitude to the range 0 to 360.
+static double
+wrap_longitude(double lon)
+{
+    lon = fmod(lon, 360.0);
+    if (lon < 0) lon += 360;
+    return lon >= 360 ? 0 : lon;
+}
+
+/** Move a coordinate by a distance north and east, in kilometres.
+ *
+ *  This uses a local flat approximation, which is fine for the few tens of
+ *  kilometres used here.  Moving past a pole continues down the other side.
+ */
+static pair<double, double>
+offset(double lat, double lon, double north, double east)
+{
+    double c = max(cos(lat * RADIANS), 1e-6);
+    lon += east / (KM_PER_DEGREE * c);
+    lat += north / KM_PER_DEGREE;
+    if (lat > 90) {
+	lat = 180 - lat;
+	lon += 180;
+    } else if (lat < -90) {
+	lat = -180 - lat;
+	lon += 180;
+    }
+    return make_pair(lat, wrap_longitude(lon));
+}
+
+/// A point uniformly distributed over the surface of the earth.
+static pair<double, double>
+uniform_point(Random & random)
+{
+    double lat = asin(random.uniform(-1, 1)) / RADIANS;
+    return make_pair(lat, random.uniform(0, 360));
+}
+
+/** Pick a centre at random, in proportion to the weights.
+ */
+static const Centre &
+pick_centre(Random & random, const Centre * centres, size_t n,
+	    double total_weight)
+{
+    double x = random.uniform() * total_weight;
+    for (size_t i = 0; i + 1 < n; ++i) {
+	x -= centres[i].weight;
+	if (x < 0) return centres[i];
+    }
+    return centres[n - 1];
+}
+
+/// Total weight of an array of centres.
+static double
+total_weight(const Centre * centres, size_t n)
+{
+    double total = 0;
+    for (size_t i = 0; i != n; ++i) total += centres[i].weight;
+    return total;
+}
+
+/** Generate points in Gaussian clusters around centres.
+ *
+ *  @param background The proportion of points spread uniformly instead.
+ */
+static void
+make_clusters(Random & random, const Centre * centres, size_t ncentres,
+	      double background, size_t n, Points & points)
+{
+    double total = total_weight(centres, ncentres);
+    for (size_t i = 0; i != n; ++i) {
+	if (random.uniform() < background) {
+	    points.push_back(uniform_point(random));
+	    continue;
+	}
+	const Centre & c = pick_centre(random, centres, ncentres, total);
+	double sigma = c.sigma ? c.sigma : 5 * sqrt(c.weight);
+	points.push_back(offset(c.lat, c.lon, random.normal() * sigma,
+				random.normal() * sigma));
+    }
+}
+
+/** Generate points along roads leading out of cities.
+ *
+ *  Each road is a chain of 5 km segments, starting near a city and turning
+ *  a little at each vertex.  Points are spread evenly along the roads and
+ *  scattered a few metres either side, as vehicle positions are.
+ */
+static void
+make_roads(Random & random, size_t n, Points & points)
+{
+    const size_t ncities = sizeof(cities) / sizeof(cities[0]);
+    double total = total_weight(cities, ncities);
+    const size_t nroads = 200;
+    const double segment_km = 5;
+
+    vector<Points> roads(nroads);
+    size_t total_segments = 0;
+    for (size_t r = 0; r != nroads; ++r) {
+	const Centre & c = pick_centre(random, cities, ncities, total);
+	double sigma = 5 * sqrt(c.weight);
+	pair<double, double> p = offset(c.lat, c.lon,
+					random.normal() * sigma,
+					random.normal() * sigma);
+	double heading = random.uniform(0, 2 * M_PI);
+	size_t segments = 4 + random.below(60);
+	roads[r].push_back(p);
+	for (size_t s = 0; s != segments; ++s) {
+	    heading += random.normal() * 0.25;
+	    p = offset(p.first, p.second, segment_km * cos(heading),
+		       segment_km * sin(heading));
+	    roads[r].push_back(p);
+	}
+	total_segments += segments;
+    }
+
+    for (size_t i = 0; i != n; ++i) {
+	// Choosing a segment uniformly spreads points evenly by length.
+	size_t s = random.below(total_segments);
+	size_t r = 0;
+	while (s >= roads[r].size() - 1) {
+	    s -= roads[r].size() - 1;
+	    ++r;
+	}
+	const pair<double, double> & a = roads[r][s];
+	const pair<double, double> & b = roads[r][s + 1];
+	double t = random.uniform();
+	double dlon = b.second - a.second;
+	if (dlon > 180) dlon -= 360;
+	if (dlon < -180) dlon += 360;
+	double lat = a.first + (b.first - a.first) * t;
+	double lon = a.second + dlon * t;
+	points.push_back(offset(lat, lon, random.normal() * 0.005,
+				random.normal() * 0.005));
+    }
+}
+
+/** Generate points concentrated around the poles.
+ */
+static void
+make_polar(Random & random, size_t n, Points & points)
+{
+    const double cap_z = sin(80 * RADIANS);
+    for (size_t i = 0; i != n; ++i) {
+	double x = random.uniform();
+	if (x < 0.05) {
+	    // Exactly at a pole, with an arbitrary longitude.
+	    double lat = random.uniform() < 0.6 ? 90 : -90;
+	    points.push_back(make_pair(lat, random.uniform(0, 360)));
+	} else if (x < 0.85) {
+	    // Uniformly over the area of a cap.
+	    double lat = asin(random.uniform(cap_z, 1)) / RADIANS;
+	    if (x >= 0.5) lat = -lat;
+	    points.push_back(make_pair(lat, random.uniform(0, 360)));
+	} else {
+	    points.push_back(uniform_point(random));
+	}
+    }
+}
+
+/** Generate points around the 180 degree meridian.
+ */
+static void
+make_antimeridian(Random & random, size_t n, Points & points)
+{
+    const size_t ncentres =
+	    sizeof(antimeridian_centres) / sizeof(antimeridian_centres[0]);
+    for (size_t i = 0; i != n; ++i) {
+	if (random.uniform() < 0.5) {
+	    make_clusters(random, antimeridian_centres, ncentres, 0, 1,
+			  points);
+	} else {
+	    // A band 2 degrees either side of the meridian.
+	    double lat = random.uniform(-60, 70);
+	    points.push_back(make_pair(lat,
+				       wrap_longitude(random.uniform(178,
+								     182))));
+	}
+    }
+}
+
+const char *
+GeoEncode::workload_name(WorkloadKind kind)
+{
+    return unsigned(kind) < WORKLOAD_KINDS ? workload_names[kind] : "";
+}
+
+bool
+GeoEncode::workload_from_name(const string & name, WorkloadKind & kind)
+{
+    for (unsigned i = 0; i != WORKLOAD_KINDS; ++i) {
+	if (name == workload_names[i]) {
+	    kind = WorkloadKind(i);
+	    return true;
+	}
+    }
+    return false;
+}
+
+void
+GeoEncode::make_workload(WorkloadKind kind, size_t n, uint64_t seed,
+			 Points & points)
+{
+    points.clear();
+    points.reserve(n);
+    Random random(seed);
+    switch (kind) {
+	case WORKLOAD_UNIFORM:
+	    for (size_t i = 0; i != n; ++i) {
+		points.push_back(uniform_point(random));
+	    }
+	    break;
+	case WORKLOAD_CITIES:
+	    make_clusters(random, cities, sizeof(cities) / sizeof(cities[0]),
+			  0.05, n, points);
+	    break;
+	case WORKLOAD_ROADS:
+	    make_roads(random, n, points);
+	    break;
+	case WORKLOAD_POLAR:
+	    make_polar(random, n, points);
+	    break;
+	case WORKLOAD_ANTIMERIDIAN:
+	    make_antimeridian(random, n, points);
+	    break;
+    }
+}
+
+void
+GeoEncode::encode_workload(const Points & points, vector<PackedCode> & codes)
+{
+    codes.clear();
+    codes.reserve(points.size());
+    string encoded;
+    for (size_t i = 0; i != points.size(); ++i) {
+	encoded.clear();
+	encode(points[i].first, points[i].second, encoded);
+	codes.push_back(pack(encoded.data()));
+    }
+}
+
+/// Check whether a point is in a box.
+static inline bool
+in_box(const pair<double, double> & p, const GeoEncode::QueryBox & box)
+{
+    if (p.first < box.lat1 || p.first > box.lat2) return false;
+    if (box.lon1 <= box.lon2) {
+	return p.second >= box.lon1 && p.second <= box.lon2;
+    }
+    return p.second >= box.lon1 || p.second <= box.lon2;
+}
+
+/// Count the points in a box.
+static size_t
+count_in_box(const Points & points, const GeoEncode::QueryBox & box)
+{
+    size_t count = 0;
+    for (size_t i = 0; i != points.size(); ++i) {
+	count += in_box(points[i], box);
+    }
+    return count;
+}
+
+/** Make a box of a given half-height in degrees, about square on the
+ *  ground, around a centre.
+ */
+static GeoEncode::QueryBox
+box_around(const pair<double, double> & centre, double half_height)
+{
+    GeoEncode::QueryBox box;
+    box.lat1 = max(-90.0, centre.first - half_height);
+    box.lat2 = min(90.0, centre.first + half_height);
+    double c = cos(centre.first * RADIANS);
+    double half_width = c > half_height / 180 ? half_height / c : 180;
+    if (half_width >= 180) {
+	box.lon1 = 0;
+	box.lon2 = nextafter(360.0, 0.0);
+    } else {
+	box.lon1 = wrap_longitude(centre.second - half_width);
+	box.lon2 = wrap_longitude(centre.second + half_width);
+    }
+    box.selectivity = 0;
+    return box;
+}
+
+void
+GeoEncode::make_query_boxes(const Points & points, double selectivity,
+			    size_t count, uint64_t seed,
+			    vector<QueryBox> & boxes)
+{
+    boxes.clear();
+    if (points.empty()) return;
+    Random random(seed);
+
+    Points sample;
+    if (points.size() <= BOX_SAMPLE) {
+	sample = points;
+    } else {
+	for (size_t i = 0; i != BOX_SAMPLE; ++i) {
+	    sample.push_back(points[random.below(points.size())]);
+	}
+    }
+
+    double target = selectivity * sample.size();
+    for (size_t b = 0; b != count; ++b) {
+	const pair<double, double> & centre =
+		points[random.below(points.size())];
+	// Bisect on the logarithm of the size, from about 1 cm to the whole
+	// earth.
+	double lo = log(1e-7), hi = log(180.0);
+	for (int i = 0; i != 40; ++i) {
+	    double mid = (lo + hi) * 0.5;
+	    if (count_in_box(sample, box_around(centre, exp(mid))) < target) {
+		lo = mid;
+	    } else {
+		hi = mid;
+	    }
+	}
+	QueryBox box = box_around(centre, exp(hi));
+	box.selectivity = double(count_in_box(points, box)) / points.size();
+	boxes.push_back(box);
+    }
+}
@@ -0,0 +1,151 @@
+/** @file workload.h
+ * @brief Generators of realistic point sets and queries for benchmarks.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef GEOENCODE_INCLUDED_WORKLOAD_H
+#define GEOENCODE_INCLUDED_WORKLOAD_H
+
+#include "geoencode.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+namespace GeoEncode {
+
+/** Kinds of point sets which can be generated.
+ */
+enum WorkloadKind {
+    /** Points spread evenly over the surface of the earth.
+     */
+    WORKLOAD_UNIFORM,
+
+    /** Gaussian clusters around the centres of large cities, weighted by
+     *  population, with a sparse uniform background.
+     */
+    WORKLOAD_CITIES,
+
+    /** Points along meandering roads between nearby cities, a few metres
+     *  either side of the centre line.
+     */
+    WORKLOAD_ROADS,
+
+    /** Most points within 10 degrees of a pole, including some exactly at
+     *  the poles, where every longitude is the same place.
+     */
+    WORKLOAD_POLAR,
+
+    /** Clusters and a band of points around the 180 degree meridian, where
+     *  longitudes from sources using the range -180 to 180 jump from one
+     *  end to the other.  (The encoding itself wraps at 0 instead, which
+     *  the clusters around London, Paris, Madrid and Lagos in
+     *  WORKLOAD_CITIES straddle.)
+     */
+    WORKLOAD_ANTIMERIDIAN
+};
+
+/** The number of kinds of workload.
+ */
+const unsigned WORKLOAD_KINDS = 5;
+
+/** Get the name of a kind of workload, such as "cities".
+ */
+extern const char *
+workload_name(WorkloadKind kind);
+
+/** Look up a kind of workload by name.
+ *
+ *  @returns false if @a name isn't the name of a workload.
+ */
+extern bool
+workload_from_name(const std::string & name, WorkloadKind & kind);
+
+/** Generate a set of points.
+ *
+ *  The points are produced by a generator implemented here rather than the
+ *  standard library's distributions, so the same seed gives the same points
+ *  on every platform.
+ *
+ *  @param kind The kind of point set.
+ *  @param n The number of points.
+ *  @param seed The seed for the random number generator.
+ *  @param points A vector to replace the contents of with the points, as
+ *                (latitude, longitude) pairs in degrees, with longitudes
+ *                in the range 0 to 360.
+ */
+extern void
+make_workload(WorkloadKind kind, size_t n, uint64_t seed,
+	      std::vector<std::pair<double, double> > & points);
+
+/** Encode a set of points as packed codes.
+ *
+ *  @param points The points, as (latitude, longitude) pairs in degrees.
+ *  @param codes A vector to replace the contents of with the codes, in the
+ *               same order as the points.
+ */
+extern void
+encode_workload(const std::vector<std::pair<double, double> > & points,
+		std::vector<PackedCode> & codes);
+
+/** A bounding box query.
+ */
+struct QueryBox {
+    /** The southern and northern edges of the box.
+     */
+    double lat1, lat2;
+
+    /** The western and eastern edges of the box.  The box crosses the 0/360
+     *  boundary if @a lon2 is less than @a lon1.
+     */
+    double lon1, lon2;
+
+    /** The proportion of the points which the box contains.
+     */
+    double selectivity;
+};
+
+/** Generate bounding box queries of a chosen selectivity for a set of
+ *  points.
+ *
+ *  Each box is centred on one of the points, as queries usually look where
+ *  the data is, and is about square on the ground.  Its size is found by
+ *  bisection so that it contains close to the requested proportion of the
+ *  points, counted on a sample of up to 20000 of them.  Boxes are clipped
+ *  at the poles, and may cross the 0/360 boundary.
+ *
+ *  @param points The points, as from make_workload().
+ *  @param selectivity The proportion of the points each box should contain,
+ *                     between 0 and 1.
+ *  @param count The number of boxes to generate.
+ *  @param seed The seed for the random number generator.
+ *  @param boxes A vector to replace the contents of with the boxes.
+ */
+extern void
+make_query_boxes(const std::vector<std::pair<double, double> > & points,
+		 double selectivity, size_t count, uint64_t seed,
+		 std::vector<QueryBox> & boxes);
+
+}
+
+#endif /* GEOENCODE_INCLUDED_WORKLOAD_H */
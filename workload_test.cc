@@ -0,0 +1,167 @@
+/** @file workload_test.cc
+ * @brief Tests for the benchmark workload generators.
+ */
+/* Copyright (C) 2026 The GeoEncode authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+#include "workload.h"
+
+#include <cmath>
+#include <cstdio>
+
+using namespace std;
+
+typedef vector<pair<double, double> > Points;
+
+/** Check that a workload is reproducible, in range, and has the shape
+ *  expected of its kind.
+ */
+static bool
+check_workload(GeoEncode::WorkloadKind kind)
+{
+    const char * name = GeoEncode::workload_name(kind);
+    GeoEncode::WorkloadKind kind2;
+    if (!GeoEncode::workload_from_name(name, kind2) || kind2 != kind) {
+	fprintf(stderr, "workload name %s didn't look up\n", name);
+	return false;
+    }
+
+    Points points, again, other;
+    GeoEncode::make_workload(kind, 20000, 1, points);
+    GeoEncode::make_workload(kind, 20000, 1, again);
+    GeoEncode::make_workload(kind, 20000, 2, other);
+    if (points.size() != 20000 || points != again || points == other) {
+	fprintf(stderr, "%s: points aren't determined by the seed\n", name);
+	return false;
+    }
+
+    size_t polar = 0, antimeridian = 0, at_pole = 0;
+    for (size_t i = 0; i != points.size(); ++i) {
+	double lat = points[i].first, lon = points[i].second;
+	if (!(lat >= -90 && lat <= 90 && lon >= 0 && lon < 360)) {
+	    fprintf(stderr, "%s: point (%g,%g) out of range\n",
+		    name, lat, lon);
+	    return false;
+	}
+	polar += fabs(lat) >= 80;
+	at_pole += fabs(lat) == 90;
+	antimeridian += fabs(lon - 180) <= 5;
+    }
+    if (kind == GeoEncode::WORKLOAD_POLAR &&
+	(polar < points.size() * 0.8 || at_pole == 0)) {
+	fprintf(stderr, "polar: only %zu points near the poles\n", polar);
+	return false;
+    }
+    if (kind == GeoEncode::WORKLOAD_ANTIMERIDIAN &&
+	antimeridian < points.size() * 0.8) {
+	fprintf(stderr, "antimeridian: only %zu points near 180\n",
+		antimeridian);
+	return false;
+    }
+    if (kind == GeoEncode::WORKLOAD_UNIFORM &&
+	fabs(polar - points.size() * (1 - sin(80 * M_PI / 180))) >
+	    points.size() * 0.005) {
+	fprintf(stderr, "uniform: %zu points near the poles\n", polar);
+	return false;
+    }
+
+    vector<GeoEncode::PackedCode> codes;
+    GeoEncode::encode_workload(points, codes);
+    if (codes.size() != points.size()) {
+	fprintf(stderr, "%s: encoded %zu points\n", name, codes.size());
+	return false;
+    }
+    return true;
+}
+
+/** Check that query boxes contain about the requested proportion of the
+ *  points.
+ */
+static bool
+check_boxes(GeoEncode::WorkloadKind kind, double selectivity)
+{
+    Points points;
+    GeoEncode::make_workload(kind, 50000, 7, points);
+    vector<GeoEncode::QueryBox> boxes, again;
+    GeoEncode::make_query_boxes(points, selectivity, 10, 3, boxes);
+    GeoEncode::make_query_boxes(points, selectivity, 10, 3, again);
+    if (boxes.size() != 10) {
+	fprintf(stderr, "made %zu boxes\n", boxes.size());
+	return false;
+    }
+    double total = 0;
+    for (size_t b = 0; b != boxes.size(); ++b) {
+	const GeoEncode::QueryBox & box = boxes[b];
+	if (box.lat1 != again[b].lat1 || box.lon1 != again[b].lon1 ||
+	    box.lat2 != again[b].lat2 || box.lon2 != again[b].lon2) {
+	    fprintf(stderr, "boxes aren't determined by the seed\n");
+	    return false;
+	}
+	if (!(box.lat1 <= box.lat2 && box.lon1 >= 0 && box.lon2 < 360)) {
+	    fprintf(stderr, "bad box (%g,%g)-(%g,%g)\n",
+		    box.lat1, box.lon1, box.lat2, box.lon2);
+	    return false;
+	}
+
+	// Recount the points, to check the recorded selectivity.
+	size_t count = 0;
+	for (size_t i = 0; i != points.size(); ++i) {
+	    double lat = points[i].first, lon = points[i].second;
+	    bool in_lon = box.lon1 <= box.lon2 ?
+		    (lon >= box.lon1 && lon <= box.lon2) :
+		    (lon >= box.lon1 || lon <= box.lon2);
+	    count += (lat >= box.lat1 && lat <= box.lat2 && in_lon);
+	}
+	if (fabs(double(count) / points.size() - box.selectivity) > 1e-12) {
+	    fprintf(stderr, "box holds %zu points, selectivity %g\n",
+		    count, box.selectivity);
+	    return false;
+	}
+	total += box.selectivity;
+    }
+    double mean = total / boxes.size();
+    if (mean < selectivity * 0.5 || mean > selectivity * 2) {
+	fprintf(stderr, "%s: boxes for selectivity %g hold %g\n",
+		GeoEncode::workload_name(kind), selectivity, mean);
+	return false;
+    }
+    return true;
+}
+
+int main() {
+    bool ok = true;
+
+    for (unsigned k = 0; k != GeoEncode::WORKLOAD_KINDS; ++k) {
+	GeoEncode::WorkloadKind kind = GeoEncode::WorkloadKind(k);
+	ok &= check_workload(kind);
+	ok &= check_boxes(kind, 0.01);
+	ok &= check_boxes(kind, 0.2);
+    }
+
+    GeoEncode::WorkloadKind kind;
+    if (GeoEncode::workload_from_name("nowhere", kind)) {
+	fprintf(stderr, "unknown workload name was accepted\n");
+	ok = false;
+    }
+
+    return ok ? 0 : 1;
+}